@@ -38,6 +38,12 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    const int MOVING_BLOCK = 16;//number of streamed rows each thread works on at once, multiple of 4 for dsdot4
+    const int TILE_BYTES = 256 * 1024;//size of the tile of in-memory rows that a block sweeps across, should fit in L2
+}
+
 AString AlgorithmCiftiCorrelation::getCommandSwitch()
 {
     return "-cifti-correlation";
@@ -239,37 +245,13 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
                 outRows[i - startrow] = CaretArray<float>(numRows);
             }
         }
-        int curRow = 0;//because we can't trust the order threads hit the critical section
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int i = 0; i < numRows; ++i)
+        vector<int> rangeRows(endrow - startrow), rangePos(numRows, -1);
+        for (int i = startrow; i < endrow; ++i)
         {
-            float movingRrs;
-            int myrow;
-            const float* movingRow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myrow, movingRrs);
-            }
-            for (int j = startrow; j < endrow; ++j)
-            {
-                if (myrow >= startrow && myrow < endrow)//check whether we are in the output memory area
-                {
-                    if (j >= myrow)//if so, only compute one half, and store both places
-                    {
-                        float cacheRrs;
-                        const float* cacheRow = getRow(j, cacheRrs, true);
-                        outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                        outRows[myrow - startrow][j] = outRows[j - startrow][myrow];
-                    }
-                } else {
-                    float cacheRrs;
-                    const float* cacheRow = getRow(j, cacheRrs, true);
-                    outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                }
-            }
+            rangeRows[i - startrow] = i;
+            rangePos[i] = i - startrow;
         }
+        correlateRange(rangeRows, rangePos, outRows, fisherZ);
         for (int i = startrow; i < endrow; ++i)
         {
             myCiftiOut->setRow(outRows[i - startrow], i);
@@ -409,13 +391,11 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             cacheRow(i);
         }
     }
-    CaretArray<int> indexReverse(numRows, -1);
     for (int startrow = 0; startrow < numSelected; startrow += numCacheRows)
     {
         int endrow = startrow + numCacheRows;
         if (endrow > numSelected) endrow = numSelected;
         outRows.resize(endrow - startrow);
-        int curRow = 0;//because we can't trust the order threads hit the critical section
         for (int i = startrow; i < endrow; ++i)
         {
             if (!cacheFullInput)
@@ -426,42 +406,17 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             {
                 outRows[i - startrow] = CaretArray<float>(numRows);
             }
-            indexReverse[ciftiIndexList[i].first] = i;
         }
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int i = 0; i < numRows; ++i)
+        vector<int> rangeRows(endrow - startrow), rangePos(numRows, -1);
+        for (int i = startrow; i < endrow; ++i)
         {
-            float movingRrs;
-            int myrow;
-            const float* movingRow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myrow, movingRrs);
-            }
-            for (int j = startrow; j < endrow; ++j)
-            {
-                if (indexReverse[myrow] != -1)//check if we are on a row that is in the output memory range
-                {
-                    if (indexReverse[myrow] <= j)//if so, only compute one of the elements, then store it both places
-                    {
-                        float cacheRrs;
-                        const float* cacheRow = getRow(ciftiIndexList[j].first, cacheRrs, true);
-                        outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                        outRows[indexReverse[myrow] - startrow][ciftiIndexList[j].first] = outRows[j - startrow][myrow];
-                    }
-                } else {
-                    float cacheRrs;
-                    const float* cacheRow = getRow(ciftiIndexList[j].first, cacheRrs, true);
-                    outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                }
-            }
+            rangeRows[i - startrow] = ciftiIndexList[i].first;
+            rangePos[ciftiIndexList[i].first] = i - startrow;
         }
+        correlateRange(rangeRows, rangePos, outRows, fisherZ);
         for (int i = startrow; i < endrow; ++i)
         {
             myCiftiOut->setRow(outRows[i - startrow], ciftiIndexList[i].second);
-            indexReverse[ciftiIndexList[i].first] = -1;
         }
         if (!cacheFullInput)
         {
@@ -517,30 +472,27 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
     AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, leftRoiPtr, rightRoiPtr, cerebRoiPtr, volRoiPtr, weights, fisherZ, memLimitGB, noDemean, covariance);//HACK: pass through our progress object
 }
 
-float AlgorithmCiftiCorrelation::correlate(const float* row1, const float& rrs1, const float* row2, const float& rrs2, const bool& fisherZ)
+float AlgorithmCiftiCorrelation::dotToCorrelation(const double& accum, const float& rrs1, const float& rrs2, const bool& sameRow, const bool& fisherZ)
 {
     double r;
-    if (row1 == row2 && !m_covariance)
+    if (sameRow && !m_covariance)
     {
         r = 1.0;//short circuit for same row
     } else {
         if (m_weightedMode)
-        {
-            int numWeights = (int)m_weightIndexes.size();//because we compacted the data in the row to not include any zero weights
-            double accum = dsdot(row1, row2, numWeights);//these have already had the weighted row means subtracted out, and weights applied
+        {//accum is from rows that have already had the weighted row means subtracted out, and weights applied
             if (m_covariance)
             {
                 if (m_binaryWeights)
                 {
-                    r = accum / numWeights;
+                    r = accum / m_weightIndexes.size();
                 } else {
                     r = accum / rrs1;//NOTE: will equal rrs2 as it only depends on weights, and is not square root
                 }
             } else {
-                r = accum / (rrs1 * rrs2);//as do these
+                r = accum / (rrs1 * rrs2);
             }
-        } else {
-            double accum = dsdot(row1, row2, m_numCols);//these have already had the row means subtracted out
+        } else {//these have already had the row means subtracted out
             if (m_covariance)
             {
                 r = accum / m_numCols;
@@ -564,6 +516,88 @@ float AlgorithmCiftiCorrelation::correlate(const float* row1, const float& rrs1,
     return r;
 }
 
+int AlgorithmCiftiCorrelation::getDotLength() const
+{
+    if (m_weightedMode) return (int)m_weightIndexes.size();//because we compacted the data in the row to not include any zero weights
+    return m_numCols;
+}
+
+void AlgorithmCiftiCorrelation::correlateRange(const vector<int>& rangeRows, const vector<int>& rangePos, vector<CaretArray<float> >& outRows, const bool& fisherZ)
+{//rangeRows are the cached input rows whose output rows are in memory, rangePos maps an input row to its position in rangeRows, or -1
+    const int numRows = m_inputCifti->getNumberOfRows();
+    const int rangeSize = (int)rangeRows.size();
+    const int dotLength = getDotLength();
+    CaretAssert((int)rangePos.size() == numRows && (int)outRows.size() == rangeSize);
+    vector<const float*> rangeData(rangeSize);
+    vector<float> rangeRrs(rangeSize);
+    for (int i = 0; i < rangeSize; ++i)
+    {
+        rangeData[i] = getRow(rangeRows[i], rangeRrs[i], true);
+    }
+    //each thread takes a block of MOVING_BLOCK consecutive rows, and sweeps them across tiles of the range rows that fit in L2,
+    //using dsdot4 so that every range row loaded from memory gets used for 4 dot products at once
+    int tileSize = TILE_BYTES / (int)(sizeof(float) * max(dotLength, 1));
+    if (tileSize < 1) tileSize = 1;
+    const int numBlocks = (numRows + MOVING_BLOCK - 1) / MOVING_BLOCK;
+    int curBlock = 0;//because we can't trust the order threads hit the critical section
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int b = 0; b < numBlocks; ++b)
+    {
+        int myBlock;
+#pragma omp critical
+        {//request rows in order, so that the readahead stays mostly sequential
+            myBlock = curBlock;
+            ++curBlock;
+        }
+        const int blockStart = myBlock * MOVING_BLOCK;
+        const int blockSize = min(MOVING_BLOCK, numRows - blockStart);
+        const float* movingData[MOVING_BLOCK];
+        float movingRrs[MOVING_BLOCK];
+        for (int i = 0; i < blockSize; ++i)
+        {
+            movingData[i] = getRow(blockStart + i, movingRrs[i], false, i);//CiftiFile reads are thread-safe, and can run concurrently on uncompressed input
+        }
+        for (int tileStart = 0; tileStart < rangeSize; tileStart += tileSize)
+        {
+            const int tileEnd = min(tileStart + tileSize, rangeSize);
+            for (int groupStart = 0; groupStart < blockSize; groupStart += 4)
+            {
+                const int groupSize = min(4, blockSize - groupStart);
+                const float* groupData[4];
+                int groupPos[4];
+                int firstNeeded = rangeSize;
+                for (int q = 0; q < 4; ++q)
+                {
+                    groupData[q] = movingData[groupStart + min(q, groupSize - 1)];//pad a partial group by repeating its last row
+                    if (q < groupSize)
+                    {
+                        groupPos[q] = rangePos[blockStart + groupStart + q];
+                        //rows that are in the output range only compute half of the square, and store each value both places
+                        firstNeeded = min(firstNeeded, (groupPos[q] == -1 ? 0 : groupPos[q]));
+                    }
+                }
+                for (int j = max(tileStart, firstNeeded); j < tileEnd; ++j)
+                {
+                    double accum[4];
+                    dsdot4(rangeData[j], groupData, dotLength, accum);
+                    for (int q = 0; q < groupSize; ++q)
+                    {
+                        const int myrow = blockStart + groupStart + q;
+                        if (groupPos[q] == -1)
+                        {
+                            outRows[j][myrow] = dotToCorrelation(accum[q], movingRrs[groupStart + q], rangeRrs[j], false, fisherZ);
+                        } else if (groupPos[q] <= j) {
+                            const float value = dotToCorrelation(accum[q], movingRrs[groupStart + q], rangeRrs[j], groupPos[q] == j, fisherZ);
+                            outRows[j][myrow] = value;
+                            outRows[groupPos[q]][rangeRows[j]] = value;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
 void AlgorithmCiftiCorrelation::init(const CiftiFile* input, const vector<float>* weights, const bool& noDemean, const bool& covariance)
 {
     m_noDemean = noDemean;
@@ -572,6 +606,15 @@ void AlgorithmCiftiCorrelation::init(const CiftiFile* input, const vector<float>
     m_rowInfo.resize(m_inputCifti->getNumberOfRows());
     m_cacheUsed = 0;
     m_numCols = m_inputCifti->getNumberOfColumns();
+#ifdef CARET_OMP
+    m_tempRows.resize(omp_get_max_threads() * MOVING_BLOCK);
+#else
+    m_tempRows.resize(MOVING_BLOCK);
+#endif
+    for (int i = 0; i < (int)m_tempRows.size(); ++i)
+    {
+        m_tempRows[i] = CaretArray<float>(m_numCols);
+    }
     if (weights != NULL)
     {
         m_weightedMode = true;
@@ -638,7 +681,7 @@ void AlgorithmCiftiCorrelation::clearCache()
     m_cacheUsed = 0;
 }
 
-const float* AlgorithmCiftiCorrelation::getRow(const int& ciftiIndex, float& rootResidSqr, const bool& mustBeCached)
+const float* AlgorithmCiftiCorrelation::getRow(const int& ciftiIndex, float& rootResidSqr, const bool& mustBeCached, const int& tempSlot)
 {
     float* ret;
     CaretAssertVectorIndex(m_rowInfo, ciftiIndex);
@@ -651,7 +694,7 @@ const float* AlgorithmCiftiCorrelation::getRow(const int& ciftiIndex, float& roo
         {
             throw AlgorithmException("something very bad happened, notify the developers");
         }
-        ret = getTempRow();
+        ret = getTempRow(tempSlot);
         m_inputCifti->getRow(ret, ciftiIndex);
         if (!m_rowInfo[ciftiIndex].m_haveCalculated)
         {
@@ -710,7 +753,7 @@ void AlgorithmCiftiCorrelation::computeRowStats(const float* row, float& mean, f
             {
                 accum += m_weights[i];
             }
-            rootResidSqr = accum;//repurpose this variable to store the weight sum - NOTE: don't take sqrt in case negative sum (whatever that means), so must not divide by both in correlate() in covariance mode
+            rootResidSqr = accum;//repurpose this variable to store the weight sum - NOTE: don't take sqrt in case negative sum (whatever that means), so must not divide by both in dotToCorrelation() in covariance mode
         }
     } else {
         if (m_weightedMode)
@@ -769,27 +812,15 @@ void AlgorithmCiftiCorrelation::doSubtract(float* row, const float& mean)
     }
 }
 
-float* AlgorithmCiftiCorrelation::getTempRow()
-{
+float* AlgorithmCiftiCorrelation::getTempRow(const int& tempSlot)
+{//m_tempRows is allocated in init(), because this is called from multiple threads outside of any critical section
+    CaretAssert(tempSlot >= 0 && tempSlot < MOVING_BLOCK);
 #ifdef CARET_OMP
-    int oldsize = (int)m_tempRows.size();
     int threadNum = omp_get_thread_num();
-    if (threadNum >= oldsize)
-    {
-        m_tempRows.resize(threadNum + 1);
-        for (int i = oldsize; i <= threadNum; ++i)
-        {
-            m_tempRows[i] = CaretArray<float>(m_numCols);
-        }
-    }
-    return m_tempRows[threadNum].getArray();
+    CaretAssertVectorIndex(m_tempRows, threadNum * MOVING_BLOCK + tempSlot);
+    return m_tempRows[threadNum * MOVING_BLOCK + tempSlot].getArray();
 #else
-    if (m_tempRows.size() == 0)
-    {
-        m_tempRows.resize(1);
-        m_tempRows[0] = CaretArray<float>(m_numCols);
-    }
-    return m_tempRows[0].getArray();
+    return m_tempRows[tempSlot].getArray();
 #endif
 }
 
@@ -800,9 +831,9 @@ int AlgorithmCiftiCorrelation::numRowsForMem(const float& memLimitGB, bool& cach
     int64_t targetBytes = (int64_t)(memLimitGB * 1024 * 1024 * 1024);
     if (m_inputCifti->isInMemory()) targetBytes -= numRows * m_numCols * 4;//count in-memory input against the total too
 #ifdef CARET_OMP
-    targetBytes -= inrowBytes * omp_get_max_threads();
+    targetBytes -= (int64_t)inrowBytes * MOVING_BLOCK * omp_get_max_threads();
 #else
-    targetBytes -= inrowBytes;//1 row in memory that isn't a reference to cache
+    targetBytes -= (int64_t)inrowBytes * MOVING_BLOCK;//1 block of rows in memory that aren't references to cache
 #endif
     targetBytes -= numRows * sizeof(RowInfo);//storage for mean, stdev, and info about caching
     int64_t perRowBytes = inrowBytes + outrowBytes;//cache and memory collation for output rows
@@ -28,12 +28,18 @@
 #include "dot_wrapper.h"
 #include "FileInformation.h"
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    const int64_t B_BLOCK_SIZE = 256;//rows of cifti B to normalize and correlate at a time
+}
+
 AString AlgorithmCiftiCrossCorrelation::getCommandSwitch()
 {
     return "-cifti-cross-correlation";
@@ -128,30 +134,51 @@ AlgorithmCiftiCrossCorrelation::AlgorithmCiftiCrossCorrelation(ProgressObject* m
     {
         chunkSize = numRowsForMem(memLimitGB);
     }
+    const int dotLength = (int)(m_weightedMode ? m_weightIndexes.size() : m_numCols);//rows are compacted when there are zero weights
+    const int64_t blockSize = min(B_BLOCK_SIZE, m_numRowsB);
     vector<vector<float> > outscratch(chunkSize, vector<float>(m_numRowsB));//allocate output rows
+    vector<vector<float> > blockB(blockSize, vector<float>(m_numCols));
+    vector<const float*> blockPointers(blockSize);
+    for (int64_t i = 0; i < blockSize; ++i)
+    {
+        blockPointers[i] = blockB[i].data();
+    }
     for (int64_t chunkStart = 0; chunkStart < m_numRowsA; chunkStart += chunkSize)
     {
         int64_t chunkEnd = chunkStart + chunkSize;
         if (chunkEnd > m_numRowsA) chunkEnd = m_numRowsA;
         cacheRowsA(chunkStart, chunkEnd);
-        int64_t counter = 0;
+        for (int64_t blockStart = 0; blockStart < m_numRowsB; blockStart += blockSize)
+        {//each block of B rows is normalized once per pass, then multiplied against all cached A rows while it is hot in cache
+            const int64_t numInBlock = min(blockSize, m_numRowsB - blockStart);
+            for (int64_t i = 0; i < numInBlock; ++i)
+            {
+                m_ciftiB->getRow(blockB[i].data(), blockStart + i);//read in order, one at a time
+            }
 #pragma omp CARET_PARFOR schedule(dynamic)
-        for (int64_t i = 0; i < m_numRowsB; ++i)
-        {
-            float rrsB;
-            int64_t indB;
-            const float* rowB;
-#pragma omp critical
+            for (int64_t i = 0; i < numInBlock; ++i)
             {
-                indB = counter;//manually in-order rows because we need to read them from disk, and can't request more than one at a time
-                ++counter;
-                rowB = getRowB(indB, rrsB);
+                adjustRow(blockB[i].data(), m_rowInfoB[blockStart + i]);
             }
-            for (int indA = chunkStart; indA < chunkEnd; ++indA)
+#pragma omp CARET_PARFOR schedule(dynamic)
+            for (int64_t indA = chunkStart; indA < chunkEnd; ++indA)
             {
-                float rrsA;
-                const float* rowA = getCachedRowA(indA, rrsA);
-                outscratch[indA - chunkStart][indB] = correlate(rowA, rrsA, rowB, rrsB, fisherZ);
+                const float* rowA = getCachedRowA(indA);
+                float* outRow = outscratch[indA - chunkStart].data() + blockStart;
+                double results[4];
+                int64_t j = 0;
+                for (; j + 4 <= numInBlock; j += 4)
+                {
+                    dsdot4(rowA, blockPointers.data() + j, dotLength, results);
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        outRow[j + k] = finishCorrelation(results[k], fisherZ);
+                    }
+                }
+                for (; j < numInBlock; ++j)
+                {
+                    outRow[j] = finishCorrelation(dsdot(rowA, blockPointers[j], dotLength), fisherZ);
+                }
             }
         }
         for (int64_t indA = chunkStart; indA < chunkEnd; ++indA)
@@ -212,11 +239,7 @@ int64_t AlgorithmCiftiCrossCorrelation::numRowsForMem(const float& memLimitGB)
     if (m_ciftiOut->isInMemory()) targetBytes -= sizeof(float) * m_numRowsA * m_numRowsB;//count only in-memory output against total, the only time inputs might be in memory is in the GUI
     int64_t bytesPerInputRow = sizeof(float) * m_numCols;//this means we expect the user to give "current free memory" as the limit
     int64_t bytesPerOutputRow = sizeof(float) * m_numRowsB;
-#ifdef CARET_OMP
-    targetBytes -= bytesPerInputRow * omp_get_max_threads();//subtract the temporary row memory
-#else
-    targetBytes -= bytesPerInputRow;
-#endif
+    targetBytes -= bytesPerInputRow * min(B_BLOCK_SIZE, m_numRowsB);//subtract the block of B rows
     int64_t ret = 1;
     if (targetBytes < 1)
     {
@@ -242,72 +265,28 @@ int64_t AlgorithmCiftiCrossCorrelation::numRowsForMem(const float& memLimitGB)
     return ret;
 }
 
-float AlgorithmCiftiCrossCorrelation::correlate(const float* row1, const float& rrs1, const float* row2, const float& rrs2, const bool& fisherZ)
+float AlgorithmCiftiCrossCorrelation::finishCorrelation(const double& r, const bool& fisherZ)
 {
-    double r;
-    if (m_weightedMode)
-    {
-        int numWeights = (int)m_weightIndexes.size();//because we compacted the data in the row to not include any zero weights
-        double accum = dsdot(row1, row2, numWeights);//these have already had the weighted row means subtracted out, and weights applied
-        r = accum / (rrs1 * rrs2);//as do these
-    } else {
-        double accum = dsdot(row1, row2, m_numCols);//these have already had the row means subtracted out
-        r = accum / (rrs1 * rrs2);
-    }
+    double ret = r;//rows are already normalized, so the dot product is the correlation
     if (fisherZ)
     {
-        if (r > 0.999999) r = 0.999999;//prevent inf
-        if (r < -0.999999) r = -0.999999;//prevent -inf
-        return 0.5 * log((1 + r) / (1 - r));
+        if (ret > 0.999999) ret = 0.999999;//prevent inf
+        if (ret < -0.999999) ret = -0.999999;//prevent -inf
+        return 0.5 * log((1 + ret) / (1 - ret));
     } else {
-        if (r > 1.0) r = 1.0;//don't output anything silly
-        if (r < -1.0) r = -1.0;
-        return r;
+        if (ret > 1.0) ret = 1.0;//don't output anything silly
+        if (ret < -1.0) ret = -1.0;
+        return ret;
     }
 }
 
-const float* AlgorithmCiftiCrossCorrelation::getCachedRowA(const int64_t& ciftiIndex, float& rootResidSqr)
+const float* AlgorithmCiftiCrossCorrelation::getCachedRowA(const int64_t& ciftiIndex)
 {
     CaretAssertVectorIndex(m_rowInfoA, ciftiIndex);
     CaretAssert(m_rowInfoA[ciftiIndex].m_cacheIndex != -1);
-    rootResidSqr = m_rowInfoA[ciftiIndex].m_rootResidSqr;
     return m_rowCacheA[m_rowInfoA[ciftiIndex].m_cacheIndex].m_row.data();
 }
 
-const float* AlgorithmCiftiCrossCorrelation::getRowB(const int64_t& ciftiIndex, float& rootResidSqr)
-{
-    CaretAssertVectorIndex(m_rowInfoB, ciftiIndex);
-    float* ret = getTempRowB();//purely allocation, one array per thread
-    m_ciftiB->getRow(ret, ciftiIndex);
-    adjustRow(ret, m_rowInfoB[ciftiIndex]);
-    rootResidSqr = m_rowInfoB[ciftiIndex].m_rootResidSqr;//NOTE: must do this AFTER adjustRow, because it is not computed before it on the first chunk
-    return ret;
-}
-
-float* AlgorithmCiftiCrossCorrelation::getTempRowB()
-{
-#ifdef CARET_OMP
-    int oldsize = (int)m_tempRowsB.size();
-    int threadNum = omp_get_thread_num();
-    if (threadNum >= oldsize)
-    {
-        m_tempRowsB.resize(threadNum + 1);
-        for (int i = oldsize; i <= threadNum; ++i)
-        {
-            m_tempRowsB[i] = CaretArray<float>(m_numCols);
-        }
-    }
-    return m_tempRowsB[threadNum].getArray();
-#else
-    if (m_tempRowsB.size() == 0)
-    {
-        m_tempRowsB.resize(1);
-        m_tempRowsB[0] = CaretArray<float>(m_numCols);
-    }
-    return m_tempRowsB[0].getArray();
-#endif
-}
-
 void AlgorithmCiftiCrossCorrelation::cacheRowsA(const int64_t& begin, const int64_t& end)
 {
     CaretAssert(begin > -1);
@@ -390,6 +369,7 @@ void AlgorithmCiftiCrossCorrelation::adjustRow(float* row, RowInfo& info)
             info.m_rootResidSqr = sqrt(accum);
         }
     }
+    const float scale = 1.0f / info.m_rootResidSqr;//normalize, so that correlation is just the dot product - a constant row gives NaN, same as dividing afterwards
     if (m_weightedMode)//COMPACT data, subtract mean, multiply by square root of weights if applicable
     {
         int64_t mycount = (int64_t)m_weightIndexes.size();
@@ -397,18 +377,18 @@ void AlgorithmCiftiCrossCorrelation::adjustRow(float* row, RowInfo& info)
         {
             for (int64_t i = 0; i < mycount; ++i)
             {
-                row[i] = row[m_weightIndexes[i]] - info.m_mean;
+                row[i] = (row[m_weightIndexes[i]] - info.m_mean) * scale;
             }
         } else {
             for (int64_t i = 0; i < mycount; ++i)
             {
-                row[i] = sqrt(m_weights[i]) * (row[m_weightIndexes[i]] - info.m_mean);//this is so the numerator doesn't get squared weights applied, since this happens to both rows
+                row[i] = sqrt(m_weights[i]) * (row[m_weightIndexes[i]] - info.m_mean) * scale;//this is so the numerator doesn't get squared weights applied, since this happens to both rows
             }
         }
     } else {
         for (int64_t i = 0; i < m_numCols; ++i)
         {
-            row[i] -= info.m_mean;
+            row[i] = (row[i] - info.m_mean) * scale;
         }
     }
 }
@@ -51,7 +51,6 @@ namespace caret {
         const CiftiFile* m_ciftiA, *m_ciftiB, *m_ciftiOut;//output is really only to check if it is in-memory for numRowsForMem
         std::vector<CacheRow> m_rowCacheA;//we only cache from cifti A
         std::vector<RowInfo> m_rowInfoA, m_rowInfoB;
-        std::vector<CaretArray<float> > m_tempRowsB;//reuse return values in getRowB instead of reallocating
         std::vector<float> m_weights;
         std::vector<int> m_weightIndexes;
         bool m_binaryWeights, m_weightedMode;
@@ -59,11 +58,9 @@ namespace caret {
         AlgorithmCiftiCrossCorrelation();
         void init(const CiftiFile* myCiftiA, const CiftiFile* myCiftiB, const CiftiFile* myCiftiOut, const std::vector<float>* weights);
         int64_t numRowsForMem(const float& memLimitGB);//call after init()
-        float* getTempRowB();//only used for getRowB, A rows are pulled from cache
-        const float* getCachedRowA(const int64_t& ciftiIndex, float& rootResidSqr);//retrieve already cached rows
-        const float* getRowB(const int64_t& ciftiIndex, float& rootResidSqr);
-        void adjustRow(float* row, RowInfo& info);
-        float correlate(const float* row1, const float& rrs1, const float* row2, const float& rrs2, const bool& fisherZ);
+        const float* getCachedRowA(const int64_t& ciftiIndex);//retrieve already cached rows
+        void adjustRow(float* row, RowInfo& info);//compacts, demeans, and normalizes the row
+        float finishCorrelation(const double& r, const bool& fisherZ);
         void cacheRowsA(const int64_t& begin, const int64_t& end);//grabs the rows and does whatever it needs to, using as much IO bandwidth and CPU resources as available/needed
     protected:
         static float getSubAlgorithmWeight();
@@ -22,6 +22,7 @@
 #include "AlgorithmException.h"
 #include "CaretLogger.h"
 #include "CiftiFile.h"
+#include "CiftiRowPipeline.h"
 #include "GiftiLabel.h"
 #include "GiftiLabelTable.h"
 #include "MetricFile.h"
@@ -237,6 +238,144 @@ void AlgorithmCiftiParcellate::useParameters(OperationParameters* myParams, Prog
                              includeEmpty, emptyFillValue, emptyMaskOut);
 }
 
+namespace
+{
+    //computes one output row when parcellating along rows, so that the rows can be processed with CiftiRowPipeline
+    class ParcellateRowWorker : public CiftiRowPipeline::RowWorker
+    {
+        const CiftiFile* m_input;
+        const vector<int>& m_indexToParcel;
+        const vector<vector<float> >* m_parcelWeights;//NULL for unweighted
+        vector<int64_t> m_parcelCounts;
+        ReductionEnum::Enum m_method;
+        float m_excludeLow, m_excludeHigh, m_emptyFillVal;
+        bool m_onlyNumeric, m_isLabel;
+        int m_labelDir;
+        vector<int> m_unassignedKeys;//precomputed, because getUnassignedLabelKey() can add the label, so it isn't safe to call from multiple threads
+        vector<vector<float> > m_scratchRows;//per slot
+        vector<vector<vector<float> > > m_parcelData;//per slot, float so we can use ReductionOperation
+        bool enoughData(const int64_t& count) const
+        {
+            return count > 0 && (m_method != ReductionEnum::SAMPSTDEV || count > 1);
+        }
+    public:
+        ParcellateRowWorker(const CiftiFile* input, const vector<int>& indexToParcel, const vector<int64_t>& parcelCounts, const vector<vector<float> >* parcelWeights,
+                            const ReductionEnum::Enum& method, const float& excludeLow, const float& excludeHigh, const bool& onlyNumeric,
+                            const float& emptyFillVal, const bool& isLabel, const int& labelDir, const CiftiXML& outXML) : m_indexToParcel(indexToParcel)
+        {
+            m_input = input;
+            m_parcelCounts = parcelCounts;
+            m_parcelWeights = parcelWeights;
+            m_method = method;
+            m_excludeLow = excludeLow;
+            m_excludeHigh = excludeHigh;
+            m_onlyNumeric = onlyNumeric;
+            m_emptyFillVal = emptyFillVal;
+            m_isLabel = isLabel;
+            m_labelDir = labelDir;
+            if (m_isLabel)
+            {//labelDir can't be 0 (row) because we are parcellating along row, so row must be dense
+                CaretAssert(m_labelDir > 0);
+                bool needUnassigned = false;
+                for (int j = 0; j < (int)m_parcelCounts.size(); ++j)
+                {
+                    if (!enoughData(m_parcelCounts[j])) needUnassigned = true;
+                }
+                if (needUnassigned)
+                {
+                    const CiftiLabelsMap& labelMap = outXML.getLabelsMap(m_labelDir);
+                    m_unassignedKeys.resize(labelMap.getLength());
+                    for (int i = 0; i < (int)m_unassignedKeys.size(); ++i)
+                    {
+                        m_unassignedKeys[i] = labelMap.getMapLabelTable(i)->getUnassignedLabelKey();
+                    }
+                }
+            }
+        }
+        void allocateSlots(const int& numSlots)
+        {
+            const int numParcels = (int)m_parcelCounts.size();
+            m_scratchRows.resize(numSlots, vector<float>(m_input->getNumberOfColumns()));
+            m_parcelData.resize(numSlots, vector<vector<float> >(numParcels));
+            for (int i = 0; i < numSlots; ++i)
+            {
+                for (int j = 0; j < numParcels; ++j)
+                {
+                    m_parcelData[i][j].reserve(m_parcelCounts[j]);
+                }
+            }
+        }
+        void computeRow(const vector<int64_t>& outIndex, float* outRow, const int& slot)
+        {//when parcellating along rows, the output row index is the same as the input row index
+            CaretAssertVectorIndex(m_scratchRows, slot);
+            vector<float>& scratchRow = m_scratchRows[slot];
+            vector<vector<float> >& parcelData = m_parcelData[slot];
+            const int numParcels = (int)m_parcelCounts.size();
+            const int64_t numCols = (int64_t)scratchRow.size();
+            for (int j = 0; j < numParcels; ++j)
+            {
+                parcelData[j].clear();//doesn't change allocation
+            }
+            m_input->getRow(scratchRow.data(), outIndex);
+            for (int64_t j = 0; j < numCols; ++j)
+            {
+                int parcel = m_indexToParcel[j];
+                if (parcel != -1)
+                {
+                    if (m_isLabel)
+                    {
+                        parcelData[parcel].push_back(floor(scratchRow[j] + 0.5f));//round to nearest integer to be safe
+                    } else {
+                        parcelData[parcel].push_back(scratchRow[j]);
+                    }
+                }
+            }
+            for (int j = 0; j < numParcels; ++j)
+            {
+                CaretAssert(m_parcelCounts[j] == (int64_t)parcelData[j].size());
+                if (enoughData(m_parcelCounts[j]))
+                {
+                    if (m_parcelWeights != NULL)
+                    {
+                        const float* weights = (*m_parcelWeights)[j].data();
+                        if (m_excludeLow > 0.0f && m_excludeHigh > 0.0f)
+                        {
+                            outRow[j] = ReductionOperation::reduceWeightedExcludeDev(parcelData[j].data(), weights, parcelData[j].size(), m_method, m_excludeLow, m_excludeHigh);
+                        } else {
+                            if (m_onlyNumeric)
+                            {
+                                outRow[j] = ReductionOperation::reduceWeightedOnlyNumeric(parcelData[j].data(), weights, parcelData[j].size(), m_method);
+                            } else {
+                                outRow[j] = ReductionOperation::reduceWeighted(parcelData[j].data(), weights, parcelData[j].size(), m_method);
+                            }
+                        }
+                    } else {
+                        if (m_excludeLow > 0.0f && m_excludeHigh > 0.0f)
+                        {
+                            outRow[j] = ReductionOperation::reduceExcludeDev(parcelData[j].data(), parcelData[j].size(), m_method, m_excludeLow, m_excludeHigh);
+                        } else {
+                            if (m_onlyNumeric)
+                            {
+                                outRow[j] = ReductionOperation::reduceOnlyNumeric(parcelData[j].data(), parcelData[j].size(), m_method);
+                            } else {
+                                outRow[j] = ReductionOperation::reduce(parcelData[j].data(), parcelData[j].size(), m_method);
+                            }
+                        }
+                    }
+                } else {
+                    if (m_isLabel)
+                    {
+                        CaretAssertVectorIndex(m_unassignedKeys, outIndex[m_labelDir - 1]);
+                        outRow[j] = m_unassignedKeys[outIndex[m_labelDir - 1]];
+                    } else {
+                        outRow[j] = m_emptyFillVal;//odd corner case, but probably fine: with nonzero empty fill value and SAMPSTDEV, parcels with only one element get the fill value, but aren't technically empty
+                    }
+                }
+            }
+        }
+    };
+}
+
 AlgorithmCiftiParcellate::AlgorithmCiftiParcellate(ProgressObject* myProgObj, const CiftiFile* myCiftiIn, const CiftiFile* myCiftiLabel, const int& direction, CiftiFile* myCiftiOut,
                                                    const ReductionEnum::Enum& method, const float& excludeLow, const float& excludeHigh, const bool& onlyNumeric,
                                                    const bool& includeEmpty, const float& emptyFillVal, CiftiFile* emptyMaskOut) : AbstractAlgorithm(myProgObj)
@@ -325,59 +464,8 @@ AlgorithmCiftiParcellate::AlgorithmCiftiParcellate(ProgressObject* myProgObj, co
     }
     if (direction == CiftiXML::ALONG_ROW)
     {
-        vector<float> scratchOutRow(numParcels);
-        vector<vector<float> > parcelData(numParcels);//float so we can use ReductionOperation
-        for (int j = 0; j < numParcels; ++j)
-        {
-            parcelData[j].reserve(parcelCounts[j]);
-        }
-        for (MultiDimIterator<int64_t> iter(vector<int64_t>(dims.begin() + 1, dims.end())); !iter.atEnd(); ++iter)
-        {
-            for (int j = 0; j < numParcels; ++j)
-            {
-                parcelData[j].clear();//doesn't change allocation
-            }
-            myCiftiIn->getRow(scratchRow.data(), *iter);
-            for (int64_t j = 0; j < numCols; ++j)
-            {
-                int parcel = indexToParcel[j];
-                if (parcel != -1)
-                {
-                    if (isLabel)
-                    {
-                        parcelData[parcel].push_back(floor(scratchRow[j] + 0.5f));//round to nearest integer to be safe
-                    } else {
-                        parcelData[parcel].push_back(scratchRow[j]);
-                    }
-                }
-            }
-            for (int j = 0; j < numParcels; ++j)
-            {
-                CaretAssert(parcelCounts[j] == (int64_t)parcelData[j].size());
-                if (parcelCounts[j] > 0 && (method != ReductionEnum::SAMPSTDEV || parcelCounts[j] > 1))
-                {
-                    if (excludeLow > 0.0f && excludeHigh > 0.0f)
-                    {
-                        scratchOutRow[j] = ReductionOperation::reduceExcludeDev(parcelData[j].data(), parcelData[j].size(), method, excludeLow, excludeHigh);
-                    } else {
-                        if (onlyNumeric)
-                        {
-                            scratchOutRow[j] = ReductionOperation::reduceOnlyNumeric(parcelData[j].data(), parcelData[j].size(), method);
-                        } else {
-                            scratchOutRow[j] = ReductionOperation::reduce(parcelData[j].data(), parcelData[j].size(), method);
-                        }
-                    }
-                } else {//labelDir can't be 0 (row) because we are parcellating along row, so row must be dense
-                    if (isLabel)
-                    {
-                        scratchOutRow[j] = myOutXML.getLabelsMap(labelDir).getMapLabelTable((*iter)[labelDir - 1])->getUnassignedLabelKey();
-                    } else {
-                        scratchOutRow[j] = emptyFillVal;//odd corner case, but probably fine: with nonzero empty fill value and SAMPSTDEV, parcels with only one element get the fill value, but aren't technically empty
-                    }
-                }
-            }
-            myCiftiOut->setRow(scratchOutRow.data(), *iter);
-        }
+        ParcellateRowWorker myWorker(myCiftiIn, indexToParcel, parcelCounts, NULL, method, excludeLow, excludeHigh, onlyNumeric, emptyFillVal, isLabel, labelDir, myOutXML);
+        CiftiRowPipeline(myCiftiOut).run(myWorker);
     } else {
         vector<float> scratchOutRow(numCols);
         vector<int64_t> otherDims = dims;
@@ -524,59 +612,13 @@ namespace
         vector<float> scratchRow(numCols);
         if (direction == CiftiXML::ALONG_ROW)
         {
-            vector<float> scratchOutRow(numParcels);
-            vector<vector<float> > parcelData(numParcels);//float so we can use ReductionOperation
+            vector<int64_t> parcelCounts(numParcels);
             for (int j = 0; j < numParcels; ++j)
             {
-                parcelData[j].reserve(parcelWeights[j].size());
-            }
-            for (MultiDimIterator<int64_t> iter(vector<int64_t>(dims.begin() + 1, dims.end())); !iter.atEnd(); ++iter)
-            {
-                for (int j = 0; j < numParcels; ++j)
-                {
-                    parcelData[j].clear();//doesn't change allocation
-                }
-                myCiftiIn->getRow(scratchRow.data(), *iter);
-                for (int64_t j = 0; j < numCols; ++j)
-                {
-                    int parcel = indexToParcel[j];
-                    if (parcel != -1)
-                    {
-                        if (isLabel)
-                        {
-                            parcelData[parcel].push_back(floor(scratchRow[j] + 0.5f));//round to nearest integer to be safe
-                        } else {
-                            parcelData[parcel].push_back(scratchRow[j]);
-                        }
-                    }
-                }
-                for (int j = 0; j < numParcels; ++j)
-                {
-                    CaretAssert(parcelWeights[j].size() == parcelData[j].size());
-                    if (parcelData[j].size() > 0 && (method != ReductionEnum::SAMPSTDEV || parcelData[j].size() > 1))
-                    {
-                        if (excludeLow > 0.0f && excludeHigh > 0.0f)
-                        {
-                            scratchOutRow[j] = ReductionOperation::reduceWeightedExcludeDev(parcelData[j].data(), parcelWeights[j].data(), parcelData[j].size(), method, excludeLow, excludeHigh);
-                        } else {
-                            if (onlyNumeric)
-                            {
-                                scratchOutRow[j] = ReductionOperation::reduceWeightedOnlyNumeric(parcelData[j].data(), parcelWeights[j].data(), parcelData[j].size(), method);
-                            } else {
-                                scratchOutRow[j] = ReductionOperation::reduceWeighted(parcelData[j].data(), parcelWeights[j].data(), parcelData[j].size(), method);
-                            }
-                        }
-                    } else {//labelDir can't be 0 (row) because we are parcellating along row, so row must be dense
-                        if (isLabel)
-                        {
-                            scratchOutRow[j] = myOutXML.getLabelsMap(labelDir).getMapLabelTable((*iter)[labelDir - 1])->getUnassignedLabelKey();
-                        } else {
-                            scratchOutRow[j] = emptyFillVal;
-                        }
-                    }
-                }
-                myCiftiOut->setRow(scratchOutRow.data(), *iter);
+                parcelCounts[j] = (int64_t)parcelWeights[j].size();
             }
+            ParcellateRowWorker myWorker(myCiftiIn, indexToParcel, parcelCounts, &parcelWeights, method, excludeLow, excludeHigh, onlyNumeric, emptyFillVal, isLabel, labelDir, myOutXML);
+            CiftiRowPipeline(myCiftiOut).run(myWorker);
         } else {
             vector<float> scratchOutRow(numCols);
             vector<int64_t> otherDims = dims;
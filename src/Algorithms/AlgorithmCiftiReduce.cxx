@@ -23,7 +23,7 @@
 #include "CaretAssert.h"
 #include "CaretLogger.h"
 #include "CiftiFile.h"
-#include "MultiDimIterator.h"
+#include "CiftiRowPipeline.h"
 #include "ReductionOperation.h"
 
 #include <vector>
@@ -31,6 +31,82 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    class ReduceRowWorker : public CiftiRowPipeline::RowWorker
+    {
+        const CiftiFile* m_input;
+        vector<int64_t> m_inDims;
+        int m_direction;
+        ReductionEnum::Enum m_type;
+        bool m_onlyNumeric, m_excludeDev;
+        float m_sigmaBelow, m_sigmaAbove;
+        vector<vector<float> > m_inScratch, m_reduceScratch;//per slot
+        float doReduce(const float* data, const int64_t& numElems) const
+        {
+            if (m_excludeDev) return ReductionOperation::reduceExcludeDev(data, numElems, m_type, m_sigmaBelow, m_sigmaAbove);
+            if (m_onlyNumeric) return ReductionOperation::reduceOnlyNumeric(data, numElems, m_type);
+            return ReductionOperation::reduce(data, numElems, m_type);
+        }
+    public:
+        ReduceRowWorker(const CiftiFile* input, const int& direction, const ReductionEnum::Enum& type, const bool& onlyNumeric)
+        {
+            m_input = input;
+            m_inDims = input->getDimensions();
+            m_direction = direction;
+            m_type = type;
+            m_onlyNumeric = onlyNumeric;
+            m_excludeDev = false;
+        }
+        ReduceRowWorker(const CiftiFile* input, const int& direction, const ReductionEnum::Enum& type, const float& sigmaBelow, const float& sigmaAbove)
+        {
+            m_input = input;
+            m_inDims = input->getDimensions();
+            m_direction = direction;
+            m_type = type;
+            m_onlyNumeric = false;
+            m_excludeDev = true;
+            m_sigmaBelow = sigmaBelow;
+            m_sigmaAbove = sigmaAbove;
+        }
+        void allocateSlots(const int& numSlots)
+        {
+            m_inScratch.resize(numSlots);
+            m_reduceScratch.resize(numSlots);
+        }
+        void computeRow(const vector<int64_t>& outIndex, float* outRow, const int& slot)
+        {
+            CaretAssertVectorIndex(m_inScratch, slot);
+            vector<float>& inScratch = m_inScratch[slot];//resized on first use, because a 2D input reduced along columns has only one output row
+            if (m_direction == CiftiXML::ALONG_ROW)
+            {
+                inScratch.resize(m_inDims[0]);
+                m_input->getRow(inScratch.data(), outIndex);//output index is the same as input index, the output row just has length 1
+                outRow[0] = doReduce(inScratch.data(), m_inDims[0]);
+            } else {
+                const int64_t rowLength = m_inDims[0], numReduce = m_inDims[m_direction];//reduction isn't along row, so out rows will be same length as in rows
+                inScratch.resize(rowLength * numReduce);
+                vector<float>& reduceScratch = m_reduceScratch[slot];
+                reduceScratch.resize(numReduce);
+                vector<int64_t> indexvec = outIndex;//has 0 along the reduce direction
+                for (int64_t i = 0; i < numReduce; ++i)
+                {
+                    indexvec[m_direction - 1] = i;
+                    m_input->getRow(inScratch.data() + i * rowLength, indexvec);
+                }
+                for (int64_t i = 0; i < rowLength; ++i)
+                {
+                    for (int64_t j = 0; j < numReduce; ++j)
+                    {//need reduction input in contiguous array
+                        reduceScratch[j] = inScratch[j * rowLength + i];
+                    }
+                    outRow[i] = doReduce(reduceScratch.data(), numReduce);
+                }
+            }
+        }
+    };
+}
+
 AString AlgorithmCiftiReduce::getCommandSwitch()
 {
     return "-cifti-reduce";
@@ -105,54 +181,8 @@ AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const Cift
     newMap.setMapName(0, ReductionEnum::toName(myReduce));
     myOutXML.setMap(direction, newMap);
     ciftiOut->setCiftiXML(myOutXML);
-    vector<int64_t> inDims = inputXML.getDimensions();
-    if (direction == CiftiXML::ALONG_ROW)
-    {
-        vector<float> scratchInRow(inDims[0]);
-        for (MultiDimIterator<int64_t> iter(vector<int64_t>(inDims.begin() + 1, inDims.end())); !iter.atEnd(); ++iter)
-        {// + 1 to exclude row dimension, because getRow/setRow
-            ciftiIn->getRow(scratchInRow.data(), *iter);
-            float result = -1;
-            if (onlyNumeric)
-            {
-                result = ReductionOperation::reduceOnlyNumeric(scratchInRow.data(), inDims[0], myReduce);
-            } else {
-                result = ReductionOperation::reduce(scratchInRow.data(), inDims[0], myReduce);
-            }
-            ciftiOut->setRow(&result, *iter);//if reducing along row, length of output row is 1
-        }
-    } else {
-        vector<vector<float> > scratchInRows(inDims[direction], vector<float>(inDims[0]));
-        vector<float> outRow(inDims[0]), reduceScratch(inDims[direction]);//reduction isn't along row, so out rows will be same length as in rows
-        vector<int64_t> otherDims = inDims;
-        otherDims.erase(otherDims.begin() + direction);//direction isn't 0
-        otherDims.erase(otherDims.begin());//remove row direction because getRow/setRow
-        for (MultiDimIterator<int64_t> iter(otherDims); !iter.atEnd(); ++iter)
-        {
-            vector<int64_t> indexvec = *iter;
-            indexvec.insert(indexvec.begin() + direction - 1, -1);//dummy value in place of reduce direction
-            for (int64_t i = 0; i < inDims[direction]; ++i)
-            {
-                indexvec[direction - 1] = i;
-                ciftiIn->getRow(scratchInRows[i].data(), indexvec);
-            }
-            for (int64_t i = 0; i < inDims[0]; ++i)
-            {
-                for (int64_t j = 0; j < inDims[direction]; ++j)
-                {//need reduction input in contiguous array
-                    reduceScratch[j] = scratchInRows[j][i];
-                }
-                if (onlyNumeric)
-                {
-                    outRow[i] = ReductionOperation::reduceOnlyNumeric(reduceScratch.data(), inDims[direction], myReduce);
-                } else {
-                    outRow[i] = ReductionOperation::reduce(reduceScratch.data(), inDims[direction], myReduce);
-                }
-            }
-            indexvec[direction - 1] = 0;//only one element along reduce output direction
-            ciftiOut->setRow(outRow.data(), indexvec);
-        }
-    }
+    ReduceRowWorker myWorker(ciftiIn, direction, myReduce, onlyNumeric);
+    CiftiRowPipeline(ciftiOut).run(myWorker);
 }
 
 AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const CiftiFile* ciftiIn, const ReductionEnum::Enum& myReduce, CiftiFile* ciftiOut,
@@ -168,43 +198,8 @@ AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const Cift
     newMap.setMapName(0, ReductionEnum::toName(myReduce));
     myOutXML.setMap(direction, newMap);
     ciftiOut->setCiftiXML(myOutXML);
-    vector<int64_t> inDims = inputXML.getDimensions();
-    if (direction == CiftiXML::ALONG_ROW)
-    {
-        vector<float> scratchInRow(inDims[0]);
-        for (MultiDimIterator<int64_t> iter(vector<int64_t>(inDims.begin() + 1, inDims.end())); !iter.atEnd(); ++iter)
-        {// + 1 to exclude row dimension, because getRow/setRow
-            ciftiIn->getRow(scratchInRow.data(), *iter);
-            float result = ReductionOperation::reduceExcludeDev(scratchInRow.data(), inDims[0], myReduce, sigmaBelow, sigmaAbove);
-            ciftiOut->setRow(&result, *iter);//if reducing along row, length of output row is 1
-        }
-    } else {
-        vector<vector<float> > scratchInRows(inDims[direction], vector<float>(inDims[0]));
-        vector<float> outRow(inDims[0]), reduceScratch(inDims[direction]);//reduction isn't along row, so out rows will be same length as in rows
-        vector<int64_t> otherDims = inDims;
-        otherDims.erase(otherDims.begin() + direction);//direction isn't 0
-        otherDims.erase(otherDims.begin());//remove row direction because getRow/setRow
-        for (MultiDimIterator<int64_t> iter(otherDims); !iter.atEnd(); ++iter)
-        {
-            vector<int64_t> indexvec = *iter;
-            indexvec.insert(indexvec.begin() + direction - 1, -1);//dummy value in place of reduce direction
-            for (int64_t i = 0; i < inDims[direction]; ++i)
-            {
-                indexvec[direction - 1] = i;
-                ciftiIn->getRow(scratchInRows[i].data(), indexvec);
-            }
-            for (int64_t i = 0; i < inDims[0]; ++i)
-            {
-                for (int64_t j = 0; j < inDims[direction]; ++j)
-                {//need reduction input in contiguous array
-                    reduceScratch[j] = scratchInRows[j][i];
-                }
-                outRow[i] = ReductionOperation::reduceExcludeDev(reduceScratch.data(), inDims[direction], myReduce, sigmaBelow, sigmaAbove);
-            }
-            indexvec[direction - 1] = 0;//only one element along reduce output direction
-            ciftiOut->setRow(outRow.data(), indexvec);
-        }
-    }
+    ReduceRowWorker myWorker(ciftiIn, direction, myReduce, sigmaBelow, sigmaAbove);
+    CiftiRowPipeline(ciftiOut).run(myWorker);
 }
 
 float AlgorithmCiftiReduce::getAlgorithmInternalWeight()
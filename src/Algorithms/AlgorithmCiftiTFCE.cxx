@@ -0,0 +1,475 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+
+#include "AlgorithmCiftiTFCE.h"
+#include "AlgorithmException.h"
+
+#include "AlgorithmCiftiSmoothing.h"
+#include "CaretAssert.h"
+#include "CaretOMP.h"
+#include "CaretPointer.h"
+#include "CiftiFile.h"
+#include "CiftiRowPipeline.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+#include "TFCEHelper.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+AString AlgorithmCiftiTFCE::getCommandSwitch()
+{
+    return "-cifti-tfce";
+}
+
+AString AlgorithmCiftiTFCE::getShortDescription()
+{
+    return "DO TFCE ON A CIFTI FILE";
+}
+
+OperationParameters* AlgorithmCiftiTFCE::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    ret->addCiftiParameter(1, "cifti-in", "the input cifti");
+    ret->addStringParameter(2, "direction", "which dimension to use for spatial information, ROW or COLUMN");
+    ret->addCiftiOutputParameter(3, "cifti-out", "the output cifti");
+    
+    OptionalParameter* presmoothOpt = ret->createOptionalParameter(4, "-presmooth", "smooth the data before running TFCE");
+    presmoothOpt->addDoubleParameter(1, "surface-kernel", "the sigma for the gaussian surface smoothing kernel, in mm");
+    presmoothOpt->addDoubleParameter(2, "volume-kernel", "the sigma for the gaussian volume smoothing kernel, in mm");
+    
+    OptionalParameter* leftSurfOpt = ret->createOptionalParameter(5, "-left-surface", "specify the left surface to use");
+    leftSurfOpt->addSurfaceParameter(1, "surface", "the left surface file");
+    OptionalParameter* leftCorrAreasOpt = leftSurfOpt->createOptionalParameter(2, "-corrected-areas", "vertex areas to use instead of computing them from the surface");
+    leftCorrAreasOpt->addMetricParameter(1, "area-metric", "the corrected vertex areas, as a metric");
+    
+    OptionalParameter* rightSurfOpt = ret->createOptionalParameter(6, "-right-surface", "specify the right surface to use");
+    rightSurfOpt->addSurfaceParameter(1, "surface", "the right surface file");
+    OptionalParameter* rightCorrAreasOpt = rightSurfOpt->createOptionalParameter(2, "-corrected-areas", "vertex areas to use instead of computing them from the surface");
+    rightCorrAreasOpt->addMetricParameter(1, "area-metric", "the corrected vertex areas, as a metric");
+    
+    OptionalParameter* cerebSurfOpt = ret->createOptionalParameter(7, "-cerebellum-surface", "specify the cerebellum surface to use");
+    cerebSurfOpt->addSurfaceParameter(1, "surface", "the cerebellum surface file");
+    OptionalParameter* cerebCorrAreasOpt = cerebSurfOpt->createOptionalParameter(2, "-corrected-areas", "vertex areas to use instead of computing them from the surface");
+    cerebCorrAreasOpt->addMetricParameter(1, "area-metric", "the corrected vertex areas, as a metric");
+    
+    OptionalParameter* roiOpt = ret->createOptionalParameter(8, "-cifti-roi", "run TFCE only within regions of interest");
+    roiOpt->addCiftiParameter(1, "roi-cifti", "the regions to use, as a cifti file");
+    
+    ret->createOptionalParameter(9, "-merged-volume", "treat volume components as if they were a single component");
+    
+    OptionalParameter* surfParamsOpt = ret->createOptionalParameter(10, "-surface-parameters", "set parameters for the surface TFCE integral");
+    surfParamsOpt->addDoubleParameter(1, "E", "exponent for cluster area (default 1.0)");
+    surfParamsOpt->addDoubleParameter(2, "H", "exponent for threshold value (default 2.0)");
+    
+    OptionalParameter* volParamsOpt = ret->createOptionalParameter(11, "-volume-parameters", "set parameters for the volume TFCE integral");
+    volParamsOpt->addDoubleParameter(1, "E", "exponent for cluster volume (default 0.5)");
+    volParamsOpt->addDoubleParameter(2, "H", "exponent for threshold value (default 2.0)");
+    
+    OptionalParameter* memLimitOpt = ret->createOptionalParameter(12, "-mem-limit", "restrict memory usage when processing columns");
+    memLimitOpt->addDoubleParameter(1, "limit-GB", "memory limit in gigabytes (default 4)");
+    
+    ret->setHelpText(
+        AString("Threshold-free cluster enhancement is a method to increase the relative value of regions that would form clusters in a standard thresholding test.  ") +
+        "This is accomplished by evaluating the integral of:\n\n" +
+        "e(h, p)^E * h^H * dh\n\n" +
+        "at each brainordinate p, where h ranges from 0 to the maximum value in the data, and e(h, p) is the extent of the cluster containing p at threshold h.  " +
+        "Negative values are similarly enhanced by negating the data, running the same process, and negating the result.\n\n" +
+        "Clusters do not cross structure boundaries, unless -merged-volume is specified, in which case volume clusters may cross between volume structures.  " +
+        "Surface extent is area in mm^2, volume extent is volume in mm^3, and they use separate parameters, with the same defaults as -metric-tfce and -volume-tfce.  " +
+        "The input cifti file must have a brain models mapping on the chosen dimension, columns for .dtseries and .dscalar, and either for .dconn.  " +
+        "The ROI should have a brain models mapping along columns, exactly matching the mapping of the chosen direction in the input file.  " +
+        "Data outside the ROI is ignored, and is zero in the output.\n\n" +
+        "The neighbor information for each structure is computed once and reused for every map, so this is efficient for files with many maps, such as permutation tests.  " +
+        "When the maps are columns, they are read and processed in blocks that fit within the memory limit, with each block requiring one pass through the input file.\n\n" +
+        "The TFCE method is explained in: Smith SM, Nichols TE., \"Threshold-free cluster enhancement: addressing problems of smoothing, threshold dependence and localisation in cluster inference.\" Neuroimage. 2009 Jan 1;44(1):83-98. PMID: 18501637"
+    );
+    return ret;
+}
+
+void AlgorithmCiftiTFCE::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    CiftiFile* myCifti = myParams->getCifti(1);
+    AString directionName = myParams->getString(2);
+    int myDir;
+    if (directionName == "ROW")
+    {
+        myDir = CiftiXML::ALONG_ROW;
+    } else if (directionName == "COLUMN") {
+        myDir = CiftiXML::ALONG_COLUMN;
+    } else {
+        throw AlgorithmException("incorrect string for direction, use ROW or COLUMN");
+    }
+    CiftiFile* myCiftiOut = myParams->getOutputCifti(3);
+    float surfPresmooth = 0.0f, volPresmooth = 0.0f;
+    OptionalParameter* presmoothOpt = myParams->getOptionalParameter(4);
+    if (presmoothOpt->m_present)
+    {
+        surfPresmooth = (float)presmoothOpt->getDouble(1);
+        volPresmooth = (float)presmoothOpt->getDouble(2);
+        if (surfPresmooth < 0.0f || volPresmooth < 0.0f) throw AlgorithmException("presmooth kernel sizes must not be negative");
+    }
+    SurfaceFile* myLeftSurf = NULL, *myRightSurf = NULL, *myCerebSurf = NULL;
+    MetricFile* myLeftAreas = NULL, *myRightAreas = NULL, *myCerebAreas = NULL;
+    OptionalParameter* leftSurfOpt = myParams->getOptionalParameter(5);
+    if (leftSurfOpt->m_present)
+    {
+        myLeftSurf = leftSurfOpt->getSurface(1);
+        OptionalParameter* leftCorrAreasOpt = leftSurfOpt->getOptionalParameter(2);
+        if (leftCorrAreasOpt->m_present)
+        {
+            myLeftAreas = leftCorrAreasOpt->getMetric(1);
+        }
+    }
+    OptionalParameter* rightSurfOpt = myParams->getOptionalParameter(6);
+    if (rightSurfOpt->m_present)
+    {
+        myRightSurf = rightSurfOpt->getSurface(1);
+        OptionalParameter* rightCorrAreasOpt = rightSurfOpt->getOptionalParameter(2);
+        if (rightCorrAreasOpt->m_present)
+        {
+            myRightAreas = rightCorrAreasOpt->getMetric(1);
+        }
+    }
+    OptionalParameter* cerebSurfOpt = myParams->getOptionalParameter(7);
+    if (cerebSurfOpt->m_present)
+    {
+        myCerebSurf = cerebSurfOpt->getSurface(1);
+        OptionalParameter* cerebCorrAreasOpt = cerebSurfOpt->getOptionalParameter(2);
+        if (cerebCorrAreasOpt->m_present)
+        {
+            myCerebAreas = cerebCorrAreasOpt->getMetric(1);
+        }
+    }
+    CiftiFile* roiCifti = NULL;
+    OptionalParameter* roiOpt = myParams->getOptionalParameter(8);
+    if (roiOpt->m_present)
+    {
+        roiCifti = roiOpt->getCifti(1);
+    }
+    bool mergedVol = myParams->getOptionalParameter(9)->m_present;
+    float surf_param_e = 1.0f, surf_param_h = 2.0f, vol_param_e = 0.5f, vol_param_h = 2.0f;
+    OptionalParameter* surfParamsOpt = myParams->getOptionalParameter(10);
+    if (surfParamsOpt->m_present)
+    {
+        surf_param_e = (float)surfParamsOpt->getDouble(1);
+        surf_param_h = (float)surfParamsOpt->getDouble(2);
+    }
+    OptionalParameter* volParamsOpt = myParams->getOptionalParameter(11);
+    if (volParamsOpt->m_present)
+    {
+        vol_param_e = (float)volParamsOpt->getDouble(1);
+        vol_param_h = (float)volParamsOpt->getDouble(2);
+    }
+    float memLimitGB = -1.0f;
+    OptionalParameter* memLimitOpt = myParams->getOptionalParameter(12);
+    if (memLimitOpt->m_present)
+    {
+        memLimitGB = (float)memLimitOpt->getDouble(1);
+        if (memLimitGB < 0.0f)
+        {
+            throw AlgorithmException("memory limit cannot be negative");
+        }
+    }
+    AlgorithmCiftiTFCE(myProgObj, myCifti, myDir, myCiftiOut, surfPresmooth, volPresmooth,
+                       myLeftSurf, myLeftAreas, myRightSurf, myRightAreas, myCerebSurf, myCerebAreas,
+                       roiCifti, mergedVol, surf_param_e, surf_param_h, vol_param_e, vol_param_h, memLimitGB);
+}
+
+namespace
+{
+    const float DEFAULT_MEM_LIMIT_GB = 4.0f;//for column maps, when no limit is given
+    
+    //does TFCE on every structure of one brain models map, copies share the neighbor graphs, so make one copy per thread
+    class MapProcessor
+    {
+        struct StructureInfo
+        {
+            vector<int64_t> m_ciftiIndices;//element i of the helper is m_ciftiIndices[i] in the map
+            CaretPointer<TFCEHelper> m_helper;
+            float m_param_e, m_param_h;
+        };
+        vector<StructureInfo> m_structures;
+        vector<float> m_scratchIn, m_scratchOut;
+        int64_t m_mapLength;
+        MapProcessor& operator=(const MapProcessor&);
+    public:
+        MapProcessor(const int64_t& mapLength)
+        {
+            m_mapLength = mapLength;
+        }
+        MapProcessor(const MapProcessor& other)
+        {
+            m_mapLength = other.m_mapLength;
+            for (int i = 0; i < (int)other.m_structures.size(); ++i)
+            {
+                const StructureInfo& otherInfo = other.m_structures[i];
+                addStructure(otherInfo.m_ciftiIndices, *(otherInfo.m_helper), otherInfo.m_param_e, otherInfo.m_param_h);
+            }
+        }
+        void addStructure(const vector<int64_t>& ciftiIndices, const TFCEHelper& helper, const float& param_e, const float& param_h)
+        {
+            CaretAssert((int64_t)ciftiIndices.size() == helper.getNumberOfElements());
+            m_structures.push_back(StructureInfo());
+            StructureInfo& myInfo = m_structures.back();
+            myInfo.m_ciftiIndices = ciftiIndices;
+            myInfo.m_helper.grabNew(new TFCEHelper(helper));
+            myInfo.m_param_e = param_e;
+            myInfo.m_param_h = param_h;
+            if (ciftiIndices.size() > m_scratchIn.size())
+            {
+                m_scratchIn.resize(ciftiIndices.size());
+                m_scratchOut.resize(ciftiIndices.size());
+            }
+        }
+        void process(const float* mapIn, float* mapOut)
+        {
+            for (int64_t i = 0; i < m_mapLength; ++i)
+            {
+                mapOut[i] = 0.0f;//outside the roi
+            }
+            for (int s = 0; s < (int)m_structures.size(); ++s)
+            {
+                StructureInfo& myInfo = m_structures[s];
+                const int64_t numElements = (int64_t)myInfo.m_ciftiIndices.size();
+                for (int64_t i = 0; i < numElements; ++i)
+                {
+                    m_scratchIn[i] = mapIn[myInfo.m_ciftiIndices[i]];
+                }
+                myInfo.m_helper->compute(m_scratchIn.data(), m_scratchOut.data(), myInfo.m_param_e, myInfo.m_param_h);
+                for (int64_t i = 0; i < numElements; ++i)
+                {
+                    mapOut[myInfo.m_ciftiIndices[i]] = m_scratchOut[i];
+                }
+            }
+        }
+    };
+    
+    class TFCERowWorker : public CiftiRowPipeline::RowWorker
+    {
+        const CiftiFile* m_input;
+        const MapProcessor& m_processor;
+        vector<CaretPointer<MapProcessor> > m_slotProcessors;
+        vector<vector<float> > m_slotRows;
+    public:
+        TFCERowWorker(const CiftiFile* input, const MapProcessor& processor) : m_input(input), m_processor(processor) { }
+        void allocateSlots(const int& numSlots)
+        {
+            m_slotProcessors.resize(numSlots);
+            m_slotRows.resize(numSlots);
+            for (int i = 0; i < numSlots; ++i)
+            {
+                m_slotProcessors[i].grabNew(new MapProcessor(m_processor));
+                m_slotRows[i].resize(m_input->getNumberOfColumns());
+            }
+        }
+        void computeRow(const vector<int64_t>& outIndex, float* outRow, const int& slot)
+        {
+            m_input->getRow(m_slotRows[slot].data(), outIndex);
+            m_slotProcessors[slot]->process(m_slotRows[slot].data(), outRow);
+        }
+    };
+}
+
+AlgorithmCiftiTFCE::AlgorithmCiftiTFCE(ProgressObject* myProgObj, const CiftiFile* myCifti, const int& myDir, CiftiFile* myCiftiOut,
+                                       const float& surfPresmooth, const float& volPresmooth,
+                                       const SurfaceFile* myLeftSurf, const MetricFile* myLeftAreas,
+                                       const SurfaceFile* myRightSurf, const MetricFile* myRightAreas,
+                                       const SurfaceFile* myCerebSurf, const MetricFile* myCerebAreas,
+                                       const CiftiFile* roiCifti, const bool& mergedVol,
+                                       const float& surf_param_e, const float& surf_param_h, const float& vol_param_e, const float& vol_param_h,
+                                       const float& memLimitGB) : AbstractAlgorithm(myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    const CiftiXML& myXML = myCifti->getCiftiXML();
+    if (myXML.getNumberOfDimensions() != 2) throw AlgorithmException("cifti TFCE only supported on 2D cifti");
+    if (myDir >= myXML.getNumberOfDimensions() || myDir < 0) throw AlgorithmException("direction invalid for input cifti");
+    if (myXML.getMappingType(myDir) != CiftiMappingType::BRAIN_MODELS)
+    {
+        throw AlgorithmException("specified direction does not contain brainordinates");
+    }
+    const CiftiBrainModelsMap& myBrainMap = myXML.getBrainModelsMap(myDir);
+    if (roiCifti != NULL && myBrainMap != *(roiCifti->getCiftiXML().getMap(CiftiXML::ALONG_COLUMN)))
+    {
+        throw AlgorithmException("along-column mapping of roi cifti does not match the TFCE direction of the input cifti");
+    }
+    const int64_t mapLength = myXML.getDimensionLength(myDir);
+    vector<float> roiData;
+    if (roiCifti != NULL)
+    {
+        roiData.resize(mapLength);
+        roiCifti->getColumn(roiData.data(), 0);
+    }
+    MapProcessor myProcessor(mapLength);
+    vector<StructureEnum::Enum> surfaceList = myBrainMap.getSurfaceStructureList();
+    for (int whichStruct = 0; whichStruct < (int)surfaceList.size(); ++whichStruct)
+    {
+        const SurfaceFile* mySurf = NULL;
+        const MetricFile* myAreas = NULL;
+        AString surfType;
+        switch (surfaceList[whichStruct])
+        {
+            case StructureEnum::CORTEX_LEFT:
+                mySurf = myLeftSurf;
+                myAreas = myLeftAreas;
+                surfType = "left";
+                break;
+            case StructureEnum::CORTEX_RIGHT:
+                mySurf = myRightSurf;
+                myAreas = myRightAreas;
+                surfType = "right";
+                break;
+            case StructureEnum::CEREBELLUM:
+                mySurf = myCerebSurf;
+                myAreas = myCerebAreas;
+                surfType = "cerebellum";
+                break;
+            default:
+                throw AlgorithmException("found surface model with incorrect type: " + StructureEnum::toName(surfaceList[whichStruct]));
+                break;
+        }
+        if (mySurf == NULL)
+        {
+            throw AlgorithmException(surfType + " surface required but not provided");
+        }
+        if (mySurf->getNumberOfNodes() != myBrainMap.getSurfaceNumberOfNodes(surfaceList[whichStruct]))
+        {
+            throw AlgorithmException(surfType + " surface has the wrong number of vertices");
+        }
+        if (myAreas != NULL && myAreas->getNumberOfNodes() != mySurf->getNumberOfNodes())
+        {
+            throw AlgorithmException(surfType + " corrected areas metric has the wrong number of vertices");
+        }
+        vector<float> surfAreaData;
+        const float* areaData = NULL;
+        if (myAreas == NULL)
+        {
+            mySurf->computeNodeAreas(surfAreaData);
+            areaData = surfAreaData.data();
+        } else {
+            areaData = myAreas->getValuePointerForColumn(0);
+        }
+        vector<CiftiBrainModelsMap::SurfaceMap> surfMap = myBrainMap.getSurfaceMap(surfaceList[whichStruct]);
+        vector<int64_t> nodeList, ciftiIndices;
+        for (int64_t i = 0; i < (int64_t)surfMap.size(); ++i)
+        {
+            if (roiCifti == NULL || roiData[surfMap[i].m_ciftiIndex] > 0.0f)
+            {
+                nodeList.push_back(surfMap[i].m_surfaceNode);
+                ciftiIndices.push_back(surfMap[i].m_ciftiIndex);
+            }
+        }
+        myProcessor.addStructure(ciftiIndices, TFCEHelper(mySurf, areaData, nodeList), surf_param_e, surf_param_h);
+    }
+    vector<vector<CiftiBrainModelsMap::VolumeMap> > volMaps;
+    if (mergedVol)
+    {
+        if (myBrainMap.hasVolumeData()) volMaps.push_back(myBrainMap.getFullVolumeMap());
+    } else {
+        vector<StructureEnum::Enum> volumeList = myBrainMap.getVolumeStructureList();
+        for (int whichStruct = 0; whichStruct < (int)volumeList.size(); ++whichStruct)
+        {
+            volMaps.push_back(myBrainMap.getVolumeStructureMap(volumeList[whichStruct]));
+        }
+    }
+    for (int whichStruct = 0; whichStruct < (int)volMaps.size(); ++whichStruct)
+    {
+        const vector<CiftiBrainModelsMap::VolumeMap>& volMap = volMaps[whichStruct];
+        vector<int64_t> ijkList, ciftiIndices;
+        for (int64_t i = 0; i < (int64_t)volMap.size(); ++i)
+        {
+            if (roiCifti == NULL || roiData[volMap[i].m_ciftiIndex] > 0.0f)
+            {
+                ijkList.insert(ijkList.end(), volMap[i].m_ijk, volMap[i].m_ijk + 3);
+                ciftiIndices.push_back(volMap[i].m_ciftiIndex);
+            }
+        }
+        myProcessor.addStructure(ciftiIndices, TFCEHelper(myBrainMap.getVolumeSpace(), ijkList), vol_param_e, vol_param_h);
+    }
+    const CiftiFile* toUse = myCifti;
+    CiftiFile smoothed;
+    if (surfPresmooth > 0.0f || volPresmooth > 0.0f)
+    {
+        AlgorithmCiftiSmoothing(NULL, myCifti, surfPresmooth, volPresmooth, myDir, &smoothed, myLeftSurf, myRightSurf, myCerebSurf,
+                                roiCifti, false, false, myLeftAreas, myRightAreas, myCerebAreas, mergedVol);
+        toUse = &smoothed;
+    }
+    myCiftiOut->setCiftiXML(myXML);
+    if (myDir == CiftiXML::ALONG_ROW)
+    {//each row is a map, stream them
+        TFCERowWorker myWorker(toUse, myProcessor);
+        CiftiRowPipeline(myCiftiOut).run(myWorker);
+    } else {//each column is a map, read a block of them in one pass through the file, process them in place, then write them into the output rows
+        const int64_t numMaps = myXML.getDimensionLength(CiftiXML::ALONG_ROW);
+        const float useLimitGB = (memLimitGB < 0.0f ? DEFAULT_MEM_LIMIT_GB : memLimitGB);
+        int64_t blockSize = (int64_t)(useLimitGB * 1024 * 1024 * 1024 / (mapLength * sizeof(float)));
+        if (blockSize < 1) blockSize = 1;
+        if (blockSize > numMaps) blockSize = numMaps;
+        vector<float> mapData(blockSize * mapLength), outRow(numMaps, 0.0f);
+        for (int64_t blockStart = 0; blockStart < numMaps; blockStart += blockSize)
+        {
+            const int64_t blockEnd = min(blockStart + blockSize, numMaps), blockMaps = blockEnd - blockStart;
+            vector<int64_t> blockIndices(blockMaps);
+            for (int64_t i = 0; i < blockMaps; ++i)
+            {
+                blockIndices[i] = blockStart + i;
+            }
+            toUse->getColumns(mapData.data(), blockIndices);
+#pragma omp CARET_PAR
+            {
+                MapProcessor threadProcessor(myProcessor);
+                vector<float> outMap(mapLength);
+#pragma omp CARET_FOR schedule(dynamic)
+                for (int64_t i = 0; i < blockMaps; ++i)
+                {
+                    threadProcessor.process(mapData.data() + i * mapLength, outMap.data());
+                    for (int64_t j = 0; j < mapLength; ++j)
+                    {
+                        mapData[i * mapLength + j] = outMap[j];
+                    }
+                }
+            }
+            for (int64_t row = 0; row < mapLength; ++row)
+            {
+                if (blockStart > 0) myCiftiOut->getRow(outRow.data(), row);//the first block wrote complete rows, so later blocks modify them
+                for (int64_t i = 0; i < blockMaps; ++i)
+                {
+                    outRow[blockStart + i] = mapData[i * mapLength + row];
+                }
+                myCiftiOut->setRow(outRow.data(), row);
+            }
+        }
+    }
+}
+
+float AlgorithmCiftiTFCE::getAlgorithmInternalWeight()
+{
+    return 1.0f;//override this if needed, if the progress bar isn't smooth
+}
+
+float AlgorithmCiftiTFCE::getSubAlgorithmWeight()
+{
+    //return AlgorithmInsertNameHere::getAlgorithmWeight();//if you use a subalgorithm
+    return 0.0f;
+}
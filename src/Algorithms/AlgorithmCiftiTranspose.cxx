@@ -47,7 +47,9 @@ OperationParameters* AlgorithmCiftiTranspose::getParameters()
     
     ret->setHelpText(
         AString("The input must be a 2-dimensional cifti file.  ") +
-        "The output is a cifti file where every row in the input is a column in the output."
+        "The output is a cifti file where every row in the input is a column in the output.  " +
+        "If the input file is tiled, or the output is written tiled (see the -cifti-output-tiled global option), " +
+        "the transpose is done in one pass using column access, and -mem-limit is not needed."
     );
     return ret;
 }
@@ -83,6 +85,26 @@ AlgorithmCiftiTranspose::AlgorithmCiftiTranspose(ProgressObject* myProgObj, cons
     outXML.setMap(1, *(inXML.getMap(0)));
     ciftiOut->setCiftiXML(outXML);
     int rowSize = outXML.getDimensionLength(CiftiXML::ALONG_ROW), colSize = outXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
+    if (ciftiIn->isInMemory() || ciftiIn->getTileSize() > 0)
+    {//getColumn touches only one tile column per tile size columns, so read output rows directly
+        vector<float> scratchRow(rowSize);
+        for (int i = 0; i < colSize; ++i)
+        {
+            ciftiIn->getColumn(scratchRow.data(), i);
+            ciftiOut->setRow(scratchRow.data(), i);
+        }
+        return;
+    }
+    if (ciftiOut->getWritingTileSize() > 0 && !ciftiOut->isInMemory())
+    {//input rows become output columns, which get collected into bands of tiles before being written
+        vector<float> scratchColumn(colSize);
+        for (int j = 0; j < rowSize; ++j)
+        {
+            ciftiIn->getRow(scratchColumn.data(), j);
+            ciftiOut->setColumn(scratchColumn.data(), j);
+        }
+        return;
+    }
     int64_t outRowBytes = rowSize * sizeof(float);
     int numCacheRows = colSize;
     if (memLimitGB >= 0.0f)
@@ -23,15 +23,17 @@
 
 #include "AbstractAlgorithm.h"
 
+#include <vector>
+
 namespace caret {
     
-    class TopologyHelper;
+    class TFCEHelper;
     
     class AlgorithmMetricTFCE : public AbstractAlgorithm
     {
         AlgorithmMetricTFCE();
-        void processColumn(const SurfaceFile* mySurf, const float* colData, float* outData, const float* roiData, const float& param_e, const float& param_h, const float* areaData);
-        void tfce_pos(TopologyHelper* myHelper, const float* colData, double* accumData, const float* roiData, const float& param_e, const float& param_h, const float* areaData);
+        void processColumn(TFCEHelper& myHelper, const std::vector<int64_t>& nodeList, const float* colData, float* outData,
+                           float* scratchIn, float* scratchOut, const float& param_e, const float& param_h);
     protected:
         static float getSubAlgorithmWeight();
         static float getAlgorithmInternalWeight();
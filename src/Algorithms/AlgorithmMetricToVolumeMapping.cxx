@@ -167,16 +167,28 @@ AlgorithmMetricToVolumeMapping::AlgorithmMetricToVolumeMapping(ProgressObject* m
     const int64_t frameSize = dims[0] * dims[1] * dims[2];
     vector<int32_t> voxelToVertex(frameSize);
     CaretPointer<const CaretPointLocator> myLocator = mySurf->getPointLocator();
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int64_t k = 0; k < dims[2]; ++k)
-    {
-        for (int64_t j = 0; j < dims[1]; ++j)
+    const int64_t sliceSize = dims[0] * dims[1];
+#pragma omp CARET_PAR
+    {//one batch query per slice, with the slices in parallel, because the locator only threads batches of several thousand targets
+        vector<float> sliceCoords(sliceSize * 3);
+        vector<int64_t> sliceVertices(sliceSize);
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t k = 0; k < dims[2]; ++k)
         {
-            for (int64_t i = 0; i < dims[0]; ++i)
+            for (int64_t j = 0; j < dims[1]; ++j)
             {
-                float voxelCoord[3];
-                myVolSpace.indexToSpace(i, j, k, voxelCoord);
-                voxelToVertex[myVolSpace.getIndex(i, j, k)] = myLocator->closestPointLimited(voxelCoord, nearDist);
+                for (int64_t i = 0; i < dims[0]; ++i)
+                {
+                    myVolSpace.indexToSpace(i, j, k, sliceCoords.data() + (i + j * dims[0]) * 3);
+                }
+            }
+            myLocator->closestPointsLimited(sliceCoords.data(), sliceSize, nearDist, sliceVertices.data());
+            for (int64_t j = 0; j < dims[1]; ++j)
+            {
+                for (int64_t i = 0; i < dims[0]; ++i)
+                {
+                    voxelToVertex[myVolSpace.getIndex(i, j, k)] = (int32_t)sliceVertices[i + j * dims[0]];
+                }
             }
         }
     }
@@ -25,11 +25,388 @@
 #include "CaretLogger.h"
 #include "CaretOMP.h"
 #include "CaretAssert.h"
+#include "CaretPointer.h"
+
+#include <algorithm>
 #include <cmath>
+#include <complex>
+#include <vector>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{//hidden namespace just to make sure things don't collide
+    //mixed radix complex FFT of one length, recursive decimation in time, the lengths we use only have factors of 2, 3 and 5
+    class FFTPlan
+    {
+        int64_t m_size;
+        vector<int64_t> m_factors;//pairs of radix and remaining length after that radix
+        vector<complex<double> > m_twiddles;//exp(-2 pi i k / size)
+        static complex<double> mult(const complex<double>& a, const complex<double>& b)
+        {//std::complex multiply does extra work for infinities
+            return complex<double>(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+        }
+        complex<double> twiddle(const int64_t& index, const bool& inverse) const
+        {
+            return (inverse ? conj(m_twiddles[index]) : m_twiddles[index]);
+        }
+        void work(complex<double>* out, const complex<double>* in, const int64_t& fstride, const int64_t* factors, const bool& inverse) const
+        {
+            const int64_t p = factors[0], m = factors[1];
+            if (m == 1)
+            {
+                for (int64_t q = 0; q < p; ++q)
+                {
+                    out[q] = in[q * fstride];
+                }
+            } else {
+                for (int64_t q = 0; q < p; ++q)
+                {
+                    work(out + q * m, in + q * fstride, fstride * p, factors + 2, inverse);
+                }
+            }
+            if (p == 2)
+            {
+                for (int64_t u = 0; u < m; ++u)
+                {
+                    complex<double> temp = mult(out[u + m], twiddle(u * fstride, inverse));
+                    out[u + m] = out[u] - temp;
+                    out[u] += temp;
+                }
+            } else {
+                const int MAX_RADIX = 5;
+                CaretAssert(p <= MAX_RADIX);
+                complex<double> scratch[MAX_RADIX];
+                for (int64_t u = 0; u < m; ++u)
+                {
+                    for (int64_t q = 0; q < p; ++q)
+                    {
+                        scratch[q] = out[u + q * m];
+                    }
+                    for (int64_t q1 = 0; q1 < p; ++q1)
+                    {
+                        const int64_t k = u + q1 * m;
+                        complex<double> accum = scratch[0];
+                        int64_t twidx = 0;
+                        for (int64_t q = 1; q < p; ++q)
+                        {
+                            twidx += fstride * k;
+                            if (twidx >= m_size) twidx -= m_size;
+                            accum += mult(scratch[q], twiddle(twidx, inverse));
+                        }
+                        out[k] = accum;
+                    }
+                }
+            }
+        }
+    public:
+        FFTPlan(const int64_t& size)
+        {
+            m_size = size;
+            int64_t remaining = size;
+            const int64_t radixes[3] = { 2, 3, 5 };
+            for (int r = 0; r < 3; ++r)
+            {
+                while (remaining % radixes[r] == 0)
+                {
+                    remaining /= radixes[r];
+                    m_factors.push_back(radixes[r]);
+                    m_factors.push_back(remaining);
+                }
+            }
+            CaretAssert(remaining == 1);
+            m_twiddles.resize(size);
+            for (int64_t i = 0; i < size; ++i)
+            {
+                double phase = -2.0 * 3.14159265358979323846 * i / size;
+                m_twiddles[i] = complex<double>(cos(phase), sin(phase));
+            }
+        }
+        int64_t getSize() const { return m_size; }
+        ///unnormalized, in and out must not overlap
+        void transform(const complex<double>* in, complex<double>* out, const bool& inverse) const
+        {
+            work(out, in, 1, m_factors.data(), inverse);
+        }
+    };
+    
+    int64_t nextFFTSize(const int64_t& minSize)
+    {
+        for (int64_t ret = max(minSize, (int64_t)1); ; ++ret)
+        {
+            int64_t remaining = ret;
+            while (remaining % 2 == 0) remaining /= 2;
+            while (remaining % 3 == 0) remaining /= 3;
+            while (remaining % 5 == 0) remaining /= 5;
+            if (remaining == 1) return ret;
+        }
+    }
+    
+    //the spectrum of the kernel on a zero-padded grid, large enough that circular convolution doesn't wrap around into the volume
+    class FFTConvolver;
+    
+    struct FFTKernel
+    {
+        int64_t m_dims[3], m_padDims[3];
+        CaretPointer<FFTPlan> m_plans[3];
+        vector<double> m_spectrum;//the kernel is symmetric, so its spectrum is real, includes the normalization of the inverse transform
+        float m_minWeight;//smallest nonzero weight in the kernel, to tell "no data" apart from roundoff
+        FFTKernel(const vector<int64_t>& dims, const float* const* const* weights, const int& irange, const int& jrange, const int& krange);
+    };
+    
+    class FFTConvolver
+    {
+        const FFTKernel& m_kernel;
+        vector<complex<double> > m_data;
+        friend struct FFTKernel;
+        void transformAxis(const int& axis, const int64_t& limitA, const int64_t& limitB, const bool& inverse, const bool& parallel);
+    public:
+        FFTConvolver(const FFTKernel& kernel);
+        ///convolve two real volumes at once, as the real and imaginary parts of one transform - b may be NULL, outB is only written if b is not NULL
+        void convolvePair(const float* a, const float* b, float* outA, float* outB, const bool& parallel);
+    };
+    
+    FFTKernel::FFTKernel(const vector<int64_t>& dims, const float* const* const* weights, const int& irange, const int& jrange, const int& krange)
+    {
+        const int ranges[3] = { irange, jrange, krange };
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            m_dims[axis] = dims[axis];
+            m_padDims[axis] = nextFFTSize(dims[axis] + ranges[axis]);
+            m_plans[axis].grabNew(new FFTPlan(m_padDims[axis]));
+        }
+        const int64_t padSize = m_padDims[0] * m_padDims[1] * m_padDims[2];
+        vector<complex<double> > kernelData(padSize, complex<double>(0.0, 0.0));
+        m_minWeight = -1.0f;
+        for (int k = -krange; k <= krange; ++k)
+        {
+            const int64_t kpad = (k + m_padDims[2]) % m_padDims[2];
+            for (int j = -jrange; j <= jrange; ++j)
+            {
+                const int64_t jpad = (j + m_padDims[1]) % m_padDims[1];
+                for (int i = -irange; i <= irange; ++i)
+                {
+                    const int64_t ipad = (i + m_padDims[0]) % m_padDims[0];
+                    const float weight = weights[k + krange][j + jrange][i + irange];
+                    kernelData[ipad + m_padDims[0] * (jpad + m_padDims[1] * kpad)] = weight;
+                    if (weight > 0.0f && (m_minWeight < 0.0f || weight < m_minWeight)) m_minWeight = weight;
+                }
+            }
+        }
+        FFTConvolver myConv(*this);//only uses the plans and dimensions
+        myConv.m_data.swap(kernelData);
+        myConv.transformAxis(0, m_padDims[1], m_padDims[2], false, true);
+        myConv.transformAxis(1, m_padDims[0], m_padDims[2], false, true);
+        myConv.transformAxis(2, m_padDims[0], m_padDims[1], false, true);
+        m_spectrum.resize(padSize);
+        for (int64_t i = 0; i < padSize; ++i)
+        {
+            m_spectrum[i] = myConv.m_data[i].real() / padSize;
+        }
+    }
+    
+    FFTConvolver::FFTConvolver(const FFTKernel& kernel) : m_kernel(kernel)
+    {
+    }
+    
+    void FFTConvolver::transformAxis(const int& axis, const int64_t& limitA, const int64_t& limitB, const bool& inverse, const bool& parallel)
+    {//transform the lines along axis, where the other two coordinates (in increasing axis order) are less than limitA and limitB
+        const int64_t strides[3] = { 1, m_kernel.m_padDims[0], m_kernel.m_padDims[0] * m_kernel.m_padDims[1] };
+        const int axisA = (axis == 0 ? 1 : 0), axisB = (axis == 2 ? 1 : 2);
+        const int64_t stride = strides[axis], strideA = strides[axisA], strideB = strides[axisB];
+        const FFTPlan& myPlan = *(m_kernel.m_plans[axis]);
+        const int64_t length = myPlan.getSize(), numLines = limitA * limitB;
+        complex<double>* data = m_data.data();
+#pragma omp CARET_PAR if (parallel)
+        {
+            vector<complex<double> > lineIn(length), lineOut(length);
+#pragma omp CARET_FOR
+            for (int64_t line = 0; line < numLines; ++line)
+            {
+                complex<double>* base = data + (line % limitA) * strideA + (line / limitA) * strideB;
+                for (int64_t i = 0; i < length; ++i)
+                {
+                    lineIn[i] = base[i * stride];
+                }
+                myPlan.transform(lineIn.data(), lineOut.data(), inverse);
+                for (int64_t i = 0; i < length; ++i)
+                {
+                    base[i * stride] = lineOut[i];
+                }
+            }
+        }
+    }
+    
+    void FFTConvolver::convolvePair(const float* a, const float* b, float* outA, float* outB, const bool& parallel)
+    {
+        const int64_t* dims = m_kernel.m_dims, *padDims = m_kernel.m_padDims;
+        const int64_t padSize = padDims[0] * padDims[1] * padDims[2];
+        m_data.assign(padSize, complex<double>(0.0, 0.0));//doesn't reallocate after the first time
+        for (int64_t k = 0; k < dims[2]; ++k)
+        {
+            for (int64_t j = 0; j < dims[1]; ++j)
+            {
+                const int64_t inBase = dims[0] * (j + dims[1] * k), padBase = padDims[0] * (j + padDims[1] * k);
+                for (int64_t i = 0; i < dims[0]; ++i)
+                {
+                    m_data[padBase + i] = complex<double>(a[inBase + i], (b == NULL ? 0.0 : b[inBase + i]));
+                }
+            }
+        }//lines that are entirely padding stay zero, so skip them
+        transformAxis(0, dims[1], dims[2], false, parallel);
+        transformAxis(1, padDims[0], dims[2], false, parallel);
+        transformAxis(2, padDims[0], padDims[1], false, parallel);
+        const double* spectrum = m_kernel.m_spectrum.data();
+        for (int64_t i = 0; i < padSize; ++i)
+        {
+            m_data[i] *= spectrum[i];
+        }//and in reverse, only the lines that end up inside the volume are needed
+        transformAxis(2, padDims[0], padDims[1], true, parallel);
+        transformAxis(1, padDims[0], dims[2], true, parallel);
+        transformAxis(0, dims[1], dims[2], true, parallel);
+        for (int64_t k = 0; k < dims[2]; ++k)
+        {
+            for (int64_t j = 0; j < dims[1]; ++j)
+            {
+                const int64_t outBase = dims[0] * (j + dims[1] * k), padBase = padDims[0] * (j + padDims[1] * k);
+                for (int64_t i = 0; i < dims[0]; ++i)
+                {
+                    outA[outBase + i] = (float)m_data[padBase + i].real();
+                    if (b != NULL) outB[outBase + i] = (float)m_data[padBase + i].imag();
+                }
+            }
+        }
+    }
+    
+    struct FrameJob
+    {
+        const float* m_input;
+        int64_t m_outSubvol, m_outComponent;
+        FrameJob(const float* input, const int64_t& outSubvol, const int64_t& outComponent) : m_input(input), m_outSubvol(outSubvol), m_outComponent(outComponent) { }
+    };
+    
+    const double FFT_MEM_BUDGET_GB = 2.0;//total for the per-thread FFT buffers when smoothing frames in parallel
+    
+    int getNumThreads()
+    {
+#ifdef CARET_OMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+    
+    bool fftIsFaster(const vector<int64_t>& dims, const int& irange, const int& jrange, const int& krange, const double& tapsPerVoxel, const bool& fixZeros)
+    {//rough flop counts: direct does a multiply-add on the data and on the weights for each kernel tap, a complex transform is about 5 * N * log2(N) each way
+        const double numVoxels = (double)dims[0] * dims[1] * dims[2];
+        const double padSize = (double)nextFFTSize(dims[0] + irange) * nextFFTSize(dims[1] + jrange) * nextFFTSize(dims[2] + krange);
+        const double directCost = 4.0 * tapsPerVoxel * numVoxels;
+        double fftCost = 10.0 * padSize * log2(padSize);
+        if (!fixZeros) fftCost /= 2.0;//two frames share a transform when the weight sums don't depend on the data
+        return fftCost < directCost;
+    }
+    
+    void normalizeFrame(const float* sums, const float* weightSums, const float* roiFrame, const float& cutoff, const int64_t& frameSize, float* frameOut)
+    {
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            if ((roiFrame == NULL || roiFrame[i] > 0.0f) && weightSums[i] > cutoff)
+            {
+                frameOut[i] = sums[i] / weightSums[i];
+            } else {
+                frameOut[i] = 0.0f;
+            }
+        }
+    }
+    
+    void smoothFramesFFT(const vector<FrameJob>& jobs, VolumeFile* outVol, const FFTKernel& myKernel, const float* roiFrame, const bool& fixZeros)
+    {
+        const int64_t frameSize = myKernel.m_dims[0] * myKernel.m_dims[1] * myKernel.m_dims[2];
+        const int64_t numJobs = (int64_t)jobs.size();
+        const float cutoff = myKernel.m_minWeight * 0.5f;//a voxel with any data in its kernel has at least the smallest weight
+        vector<float> fixedWeightSums;
+        if (!fixZeros)
+        {//the weight sums don't depend on the data, so get them once
+            vector<float> mask(frameSize, 1.0f);
+            if (roiFrame != NULL)
+            {
+                for (int64_t i = 0; i < frameSize; ++i)
+                {
+                    mask[i] = (roiFrame[i] > 0.0f ? 1.0f : 0.0f);
+                }
+            }
+            fixedWeightSums.resize(frameSize);
+            FFTConvolver myConv(myKernel);
+            myConv.convolvePair(mask.data(), NULL, fixedWeightSums.data(), NULL, true);
+        }
+        const int64_t framesPerTransform = (fixZeros ? 1 : 2);
+        const int64_t numTransforms = (numJobs + framesPerTransform - 1) / framesPerTransform;
+        //each thread working on its own frames needs its own padded complex volume, so limit how many of them exist at once
+        const int numThreads = getNumThreads();
+        const double convolverBytes = (double)myKernel.m_padDims[0] * myKernel.m_padDims[1] * myKernel.m_padDims[2] * sizeof(complex<double>) + 5.0 * frameSize * sizeof(float);
+        int numWorkers = (int)min((double)numThreads, FFT_MEM_BUDGET_GB * 1024 * 1024 * 1024 / convolverBytes);
+        if (numWorkers < 1) numWorkers = 1;
+        //when the budget allows less than half the threads, splitting every transform across all threads is faster
+        const bool frameParallel = (numWorkers > 1 && numWorkers * 2 >= numThreads && numTransforms > 1 && numTransforms >= numWorkers);
+#pragma omp CARET_PAR if (frameParallel) num_threads(numWorkers)
+        {
+            FFTConvolver myConv(myKernel);
+            vector<float> inA(frameSize), inB(frameSize), outA(frameSize), outB(frameSize), result(frameSize);
+#pragma omp CARET_FOR schedule(dynamic)
+            for (int64_t t = 0; t < numTransforms; ++t)
+            {
+                if (fixZeros)
+                {//transform the used data and the mask of used voxels together
+                    const FrameJob& myJob = jobs[t];
+                    for (int64_t i = 0; i < frameSize; ++i)
+                    {
+                        if ((roiFrame == NULL || roiFrame[i] > 0.0f) && myJob.m_input[i] != 0.0f)
+                        {
+                            inA[i] = myJob.m_input[i];
+                            inB[i] = 1.0f;
+                        } else {
+                            inA[i] = 0.0f;
+                            inB[i] = 0.0f;
+                        }
+                    }
+                    myConv.convolvePair(inA.data(), inB.data(), outA.data(), outB.data(), !frameParallel);
+                    normalizeFrame(outA.data(), outB.data(), roiFrame, cutoff, frameSize, result.data());
+#pragma omp critical
+                    outVol->setFrame(result.data(), myJob.m_outSubvol, myJob.m_outComponent);//setFrame also calls setModified, which isn't thread safe
+                } else {
+                    const FrameJob& firstJob = jobs[t * 2];
+                    const bool haveSecond = (t * 2 + 1 < numJobs);
+                    for (int64_t i = 0; i < frameSize; ++i)
+                    {
+                        inA[i] = ((roiFrame == NULL || roiFrame[i] > 0.0f) ? firstJob.m_input[i] : 0.0f);
+                    }
+                    if (haveSecond)
+                    {
+                        const FrameJob& secondJob = jobs[t * 2 + 1];
+                        for (int64_t i = 0; i < frameSize; ++i)
+                        {
+                            inB[i] = ((roiFrame == NULL || roiFrame[i] > 0.0f) ? secondJob.m_input[i] : 0.0f);
+                        }
+                    }
+                    myConv.convolvePair(inA.data(), (haveSecond ? inB.data() : NULL), outA.data(), outB.data(), !frameParallel);
+                    normalizeFrame(outA.data(), fixedWeightSums.data(), roiFrame, cutoff, frameSize, result.data());
+#pragma omp critical
+                    outVol->setFrame(result.data(), firstJob.m_outSubvol, firstJob.m_outComponent);
+                    if (haveSecond)
+                    {
+                        const FrameJob& secondJob = jobs[t * 2 + 1];
+                        normalizeFrame(outB.data(), fixedWeightSums.data(), roiFrame, cutoff, frameSize, result.data());
+#pragma omp critical
+                        outVol->setFrame(result.data(), secondJob.m_outSubvol, secondJob.m_outComponent);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
 //makes the program issue warning only once per launch, prevents repeated calls by other algorithms from spamming
 bool AlgorithmVolumeSmoothing::haveWarned = false;
 
@@ -62,8 +439,9 @@ OperationParameters* AlgorithmVolumeSmoothing::getParameters()
     
     ret->setHelpText(
         AString("Gaussian smoothing for volumes.  By default, smooths all subvolumes with no ROI, if ROI is given, only ") +
-        "positive voxels in the ROI volume have their values used, and all other voxels are set to zero.  Smoothing a non-orthogonal volume will " +
-        "be significantly slower, because the operation cannot be separated into 1-dimensional smoothings without distorting the kernel shape.\n\n" +
+        "positive voxels in the ROI volume have their values used, and all other voxels are set to zero.  A non-orthogonal volume cannot be " +
+        "smoothed as separate 1-dimensional smoothings without distorting the kernel shape, so it and very large kernels are instead smoothed " +
+        "by FFT convolution, when that is estimated to be faster.\n\n" +
         "The -fix-zeros option causes the smoothing to not use an input value if it is zero, but still write a smoothed value to the voxel.  " +
         "This is useful for zeros that indicate lack of information, preventing them from pulling down the intensity of nearby voxels, while " +
         "giving the zero an extrapolated value."
@@ -116,21 +494,46 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
     {
         throw AlgorithmException("kernel too small");
     }
-    CaretArray<float> scratchFrame(myDims[0] * myDims[1] * myDims[2]);//it could be faster to preinitialize with zeros, then generate a usable voxels list if there is a small ROI...
+    const int64_t frameSize = myDims[0] * myDims[1] * myDims[2];
     float kernBox = kernel * 3.0f;
     vector<vector<float> > volSpace = inVol->getSform();
     Vector3D ivec, jvec, kvec, origin, ijorth, jkorth, kiorth;
     ivec[0] = volSpace[0][0]; jvec[0] = volSpace[0][1]; kvec[0] = volSpace[0][2]; origin[0] = volSpace[0][3];
     ivec[1] = volSpace[1][0]; jvec[1] = volSpace[1][1]; kvec[1] = volSpace[1][2]; origin[1] = volSpace[1][3];
     ivec[2] = volSpace[2][0]; jvec[2] = volSpace[2][1]; kvec[2] = volSpace[2][2]; origin[2] = volSpace[2][3];
+    vector<FrameJob> jobs;//set up the output, and list the frames to smooth
+    if (subvol == -1)
+    {
+        vector<int64_t> origDims = inVol->getOriginalDimensions();
+        outVol->reinitialize(origDims, volSpace, myDims[4]);
+        for (int s = 0; s < myDims[3]; ++s)
+        {
+            outVol->setMapName(s, inVol->getMapName(s) + ", smooth " + AString::number(kernel));
+            for (int c = 0; c < myDims[4]; ++c)
+            {
+                jobs.push_back(FrameJob(inVol->getFrame(s, c), s, c));
+            }
+        }
+    } else {
+        vector<int64_t> origDims = inVol->getOriginalDimensions(), newDims;
+        newDims.resize(3);
+        newDims[0] = origDims[0];
+        newDims[1] = origDims[1];
+        newDims[2] = origDims[2];
+        outVol->reinitialize(newDims, volSpace, myDims[4]);
+        outVol->setMapName(0, inVol->getMapName(subvol) + ", smooth " + AString::number(kernel));
+        for (int c = 0; c < myDims[4]; ++c)
+        {
+            jobs.push_back(FrameJob(inVol->getFrame(subvol, c), 0, c));
+        }
+    }
+    const int64_t numJobs = (int64_t)jobs.size();
+    const bool frameParallel = (numJobs > 1 && numJobs >= getNumThreads());//with enough frames, give each thread whole frames, rather than splitting every frame across threads
+    const float* roiFrame = NULL;
+    if (roiVol != NULL) roiFrame = roiVol->getFrame();
     const float ORTH_TOLERANCE = 0.001f;//tolerate this much deviation from orthogonal (dot product divided by product of lengths) to use orthogonal assumptions to smooth
     if (abs(ivec.dot(jvec.normal())) / ivec.length() < ORTH_TOLERANCE && abs(jvec.dot(kvec.normal())) / jvec.length() < ORTH_TOLERANCE && abs(kvec.dot(ivec.normal())) / kvec.length() < ORTH_TOLERANCE)
     {//if our axes are orthogonal, optimize by doing three 1-dimensional smoothings for O(voxels * (ki + kj + kk)) instead of O(voxels * (ki * kj * kk))
-        CaretArray<float> scratchFrame2(myDims[0] * myDims[1] * myDims[2]), scratchWeights(myDims[0] * myDims[1] * myDims[2]), scratchWeights2(myDims[0] * myDims[1] * myDims[2]), scratchFrame3;
-        if (roiVol != NULL)
-        {
-            scratchFrame3 = CaretArray<float> (myDims[0] * myDims[1] * myDims[2]);
-        }
         float ispace = ivec.length(), jspace = jvec.length(), kspace = kvec.length();
         int irange = (int)floor(kernBox / ispace);
         int jrange = (int)floor(kernBox / jspace);
@@ -157,53 +560,58 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
             float tempf = kspace * (k - krange) / kernel;
             kweights[k] = exp(-tempf * tempf / 2.0f);
         }
-        if (subvol == -1)
-        {
-            vector<int64_t> origDims = inVol->getOriginalDimensions();
-            outVol->reinitialize(origDims, volSpace, myDims[4]);
-            vector<int> lists[3];
-            for (int s = 0; s < myDims[3]; ++s)
+        if (fftIsFaster(myDims, irange, jrange, krange, isize + jsize + ksize, fixZeros))
+        {//very large kernels, the separable kernel is the product of the 1D kernels
+            CaretArray<float**> weights(ksize);
+            CaretArray<float*> weights2(ksize * jsize);
+            CaretArray<float> weights3(ksize * jsize * isize);
+            for (int k = 0; k < ksize; ++k)
             {
-                outVol->setMapName(s, inVol->getMapName(s) + ", smooth " + AString::number(kernel));
-                for (int c = 0; c < myDims[4]; ++c)
+                weights[k] = weights2 + k * jsize;
+                for (int j = 0; j < jsize; ++j)
                 {
-                    const float* inFrame = inVol->getFrame(s, c);
-                    if (roiVol == NULL)
+                    weights[k][j] = weights3 + ((k * jsize) + j) * isize;
+                    for (int i = 0; i < isize; ++i)
                     {
-                        smoothFrame(inFrame, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, inVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
-                    } else {
-                        smoothFrameROI(inFrame, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
+                        weights[k][j][i] = kweights[k] * jweights[j] * iweights[i];
                     }
-                    outVol->setFrame(scratchFrame, s, c);
                 }
             }
-        } else {
-            vector<int64_t> origDims = inVol->getOriginalDimensions(), newDims;
-            newDims.resize(3);
-            newDims[0] = origDims[0];
-            newDims[1] = origDims[1];
-            newDims[2] = origDims[2];
-            outVol->reinitialize(newDims, volSpace, myDims[4]);
-            vector<int> lists[3];
-            outVol->setMapName(0, inVol->getMapName(subvol) + ", smooth " + AString::number(kernel));
-            for (int c = 0; c < myDims[4]; ++c)
+            FFTKernel myKernel(myDims, weights, irange, jrange, krange);
+            smoothFramesFFT(jobs, outVol, myKernel, roiFrame, fixZeros);
+            return;
+        }
+        vector<int> lists[3];
+        int64_t firstJob = 0;
+        if (roiVol != NULL && numJobs > 0)
+        {//the first ROI frame builds the voxel lists that the others use, so do it alone
+            CaretArray<float> scratchFrame(frameSize), scratchFrame2(frameSize), scratchFrame3(frameSize), scratchWeights(frameSize), scratchWeights2(frameSize);
+            smoothFrameROI(jobs[0].m_input, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
+            outVol->setFrame(scratchFrame, jobs[0].m_outSubvol, jobs[0].m_outComponent);
+            firstJob = 1;
+        }
+#pragma omp CARET_PAR if (frameParallel)
+        {
+            //the ROI version only updates the voxels in its lists after the first frame, so the rest must start as zero, as the first frame left them
+            CaretArray<float> scratchFrame(frameSize, 0.0f), scratchFrame2(frameSize, 0.0f), scratchWeights(frameSize, 0.0f), scratchWeights2(frameSize, 0.0f), scratchFrame3;
+            if (roiVol != NULL)
             {
-                const float* inFrame = inVol->getFrame(subvol, c);
+                scratchFrame3 = CaretArray<float>(frameSize, 0.0f);
+            }
+#pragma omp CARET_FOR schedule(dynamic)
+            for (int64_t job = firstJob; job < numJobs; ++job)
+            {//when frameParallel, the loops inside these functions don't split further (no nested parallelism)
                 if (roiVol == NULL)
                 {
-                    smoothFrame(inFrame, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, inVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
+                    smoothFrame(jobs[job].m_input, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, inVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
                 } else {
-                    smoothFrameROI(inFrame, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
+                    smoothFrameROI(jobs[job].m_input, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
                 }
-                outVol->setFrame(scratchFrame, 0, c);
+#pragma omp critical
+                outVol->setFrame(scratchFrame, jobs[job].m_outSubvol, jobs[job].m_outComponent);
             }
         }
     } else {
-        if (!haveWarned)
-        {
-            CaretLogWarning("input volume is not orthogonal, smoothing will take longer");
-            haveWarned = true;
-        }
         ijorth = ivec.cross(jvec).normal();//find the bounding box that encloses a sphere of radius kernBox
         jkorth = jvec.cross(kvec).normal();
         kiorth = kvec.cross(ivec).normal();
@@ -220,6 +628,7 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
         CaretArray<float*> weights2(ksize * jsize);//construct flat arrays and index them into 3D
         CaretArray<float> weights3(ksize * jsize * isize);//index i comes last because that is linear for volume frames
         Vector3D kscratch, jscratch, iscratch;
+        int64_t numTaps = 0;
         for (int k = 0; k < ksize; ++k)
         {
             kscratch = kvec * (k - krange);
@@ -237,37 +646,31 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
                         weights[k][j][i] = 0.0f;//test for zero to avoid some multiplies/adds, cheaper or cleaner than checking bounds on indexes from an index list
                     } else {
                         weights[k][j][i] = exp(-tempf * tempf / kernel / kernel / 2.0f);//optimization here isn't critical
+                        ++numTaps;
                     }
                 }
             }
         }
-        if (subvol == -1)
+        if (fftIsFaster(myDims, irange, jrange, krange, numTaps, fixZeros))
         {
-            vector<int64_t> origDims = inVol->getOriginalDimensions();
-            outVol->reinitialize(origDims, volSpace, myDims[4]);
-            for (int s = 0; s < myDims[3]; ++s)
-            {
-                outVol->setMapName(s, inVol->getMapName(s) + ", smooth " + AString::number(kernel));
-                for (int c = 0; c < myDims[4]; ++c)
-                {
-                    const float* inFrame = inVol->getFrame(s, c);
-                    smoothFrameNonOrth(inFrame, myDims, scratchFrame, inVol, roiVol, weights, irange, jrange, krange, fixZeros);
-                    outVol->setFrame(scratchFrame, s, c);
-                }
-            }
-        } else {
-            vector<int64_t> origDims = inVol->getOriginalDimensions(), newDims;
-            newDims.resize(3);
-            newDims[0] = origDims[0];
-            newDims[1] = origDims[1];
-            newDims[2] = origDims[2];
-            outVol->reinitialize(newDims, volSpace, myDims[4]);
-            outVol->setMapName(0, inVol->getMapName(subvol) + ", smooth " + AString::number(kernel));
-            for (int c = 0; c < myDims[4]; ++c)
+            FFTKernel myKernel(myDims, weights, irange, jrange, krange);
+            smoothFramesFFT(jobs, outVol, myKernel, roiFrame, fixZeros);
+            return;
+        }
+        if (!haveWarned)
+        {
+            CaretLogWarning("input volume is not orthogonal, smoothing will take longer");
+            haveWarned = true;
+        }
+#pragma omp CARET_PAR if (frameParallel)
+        {
+            CaretArray<float> scratchFrame(frameSize);
+#pragma omp CARET_FOR schedule(dynamic)
+            for (int64_t job = 0; job < numJobs; ++job)
             {
-                const float* inFrame = inVol->getFrame(subvol, c);
-                smoothFrameNonOrth(inFrame, myDims, scratchFrame, inVol, roiVol, weights, irange, jrange, krange, fixZeros);
-                outVol->setFrame(scratchFrame, 0, c);
+                smoothFrameNonOrth(jobs[job].m_input, myDims, scratchFrame, inVol, roiVol, weights, irange, jrange, krange, fixZeros);
+#pragma omp critical
+                outVol->setFrame(scratchFrame, jobs[job].m_outSubvol, jobs[job].m_outComponent);
             }
         }
     }
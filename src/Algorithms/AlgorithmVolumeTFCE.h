@@ -23,13 +23,17 @@
 
 #include "AbstractAlgorithm.h"
 
+#include <vector>
+
 namespace caret {
     
+    class TFCEHelper;
+    
     class AlgorithmVolumeTFCE : public AbstractAlgorithm
     {
         AlgorithmVolumeTFCE();
-        void processFrame(const VolumeFile* inVol, const int64_t& b, const int64_t& c, float* outData, const float* roiData, const float& param_e, const float& param_h);
-        void tfce(const VolumeFile* inVol, const int64_t& b, const int64_t& c, double* accumData, const float* roiData, const float& param_e, const float& param_h, const bool& negate);
+        void processFrame(TFCEHelper& myHelper, const std::vector<int64_t>& voxelIndices, const float* inData, float* outData,
+                          float* scratchIn, float* scratchOut, const float& param_e, const float& param_h);
     protected:
         static float getSubAlgorithmWeight();
         static float getAlgorithmInternalWeight();
@@ -22,6 +22,7 @@
 #include "AlgorithmException.h"
 
 #include "CaretOMP.h"
+#include "CiftiBrainModelsMap.h"
 #include "FloatMatrix.h"
 #include "MathFunctions.h"
 #include "MetricFile.h"
@@ -33,6 +34,7 @@
 #include "AlgorithmSurfaceToSurface3dDistance.h"
 #include "AlgorithmCreateSignedDistanceVolume.h"
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 
@@ -79,6 +81,11 @@ OperationParameters* AlgorithmVolumeToSurfaceMapping::getParameters()
     ribbonWeights->addVolumeOutputParameter(2, "weights-out", "volume to write the weights to");
     OptionalParameter* ribbonWeightsText = ribbonOpt->createOptionalParameter(6, "-output-weights-text", "write the voxel weights for all vertices to a text file");
     ribbonWeightsText->addStringParameter(1, "text-out", "output - the output text filename");//fake the output formatting
+    OptionalParameter* ribbonSaveWeights = ribbonOpt->createOptionalParameter(9, "-save-weights", "save the voxel weights for all vertices, for use with -ribbon-weights");
+    ribbonSaveWeights->addStringParameter(1, "weights-out", "output - the output weights filename (.resample.wbsparse)");//fake the output formatting
+    
+    OptionalParameter* ribbonWeightsOpt = ret->createOptionalParameter(10, "-ribbon-weights", "use ribbon constrained mapping with previously saved weights");
+    ribbonWeightsOpt->addStringParameter(1, "weights-file", "the weights file from -save-weights");
     
     OptionalParameter* myelinStyleOpt = ret->createOptionalParameter(9, "-myelin-style", "use the method from myelin mapping");
     myelinStyleOpt->addVolumeParameter(1, "ribbon-roi", "an roi volume of the cortical ribbon for this hemisphere");
@@ -100,7 +107,10 @@ OperationParameters* AlgorithmVolumeToSurfaceMapping::getParameters()
         "voxels that don't have a positive value in the mask.  The subdivision number specifies how it approximates the amount of the volume the polyhedron " +
         "intersects, by splitting each voxel into NxNxN pieces, and checking whether the center of each piece is inside the polyhedron.  If you have very large " +
         "voxels, consider increasing this if you get zeros in your output.  " +
-        "The -gaussian option makes it act more like the myelin method, where the distance of a voxel from <surface> is used to downweight the voxel.\n\n" +
+        "The -gaussian option makes it act more like the myelin method, where the distance of a voxel from <surface> is used to downweight the voxel.  " +
+        "Computing the ribbon weights is the slow part of this method, so -save-weights can write them to a file, and -ribbon-weights can then use that file " +
+        "instead of -ribbon-constrained to map other volumes in the same volume space, for example every run of a subject.  " +
+        "The weights are saved as a sparse matrix from voxels to vertices, and all maps of the volume are mapped together through it.\n\n" +
         "The myelin style method uses part of the caret5 myelin mapping command to do the mapping: for each surface vertex, take all voxels that are in a cylinder " +
         "with width and height equal to cortical thickness, centered on the vertex and aligned with the surface normal, and that are also within the ribbon ROI, " +
         "and apply a gaussian kernel with the specified sigma to them to get the weights to use.  " +
@@ -120,6 +130,7 @@ void AlgorithmVolumeToSurfaceMapping::useParameters(OperationParameters* myParam
     OptionalParameter* cubicOpt = myParams->getOptionalParameter(8);
     OptionalParameter* ribbonOpt = myParams->getOptionalParameter(6);
     OptionalParameter* myelinStyleOpt = myParams->getOptionalParameter(9);
+    OptionalParameter* ribbonWeightsOpt = myParams->getOptionalParameter(10);
     int64_t mySubVol = -1;
     OptionalParameter* subvolumeSelect = myParams->getOptionalParameter(7);
     if (subvolumeSelect->m_present)
@@ -177,6 +188,15 @@ void AlgorithmVolumeToSurfaceMapping::useParameters(OperationParameters* myParam
         haveMethod = true;
         myMethod = MYELIN_STYLE;
     }
+    if (ribbonWeightsOpt->m_present)
+    {
+        if (haveMethod)
+        {
+            throw AlgorithmException("more than one mapping method specified");
+        }
+        haveMethod = true;
+        myMethod = RIBBON_WEIGHTS;
+    }
     if (!haveMethod)
     {
         throw AlgorithmException("no mapping method specified");
@@ -224,8 +244,14 @@ void AlgorithmVolumeToSurfaceMapping::useParameters(OperationParameters* myParam
                 weightsOutVertex = (int)ribbonWeights->getInteger(1);
                 weightsOut = ribbonWeights->getOutputVolume(2);
             }
+            ResamplingMatrix weightsMatrix;
+            OptionalParameter* ribbonSaveWeights = ribbonOpt->getOptionalParameter(9);
             AlgorithmVolumeToSurfaceMapping(myProgObj, myVolume, mySurface, myMetricOut, innerSurf, outerSurf, myRoiVol, subdivisions, thinColumns,
-                                            mySubVol, gaussScale, weightsOutVertex, weightsOut);
+                                            mySubVol, gaussScale, weightsOutVertex, weightsOut, (ribbonSaveWeights->m_present ? &weightsMatrix : NULL));
+            if (ribbonSaveWeights->m_present)
+            {
+                weightsMatrix.writeFile(ribbonSaveWeights->getString(1));
+            }
             OptionalParameter* ribbonWeightsText = ribbonOpt->getOptionalParameter(6);
             if (ribbonWeightsText->m_present)
             {//do this after the algorithm, to let it do the error condition checking
@@ -260,6 +286,13 @@ void AlgorithmVolumeToSurfaceMapping::useParameters(OperationParameters* myParam
             AlgorithmVolumeToSurfaceMapping(myProgObj, myVolume, mySurface, myMetricOut, roi, thickness, sigma, mySubVol, oldCutoffBug);
             break;
         }
+        case RIBBON_WEIGHTS:
+        {
+            ResamplingMatrix weightsMatrix;
+            weightsMatrix.readFile(ribbonWeightsOpt->getString(1));
+            AlgorithmVolumeToSurfaceMapping(myProgObj, myVolume, mySurface, myMetricOut, weightsMatrix, mySubVol);
+            break;
+        }
         default:
             throw AlgorithmException("this method not yet implemented");
     }
@@ -363,7 +396,7 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
 AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
                                                                  const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const VolumeFile* roiVol,
                                                                  const int32_t& subdivisions, const bool& thinColumns, const int64_t& mySubVol, const float& gaussScale,
-                                                                 const int& weightsOutVertex, VolumeFile* weightsOut) : AbstractAlgorithm(myProgObj)
+                                                                 const int& weightsOutVertex, VolumeFile* weightsOut, ResamplingMatrix* weightsMatrixOut) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     vector<int64_t> myVolDims;
@@ -411,75 +444,161 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
             weightsOut->setValue(vertexWeights[i].weight, vertexWeights[i].ijk);
         }
     }
-    CaretArray<float> myScratchArray(numNodes);
-    float* myScratch = myScratchArray.getArray();
+    bool haveWeights = false;
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        if (!myWeights[node].empty())
+        {
+            haveWeights = true;
+            break;
+        }
+    }
+    if (!haveWeights)
+    {
+        if (weightsMatrixOut != NULL) throw AlgorithmException("no voxels have ribbon mapping weights, cannot save weights");
+        applyWeightsMatrix(myVolume, NULL, myMetricOut, mySubVol, " ribbon constrained");
+        return;
+    }
+    ResamplingMatrix tempMatrix;
+    ResamplingMatrix* useMatrix = &tempMatrix;
+    if (weightsMatrixOut != NULL) useMatrix = weightsMatrixOut;
+    RibbonMappingHelper::weightsToMatrix(myWeights, myVolume->getVolumeSpace(), mySurface->getStructure(), *useMatrix);
+    applyWeightsMatrix(myVolume, useMatrix, myMetricOut, mySubVol, " ribbon constrained");
+}
+
+//ribbon mapping with saved weights
+AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
+                                                                 const ResamplingMatrix& ribbonWeights, const int64_t& mySubVol) : AbstractAlgorithm(myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    vector<int64_t> myVolDims;
+    myVolume->getDimensions(myVolDims);
+    if (mySubVol >= myVolDims[3] || mySubVol < -1)
+    {
+        throw AlgorithmException("invalid subvolume specified");
+    }
+    const CiftiBrainModelsMap& inSpace = ribbonWeights.getInputSpace(), &outSpace = ribbonWeights.getOutputSpace();
+    if (!inSpace.getSurfaceStructureList().empty() || !inSpace.hasVolumeData())
+    {
+        throw AlgorithmException("ribbon weights file must map from voxels only");
+    }
+    if (outSpace.getSurfaceStructureList().size() != 1 || outSpace.hasVolumeData())
+    {
+        throw AlgorithmException("ribbon weights file must map to a single surface");
+    }
+    if (!myVolume->matchesVolumeSpace(inSpace.getVolumeSpace()))
+    {
+        throw AlgorithmException("ribbon weights file was made for a different volume space than the input volume");
+    }
+    int64_t numNodes = mySurface->getNumberOfNodes();
+    if (outSpace.getSurfaceNumberOfNodes(outSpace.getSurfaceStructureList()[0]) != numNodes)
+    {
+        throw AlgorithmException("ribbon weights file was made for a different number of vertices than the surface");
+    }
+    StructureEnum::Enum weightsStructure = outSpace.getSurfaceStructureList()[0], surfStructure = mySurface->getStructure();
+    if (surfStructure == StructureEnum::INVALID) surfStructure = StructureEnum::OTHER;//saving the weights does the same
+    if (weightsStructure != surfStructure)
+    {
+        throw AlgorithmException("ribbon weights file was made for structure " + StructureEnum::toName(weightsStructure) +
+                                 ", but the surface is " + StructureEnum::toName(surfStructure));
+    }
+    int64_t numColumns;
+    if (mySubVol == -1)
+    {
+        numColumns = myVolDims[3] * myVolDims[4];
+    } else {
+        numColumns = myVolDims[4];
+    }
+    myMetricOut->setNumberOfNodesAndColumns(numNodes, numColumns);
+    myMetricOut->setStructure(mySurface->getStructure());
+    applyWeightsMatrix(myVolume, &ribbonWeights, myMetricOut, mySubVol, " ribbon constrained");
+}
+
+void AlgorithmVolumeToSurfaceMapping::applyWeightsMatrix(const VolumeFile* myVolume, const ResamplingMatrix* myMatrix, MetricFile* myMetricOut, const int64_t& mySubVol,
+                                                         const AString& labelSuffix)
+{//all selected frames go through the matrix together, in batches, instead of looping over the weights of every vertex for each frame
+    vector<int64_t> myVolDims;
+    myVolume->getDimensions(myVolDims);
+    vector<int64_t> frameMaps, frameComponents;
     if (mySubVol == -1)
     {
         for (int64_t i = 0; i < myVolDims[3]; ++i)
         {
             for (int64_t j = 0; j < myVolDims[4]; ++j)
             {
-                int64_t thisCol = i * myVolDims[4] + j;
-                AString metricLabel = myVolume->getMapName(i);
-                if (myVolDims[4] != 1)
-                {
-                    metricLabel += " component " + AString::number(j);
-                }
-                metricLabel += " ribbon constrained";
-                myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR schedule(dynamic)
-                for (int64_t node = 0; node < numNodes; ++node)
-                {
-                    myScratch[node] = 0.0f;
-                    float totalWeight = 0.0f;
-                    int numVoxels = (int)myWeights[node].size();
-                    for (int voxel = 0; voxel < numVoxels; ++voxel)
-                    {
-                        float thisWeight = myWeights[node][voxel].weight;
-                        totalWeight += thisWeight;
-                        myScratch[node] += thisWeight * myVolume->getValue(myWeights[node][voxel].ijk, i, j);
-                    }
-                    if (totalWeight != 0.0f)
-                    {
-                        myScratch[node] /= totalWeight;
-                    } else {
-                        myScratch[node] = 0.0f;
-                    }
-                }
-                myMetricOut->setValuesForColumn(thisCol, myScratch);
+                frameMaps.push_back(i);
+                frameComponents.push_back(j);
             }
         }
     } else {
         for (int64_t j = 0; j < myVolDims[4]; ++j)
         {
-            AString metricLabel = myVolume->getMapName(mySubVol);
-            if (myVolDims[4] != 1)
+            frameMaps.push_back(mySubVol);
+            frameComponents.push_back(j);
+        }
+    }
+    int64_t numColumns = (int64_t)frameMaps.size(), numNodes = myMetricOut->getNumberOfNodes();
+    for (int64_t col = 0; col < numColumns; ++col)
+    {
+        AString metricLabel = myVolume->getMapName(frameMaps[col]);
+        if (myVolDims[4] != 1)
+        {
+            metricLabel += " component " + AString::number(frameComponents[col]);
+        }
+        metricLabel += labelSuffix;
+        myMetricOut->setColumnName(col, metricLabel);
+    }
+    vector<float> myColumn(numNodes, 0.0f);
+    if (myMatrix == NULL)
+    {//no weights at all
+        for (int64_t col = 0; col < numColumns; ++col)
+        {
+            myMetricOut->setValuesForColumn(col, myColumn.data());
+        }
+        return;
+    }
+    int64_t numInputs = myMatrix->getNumberOfInputs(), numOutputs = myMatrix->getNumberOfOutputs();
+    vector<int64_t> inputToVoxel(numInputs, 0), outputToNode(numOutputs, -1);
+    vector<CiftiBrainModelsMap::VolumeMap> inputMap = myMatrix->getInputSpace().getFullVolumeMap();
+    for (int64_t i = 0; i < (int64_t)inputMap.size(); ++i)
+    {
+        inputToVoxel[inputMap[i].m_ciftiIndex] = myVolume->getIndex(inputMap[i].m_ijk);
+    }
+    const CiftiBrainModelsMap& outSpace = myMatrix->getOutputSpace();
+    vector<CiftiBrainModelsMap::SurfaceMap> outputMap = outSpace.getSurfaceMap(outSpace.getSurfaceStructureList()[0]);
+    for (int64_t i = 0; i < (int64_t)outputMap.size(); ++i)
+    {
+        outputToNode[outputMap[i].m_ciftiIndex] = outputMap[i].m_surfaceNode;
+    }
+    const int64_t maxBatchElements = 1 << 24;//limit the scratch memory to 64MB per buffer
+    int64_t batchSize = max((int64_t)1, min(numColumns, maxBatchElements / max(max(numInputs, numOutputs), (int64_t)1)));
+    vector<float> inScratch(numInputs * batchSize), outScratch(numOutputs * batchSize);
+    vector<const float*> batchFrames(batchSize);
+    for (int64_t batchStart = 0; batchStart < numColumns; batchStart += batchSize)
+    {
+        int64_t thisBatch = min(batchSize, numColumns - batchStart);
+        for (int64_t f = 0; f < thisBatch; ++f)
+        {
+            batchFrames[f] = myVolume->getFrame(frameMaps[batchStart + f], frameComponents[batchStart + f]);
+        }
+#pragma omp CARET_PARFOR schedule(static)
+        for (int64_t i = 0; i < numInputs; ++i)
+        {
+            float* inRow = inScratch.data() + i * thisBatch;
+            int64_t voxel = inputToVoxel[i];
+            for (int64_t f = 0; f < thisBatch; ++f)
             {
-                metricLabel += " component " + AString::number(j);
+                inRow[f] = batchFrames[f][voxel];
             }
-            metricLabel += " ribbon constrained";
-            int64_t thisCol = j;
-            myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR schedule(dynamic)
-            for (int64_t node = 0; node < numNodes; ++node)
+        }
+        myMatrix->multiply(inScratch.data(), thisBatch, outScratch.data(), 0.0f);
+        for (int64_t f = 0; f < thisBatch; ++f)
+        {
+            for (int64_t i = 0; i < numOutputs; ++i)
             {
-                    myScratch[node] = 0.0f;
-                    float totalWeight = 0.0f;
-                    int numVoxels = (int)myWeights[node].size();
-                    for (int voxel = 0; voxel < numVoxels; ++voxel)
-                    {
-                        float thisWeight = myWeights[node][voxel].weight;
-                        totalWeight += thisWeight;
-                        myScratch[node] += thisWeight * myVolume->getValue(myWeights[node][voxel].ijk, mySubVol, j);
-                    }
-                    if (totalWeight != 0.0f)
-                    {
-                        myScratch[node] /= totalWeight;
-                    } else {
-                        myScratch[node] = 0.0f;
-                    }
+                if (outputToNode[i] >= 0) myColumn[outputToNode[i]] = outScratch[i * thisBatch + f];
             }
-            myMetricOut->setValuesForColumn(thisCol, myScratch);
+            myMetricOut->setValuesForColumn(batchStart + f, myColumn.data());
         }
     }
 }
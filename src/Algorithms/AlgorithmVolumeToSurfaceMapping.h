@@ -23,6 +23,7 @@
 
 #include "AbstractAlgorithm.h"
 
+#include "ResamplingMatrix.h"
 #include "RibbonMappingHelper.h"
 #include "Vector3D.h"
 #include "VolumeFile.h"
@@ -38,13 +39,15 @@ namespace caret {
                                             const MetricFile* thickness, const float& sigma, const bool& oldCutoffBug);
         static void precomputeWeightsRibbon(std::vector<std::vector<VoxelWeight> >& myWeights, const VolumeSpace& volSpace, const SurfaceFile* innerSurf, const SurfaceFile* outerSurf,
                                             const float* roiFrame, const int& subdivisions, const bool& thinColumns, const SurfaceFile* gaussSurf, const float& gaussScale);
+        static void applyWeightsMatrix(const VolumeFile* myVolume, const ResamplingMatrix* myMatrix, MetricFile* myMetricOut, const int64_t& mySubVol, const AString& labelSuffix);
         enum Method
         {
             TRILINEAR,
             ENCLOSING_VOXEL,
             RIBBON_CONSTRAINED,
             CUBIC,
-            MYELIN_STYLE
+            MYELIN_STYLE,
+            RIBBON_WEIGHTS
         };
     protected:
         static float getSubAlgorithmWeight();
@@ -56,7 +59,9 @@ namespace caret {
                                         const SurfaceFile* innerSurf, const SurfaceFile* outerSurf,
                                         const VolumeFile* roiVol = NULL, const int32_t& subdivisions = 3, const bool& thinColumns = false,
                                         const int64_t& mySubVol = -1, const float& gaussScale = -1.0f,
-                                        const int& weightsOutVertex = -1, VolumeFile* weightsOut = NULL);
+                                        const int& weightsOutVertex = -1, VolumeFile* weightsOut = NULL, ResamplingMatrix* weightsMatrixOut = NULL);
+        AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
+                                        const ResamplingMatrix& ribbonWeights, const int64_t& mySubVol = -1);
         AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
                                         const VolumeFile* roiVol, const MetricFile* thickness, const float& sigma, const int64_t& mySubVol = -1, const bool& oldCutoffBug = false);
         static OperationParameters* getParameters();
@@ -24,12 +24,15 @@
 #include "CaretAssert.h"
 #include "CaretHttpManager.h"
 #include "CaretLogger.h"
+#include "CaretMutex.h"
 #include "DataFileException.h"
 #include "FileInformation.h"
 #include "MultiDimArray.h"
 #include "MultiDimIterator.h"
 #include "NiftiIO.h"
 
+#include <algorithm>
+
 using namespace std;
 using namespace caret;
 
@@ -40,18 +43,42 @@ namespace
     {
         mutable NiftiIO m_nifti;//because file objects aren't stateless (current position), so reading "changes" them
         CiftiXML m_xml;//because we need to parse it to set up the dimensions anyway
+        //tiled layout: the matrix is padded to whole tiles, tiles are stored in row-major order, and each tile is stored row-major
+        //the nifti dimensions get overridden to [tile, tile, numTileCols, numTileRows], so 2 full dims reads a tile, and 3 reads a band of tile rows
+        int64_t m_tileSize;//0 for standard layout
+        int64_t m_numTileRows, m_numTileCols;
+        enum CacheType
+        {
+            NO_CACHE,
+            ROW_BAND,//all tiles in one tile row, in file order
+            COLUMN_BAND//all tiles in one tile column, in increasing tile row order
+        };
+        mutable CaretMutex m_cacheMutex;//getRow may be called from multiple threads
+        mutable CacheType m_cacheType;
+        mutable int64_t m_cacheIndex;
+        mutable bool m_cacheDirty;
+        mutable std::vector<float> m_cache;
+        mutable std::vector<char> m_tileWritten;//only used when writing a new file, so we don't try to read tiles that aren't in the file yet
+        bool isTileWritten(const int64_t& tileCol, const int64_t& tileRow) const;
+        void loadCache(const CacheType& type, const int64_t& index) const;//call with m_cacheMutex locked
+        void flushCache() const;//ditto
+        void setTiledLayout(const int64_t& tileSize);
     public:
         CiftiOnDiskImpl(const QString& filename);//read-only
         CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, const CiftiVersion& version, const bool& swapEndian,
-                        const int16_t& datatype, const bool& rescale, const double& minval, const double& maxval);//make new empty file with read/write
+                        const int16_t& datatype, const bool& rescale, const double& minval, const double& maxval, const int64_t& tileSize);//make new empty file with read/write
         void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const;
         void getColumn(float* dataOut, const int64_t& index) const;
+        void getColumns(float* dataOut, const std::vector<int64_t>& indices, const int64_t& colLength) const;
+        const float* getRowPointer(const std::vector<int64_t>& indexSelect) const;
+        int64_t getTileSize() const { return m_tileSize; }
         const CiftiXML& getCiftiXML() const { return m_xml; }
         QString getFilename() const { return m_nifti.getFilename(); }
         bool isSwapped() const { return m_nifti.getHeader().isSwapped(); }
         void setRow(const float* dataIn, const std::vector<int64_t>& indexSelect);
         void setColumn(const float* dataIn, const int64_t& index);
         void close();
+        ~CiftiOnDiskImpl();
     };
     
     class CiftiMemoryImpl : public CiftiFile::WriteImplInterface
@@ -61,6 +88,7 @@ namespace
         CiftiMemoryImpl(const CiftiXML& xml);
         void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const;
         void getColumn(float* dataOut, const int64_t& index) const;
+        const float* getRowPointer(const std::vector<int64_t>& indexSelect) const;
         bool isInMemory() const { return true; }
         void setRow(const float* dataIn, const std::vector<int64_t>& indexSelect);
         void setColumn(const float* dataIn, const int64_t& index);
@@ -103,6 +131,14 @@ CiftiFile::ReadImplInterface::~ReadImplInterface()
 {
 }
 
+void CiftiFile::ReadImplInterface::getColumns(float* dataOut, const vector<int64_t>& indices, const int64_t& colLength) const
+{
+    for (int64_t i = 0; i < (int64_t)indices.size(); ++i)
+    {
+        getColumn(dataOut + i * colLength, indices[i]);
+    }
+}
+
 CiftiFile::WriteImplInterface::~WriteImplInterface()
 {
 }
@@ -110,6 +146,7 @@ CiftiFile::WriteImplInterface::~WriteImplInterface()
 CiftiFile::CiftiFile(const QString& fileName)
 {
     m_endianPref = NATIVE;
+    m_writingTileSize = 0;
     setWritingDataTypeNoScaling();//default argument is float32
     openFile(fileName);
 }
@@ -172,6 +209,25 @@ void CiftiFile::setWritingDataTypeAndScaling(const int16_t& type, const double&
     m_writingImpl.grabNew(NULL);//prevent writing to previous writing implementation, let the next set...() set up for writing
 }
 
+void CiftiFile::setWritingTiled(const int64_t& tileSize)
+{
+    if (tileSize < 1) throw DataFileException("tile size must be positive");
+    m_writingTileSize = tileSize;
+    m_writingImpl.grabNew(NULL);//prevent writing to previous writing implementation, let the next set...() set up for writing
+}
+
+void CiftiFile::setWritingUntiled()
+{
+    m_writingTileSize = 0;
+    m_writingImpl.grabNew(NULL);//prevent writing to previous writing implementation, let the next set...() set up for writing
+}
+
+int64_t CiftiFile::getTileSize() const
+{
+    if (m_readingImpl == NULL) return 0;
+    return m_readingImpl->getTileSize();
+}
+
 void CiftiFile::writeFile(const QString& fileName, const CiftiVersion& writingVersion, const ENDIAN& endian)
 {
     if (m_readingImpl == NULL || m_dims.empty()) throw DataFileException("writeFile called on uninitialized CiftiFile");
@@ -182,7 +238,8 @@ void CiftiFile::writeFile(const QString& fileName, const CiftiVersion& writingVe
     bool collision = false, hadWriter = (m_writingImpl != NULL);
     if (testImpl != NULL && canonicalFilename != "" && FileInformation(testImpl->getFilename()).getCanonicalFilePath() == canonicalFilename)
     {//empty string test is so that we don't say collision if both are nonexistant - could happen if file is removed/unlinked while reading on some filesystems
-        if (m_onDiskVersion == writingVersion && !m_xml.mutablesModified() && (dontRewrite(endian) || writeSwapped == testImpl->isSwapped())) return;//don't need to copy to itself
+        if (m_onDiskVersion == writingVersion && !m_xml.mutablesModified() && (dontRewrite(endian) || writeSwapped == testImpl->isSwapped()) &&
+            testImpl->getTileSize() == m_writingTileSize) return;//don't need to copy to itself
         collision = true;//we need to copy to memory temporarily
         CaretPointer<WriteImplInterface> tempMemory(new CiftiMemoryImpl(m_xml));
         copyImplData(m_readingImpl, tempMemory, m_dims);
@@ -190,7 +247,7 @@ void CiftiFile::writeFile(const QString& fileName, const CiftiVersion& writingVe
         m_writingImpl.grabNew(NULL);//and make it re-magic the writing implementation again if data is set
     }
     CaretPointer<WriteImplInterface> tempWrite(new CiftiOnDiskImpl(myInfo.getAbsoluteFilePath(), m_xml, writingVersion, writeSwapped,
-                                                                   m_writingDataType, m_doWriteScaling, m_minScalingVal, m_maxScalingVal));
+                                                                   m_writingDataType, m_doWriteScaling, m_minScalingVal, m_maxScalingVal, m_writingTileSize));
     copyImplData(m_readingImpl, tempWrite, m_dims);
     if (collision)//if we rewrote the file, we need the handle to the new file, and to dump the temporary in-memory version
     {
@@ -219,6 +276,7 @@ void CiftiFile::close()
     m_onDiskVersion = CiftiVersion();//for completeness, it gets reset on open anyway
     m_endianPref = NATIVE;//reset things to defaults
     setWritingDataTypeNoScaling();//default argument is float32
+    m_writingTileSize = 0;
 }
 
 void CiftiFile::convertToInMemory()
@@ -257,6 +315,32 @@ void CiftiFile::getColumn(float* dataOut, const int64_t& index) const
     m_readingImpl->getColumn(dataOut, index);
 }
 
+void CiftiFile::getColumns(float* dataOut, const vector<int64_t>& indices) const
+{
+    if (m_dims.empty()) throw DataFileException("getColumns called on uninitialized CiftiFile");
+    if (m_dims.size() != 2) throw DataFileException("getColumns called on non-2D CiftiFile");
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        if (indices[i] < 0 || indices[i] >= m_dims[0]) throw DataFileException("getColumns called with invalid column index");
+    }
+    if (m_readingImpl == NULL) return;//NOT an error because we are pretending to have a matrix already, while we are waiting for setRow to actually start writing the file
+    m_readingImpl->getColumns(dataOut, indices, m_dims[1]);
+}
+
+const float* CiftiFile::getRowPointer(const vector<int64_t>& indexSelect) const
+{
+    if (m_dims.empty()) throw DataFileException("getRowPointer called on uninitialized CiftiFile");
+    if (m_readingImpl == NULL) return NULL;
+    return m_readingImpl->getRowPointer(indexSelect);
+}
+
+const float* CiftiFile::getRowPointer(const int64_t& index) const
+{
+    if (m_dims.empty()) throw DataFileException("getRowPointer called on uninitialized CiftiFile");
+    if (m_dims.size() != 2) throw DataFileException("getRowPointer with single index called on non-2D CiftiFile");
+    return getRowPointer(vector<int64_t>(1, index));
+}
+
 void CiftiFile::setCiftiXML(const CiftiXML& xml, const bool useOldMetadata)
 {
     if (xml.getNumberOfDimensions() == 0) throw DataFileException("setCiftiXML called with 0-dimensional CiftiXML");
@@ -386,7 +470,7 @@ void CiftiFile::verifyWriteImpl()
             }
         }
         m_writingImpl.grabNew(new CiftiOnDiskImpl(m_writingFile, m_xml, m_onDiskVersion, shouldSwap(m_endianPref),
-                                                  m_writingDataType, m_doWriteScaling, m_minScalingVal, m_maxScalingVal));//this constructor makes new file for writing
+                                                  m_writingDataType, m_doWriteScaling, m_minScalingVal, m_maxScalingVal, m_writingTileSize));//this constructor makes new file for writing
         if (m_readingImpl != NULL)
         {
             copyImplData(m_readingImpl, m_writingImpl, m_dims);
@@ -435,6 +519,11 @@ void CiftiMemoryImpl::getColumn(float* dataOut, const int64_t& index) const
     }
 }
 
+const float* CiftiMemoryImpl::getRowPointer(const vector<int64_t>& indexSelect) const
+{
+    return m_array.get(1, indexSelect);
+}
+
 void CiftiMemoryImpl::setRow(const float* dataIn, const vector<int64_t>& indexSelect)
 {
     float* ref = m_array.get(1, indexSelect);
@@ -458,22 +547,69 @@ void CiftiMemoryImpl::setColumn(const float* dataIn, const int64_t& index)
     }
 }
 
+namespace
+{
+    const char TILED_MAGIC[] = "WBTILED";//tiled extension starts with a line of "WBTILED <tile size>", followed by the cifti XML
+    
+    //the nifti dimensions of a tiled file: the elements of a tile, then the tiles
+    vector<int64_t> getTiledDims(const CiftiXML& xml, const int64_t& tileSize)
+    {
+        vector<int64_t> ret(2, tileSize);
+        ret.push_back((xml.getDimensionLength(CiftiXML::ALONG_ROW) + tileSize - 1) / tileSize);
+        ret.push_back((xml.getDimensionLength(CiftiXML::ALONG_COLUMN) + tileSize - 1) / tileSize);
+        return ret;
+    }
+}
+
 CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename)
 {//opens existing file for reading
+    m_tileSize = 0;
+    m_cacheType = NO_CACHE;
+    m_cacheDirty = false;
     m_nifti.openRead(filename);//read-only, so we don't need write permission to read a cifti file
     if (m_nifti.getNumComponents() != 1) throw DataFileException("complex or rgb datatype found in file '" + filename + "', these are not supported in cifti");
     const NiftiHeader& myHeader = m_nifti.getHeader();
     int numExts = (int)myHeader.m_extensions.size(), whichExt = -1;
+    bool tiled = false;
     for (int i = 0; i < numExts; ++i)
     {
-        if (myHeader.m_extensions[i]->m_ecode == NIFTI_ECODE_CIFTI)
+        if (myHeader.m_extensions[i]->m_ecode == NIFTI_ECODE_CIFTI || myHeader.m_extensions[i]->m_ecode == NIFTI_ECODE_WB_TILED_CIFTI)
         {
             whichExt = i;
+            tiled = (myHeader.m_extensions[i]->m_ecode == NIFTI_ECODE_WB_TILED_CIFTI);
             break;
         }
     }
     if (whichExt == -1) throw DataFileException("no cifti extension found in file '" + filename + "'");
-    m_xml.readXML(QByteArray(myHeader.m_extensions[whichExt]->m_bytes.data(), myHeader.m_extensions[whichExt]->m_bytes.size()));//CiftiXML should be under 2GB
+    QByteArray extBytes(myHeader.m_extensions[whichExt]->m_bytes.data(), myHeader.m_extensions[whichExt]->m_bytes.size());//CiftiXML should be under 2GB
+    int64_t tileSize = 0;
+    if (tiled)
+    {
+        QByteArray prefix = QByteArray(TILED_MAGIC) + " ";
+        int lineEnd = extBytes.indexOf('\n');
+        bool ok = false;
+        if (lineEnd > prefix.size() && extBytes.startsWith(prefix))
+        {
+            tileSize = extBytes.mid(prefix.size(), lineEnd - prefix.size()).toLongLong(&ok);
+        }
+        if (!ok || tileSize < 1) throw DataFileException("invalid tiled cifti extension in file '" + filename + "'");
+        extBytes = extBytes.mid(lineEnd + 1);
+    }
+    m_xml.readXML(extBytes);
+    if (tiled)
+    {//the header has the tile dimensions instead of the matrix dimensions
+        if (m_xml.getNumberOfDimensions() != 2 || m_xml.getParsedVersion().hasReversedFirstDims())
+        {
+            throw DataFileException("tiled layout found in unsupported cifti file '" + filename + "', only 2D cifti-2 files can be tiled");
+        }
+        if (myHeader.getIntentCode() != NIFTI_INTENT_WB_TILED_CIFTI || m_nifti.getDimensions() != getTiledDims(m_xml, tileSize))
+        {
+            throw DataFileException("tiled cifti file '" + filename + "' has a header that doesn't match its tiled extension");
+        }
+        setTiledLayout(tileSize);
+        m_tileWritten.clear();//existing file, assume it is complete, readData will complain if it is truncated
+        return;
+    }
     vector<int64_t> dimCheck = m_nifti.getDimensions();
     if (dimCheck.size() < 5)
     {
@@ -516,6 +652,17 @@ CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename)
     }
 }
 
+void CiftiOnDiskImpl::setTiledLayout(const int64_t& tileSize)
+{
+    CaretAssert(tileSize > 0 && m_xml.getNumberOfDimensions() == 2);
+    m_tileSize = tileSize;
+    vector<int64_t> tiledDims = getTiledDims(m_xml, tileSize);
+    m_numTileCols = tiledDims[2];
+    m_numTileRows = tiledDims[3];
+    m_nifti.overrideDimensions(tiledDims);
+    m_tileWritten.assign(m_numTileCols * m_numTileRows, 0);
+}
+
 namespace
 {
     void warnForBadExtension(const QString& filename, const CiftiXML& myXML)
@@ -611,9 +758,24 @@ namespace
 }
 
 CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, const CiftiVersion& version, const bool& swapEndian,
-                                 const int16_t& datatype, const bool& rescale, const double& minval, const double& maxval)
+                                 const int16_t& datatype, const bool& rescale, const double& minval, const double& maxval, const int64_t& tileSize)
 {//starts writing new file
+    m_tileSize = 0;
+    m_cacheType = NO_CACHE;
+    m_cacheDirty = false;
     warnForBadExtension(filename, xml);
+    bool tiled = false;
+    if (tileSize > 0)
+    {
+        if (xml.getNumberOfDimensions() != 2 || version.hasReversedFirstDims())
+        {
+            CaretLogWarning("tiled layout is only supported for 2D cifti-2 files, writing file '" + filename + "' with the standard layout");
+        } else if (filename.endsWith(".gz")) {
+            throw DataFileException("tiled cifti layout can't be used with compressed file '" + filename + "'");
+        } else {
+            tiled = true;
+        }
+    }
     NiftiHeader outHeader;
     if (rescale)
     {
@@ -627,10 +789,17 @@ CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, c
     }
     char intentName[16];
     int32_t intentCode = xml.getIntentInfo(version, intentName);
+    if (tiled) intentCode = NIFTI_INTENT_WB_TILED_CIFTI;//keep the intent name, the XML says what kind of cifti file it is
     outHeader.setIntent(intentCode, intentName);
     QByteArray xmlBytes = xml.writeXMLToQByteArray(version);
     CaretPointer<NiftiExtension> outExtension(new NiftiExtension());
-    outExtension->m_ecode = NIFTI_ECODE_CIFTI;
+    if (tiled)
+    {
+        xmlBytes.prepend(QByteArray(TILED_MAGIC) + " " + QByteArray::number((qlonglong)tileSize) + "\n");
+        outExtension->m_ecode = NIFTI_ECODE_WB_TILED_CIFTI;
+    } else {
+        outExtension->m_ecode = NIFTI_ECODE_CIFTI;
+    }
     int numBytes = xmlBytes.size();
     outExtension->m_bytes.resize(numBytes);
     for (int i = 0; i < numBytes; ++i)
@@ -651,21 +820,151 @@ CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, c
         outHeader.setDimensions(headerDims);//give the header the reversed dimensions
         m_nifti.writeNew(filename, outHeader, 2, true, swapEndian);
         m_nifti.overrideDimensions(niftiDims);//and then tell the nifti reader to use the correct dimensions
+    } else if (tiled) {
+        outHeader.setDimensions(getTiledDims(xml, tileSize));//so other readers can't treat the tiles as rows
+        m_nifti.writeNew(filename, outHeader, 2, true, swapEndian);
     } else {
         outHeader.setDimensions(niftiDims);
         m_nifti.writeNew(filename, outHeader, 2, true, swapEndian);
     }
     m_xml = xml;
+    if (tiled)
+    {
+        setTiledLayout(tileSize);
+    }
 }
 
 void CiftiOnDiskImpl::close()
 {
+    {
+        CaretMutexLocker locked(&m_cacheMutex);
+        flushCache();
+        m_cacheType = NO_CACHE;
+    }
     m_nifti.close();//lets this throw when there is a writing problem
 }//don't bother resetting m_xml, this instance is about to be destroyed
 
+CiftiOnDiskImpl::~CiftiOnDiskImpl()
+{
+    if (m_cacheDirty)
+    {//CiftiFile::close() wasn't called, destructors can't throw
+        try
+        {
+            flushCache();
+        } catch (CaretException& e) {
+            CaretLogSevere("failed to write tiled data to cifti file '" + getFilename() + "': " + e.whatString());
+        }
+    }
+}
+
+bool CiftiOnDiskImpl::isTileWritten(const int64_t& tileCol, const int64_t& tileRow) const
+{
+    if (m_tileWritten.empty()) return true;//existing file
+    CaretAssertVectorIndex(m_tileWritten, tileCol + tileRow * m_numTileCols);
+    return (m_tileWritten[tileCol + tileRow * m_numTileCols] != 0);
+}
+
+void CiftiOnDiskImpl::loadCache(const CacheType& type, const int64_t& index) const
+{
+    if (m_cacheType == type && m_cacheIndex == index) return;
+    flushCache();
+    m_cacheType = NO_CACHE;//in case reading throws
+    const int64_t tileElems = m_tileSize * m_tileSize;
+    vector<int64_t> indexSelect;
+    if (type == ROW_BAND)
+    {
+        m_cache.resize(tileElems * m_numTileCols);
+        bool allWritten = true;
+        for (int64_t tileCol = 0; tileCol < m_numTileCols; ++tileCol)
+        {
+            if (!isTileWritten(tileCol, index))
+            {
+                allWritten = false;
+                break;
+            }
+        }
+        if (allWritten)
+        {
+            indexSelect.push_back(index);
+            m_nifti.readData(m_cache.data(), 3, indexSelect);//whole band is contiguous
+        } else {
+            indexSelect.resize(2);
+            indexSelect[1] = index;
+            for (int64_t tileCol = 0; tileCol < m_numTileCols; ++tileCol)
+            {
+                if (isTileWritten(tileCol, index))
+                {
+                    indexSelect[0] = tileCol;
+                    m_nifti.readData(m_cache.data() + tileCol * tileElems, 2, indexSelect);
+                } else {
+                    std::fill(m_cache.begin() + tileCol * tileElems, m_cache.begin() + (tileCol + 1) * tileElems, 0.0f);
+                }
+            }
+        }
+    } else {
+        CaretAssert(type == COLUMN_BAND);
+        m_cache.resize(tileElems * m_numTileRows);
+        indexSelect.resize(2);
+        indexSelect[0] = index;
+        for (int64_t tileRow = 0; tileRow < m_numTileRows; ++tileRow)
+        {
+            if (isTileWritten(index, tileRow))
+            {
+                indexSelect[1] = tileRow;
+                m_nifti.readData(m_cache.data() + tileRow * tileElems, 2, indexSelect);
+            } else {
+                std::fill(m_cache.begin() + tileRow * tileElems, m_cache.begin() + (tileRow + 1) * tileElems, 0.0f);
+            }
+        }
+    }
+    m_cacheType = type;
+    m_cacheIndex = index;
+    m_cacheDirty = false;
+}
+
+void CiftiOnDiskImpl::flushCache() const
+{
+    if (!m_cacheDirty) return;
+    CaretAssert(m_cacheType != NO_CACHE);
+    const int64_t tileElems = m_tileSize * m_tileSize;
+    vector<int64_t> indexSelect;
+    if (m_cacheType == ROW_BAND)
+    {
+        indexSelect.push_back(m_cacheIndex);
+        m_nifti.writeData(m_cache.data(), 3, indexSelect);
+        for (int64_t tileCol = 0; tileCol < m_numTileCols && !m_tileWritten.empty(); ++tileCol)
+        {
+            m_tileWritten[tileCol + m_cacheIndex * m_numTileCols] = 1;
+        }
+    } else {
+        indexSelect.resize(2);
+        indexSelect[0] = m_cacheIndex;
+        for (int64_t tileRow = 0; tileRow < m_numTileRows; ++tileRow)
+        {
+            indexSelect[1] = tileRow;
+            m_nifti.writeData(m_cache.data() + tileRow * tileElems, 2, indexSelect);
+            if (!m_tileWritten.empty()) m_tileWritten[m_cacheIndex + tileRow * m_numTileCols] = 1;
+        }
+    }
+    m_cacheDirty = false;
+}
+
 
 void CiftiOnDiskImpl::getRow(float* dataOut, const vector<int64_t>& indexSelect, const bool& tolerateShortRead) const
 {
+    if (m_tileSize > 0)
+    {//rows in the same tile row are served from one band read
+        CaretAssert(indexSelect.size() == 1);
+        const int64_t rowSize = m_xml.getDimensionLength(CiftiXML::ALONG_ROW), row = indexSelect[0];
+        CaretMutexLocker locked(&m_cacheMutex);
+        loadCache(ROW_BAND, row / m_tileSize);
+        const float* rowStart = m_cache.data() + (row % m_tileSize) * m_tileSize;
+        for (int64_t i = 0; i < rowSize; ++i)
+        {
+            dataOut[i] = rowStart[(i / m_tileSize) * m_tileSize * m_tileSize + i % m_tileSize];
+        }
+        return;
+    }
     m_nifti.readData(dataOut, 5, indexSelect, tolerateShortRead);//5 means 4 reserved (space and time) plus the first cifti dimension
 }
 
@@ -673,6 +972,18 @@ void CiftiOnDiskImpl::getColumn(float* dataOut, const int64_t& index) const
 {
     CaretAssert(m_xml.getNumberOfDimensions() == 2);//otherwise this shouldn't be called
     CaretAssert(index >= 0 && index < m_xml.getDimensionLength(CiftiXML::ALONG_ROW));
+    if (m_tileSize > 0)
+    {//columns in the same tile column are served from one read per tile
+        const int64_t colLength = m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN);
+        CaretMutexLocker locked(&m_cacheMutex);
+        loadCache(COLUMN_BAND, index / m_tileSize);
+        const float* colStart = m_cache.data() + index % m_tileSize;
+        for (int64_t i = 0; i < colLength; ++i)
+        {//tiles in a column band are consecutive, so this is a constant stride
+            dataOut[i] = colStart[i * m_tileSize];
+        }
+        return;
+    }
     CaretLogFine("getColumn called on CiftiOnDiskImpl, this will be slow");//generate logging messages at a low priority
     vector<int64_t> indexSelect(2);
     indexSelect[0] = index;
@@ -684,8 +995,79 @@ void CiftiOnDiskImpl::getColumn(float* dataOut, const int64_t& index) const
     }
 }
 
+namespace
+{
+    const int64_t PAGE_BYTES = 4096;//roughly what the disk has to read to get a single element
+}
+
+void CiftiOnDiskImpl::getColumns(float* dataOut, const vector<int64_t>& indices, const int64_t& colLength) const
+{
+    CaretAssert(m_xml.getNumberOfDimensions() == 2);//otherwise this shouldn't be called
+    CaretAssert(colLength == m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN));
+    const int64_t rowSize = m_xml.getDimensionLength(CiftiXML::ALONG_ROW), numIndices = (int64_t)indices.size();
+    if (m_tileSize > 0)
+    {//go in column order, so each band of tiles only gets read once
+        vector<pair<int64_t, int64_t> > sorted(numIndices);
+        for (int64_t i = 0; i < numIndices; ++i)
+        {
+            sorted[i] = make_pair(indices[i], i);
+        }
+        sort(sorted.begin(), sorted.end());
+        for (int64_t i = 0; i < numIndices; ++i)
+        {
+            getColumn(dataOut + sorted[i].second * colLength, sorted[i].first);
+        }
+        return;
+    }
+    if (numIndices * PAGE_BYTES < rowSize * (int64_t)sizeof(float))
+    {//few enough columns that reading single elements touches less of the file than reading every row
+        for (int64_t i = 0; i < numIndices; ++i)
+        {
+            getColumn(dataOut + i * colLength, indices[i]);
+        }
+        return;
+    }
+    vector<float> scratchRow;
+    vector<int64_t> indexSelect(1);
+    for (int64_t row = 0; row < colLength; ++row)
+    {//one sequential pass over the file, scattering the selected elements
+        indexSelect[0] = row;
+        const float* rowData = getRowPointer(indexSelect);
+        if (rowData == NULL)
+        {
+            scratchRow.resize(rowSize);
+            m_nifti.readData(scratchRow.data(), 5, indexSelect);
+            rowData = scratchRow.data();
+        }
+        for (int64_t i = 0; i < numIndices; ++i)
+        {
+            dataOut[i * colLength + row] = rowData[indices[i]];
+        }
+    }
+}
+
+const float* CiftiOnDiskImpl::getRowPointer(const vector<int64_t>& indexSelect) const
+{
+    if (m_tileSize > 0) return NULL;
+    return m_nifti.getDirectDataPointer<float>(5, indexSelect);//NULL unless mapped, native endian, unscaled float32
+}
+
 void CiftiOnDiskImpl::setRow(const float* dataIn, const vector<int64_t>& indexSelect)
 {
+    if (m_tileSize > 0)
+    {
+        CaretAssert(indexSelect.size() == 1);
+        const int64_t rowSize = m_xml.getDimensionLength(CiftiXML::ALONG_ROW), row = indexSelect[0];
+        CaretMutexLocker locked(&m_cacheMutex);
+        loadCache(ROW_BAND, row / m_tileSize);
+        float* rowStart = m_cache.data() + (row % m_tileSize) * m_tileSize;
+        for (int64_t i = 0; i < rowSize; ++i)
+        {
+            rowStart[(i / m_tileSize) * m_tileSize * m_tileSize + i % m_tileSize] = dataIn[i];
+        }
+        m_cacheDirty = true;
+        return;
+    }
     m_nifti.writeData(dataIn, 5, indexSelect);
 }
 
@@ -693,6 +1075,19 @@ void CiftiOnDiskImpl::setColumn(const float* dataIn, const int64_t& index)
 {
     CaretAssert(m_xml.getNumberOfDimensions() == 2);//otherwise this shouldn't be called
     CaretAssert(index >= 0 && index < m_xml.getDimensionLength(CiftiXML::ALONG_ROW));
+    if (m_tileSize > 0)
+    {
+        const int64_t colLength = m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN);
+        CaretMutexLocker locked(&m_cacheMutex);
+        loadCache(COLUMN_BAND, index / m_tileSize);
+        float* colStart = m_cache.data() + index % m_tileSize;
+        for (int64_t i = 0; i < colLength; ++i)
+        {
+            colStart[i * m_tileSize] = dataIn[i];
+        }
+        m_cacheDirty = true;
+        return;
+    }
     CaretLogFine("setColumn called on CiftiOnDiskImpl, this will be slow");//generate logging messages at a low priority
     vector<int64_t> indexSelect(2);
     indexSelect[0] = index;
@@ -49,6 +49,7 @@ namespace caret
         CiftiFile()
         {
             m_endianPref = NATIVE;
+            m_writingTileSize = 0;
             setWritingDataTypeNoScaling();//default argument is float32
         }
         explicit CiftiFile(const QString &fileName);//calls openFile
@@ -63,22 +64,36 @@ namespace caret
         
         bool isInMemory() const;
         void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead = false) const;//tolerateShortRead is useful for on-disk writing when it is easiest to do RMW multiple times on a new file
+        //NOTE: getRow may be called from multiple threads at once, and on uncompressed files opened read-only, the reads will actually proceed in parallel
         const std::vector<int64_t>& getDimensions() const { return m_dims; }
         MultiDimIterator<int64_t> getIteratorOverRows() const
         {
             return MultiDimIterator<int64_t>(std::vector<int64_t>(m_dims.begin() + 1, m_dims.end()));
         }
-        void getColumn(float* dataOut, const int64_t& index) const;//for 2D only, will be slow if on disk!
+        void getColumn(float* dataOut, const int64_t& index) const;//for 2D only, will be slow if on disk, unless the file is tiled
+        //for 2D only, column indices[i] goes to dataOut[i * getNumberOfRows()], on disk this reads each row once, rather than each element separately
+        void getColumns(float* dataOut, const std::vector<int64_t>& indices) const;
+        //pointer to the row in memory or in the memory mapped file, NULL if the row can't be accessed without a copy (on-disk conversion, byteswapping, scaling)
+        //valid until the file is modified or closed
+        const float* getRowPointer(const std::vector<int64_t>& indexSelect) const;
+        const float* getRowPointer(const int64_t& index) const;
         
         void setCiftiXML(const CiftiXML& xml, const bool useOldMetadata = true);
         void setCiftiXML(const CiftiXMLOld &xml, const bool useOldMetadata = true);//set xml from old implementation
         void setRow(const float* dataIn, const std::vector<int64_t>& indexSelect);
-        void setColumn(const float* dataIn, const int64_t& index);//for 2D only, will be slow if on disk!
+        void setColumn(const float* dataIn, const int64_t& index);//for 2D only, will be slow if on disk, unless writing tiled
         
         ///data type and scaling options - should be set before setRow, etc, to avoid rewriting of file
         void setWritingDataTypeNoScaling(const int16_t& type = NIFTI_TYPE_FLOAT32);
         void setWritingDataTypeAndScaling(const int16_t& type, const double& minval, const double& maxval);
         
+        ///on-disk layout option - tiled files store the matrix in square tiles, so that reading or writing a row or a column touches a bounded number
+        ///of contiguous blocks, but ONLY workbench can read them, so this is not the default - only used for 2D files written as cifti-2 or later
+        void setWritingTiled(const int64_t& tileSize = 64);
+        void setWritingUntiled();
+        int64_t getWritingTileSize() const { return m_writingTileSize; }//0 means standard layout
+        int64_t getTileSize() const;//tile size of the current on-disk file, 0 if untiled or in memory
+        
         void getRow(float* dataOut, const int64_t& index, const bool& tolerateShortRead) const;//backwards compatibility for old CiftiFile/CiftiInterface
         void getRow(float* dataOut, const int64_t& index) const;
         int64_t getNumberOfRows() const;
@@ -91,7 +106,10 @@ namespace caret
         public:
             virtual void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const = 0;
             virtual void getColumn(float* dataOut, const int64_t& index) const = 0;
+            virtual void getColumns(float* dataOut, const std::vector<int64_t>& indices, const int64_t& colLength) const;//default calls getColumn repeatedly
+            virtual const float* getRowPointer(const std::vector<int64_t>&) const { return NULL; }
             virtual bool isInMemory() const { return false; }
+            virtual int64_t getTileSize() const { return 0; }
             virtual ~ReadImplInterface();
         };
         //assume if you can write to it, you can also read from it
@@ -113,6 +131,7 @@ namespace caret
         ENDIAN m_endianPref;
         bool m_doWriteScaling;
         int16_t m_writingDataType;
+        int64_t m_writingTileSize;
         double m_minScalingVal, m_maxScalingVal;
         
         void verifyWriteImpl();
@@ -0,0 +1,172 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CommandFileCache.h"
+
+#include "BorderFile.h"
+#include "CaretLogger.h"
+#include "FociFile.h"
+#include "LabelFile.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+#include "VolumeFile.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+
+#include <map>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    struct HolderBase
+    {//so that one map can hold all file types
+        virtual bool isModified() const = 0;
+        virtual ~HolderBase() { }
+    };
+
+    template<typename T>
+    struct Holder : public HolderBase
+    {
+        CaretPointer<T> m_file;
+        Holder(const CaretPointer<T>& file) : m_file(file) { }
+        bool isModified() const { return m_file->isModified(); }
+    };
+
+    struct CacheEntry
+    {
+        CaretPointer<HolderBase> m_holder;
+        int64_t m_modTime, m_fileSize, m_lastUsed;
+    };
+
+    bool g_cacheEnabled = false;
+    int64_t g_memLimit = 0, g_memUsed = 0, g_useCounter = 0;
+    map<AString, CacheEntry> g_cache;//key is canonical path
+
+    void evictOldest()
+    {
+        map<AString, CacheEntry>::iterator oldest = g_cache.begin();
+        for (map<AString, CacheEntry>::iterator iter = g_cache.begin(); iter != g_cache.end(); ++iter)
+        {
+            if (iter->second.m_lastUsed < oldest->second.m_lastUsed) oldest = iter;
+        }
+        CaretAssert(oldest != g_cache.end());
+        g_memUsed -= oldest->second.m_fileSize;
+        g_cache.erase(oldest);
+    }
+
+    template<typename T>
+    CaretPointer<T> readCached(const AString& filename)
+    {
+        CaretPointer<T> ret;
+        QFileInfo myInfo(filename);
+        if (!g_cacheEnabled || !myInfo.isFile())
+        {//includes remote files, and let readFile give the error for nonexistent files
+            ret.grabNew(new T());
+            ret->readFile(filename);
+            return ret;
+        }
+        const AString key = myInfo.canonicalFilePath();
+        const int64_t modTime = myInfo.lastModified().toMSecsSinceEpoch(), fileSize = myInfo.size();
+        map<AString, CacheEntry>::iterator iter = g_cache.find(key);
+        if (iter != g_cache.end())
+        {
+            Holder<T>* myHolder = dynamic_cast<Holder<T>*>(iter->second.m_holder.getPointer());//NULL if it was last read as a different type
+            if (myHolder != NULL && iter->second.m_modTime == modTime && iter->second.m_fileSize == fileSize && !myHolder->isModified())
+            {
+                CaretLogFine("reusing already loaded file '" + filename + "'");
+                iter->second.m_lastUsed = ++g_useCounter;
+                return myHolder->m_file;
+            }
+            g_memUsed -= iter->second.m_fileSize;
+            g_cache.erase(iter);
+        }
+        ret.grabNew(new T());
+        ret->readFile(filename);
+        if (fileSize <= g_memLimit)
+        {
+            CacheEntry& myEntry = g_cache[key];
+            myEntry.m_holder.grabNew(new Holder<T>(ret));
+            myEntry.m_modTime = modTime;
+            myEntry.m_fileSize = fileSize;
+            myEntry.m_lastUsed = ++g_useCounter;
+            g_memUsed += fileSize;
+            while (g_memUsed > g_memLimit && g_cache.size() > 1)//the new entry is the most recently used, so it won't get evicted
+            {
+                evictOldest();
+            }
+        }
+        return ret;
+    }
+}
+
+void CommandFileCache::enable(const int64_t& memLimitBytes)
+{
+    g_cacheEnabled = true;
+    g_memLimit = memLimitBytes;
+    while (g_memUsed > g_memLimit && !g_cache.empty())
+    {
+        evictOldest();
+    }
+}
+
+void CommandFileCache::disable()
+{
+    g_cacheEnabled = false;
+    g_cache.clear();
+    g_memUsed = 0;
+}
+
+bool CommandFileCache::isEnabled()
+{
+    return g_cacheEnabled;
+}
+
+CaretPointer<BorderFile> CommandFileCache::readBorder(const AString& filename)
+{
+    return readCached<BorderFile>(filename);
+}
+
+CaretPointer<FociFile> CommandFileCache::readFoci(const AString& filename)
+{
+    return readCached<FociFile>(filename);
+}
+
+CaretPointer<LabelFile> CommandFileCache::readLabel(const AString& filename)
+{
+    return readCached<LabelFile>(filename);
+}
+
+CaretPointer<MetricFile> CommandFileCache::readMetric(const AString& filename)
+{
+    return readCached<MetricFile>(filename);
+}
+
+CaretPointer<SurfaceFile> CommandFileCache::readSurface(const AString& filename)
+{
+    return readCached<SurfaceFile>(filename);
+}
+
+CaretPointer<VolumeFile> CommandFileCache::readVolume(const AString& filename)
+{
+    return readCached<VolumeFile>(filename);
+}
@@ -0,0 +1,66 @@
+#ifndef __COMMAND_FILE_CACHE_H__
+#define __COMMAND_FILE_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+//NOTE: this is for batch mode, where many commands run in one process, so that input files that were already read by a previous command
+//      can be reused instead of read again.  This also keeps the helpers that surfaces build on demand (topology, geodesic, signed
+//      distance, point locator).  An entry is only reused if the file on disk still has the same modification time and size, and the
+//      in-memory object hasn't been modified (some commands modify an input before writing it to a different file).
+//
+//      Cifti files aren't cached, because they are mostly read lazily from disk anyway, and CiftiFile doesn't track modification.
+//
+//      The memory limit is checked against the size of the files on disk, so compressed files use more memory than their share.
+
+#include "AString.h"
+#include "CaretPointer.h"
+
+#include "stdint.h"
+
+namespace caret
+{
+    class BorderFile;
+    class FociFile;
+    class LabelFile;
+    class MetricFile;
+    class SurfaceFile;
+    class VolumeFile;
+
+    class CommandFileCache
+    {
+    public:
+        ///start caching input files, up to approximately memLimitBytes of files
+        static void enable(const int64_t& memLimitBytes);
+        ///stop caching, and release all cached files
+        static void disable();
+        static bool isEnabled();
+
+        //these read the file normally when caching is disabled
+        static CaretPointer<BorderFile> readBorder(const AString& filename);
+        static CaretPointer<FociFile> readFoci(const AString& filename);
+        static CaretPointer<LabelFile> readLabel(const AString& filename);
+        static CaretPointer<MetricFile> readMetric(const AString& filename);
+        static CaretPointer<SurfaceFile> readSurface(const AString& filename);
+        static CaretPointer<VolumeFile> readVolume(const AString& filename);
+    };
+}
+
+#endif //__COMMAND_FILE_CACHE_H__
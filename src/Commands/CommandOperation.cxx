@@ -82,6 +82,10 @@ void CommandOperation::setCiftiOutputDTypeNoScale(const int16_t&)
 {
 }
 
+void CommandOperation::setCiftiOutputTiled(const int64_t&)
+{
+}
+
 AString CommandOperation::doCompletion(ProgramParameters&, const bool&)
 {
     return "";
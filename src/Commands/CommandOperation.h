@@ -45,6 +45,8 @@ namespace caret {
         
         virtual void setCiftiOutputDTypeNoScale(const int16_t& dtype);
         
+        virtual void setCiftiOutputTiled(const int64_t& tileSize);
+        
         virtual AString doCompletion(ProgramParameters& parameters, const bool& useExtGlob);
         
     protected:
@@ -58,6 +58,7 @@
 #include "AlgorithmCiftiROIsFromExtrema.h"
 #include "AlgorithmCiftiSeparate.h"
 #include "AlgorithmCiftiSmoothing.h"
+#include "AlgorithmCiftiTFCE.h"
 #include "AlgorithmCiftiTranspose.h"
 #include "AlgorithmCiftiVectorOperation.h"
 #include "AlgorithmCreateSignedDistanceVolume.h"
@@ -145,6 +146,7 @@
 #include "OperationBorderFileExportToCaret5.h"
 #include "OperationBorderLength.h"
 #include "OperationBorderMerge.h"
+#include "OperationCiftiApplyResampleMatrix.h"
 #include "OperationCiftiChangeMapping.h"
 #include "OperationCiftiChangeTimestep.h"
 #include "OperationCiftiConvert.h"
@@ -162,6 +164,7 @@
 #include "OperationCiftiPalette.h"
 #include "OperationCiftiResampleDconnMemory.h"
 #include "AlgorithmCiftiRestrictDenseMap.h"
+#include "OperationCiftiResampleMatrix.h"
 #include "OperationCiftiROIAverage.h"
 #include "OperationCiftiSeparateAll.h"
 #include "OperationCiftiStats.h"
@@ -182,6 +185,7 @@
 #include "OperationLabelMerge.h"
 #include "OperationMetadataRemoveProvenance.h"
 #include "OperationMetadataStringReplace.h"
+#include "OperationMetricApplyResampleMatrix.h"
 #include "OperationMetricConvert.h"
 #include "OperationMetricLabelImport.h"
 #include "OperationMetricMask.h"
@@ -210,6 +214,7 @@
 #include "OperationSurfaceGeodesicROIs.h"
 #include "OperationSurfaceInformation.h"
 #include "OperationSurfaceNormals.h"
+#include "OperationSurfaceResampleMatrix.h"
 #include "OperationSurfaceSetCoordinates.h"
 #include "OperationSurfaceVertexAreas.h"
 #include "OperationVolumeCapturePlane.h"
@@ -242,10 +247,20 @@
 #include "CommandUnitTest.h"
 #include "ProgramParameters.h"
 
+#include "Base64.h"
+#include "CaretBinaryFile.h"
+#include "CaretCommandLine.h"
 #include "CaretLogger.h"
+#include "CommandFileCache.h"
+#include "MetricSmoothingObject.h"
+#include "NiftiConvert.h"
 #include "dot_wrapper.h"
 #include "StructureEnum.h"
 
+#include <QFileInfo>
+
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <map>
 
@@ -320,6 +335,7 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmCiftiROIsFromExtrema()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmCiftiSeparate()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmCiftiSmoothing()));
+    this->commandOperations.push_back(new CommandParser(new AutoAlgorithmCiftiTFCE()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmCiftiTranspose()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmCiftiVectorOperation()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmCreateSignedDistanceVolume()));
@@ -407,6 +423,7 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandParser(new AutoOperationBorderFileExportToCaret5()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationBorderLength()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationBorderMerge()));
+    this->commandOperations.push_back(new CommandParser(new AutoOperationCiftiApplyResampleMatrix()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationCiftiChangeMapping()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationCiftiConvert()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationCiftiCreateDenseFromTemplate()));
@@ -420,6 +437,7 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandParser(new AutoOperationCiftiMerge()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationCiftiPalette()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationCiftiResampleDconnMemory()));
+    this->commandOperations.push_back(new CommandParser(new AutoOperationCiftiResampleMatrix()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationCiftiROIAverage()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationCiftiStats()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationCiftiWeightedStats()));
@@ -439,6 +457,7 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandParser(new AutoOperationLabelMerge()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationMetadataRemoveProvenance()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationMetadataStringReplace()));
+    this->commandOperations.push_back(new CommandParser(new AutoOperationMetricApplyResampleMatrix()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationMetricConvert()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationMetricLabelImport()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationMetricMask()));
@@ -467,6 +486,7 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceGeodesicROIs()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceInformation()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceNormals()));
+    this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceResampleMatrix()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceSetCoordinates()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceVertexAreas()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationVolumeCapturePlane()));
@@ -546,6 +566,104 @@ namespace
         }
         return iter->second;
     }
+    
+    DotSIMDEnum::Enum g_simdImpl = DOT_AUTO;//what -simd last asked for, so batch mode can put it back
+    
+    void setSimdImpl(const DotSIMDEnum::Enum& impl, const bool& warn)
+    {
+        DotSIMDEnum::Enum retval = dot_set_impl(impl);
+        if (warn && impl != DOT_AUTO && retval != impl)
+        {
+            CaretLogWarning("SIMD type '" + DotSIMDEnum::toName(impl) + "' not supported (could be cpu, compiler, or build options), using '" + DotSIMDEnum::toName(retval) + "'");
+        }
+        NiftiConvert::setImpl(impl);//only has plain and AVX2 versions, so don't warn about it
+        Base64::setImpl(impl);
+        g_simdImpl = impl;
+    }
+    
+    //the process-wide settings that global options change, saved before each line of a batch script and restored after it,
+    //so that every line behaves as if it were run in its own process
+    struct GlobalOptionState
+    {
+        LogLevelEnum::Enum m_logLevel;
+        DotSIMDEnum::Enum m_simdImpl;
+        int m_gzLevel, m_gzThreads;
+        AString m_smoothingCacheDir;
+        
+        GlobalOptionState()
+        {
+            m_logLevel = CaretLogger::getLogger()->getLevel();
+            m_simdImpl = g_simdImpl;
+            CaretBinaryFile::getCompressionOptions(m_gzLevel, m_gzThreads);
+            m_smoothingCacheDir = MetricSmoothingObject::getWeightCacheDirectory();
+        }
+        
+        void restore() const
+        {
+            CaretLogger::getLogger()->setLevel(m_logLevel);
+            if (g_simdImpl != m_simdImpl) setSimdImpl(m_simdImpl, false);
+            CaretBinaryFile::setCompressionOptions(m_gzLevel, m_gzThreads);
+            MetricSmoothingObject::setWeightCacheDirectory(m_smoothingCacheDir);
+        }
+    };
+}
+
+/**
+ * Split a line of a batch script into arguments, with roughly the quoting rules of sh: single quotes are literal,
+ * double quotes allow backslash to escape \ and ", backslash outside quotes escapes any character, and # starts a comment.
+ *
+ * @param line
+ *    The line of the script.
+ * @param lineNum
+ *    Line number, for error messages.
+ * @throws CommandException
+ *    If a quote is not terminated.
+ */
+vector<AString> CommandOperationManager::splitCommandLine(const AString& line, const int64_t& lineNum)
+{
+    vector<AString> ret;
+    AString current;
+    bool inWord = false;
+    const int length = line.size();
+    for (int i = 0; i < length; ++i)
+    {
+        const QChar c = line[i];
+        if (c == '\'')
+        {
+            inWord = true;
+            int end = line.indexOf('\'', i + 1);
+            if (end == -1) throw CommandException("unterminated single quote on line " + AString::number(lineNum) + " of batch script");
+            current += line.mid(i + 1, end - i - 1);
+            i = end;
+        } else if (c == '"') {
+            inWord = true;
+            ++i;
+            for (; i < length && line[i] != '"'; ++i)
+            {
+                if (line[i] == '\\' && i + 1 < length && (line[i + 1] == '"' || line[i + 1] == '\\')) ++i;
+                current += line[i];
+            }
+            if (i >= length) throw CommandException("unterminated double quote on line " + AString::number(lineNum) + " of batch script");
+        } else if (c == '\\') {
+            inWord = true;
+            if (i + 1 < length)
+            {
+                ++i;
+                current += line[i];
+            }
+        } else if (c.isSpace()) {
+            if (inWord) ret.push_back(current);
+            current = "";
+            inWord = false;
+        } else if (c == '#' && !inWord) {
+            break;
+        } else {
+            inWord = true;
+            current += c;
+        }
+    }
+    if (inWord) ret.push_back(current);
+    return ret;
 }
 
 /**
@@ -560,7 +678,9 @@ void
 CommandOperationManager::runCommand(ProgramParameters& parameters)
 {
     vector<AString> globalOptionArgs;
+    vector<vector<AString> > perCommandOptions;//options that are passed to the command rather than set globally, so -batch can give them to every line
     bool preventProvenance = getGlobalOption(parameters, "-disable-provenance", 0, globalOptionArgs);//check these BEFORE we test if we have a command switch, because they remove the switch and arguments from the ProgramParameters
+    if (preventProvenance) perCommandOptions.push_back(vector<AString>(1, "-disable-provenance"));
     if (getGlobalOption(parameters, "-logging", 1, globalOptionArgs))
     {
         bool valid = false;
@@ -573,11 +693,7 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
         bool valid = false;
         const DotSIMDEnum::Enum impl = DotSIMDEnum::fromName(globalOptionArgs[0], &valid);
         if (!valid) throw CommandException("unrecognized SIMD type: '" + globalOptionArgs[0] + "'");
-        DotSIMDEnum::Enum retval = dot_set_impl(impl);
-        if (impl != DOT_AUTO && retval != impl)
-        {
-            CaretLogWarning("SIMD type '" + DotSIMDEnum::toName(impl) + "' not supported (could be cpu, compiler, or build options), using '" + DotSIMDEnum::toName(retval) + "'");
-        }
+        setSimdImpl(impl, true);
     }
     int16_t ciftiDType = NIFTI_TYPE_FLOAT32;
     bool ciftiScale = false;
@@ -585,6 +701,8 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
     if (getGlobalOption(parameters, "-cifti-output-datatype", 1, globalOptionArgs))
     {
         ciftiDType = stringToCiftiType(globalOptionArgs[0]);
+        perCommandOptions.push_back(vector<AString>(1, "-cifti-output-datatype"));
+        perCommandOptions.back().insert(perCommandOptions.back().end(), globalOptionArgs.begin(), globalOptionArgs.end());
     }
     if (getGlobalOption(parameters, "-cifti-output-range", 2, globalOptionArgs))
     {
@@ -594,6 +712,32 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
         if (!valid) throw CommandException("non-numeric option to -cifti-output-range: '" + globalOptionArgs[0] + "'");
         ciftiMax = globalOptionArgs[1].toDouble(&valid);
         if (!valid) throw CommandException("non-numeric option to -cifti-output-range: '" + globalOptionArgs[1] + "'");
+        perCommandOptions.push_back(vector<AString>(1, "-cifti-output-range"));
+        perCommandOptions.back().insert(perCommandOptions.back().end(), globalOptionArgs.begin(), globalOptionArgs.end());
+    }
+    int64_t ciftiTileSize = 0;
+    if (getGlobalOption(parameters, "-cifti-output-tiled", 1, globalOptionArgs))
+    {
+        bool valid = false;
+        ciftiTileSize = globalOptionArgs[0].toLongLong(&valid);
+        if (!valid || ciftiTileSize < 1) throw CommandException("tile size for -cifti-output-tiled must be a positive integer, got '" + globalOptionArgs[0] + "'");
+        perCommandOptions.push_back(vector<AString>(1, "-cifti-output-tiled"));
+        perCommandOptions.back().insert(perCommandOptions.back().end(), globalOptionArgs.begin(), globalOptionArgs.end());
+    }
+    if (getGlobalOption(parameters, "-gz-output", 2, globalOptionArgs))
+    {//applies to every compressed file written, so set it directly rather than passing it to the command
+        bool valid = false;
+        const int level = globalOptionArgs[0].toInt(&valid);
+        if (!valid || level < 0 || level > 9) throw CommandException("compression level for -gz-output must be an integer from 0 to 9, got '" + globalOptionArgs[0] + "'");
+        const int numThreads = globalOptionArgs[1].toInt(&valid);
+        if (!valid || numThreads < 0) throw CommandException("number of threads for -gz-output must be a non-negative integer, got '" + globalOptionArgs[1] + "'");
+        CaretBinaryFile::setCompressionOptions(level, numThreads);
+    }
+    if (getGlobalOption(parameters, "-smoothing-weights-cache", 1, globalOptionArgs))
+    {
+        QFileInfo cacheDirInfo(globalOptionArgs[0]);
+        if (!cacheDirInfo.isDir()) throw CommandException("directory for -smoothing-weights-cache does not exist: '" + globalOptionArgs[0] + "'");
+        MetricSmoothingObject::setWeightCacheDirectory(cacheDirInfo.absoluteFilePath());
     }
 
     const uint64_t numberOfCommands = this->commandOperations.size();
@@ -632,6 +776,18 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
         printDeprecatedCommands();
     } else if (commandSwitch == "-all-commands-help") {
         printAllCommandsHelpInfo(myProgramName);
+    } else if (commandSwitch == "-batch") {
+        AString scriptName = parameters.nextString("batch script");
+        double cacheLimitGB = 4.0;
+        if (parameters.hasNext())
+        {
+            AString option = parameters.nextString("batch option");
+            if (option != "-cache-limit") throw CommandException("unrecognized option to -batch: '" + option + "'");
+            cacheLimitGB = parameters.nextDouble("cache limit");
+            if (cacheLimitGB < 0.0) throw CommandException("cache limit must not be negative");
+        }
+        parameters.verifyAllParametersProcessed();
+        runBatch(scriptName, (int64_t)(cacheLimitGB * 1024 * 1024 * 1024), perCommandOptions);
     } else {
         
         CommandOperation* operation = NULL;
@@ -674,6 +830,7 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
                 } else {
                     operation->setCiftiOutputDTypeNoScale(ciftiDType);
                 }
+                operation->setCiftiOutputTiled(ciftiTileSize);
                 operation->execute(parameters, preventProvenance);
             }
         }
@@ -720,12 +877,27 @@ AString CommandOperationManager::doCompletion(ProgramParameters& parameters, con
     {//can't tab complete a literal number
         return "";
     }
-    ret = "wordlist -disable-provenance\\ -logging\\ -simd\\ -cifti-output-datatype\\ -cifti-output-range";//we could prevent suggesting an already-provided global option, but that would be a bit surprising
+    OptionInfo ciftiTiledInfo = parseGlobalOption(parameters, "-cifti-output-tiled", 1, globalOptionArgs, true);
+    if (ciftiTiledInfo.specified && !ciftiTiledInfo.complete)
+    {
+        return "";
+    }
+    OptionInfo gzOutputInfo = parseGlobalOption(parameters, "-gz-output", 2, globalOptionArgs, true);
+    if (gzOutputInfo.specified && !gzOutputInfo.complete)
+    {
+        return "";
+    }
+    OptionInfo smoothingCacheInfo = parseGlobalOption(parameters, "-smoothing-weights-cache", 1, globalOptionArgs, true);
+    if (smoothingCacheInfo.specified && !smoothingCacheInfo.complete)
+    {
+        return "";
+    }
+    ret = "wordlist -disable-provenance\\ -logging\\ -simd\\ -cifti-output-datatype\\ -cifti-output-range\\ -cifti-output-tiled\\ -gz-output\\ -smoothing-weights-cache";//we could prevent suggesting an already-provided global option, but that would be a bit surprising
     const uint64_t numberOfCommands = this->commandOperations.size();
     const uint64_t numberOfDeprecated = this->deprecatedOperations.size();
     if (!parameters.hasNext())
     {//suggest all commands, including deprecated and informational (order doesn't matter, bash sorts them before displaying)
-        ret += "\\ -help\\ -arguments-help\\ -global-options\\ -parallel-help\\ -cifti-help\\ -gifti-help\\ -volume-help\\ -version\\ -list-commands\\ -list-deprecated-commands\\ -all-commands-help";
+        ret += "\\ -help\\ -batch\\ -arguments-help\\ -global-options\\ -parallel-help\\ -cifti-help\\ -gifti-help\\ -volume-help\\ -version\\ -list-commands\\ -list-deprecated-commands\\ -all-commands-help";
         for (uint64_t i = 0; i < numberOfCommands; i++)
         {
             ret += "\\ " + commandOperations[i]->getCommandLineSwitch();
@@ -965,6 +1137,65 @@ CommandOperationManager::getCommandOperations()
     return this->commandOperations;
 }
 
+void CommandOperationManager::runBatch(const AString& scriptName, const int64_t& cacheLimitBytes, const vector<vector<AString> >& lineDefaults)
+{
+    if (CommandFileCache::isEnabled()) throw CommandException("-batch can't be used inside a batch script");
+    ifstream scriptFile;
+    istream* input = &cin;
+    if (scriptName != "-")
+    {
+        scriptFile.open(scriptName.toLocal8Bit().constData());
+        if (!scriptFile) throw CommandException("failed to open batch script '" + scriptName + "'");
+        input = &scriptFile;
+    }
+    CommandFileCache::enable(cacheLimitBytes);
+    try
+    {
+        string line;
+        int64_t lineNum = 0;
+        while (getline(*input, line))
+        {
+            ++lineNum;
+            vector<AString> words = splitCommandLine(AString::fromLocal8Bit(line.c_str()), lineNum);
+            if (!words.empty() && words[0] == "wb_command") words.erase(words.begin());//allow lines copied from a shell script
+            if (words.empty()) continue;
+            const char* programName = "wb_command";
+            ProgramParameters lineParameters(1, &programName);
+            for (int i = 0; i < (int)lineDefaults.size(); ++i)
+            {//global options given with -batch go first, so the line's own option wins if it has one (the last occurrence is used)
+                if (find(words.begin(), words.end(), lineDefaults[i][0]) != words.end()) continue;//don't log about it being given twice
+                for (int j = 0; j < (int)lineDefaults[i].size(); ++j)
+                {
+                    lineParameters.addParameter(lineDefaults[i][j]);
+                }
+            }
+            for (int i = 0; i < (int)words.size(); ++i)
+            {
+                lineParameters.addParameter(words[i]);
+            }
+            caret_global_commandLine_init(lineParameters);//for provenance, and so that errors show this command
+            CaretLogFine("Running: " + caret_global_commandLine);
+            const GlobalOptionState savedState;//global options on one line must not affect later lines
+            try
+            {
+                runCommand(lineParameters);
+            } catch (CaretException& e) {
+                savedState.restore();
+                throw CommandException("line " + AString::number(lineNum) + " of batch script '" + scriptName + "': " + e.whatString());
+            } catch (...) {
+                savedState.restore();
+                throw;
+            }
+            savedState.restore();
+            cout.flush();//so that something driving us through a pipe sees each command's output as soon as it finishes
+        }
+    } catch (...) {
+        CommandFileCache::disable();
+        throw;
+    }
+    CommandFileCache::disable();
+}
+
 void CommandOperationManager::printHelpInfo()
 {
     cout << ApplicationInformation().getSummaryInformationInString("\n");
@@ -983,6 +1214,16 @@ void CommandOperationManager::printHelpInfo()
     cout << "   -all-commands-help          show all processing subcommands and their help" << endl;
     cout << "                                  info - VERY LONG" << endl;
     cout << endl;
+    cout << "Batch mode:" << endl;
+    cout << "   -batch <script> [-cache-limit <GB>]" << endl;
+    cout << "                               run each line of <script> (or standard input," << endl;
+    cout << "                                  if <script> is -) as a command, in one" << endl;
+    cout << "                                  process, reusing input files that were" << endl;
+    cout << "                                  already read by an earlier line if they" << endl;
+    cout << "                                  haven't changed on disk (default limit 4GB)," << endl;
+    cout << "                                  global options given with -batch apply to" << endl;
+    cout << "                                  every line that doesn't give its own" << endl;
+    cout << endl;
     cout << "To get the help information of a processing subcommand, run it without any" << endl;
     cout << "   additional arguments." << endl;
     cout << endl;
@@ -1083,6 +1324,26 @@ void CommandOperationManager::printGlobalOptions()
     cout << "                                        represented, mostly useful with integer" << endl;
     cout << "                                        output datatypes (see above)" << endl;
     cout << endl;
+    cout << "   -cifti-output-tiled <tile-size>   write 2D cifti output in square tiles of" << endl;
+    cout << "                                        the given size, so that accessing" << endl;
+    cout << "                                        columns of the matrix is fast, but ONLY" << endl;
+    cout << "                                        workbench can read the resulting files as" << endl;
+    cout << "                                        cifti, other software sees a nifti file" << endl;
+    cout << "                                        of tiles with a non-cifti intent code," << endl;
+    cout << "                                        any command run without this option" << endl;
+    cout << "                                        writes the standard layout" << endl;
+    cout << endl;
+    cout << "   -gz-output <level> <threads>      compress .gz output files (like .nii.gz)" << endl;
+    cout << "                                        with the given zlib compression level" << endl;
+    cout << "                                        (0 to 9, default 6), using the given" << endl;
+    cout << "                                        number of threads (0 for the default" << endl;
+    cout << "                                        number of threads)" << endl;
+    cout << endl;
+    cout << "   -smoothing-weights-cache <dir>    save the weights computed for surface" << endl;
+    cout << "                                        smoothing in the given directory, and" << endl;
+    cout << "                                        reuse them when smoothing on the same" << endl;
+    cout << "                                        surface with the same settings" << endl;
+    cout << endl;
     cout << "   -logging <level>                  set the logging level, valid values are:" << endl;
     vector<LogLevelEnum::Enum> logLevels;
     LogLevelEnum::getAllEnums(logLevels);
@@ -1095,8 +1356,9 @@ void CommandOperationManager::printGlobalOptions()
     //guide for wrap, assuming 80 columns:                                                  |
     cout << "   -simd <type>                      set the SIMD implementation to use" << endl;
     cout << "                                        (currently used only for correlation," << endl;
-    cout << "                                        default AUTO which selects fastest" << endl;
-    cout << "                                        supported), valid values are:" << endl;
+    cout << "                                        nifti data conversion, and gifti base64" << endl;
+    cout << "                                        decoding, default AUTO which selects" << endl;
+    cout << "                                        fastest supported), valid values are:" << endl;
     vector<DotSIMDEnum::Enum> simdTypes = DotSIMDEnum::getAllEnums();
     for (vector<DotSIMDEnum::Enum>::iterator iter = simdTypes.begin();
          iter != simdTypes.end();
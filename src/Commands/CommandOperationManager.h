@@ -48,6 +48,8 @@ namespace caret {
         
         std::vector<CommandOperation*> getCommandOperations();
         
+        static std::vector<AString> splitCommandLine(const AString& line, const int64_t& lineNum);
+        
     private:
         CommandOperationManager();
         
@@ -79,6 +81,8 @@ namespace caret {
         
         void printVersionInfo();
         
+        void runBatch(const AString& scriptName, const int64_t& cacheLimitBytes, const std::vector<std::vector<AString> >& lineDefaults);
+        
         bool getGlobalOption(ProgramParameters& parameters, const AString& optionString, const int& numArgs, std::vector<AString>& arguments);
         
         struct OptionInfo
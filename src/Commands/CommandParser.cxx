@@ -28,6 +28,7 @@
 #include "CaretDataFileHelper.h"
 #include "CaretLogger.h"
 #include "CiftiFile.h"
+#include "CommandFileCache.h"
 #include "DataFileException.h"
 #include "FileInformation.h"
 #include "FociFile.h"
@@ -59,6 +60,7 @@ CommandParser::CommandParser(AutoOperationInterface* myAutoOper) :
     m_ciftiDType = NIFTI_TYPE_FLOAT32;
     m_ciftiMax = -1.0;//these values won't get used, but don't leave them uninitialized
     m_ciftiMin = -1.0;
+    m_ciftiTileSize = 0;
 }
 
 void CommandParser::disableProvenance()
@@ -82,6 +84,11 @@ void CommandParser::setCiftiOutputDTypeNoScale(const int16_t& dtype)
     m_ciftiScale = false;
 }
 
+void CommandParser::setCiftiOutputTiled(const int64_t& tileSize)
+{
+    m_ciftiTileSize = tileSize;
+}
+
 void CommandParser::executeOperation(ProgramParameters& parameters)
 {
     CaretPointer<OperationParameters> myAlgParams(m_autoOper->getParameters());//could be an autopointer, but this is safer
@@ -167,8 +174,7 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::BORDER:
                 {
-                    CaretPointer<BorderFile> myFile(new BorderFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<BorderFile> myFile = CommandFileCache::readBorder(nextArg);//only actually caches in batch mode
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -231,8 +237,7 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::FOCI:
                 {
-                    CaretPointer<FociFile> myFile(new FociFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<FociFile> myFile = CommandFileCache::readFoci(nextArg);
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -266,8 +271,7 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::LABEL:
                 {
-                    CaretPointer<LabelFile> myFile(new LabelFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<LabelFile> myFile = CommandFileCache::readLabel(nextArg);
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -290,8 +294,7 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::METRIC:
                 {
-                    CaretPointer<MetricFile> myFile(new MetricFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<MetricFile> myFile = CommandFileCache::readMetric(nextArg);
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -324,8 +327,7 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::SURFACE:
                 {
-                    CaretPointer<SurfaceFile> myFile(new SurfaceFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<SurfaceFile> myFile = CommandFileCache::readSurface(nextArg);
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -348,8 +350,7 @@ void CommandParser::parseComponent(ParameterComponent* myComponent, ProgramParam
                 }
                 case OperationParametersEnum::VOLUME:
                 {
-                    CaretPointer<VolumeFile> myFile(new VolumeFile());
-                    myFile->readFile(nextArg);
+                    CaretPointer<VolumeFile> myFile = CommandFileCache::readVolume(nextArg);
                     if (m_doProvenance)
                     {
                         const GiftiMetaData* md = myFile->getFileMetaData();
@@ -972,6 +973,10 @@ void CommandParser::makeOnDiskOutputs(const vector<OutputAssoc>& outAssociation)
                 } else {
                     myCiftiParam->m_parameter->setWritingDataTypeNoScaling(m_ciftiDType);
                 }
+                if (m_ciftiTileSize > 0)
+                {
+                    myCiftiParam->m_parameter->setWritingTiled(m_ciftiTileSize);
+                }
                 break;
             }
             default:
@@ -40,6 +40,7 @@ namespace caret {
         bool m_doProvenance, m_ciftiScale;
         double m_ciftiMin, m_ciftiMax;
         int16_t m_ciftiDType;
+        int64_t m_ciftiTileSize;
         const static AString PROVENANCE_NAME, PARENT_PROVENANCE_NAME, PROGRAM_PROVENANCE_NAME, CWD_PROVENANCE_NAME;//TODO: put this elsewhere?
         std::map<AString, const CiftiFile*> m_inputCiftiNames;
         struct OutputAssoc
@@ -76,6 +77,7 @@ namespace caret {
         void disableProvenance();
         void setCiftiOutputDTypeAndScale(const int16_t& dtype, const double& minVal, const double& maxVal);
         void setCiftiOutputDTypeNoScale(const int16_t& dtype);
+        void setCiftiOutputTiled(const int64_t& tileSize);
         void executeOperation(ProgramParameters& parameters);
         void showParsedOperation(ProgramParameters& parameters);
         AString doCompletion(ProgramParameters& parameters, const bool& useExtGlob);
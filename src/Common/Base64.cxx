@@ -36,8 +36,22 @@
 
 #include "Base64.h"
 
+#ifdef CARET_DOTFCN
+extern "C"
+{
+#include "cpuinfo.h"
+}
+#endif
+
 using namespace caret;
 
+namespace caret
+{//in its own file because it is compiled with -mavx2
+#ifdef CARET_DOTFCN
+    int64_t base64DecodeBlocksAVX2(const char* input, int64_t inputLength, unsigned char* output, int64_t outputSpace, int64_t* inputUsed);
+#endif
+}
+
 //----------------------------------------------------------------------------
 static const unsigned char Base64EncodeTable[65] =
 "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
@@ -298,3 +312,67 @@ uint64_t Base64::decode(const unsigned char *input,
 
   return optr - output;
 }
+
+//----------------------------------------------------------------------------
+namespace
+{
+    int64_t decodeRunNaive(const char* input, int64_t inputLength, unsigned char* output, int64_t outputSpace, int64_t* inputUsed)
+    {
+        int64_t i = 0, written = 0;
+        for (; i + 4 <= inputLength && written + 3 <= outputSpace; i += 4)
+        {
+            const unsigned char* ptr = (const unsigned char*)(input + i);
+            unsigned char d0 = Base64DecodeTable[ptr[0]], d1 = Base64DecodeTable[ptr[1]], d2 = Base64DecodeTable[ptr[2]], d3 = Base64DecodeTable[ptr[3]];
+            if (((d0 | d1 | d2 | d3) & 0x80) != 0 || ptr[0] == '=' || ptr[1] == '=' || ptr[2] == '=' || ptr[3] == '=') break;//the table decodes '=' as 0
+            output[written] = (unsigned char)((d0 << 2) | (d1 >> 4));
+            output[written + 1] = (unsigned char)((d1 << 4) | (d2 >> 2));
+            output[written + 2] = (unsigned char)((d2 << 6) | d3);
+            written += 3;
+        }
+        *inputUsed = i;
+        return written;
+    }
+
+#ifdef CARET_DOTFCN
+    int64_t decodeRunAVX2(const char* input, int64_t inputLength, unsigned char* output, int64_t outputSpace, int64_t* inputUsed)
+    {//the AVX2 kernel only does whole 32 character blocks, finish with the plain version
+        int64_t blockUsed = 0, tailUsed = 0;
+        int64_t written = base64DecodeBlocksAVX2(input, inputLength, output, outputSpace, &blockUsed);
+        written += decodeRunNaive(input + blockUsed, inputLength - blockUsed, output + written, outputSpace - written, &tailUsed);
+        *inputUsed = blockUsed + tailUsed;
+        return written;
+    }
+#endif
+}
+
+Base64::DecodeRunFunc* Base64::s_decodeRun = &Base64::decodeRunSelect;
+
+DotSIMDEnum::Enum Base64::setImpl(const DotSIMDEnum::Enum& impl)
+{
+#ifdef CARET_DOTFCN
+  switch (impl)
+    {
+    case DOT_AUTO:
+    case DOT_AVX512FMA:
+    case DOT_AVX512:
+    case DOT_AVXFMA:
+    case DOT_AVX:
+      if (hasAVX() && hasAVX2())
+        {
+        s_decodeRun = &decodeRunAVX2;
+        return DOT_AVX;
+        }
+      break;
+    default:
+      break;
+    }
+#endif
+  s_decodeRun = &decodeRunNaive;
+  return DOT_NAIVE;
+}
+
+int64_t Base64::decodeRunSelect(const char* input, int64_t inputLength, unsigned char* output, int64_t outputSpace, int64_t* inputUsed)
+{
+  setImpl(DOT_AUTO);
+  return (*s_decodeRun)(input, inputLength, output, outputSpace, inputUsed);
+}
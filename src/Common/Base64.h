@@ -41,6 +41,7 @@
 
 #include <stdint.h>
 #include "CaretObject.h"
+#include "dot_wrapper.h"
 
 namespace caret {
     
@@ -89,7 +90,29 @@ public:
                               unsigned char *output,
                               uint64_t max_input_length = 0);
     
+  // Description:
+  // Decode the leading run of complete 4 character groups that are entirely
+  // in the base64 alphabet, stopping at the first group containing padding,
+  // whitespace or anything else, or when outputSpace is nearly used up.
+  // Returns the number of bytes written, and the number of characters used
+  // in inputUsed.  For callers that deal with whitespace and padding
+  // themselves, like GiftiStreamDecoder.  Uses AVX2 if the cpu supports it.
+  static int64_t decodeRun(const char* input, const int64_t& inputLength, unsigned char* output, const int64_t& outputSpace, int64_t* inputUsed)
+  { return (*s_decodeRun)(input, inputLength, output, outputSpace, inputUsed); }
+  
+  // Description:
+  // Like NiftiConvert::setImpl, returns DOT_AVX when the AVX2 version was selected, otherwise DOT_NAIVE.
+  static DotSIMDEnum::Enum setImpl(const DotSIMDEnum::Enum& impl);
+  
+  typedef int64_t (DecodeRunFunc)(const char*, int64_t, unsigned char*, int64_t, int64_t*);
+    
 private:
+    static DecodeRunFunc* s_decodeRun;
+    
+    // selects the implementation on first use, then calls it
+    static int64_t decodeRunSelect(const char* input, int64_t inputLength, unsigned char* output, int64_t outputSpace, int64_t* inputUsed);
+    
+
     // Description:  
     // Decode 4 bytes into 3 bytes.
     static int DecodeTriplet(unsigned char i0,
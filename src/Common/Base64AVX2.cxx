@@ -0,0 +1,68 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+//this file is compiled with -mavx2 when SIMD is enabled, so it must only be called after checking the cpu, see Base64::setImpl
+
+#ifdef CARET_DOTFCN
+
+#include <immintrin.h>
+
+#include "stdint.h"
+
+namespace caret
+{
+    //decodes 32 characters to 24 bytes at a time, using nibble lookups to validate and translate (Mula and Lemire's method)
+    //stops at the first block that contains anything outside the base64 alphabet, including padding and whitespace
+    //writes 32 bytes per block, so it stops when there is less than that much output space left
+    int64_t base64DecodeBlocksAVX2(const char* input, int64_t inputLength, unsigned char* output, int64_t outputSpace, int64_t* inputUsed)
+    {
+        const __m256i lutLo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                               0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m256i lutHi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                               0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m256i lutRoll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m256i mask2F = _mm256_set1_epi8(0x2F);
+        const __m256i mergeMult1 = _mm256_set1_epi32(0x01400140), mergeMult2 = _mm256_set1_epi32(0x00011000);
+        const __m256i packShuffle = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                     2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        const __m256i packPermute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+        int64_t i = 0, written = 0;
+        for (; i + 32 <= inputLength && written + 32 <= outputSpace; i += 32)
+        {
+            __m256i chars = _mm256_loadu_si256((const __m256i*)(input + i));
+            __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(chars, 4), mask2F);
+            __m256i loNibbles = _mm256_and_si256(chars, mask2F);
+            __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+            __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+            if (!_mm256_testz_si256(lo, hi)) break;//invalid character somewhere in the block
+            __m256i roll = _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(_mm256_cmpeq_epi8(chars, mask2F), hiNibbles));
+            __m256i values = _mm256_add_epi8(chars, roll);//now 6 bit values
+            __m256i merged = _mm256_madd_epi16(_mm256_maddubs_epi16(values, mergeMult1), mergeMult2);//24 bits in each 32 bit lane
+            __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(merged, packShuffle), packPermute);
+            _mm256_storeu_si256((__m256i*)(output + written), packed);
+            written += 24;
+        }
+        *inputUsed = i;
+        return written;
+    }
+}
+
+#endif //CARET_DOTFCN
@@ -28,12 +28,22 @@
 #include "CaretAssert.h"
 #include "CaretBinaryFile.h"
 #include "CaretLogger.h"
+#include "CaretMutex.h"
+#include "CaretOMP.h"
+#include "CaretOMPExceptionHolder.h"
 #include "DataFileException.h"
 
 #include <QFile>
 #include "zlib.h"
 
 #include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifndef CARET_OS_WINDOWS
+#include <cerrno>
+#include <unistd.h>
+#endif
 
 using namespace caret;
 using namespace std;
@@ -41,41 +51,107 @@ using namespace std;
 //private implementation classes
 namespace caret
 {
-#ifdef ZLIB_VERSION
-    class ZFileImpl : public CaretBinaryFile::ImplInterface
+    class QFileImpl : public CaretBinaryFile::ImplInterface
     {
-        gzFile m_zfile;
+    protected:
+        QFile m_file;
+        bool m_readOnly;//pread doesn't know about QFile's write buffer, so only use it when we never write
         const static int64_t CHUNK_SIZE;
     public:
-        ZFileImpl() { m_zfile = NULL; }
+        QFileImpl() { m_readOnly = false; }
         void open(const QString& filename, const CaretBinaryFile::OpenMode& opmode);
         void close();
         void seek(const int64_t& position);
         int64_t pos();
-        int64_t size() { return -1; }
+        int64_t size() { return m_file.size(); }
         void read(void* dataOut, const int64_t& count, int64_t* numRead);
         void write(const void* dataIn, const int64_t& count);
-        ~ZFileImpl();
+#ifndef CARET_OS_WINDOWS
+        void readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead);
+        bool hasThreadSafeReadAt() const { return m_readOnly; }
+#endif
     };
     
-    const int64_t ZFileImpl::CHUNK_SIZE = 1<<26;//64MiB, large enough for good performance, small enough for zlib, must convert to uint32
-#endif //ZLIB_VERSION
-
-    class QFileImpl : public CaretBinaryFile::ImplInterface
+    const int64_t QFileImpl::CHUNK_SIZE = 1<<30;//1GiB, QT4 apparently chokes at more than 2GiB via buffer.read using int32
+    
+    //read-only, uses QFile::map so that reads are memcpy from the page cache, and so callers can use the mapped memory directly
+    class QFileMapImpl : public QFileImpl
     {
-        QFile m_file;
+        uchar* m_mapped;//NULL if mapping failed, in which case we just act like QFileImpl
+        int64_t m_mapSize, m_pos;
+    public:
+        QFileMapImpl() { m_mapped = NULL; m_mapSize = 0; m_pos = 0; }
+        void open(const QString& filename, const CaretBinaryFile::OpenMode& opmode);
+        void close();
+        void seek(const int64_t& position);
+        int64_t pos();
+        int64_t size() { return (m_mapped == NULL ? m_file.size() : m_mapSize); }//readers of the mapped data call this concurrently, so don't ask QFile
+        void read(void* dataOut, const int64_t& count, int64_t* numRead);
+        const char* getMappedData() const { return (const char*)m_mapped; }
+        void readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead);
+        bool hasThreadSafeReadAt() const { return m_mapped != NULL || QFileImpl::hasThreadSafeReadAt(); }
+    };
+    
+#ifdef ZLIB_VERSION
+    //.gz files are written as a series of independent gzip members, each holding BLOCK_SIZE bytes of uncompressed data (like BGZF, or pigz),
+    //which also lets multiple threads compress different blocks at the same time
+    //with a gzip extra field in each member header giving the compressed and uncompressed sizes of that member
+    //concatenated gzip members are still a normal gzip file, but this lets us build an index of the members on open by reading only the headers,
+    //so we can seek to any position by inflating only one block, and inflate multiple blocks in parallel
+    //files without the extra field (written by other programs) are read with gzread/gzseek, as before
+    class ZFileImpl : public CaretBinaryFile::ImplInterface
+    {
+        gzFile m_zfile;//only used for files without a block index
         const static int64_t CHUNK_SIZE;
+        const static int64_t BLOCK_SIZE;
+        const static int NUM_CACHED_BLOCKS;
+        struct BlockInfo
+        {
+            int64_t m_fileOffset, m_memberSize;//where the whole gzip member is
+            int64_t m_dataOffset, m_dataSize;//uncompressed data range
+        };
+        struct CachedBlock
+        {
+            int64_t m_block;
+            uint64_t m_lastUsed;
+            std::vector<char> m_data;
+        };
+        QFileImpl m_rawFile;//compressed bytes, for block indexed reading and for block writing
+        bool m_indexed, m_writing;
+        std::vector<BlockInfo> m_blocks;
+        int64_t m_totalSize, m_pos;//uncompressed size and position, for block indexed reading or writing
+        CaretMutex m_rawMutex;//in case m_rawFile.readAt isn't thread-safe
+        CaretMutex m_cacheMutex;
+        std::vector<CachedBlock> m_cache;//decompressed blocks, so that small reads in the same block don't inflate it every time
+        uint64_t m_useCounter;
+        std::vector<char> m_writeBuffer;//uncompressed data that hasn't been compressed yet, up to a block per thread (times 2 to even out the work)
+        int m_writeLevel, m_writeThreads;
+        bool m_wroteBlock;
+        bool openIndexed(const QString& filename);//returns false if the file doesn't have our extra field in every member
+        int64_t findBlock(const int64_t& position) const;
+        void readBlock(const int64_t& block, char* dataOut);//inflate the whole block, thread-safe
+        void readFromBlock(const int64_t& block, const int64_t& offsetInBlock, const int64_t& count, char* dataOut);//uses the cache, thread-safe
+        void writeBlocks(const bool& final);//compresses the buffered blocks in parallel, then writes them in order, final includes the partial last block
     public:
+        ZFileImpl() { m_zfile = NULL; m_indexed = false; m_writing = false; m_totalSize = 0; m_pos = 0; m_useCounter = 0; m_wroteBlock = false; m_writeLevel = -1; m_writeThreads = 1; }
         void open(const QString& filename, const CaretBinaryFile::OpenMode& opmode);
         void close();
         void seek(const int64_t& position);
         int64_t pos();
-        int64_t size() { return m_file.size(); }
+        int64_t size() { return (m_indexed ? m_totalSize : -1); }
         void read(void* dataOut, const int64_t& count, int64_t* numRead);
         void write(const void* dataIn, const int64_t& count);
+        void readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead);
+        bool hasThreadSafeReadAt() const { return m_indexed; }
+        ~ZFileImpl();
     };
     
-    const int64_t QFileImpl::CHUNK_SIZE = 1<<30;//1GiB, QT4 apparently chokes at more than 2GiB via buffer.read using int32
+    int g_compressionLevel = -1, g_compressionThreads = 0;//see setCompressionOptions
+    
+    const int64_t ZFileImpl::CHUNK_SIZE = 1<<26;//64MiB, large enough for good performance, small enough for zlib, must convert to uint32
+    const int64_t ZFileImpl::BLOCK_SIZE = 1<<20;//1MiB, compresses nearly as well as one big stream, small enough that reading a single row is cheap
+    const int ZFileImpl::NUM_CACHED_BLOCKS = 8;
+#endif //ZLIB_VERSION
 }
 
 CaretBinaryFile::ImplInterface::~ImplInterface()
@@ -129,6 +205,46 @@ void CaretBinaryFile::open(const QString& filename, const OpenMode& opmode)
     m_curMode = opmode;
 }
 
+void CaretBinaryFile::openMapped(const QString& filename)
+{
+    close();
+    if (filename.endsWith(".gz") || sizeof(void*) < 8)//don't try to map large files into a 32-bit address space
+    {
+        open(filename, READ);
+        return;
+    }
+    m_impl.grabNew(new QFileMapImpl());
+    m_impl->open(filename, READ);
+    m_curMode = READ;
+}
+
+void CaretBinaryFile::setCompressionOptions(const int& level, const int& numThreads)
+{
+    if (level < -1 || level > 9) throw DataFileException("compression level must be between 0 and 9");
+    if (numThreads < 0) throw DataFileException("number of compression threads must not be negative");
+#ifdef ZLIB_VERSION
+    g_compressionLevel = level;
+    g_compressionThreads = numThreads;
+#endif
+}
+
+void CaretBinaryFile::getCompressionOptions(int& level, int& numThreads)
+{
+#ifdef ZLIB_VERSION
+    level = g_compressionLevel;
+    numThreads = g_compressionThreads;
+#else
+    level = -1;
+    numThreads = 0;
+#endif
+}
+
+const char* CaretBinaryFile::getMappedData() const
+{
+    if (m_impl == NULL) return NULL;
+    return m_impl->getMappedData();
+}
+
 void CaretBinaryFile::read(void* dataOut, const int64_t& count, int64_t* numRead)
 {
     CaretAssert(count >= 0);//not sure about allowing 0
@@ -136,6 +252,19 @@ void CaretBinaryFile::read(void* dataOut, const int64_t& count, int64_t* numRead
     m_impl->read(dataOut, count, numRead);
 }
 
+void CaretBinaryFile::readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead)
+{
+    CaretAssert(count >= 0 && position >= 0);
+    if (!getOpenForRead()) throw DataFileException("file is not open for reading");
+    m_impl->readAt(dataOut, count, position, numRead);
+}
+
+bool CaretBinaryFile::hasThreadSafeReadAt() const
+{
+    if (m_impl == NULL) return false;
+    return m_impl->hasThreadSafeReadAt();
+}
+
 void CaretBinaryFile::seek(const int64_t& position)
 {
     CaretAssert(position >= 0);
@@ -163,51 +292,331 @@ void CaretBinaryFile::write(const void* dataIn, const int64_t& count)
 }
 
 #ifdef ZLIB_VERSION
+namespace
+{//gzip member layout used for block writing: fixed header with FEXTRA, one "WB" subfield with the member size and uncompressed size
+    const int GZ_HEADER_SIZE = 24;//10 byte fixed header, 2 byte XLEN, 4 byte subfield header, 8 bytes of subfield data
+    const int GZ_TRAILER_SIZE = 8;//CRC32 and ISIZE
+    
+    void putLE16(unsigned char* out, const uint32_t& value)
+    {
+        out[0] = value & 0xFF;
+        out[1] = (value >> 8) & 0xFF;
+    }
+    
+    void putLE32(unsigned char* out, const uint32_t& value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            out[i] = (value >> (8 * i)) & 0xFF;
+        }
+    }
+    
+    uint32_t getLE16(const unsigned char* in)
+    {
+        return ((uint32_t)in[0]) | (((uint32_t)in[1]) << 8);
+    }
+    
+    uint32_t getLE32(const unsigned char* in)
+    {
+        uint32_t ret = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            ret |= ((uint32_t)in[i]) << (8 * i);
+        }
+        return ret;
+    }
+    
+    //returns false if the header isn't exactly what compressMember writes
+    bool parseMemberHeader(const unsigned char* header, int64_t& memberSizeOut, int64_t& dataSizeOut)
+    {
+        if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || header[3] != 4) return false;//gzip magic, deflate, only FEXTRA flag
+        if (getLE16(header + 10) != 12 || header[12] != 'W' || header[13] != 'B' || getLE16(header + 14) != 8) return false;
+        memberSizeOut = getLE32(header + 16);
+        dataSizeOut = getLE32(header + 20);
+        return memberSizeOut >= GZ_HEADER_SIZE + GZ_TRAILER_SIZE;
+    }
+    
+    //compress data into a complete gzip member, returns false on zlib error
+    bool compressMember(const char* data, const int64_t& count, const int& level, vector<char>& memberOut)
+    {
+        z_stream myStream;
+        memset(&myStream, 0, sizeof(myStream));
+        if (deflateInit2(&myStream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;//negative window bits for raw deflate, we write the gzip wrapper ourselves
+        memberOut.resize(GZ_HEADER_SIZE + deflateBound(&myStream, count) + GZ_TRAILER_SIZE);
+        myStream.next_in = (Bytef*)data;
+        myStream.avail_in = count;
+        myStream.next_out = (Bytef*)(memberOut.data() + GZ_HEADER_SIZE);
+        myStream.avail_out = memberOut.size() - GZ_HEADER_SIZE - GZ_TRAILER_SIZE;
+        int ret = deflate(&myStream, Z_FINISH);
+        int64_t compSize = myStream.total_out;
+        deflateEnd(&myStream);
+        if (ret != Z_STREAM_END) return false;
+        memberOut.resize(GZ_HEADER_SIZE + compSize + GZ_TRAILER_SIZE);
+        unsigned char* header = (unsigned char*)memberOut.data();
+        header[0] = 0x1f;
+        header[1] = 0x8b;
+        header[2] = 8;//deflate
+        header[3] = 4;//FEXTRA
+        putLE32(header + 4, 0);//no modification time
+        header[8] = 0;
+        header[9] = 255;//unknown OS
+        putLE16(header + 10, 12);
+        header[12] = 'W';
+        header[13] = 'B';
+        putLE16(header + 14, 8);
+        putLE32(header + 16, memberOut.size());
+        putLE32(header + 20, count);
+        unsigned char* trailer = header + GZ_HEADER_SIZE + compSize;
+        putLE32(trailer, crc32(crc32(0, Z_NULL, 0), (const Bytef*)data, count));
+        putLE32(trailer + 4, count);
+        return true;
+    }
+    
+    //inflate a complete gzip member written by compressMember, returns false if it is corrupt
+    bool inflateMember(const char* member, const int64_t& memberSize, char* dataOut, const int64_t& dataSize)
+    {
+        z_stream myStream;
+        memset(&myStream, 0, sizeof(myStream));
+        if (inflateInit2(&myStream, -15) != Z_OK) return false;
+        myStream.next_in = (Bytef*)(member + GZ_HEADER_SIZE);
+        myStream.avail_in = memberSize - GZ_HEADER_SIZE - GZ_TRAILER_SIZE;
+        myStream.next_out = (Bytef*)dataOut;
+        myStream.avail_out = dataSize;
+        int ret = inflate(&myStream, Z_FINISH);
+        int64_t outSize = myStream.total_out;
+        inflateEnd(&myStream);
+        if (ret != Z_STREAM_END || outSize != dataSize) return false;
+        const unsigned char* trailer = (const unsigned char*)(member + memberSize - GZ_TRAILER_SIZE);
+        return getLE32(trailer) == crc32(crc32(0, Z_NULL, 0), (const Bytef*)dataOut, dataSize) && getLE32(trailer + 4) == (uint32_t)dataSize;
+    }
+}
+
 void ZFileImpl::open(const QString& filename, const CaretBinaryFile::OpenMode& opmode)
 {
     close();//don't need to, but just because
     m_fileName = filename;
-    const char* mode = NULL;
-    switch (opmode)//we only support a limited number of combinations, and the string modes are quirky
+    switch (opmode)//we only support a limited number of combinations
     {
         case CaretBinaryFile::READ:
-            mode = "rb";
+            if (openIndexed(filename)) return;
             break;
         case CaretBinaryFile::WRITE_TRUNCATE:
-            mode = "wb";//you have to do "r+b" in order to ask it to not truncate, which zlib doesn't support anyway
-            break;
+            m_rawFile.open(filename, opmode);
+            m_writing = true;
+            m_pos = 0;
+            m_wroteBlock = false;
+            m_writeLevel = g_compressionLevel;
+            m_writeThreads = g_compressionThreads;
+#ifdef CARET_OMP
+            if (m_writeThreads == 0) m_writeThreads = omp_get_max_threads();
+#else
+            m_writeThreads = 1;
+#endif
+            m_writeBuffer.reserve(BLOCK_SIZE * m_writeThreads * 2);
+            return;
         default:
             throw DataFileException("compressed file only supports READ and WRITE_TRUNCATE modes");
     }
 #if !defined(CARET_OS_MACOSX) && ZLIB_VERNUM > 0x1232
-    m_zfile = gzopen64(filename.toLocal8Bit().constData(), mode);
+    m_zfile = gzopen64(filename.toLocal8Bit().constData(), "rb");
 #else
-    m_zfile = gzopen(filename.toLocal8Bit().constData(), mode);
+    m_zfile = gzopen(filename.toLocal8Bit().constData(), "rb");
 #endif
     if (m_zfile == NULL)
     {
         if (!QFile::exists(filename))
         {
-            if (!(opmode & CaretBinaryFile::TRUNCATE))
-            {
-                throw DataFileException("failed to open compressed file '" + filename + "', file does not exist, or folder permissions prevent seeing it");
-            } else {//use same logic as QFile impl for now
-                throw DataFileException("failed to open compressed file '" + filename + "', unable to create file");
-            }
+            throw DataFileException("failed to open compressed file '" + filename + "', file does not exist, or folder permissions prevent seeing it");
         }//TODO: check gzerror and errno for more informative error messages
         throw DataFileException("failed to open compressed file '" + filename + "'");
     }
 }
 
+bool ZFileImpl::openIndexed(const QString& filename)
+{
+    m_rawFile.open(filename, CaretBinaryFile::READ);//throws if it doesn't exist, same as gzopen failure
+    int64_t fileSize = m_rawFile.size(), offset = 0, dataOffset = 0;
+    unsigned char header[GZ_HEADER_SIZE];
+    while (offset < fileSize)
+    {
+        int64_t numRead = 0, memberSize = 0, dataSize = 0;
+        m_rawFile.readAt(header, GZ_HEADER_SIZE, offset, &numRead);
+        if (numRead != GZ_HEADER_SIZE || !parseMemberHeader(header, memberSize, dataSize) || offset + memberSize > fileSize)
+        {//not written by us, or appended to, or truncated - let zlib deal with it
+            m_blocks.clear();
+            m_rawFile.close();
+            return false;
+        }
+        BlockInfo myInfo;
+        myInfo.m_fileOffset = offset;
+        myInfo.m_memberSize = memberSize;
+        myInfo.m_dataOffset = dataOffset;
+        myInfo.m_dataSize = dataSize;
+        m_blocks.push_back(myInfo);
+        offset += memberSize;
+        dataOffset += dataSize;
+    }
+    if (m_blocks.empty())
+    {
+        m_rawFile.close();
+        return false;
+    }
+    m_totalSize = dataOffset;
+    m_pos = 0;
+    m_indexed = true;
+    return true;
+}
+
 void ZFileImpl::close()
 {
+    if (m_writing)
+    {
+        m_writing = false;//don't try again if this throws
+        writeBlocks(true);
+        vector<char>().swap(m_writeBuffer);//release the memory
+        m_rawFile.close();
+    }
+    if (m_indexed)
+    {
+        m_indexed = false;
+        m_blocks.clear();
+        m_cache.clear();
+        m_rawFile.close();
+    }
     if (m_zfile == NULL) return;//happens when closed and then destroyed, error opening
     if (gzclose(m_zfile) != 0) throw DataFileException("error closing compressed file '" + m_fileName + "'");
     m_zfile = NULL;
 }
 
+int64_t ZFileImpl::findBlock(const int64_t& position) const
+{
+    CaretAssert(!m_blocks.empty() && position >= 0 && position < m_totalSize);
+    int64_t low = 0, high = (int64_t)m_blocks.size();//find last block starting at or before position
+    while (high - low > 1)
+    {
+        int64_t mid = (low + high) / 2;
+        if (m_blocks[mid].m_dataOffset <= position)
+        {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+void ZFileImpl::readBlock(const int64_t& block, char* dataOut)
+{
+    CaretAssertVectorIndex(m_blocks, block);
+    const BlockInfo& myInfo = m_blocks[block];
+    vector<char> member(myInfo.m_memberSize);
+    if (m_rawFile.hasThreadSafeReadAt())
+    {
+        m_rawFile.readAt(member.data(), myInfo.m_memberSize, myInfo.m_fileOffset, NULL);
+    } else {
+        CaretMutexLocker locked(&m_rawMutex);
+        m_rawFile.readAt(member.data(), myInfo.m_memberSize, myInfo.m_fileOffset, NULL);
+    }
+    if (!inflateMember(member.data(), myInfo.m_memberSize, dataOut, myInfo.m_dataSize))
+    {
+        throw DataFileException("error while reading compressed file '" + m_fileName + "', data is corrupt");
+    }
+}
+
+void ZFileImpl::readFromBlock(const int64_t& block, const int64_t& offsetInBlock, const int64_t& count, char* dataOut)
+{
+    CaretAssertVectorIndex(m_blocks, block);
+    CaretAssert(offsetInBlock >= 0 && offsetInBlock + count <= m_blocks[block].m_dataSize);
+    {
+        CaretMutexLocker locked(&m_cacheMutex);
+        for (int i = 0; i < (int)m_cache.size(); ++i)
+        {
+            if (m_cache[i].m_block == block)
+            {
+                m_cache[i].m_lastUsed = ++m_useCounter;
+                memcpy(dataOut, m_cache[i].m_data.data() + offsetInBlock, count);
+                return;
+            }
+        }
+    }
+    vector<char> blockData(m_blocks[block].m_dataSize);
+    readBlock(block, blockData.data());//don't hold the lock while inflating, so other threads can use the cache
+    memcpy(dataOut, blockData.data() + offsetInBlock, count);
+    CaretMutexLocker locked(&m_cacheMutex);
+    int replace = -1;
+    if ((int)m_cache.size() < NUM_CACHED_BLOCKS)
+    {
+        m_cache.push_back(CachedBlock());
+        replace = (int)m_cache.size() - 1;
+    } else {
+        replace = 0;
+        for (int i = 1; i < (int)m_cache.size(); ++i)
+        {
+            if (m_cache[i].m_lastUsed < m_cache[replace].m_lastUsed) replace = i;
+        }
+    }
+    m_cache[replace].m_block = block;
+    m_cache[replace].m_lastUsed = ++m_useCounter;
+    m_cache[replace].m_data.swap(blockData);//another thread may have inflated the same block meanwhile, that only wastes a cache slot
+}
+
+void ZFileImpl::readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead)
+{
+    if (!m_indexed)
+    {
+        CaretBinaryFile::ImplInterface::readAt(dataOut, count, position, numRead);
+        return;
+    }
+    int64_t total = max(int64_t(0), min(count, m_totalSize - position));
+    if (total > 0)
+    {
+        const int64_t firstBlock = findBlock(position), lastBlock = findBlock(position + total - 1);
+        CaretOMPExceptionHolder errors;
+        //blocks are independent, so a large read can inflate them in parallel, straight into the output when the whole block is wanted
+#pragma omp CARET_PARFOR schedule(dynamic) if (lastBlock > firstBlock)
+        for (int64_t block = firstBlock; block <= lastBlock; ++block)
+        {
+            if (errors.failed()) continue;
+            const BlockInfo& myInfo = m_blocks[block];
+            const int64_t start = max(position, myInfo.m_dataOffset), end = min(position + total, myInfo.m_dataOffset + myInfo.m_dataSize);
+            char* myOut = ((char*)dataOut) + (start - position);
+            try
+            {
+                if (start == myInfo.m_dataOffset && end == myInfo.m_dataOffset + myInfo.m_dataSize && lastBlock > firstBlock)
+                {
+                    readBlock(block, myOut);
+                } else {
+                    readFromBlock(block, start - myInfo.m_dataOffset, end - start, myOut);
+                }
+            } catch (...) {
+                errors.capture();
+            }
+        }
+        errors.rethrowIfFailed();
+    }
+    if (numRead == NULL)
+    {
+        if (total != count) throw DataFileException("premature end of file in compressed file '" + m_fileName + "'");
+    } else {
+        *numRead = total;
+    }
+}
+
 void ZFileImpl::read(void* dataOut, const int64_t& count, int64_t* numRead)
 {
+    if (m_indexed)
+    {
+        int64_t myNumRead = 0;
+        readAt(dataOut, count, m_pos, &myNumRead);
+        m_pos += myNumRead;
+        if (numRead == NULL)
+        {
+            if (myNumRead != count) throw DataFileException("premature end of file in compressed file '" + m_fileName + "'");
+        } else {
+            *numRead = myNumRead;
+        }
+        return;
+    }
     if (m_zfile == NULL) throw DataFileException("read called on unopened ZFileImpl");//shouldn't happen
     int64_t totalRead = 0;
     int readret = 0;//to preserve the info of the read that broke early
@@ -232,6 +641,22 @@ void ZFileImpl::read(void* dataOut, const int64_t& count, int64_t* numRead)
 
 void ZFileImpl::seek(const int64_t& position)
 {
+    if (m_indexed)
+    {
+        if (position < 0 || position > m_totalSize) throw DataFileException("seek failed in compressed file '" + m_fileName + "'");
+        m_pos = position;
+        return;
+    }
+    if (m_writing)
+    {//gzseek on writing also only went forward, filling with zeros
+        if (position < m_pos) throw DataFileException("compressed file '" + m_fileName + "' can only be written sequentially");
+        const vector<char> zeros(min(position - m_pos, BLOCK_SIZE), 0);
+        while (m_pos < position)
+        {
+            write(zeros.data(), min(position - m_pos, (int64_t)zeros.size()));
+        }
+        return;
+    }
     if (m_zfile == NULL) throw DataFileException("seek called on unopened ZFileImpl");//shouldn't happen
     if (pos() == position) return;//slight hack, since gzseek is slow or nonfunctional for some cases, so don't try it unless necessary
 #if !defined(CARET_OS_MACOSX) && ZLIB_VERNUM > 0x1232
@@ -244,6 +669,7 @@ void ZFileImpl::seek(const int64_t& position)
 
 int64_t ZFileImpl::pos()
 {
+    if (m_indexed || m_writing) return m_pos;
     if (m_zfile == NULL) throw DataFileException("pos called on unopened ZFileImpl");//shouldn't happen
 #if !defined(CARET_OS_MACOSX) && ZLIB_VERNUM > 0x1232
     return gztell64(m_zfile);
@@ -254,16 +680,53 @@ int64_t ZFileImpl::pos()
 
 void ZFileImpl::write(const void* dataIn, const int64_t& count)
 {
-    if (m_zfile == NULL) throw DataFileException("read called on unopened ZFileImpl");//shouldn't happen
-    int64_t totalWritten = 0;
-    while (totalWritten < count)
+    if (!m_writing) throw DataFileException("write called on ZFileImpl not opened for writing");//shouldn't happen
+    const char* myData = (const char*)dataIn;
+    const int64_t bufferLimit = BLOCK_SIZE * m_writeThreads * 2;
+    int64_t used = 0;
+    while (used < count)
+    {
+        int64_t toCopy = min(count - used, bufferLimit - (int64_t)m_writeBuffer.size());
+        m_writeBuffer.insert(m_writeBuffer.end(), myData + used, myData + used + toCopy);
+        used += toCopy;
+        if ((int64_t)m_writeBuffer.size() == bufferLimit)
+        {
+            writeBlocks(false);
+        }
+    }
+    m_pos += count;
+}
+
+void ZFileImpl::writeBlocks(const bool& final)
+{
+    const int64_t bufferSize = (int64_t)m_writeBuffer.size();
+    int64_t numBlocks = bufferSize / BLOCK_SIZE;
+    if (final && (bufferSize % BLOCK_SIZE != 0 || !m_wroteBlock)) ++numBlocks;//an empty file still needs one member to be a valid gzip file
+    if (numBlocks == 0) return;
+    vector<vector<char> > members(numBlocks);
+    CaretOMPExceptionHolder errors;
+#pragma omp CARET_PARFOR schedule(dynamic) num_threads(m_writeThreads)
+    for (int64_t i = 0; i < numBlocks; ++i)
     {
-        int64_t iterSize = min(count - totalWritten, CHUNK_SIZE);
-        int writeret = gzwrite(m_zfile, ((const char*)dataIn) + totalWritten, iterSize);
-        if (writeret < 1) break;//0 or -1 indicate eof or error
-        totalWritten += writeret;
+        if (errors.failed()) continue;
+        try
+        {
+            const int64_t start = i * BLOCK_SIZE;
+            if (!compressMember(m_writeBuffer.data() + start, min(BLOCK_SIZE, bufferSize - start), m_writeLevel, members[i]))
+            {
+                throw DataFileException("failed to compress data for file '" + m_fileName + "'");
+            }
+        } catch (...) {//including bad_alloc from the member buffers
+            errors.capture();
+        }
+    }
+    errors.rethrowIfFailed();
+    for (int64_t i = 0; i < numBlocks; ++i)
+    {
+        m_rawFile.write(members[i].data(), members[i].size());
     }
-    if (totalWritten != count) throw DataFileException("failed to write to compressed file '" + m_fileName + "'");
+    m_wroteBlock = true;
+    m_writeBuffer.erase(m_writeBuffer.begin(), m_writeBuffer.begin() + min(bufferSize, numBlocks * BLOCK_SIZE));
 }
 
 ZFileImpl::~ZFileImpl()
@@ -285,6 +748,7 @@ void QFileImpl::open(const QString& filename, const CaretBinaryFile::OpenMode& o
 {
     close();//don't need to, but just because
     m_fileName = filename;
+    m_readOnly = (opmode == CaretBinaryFile::READ);
     QIODevice::OpenMode mode = QIODevice::NotOpen;//means 0
     if (opmode & CaretBinaryFile::READ) mode |= QIODevice::ReadOnly;
     if (opmode & CaretBinaryFile::WRITE) mode |= QIODevice::WriteOnly;
@@ -344,6 +808,38 @@ void QFileImpl::read(void* dataOut, const int64_t& count, int64_t* numRead)
     }
 }
 
+#ifndef CARET_OS_WINDOWS
+void QFileImpl::readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead)
+{
+    if (!m_readOnly)
+    {
+        CaretBinaryFile::ImplInterface::readAt(dataOut, count, position, numRead);
+        return;
+    }
+    int fd = m_file.handle();
+    int64_t total = 0;
+    int64_t readret = -1;
+    while (total < count)
+    {
+        int64_t maxToRead = min(count - total, CHUNK_SIZE);
+        readret = pread(fd, ((char*)dataOut) + total, maxToRead, position + total);
+        if (readret < 0 && errno == EINTR) continue;
+        if (readret < 1) break;//0 or -1 means error or eof
+        total += readret;
+    }
+    if (numRead == NULL)
+    {
+        if (total != count)
+        {
+            if (readret < 0) throw DataFileException("error while reading file '" + m_fileName + "'");
+            throw DataFileException("premature end of file in '" + m_fileName + "'");
+        }
+    } else {
+        *numRead = total;
+    }
+}
+#endif
+
 void QFileImpl::seek(const int64_t& position)
 {
     if (!m_file.seek(position)) throw DataFileException("seek failed in file '" + m_fileName + "'");
@@ -374,3 +870,84 @@ void QFileImpl::write(const void* dataIn, const int64_t& count)
                          + " bytes.");
     if (total != count) throw DataFileException(msg);
 }
+
+void QFileMapImpl::open(const QString& filename, const CaretBinaryFile::OpenMode& opmode)
+{
+    if (opmode != CaretBinaryFile::READ) throw DataFileException("memory mapped file only supports READ mode");//CaretBinaryFile::openMapped never asks for anything else
+    QFileImpl::open(filename, opmode);
+    m_pos = 0;
+    m_mapSize = m_file.size();
+    if (m_mapSize > 0)
+    {
+        m_mapped = m_file.map(0, m_mapSize);//if this fails, we fall back to QFile reading
+    }
+    if (m_mapped == NULL)
+    {
+        CaretLogFine("unable to memory map file '" + filename + "', using normal reads");
+        m_mapSize = 0;
+    }
+}
+
+void QFileMapImpl::close()
+{
+    if (m_mapped != NULL)
+    {
+        m_file.unmap(m_mapped);
+        m_mapped = NULL;
+    }
+    m_mapSize = 0;
+    m_pos = 0;
+    QFileImpl::close();
+}
+
+void QFileMapImpl::readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead)
+{
+    if (m_mapped == NULL)
+    {
+        QFileImpl::readAt(dataOut, count, position, numRead);
+        return;
+    }
+    int64_t total = max(int64_t(0), min(count, m_mapSize - position));
+    memcpy(dataOut, m_mapped + position, total);
+    if (numRead == NULL)
+    {
+        if (total != count) throw DataFileException("premature end of file in '" + m_fileName + "'");
+    } else {
+        *numRead = total;
+    }
+}
+
+void QFileMapImpl::seek(const int64_t& position)
+{
+    if (m_mapped == NULL)
+    {
+        QFileImpl::seek(position);
+        return;
+    }
+    if (position < 0 || position > m_mapSize) throw DataFileException("seek failed in file '" + m_fileName + "'");//QFile allows seeking past the end, but this is read-only
+    m_pos = position;
+}
+
+int64_t QFileMapImpl::pos()
+{
+    if (m_mapped == NULL) return QFileImpl::pos();
+    return m_pos;
+}
+
+void QFileMapImpl::read(void* dataOut, const int64_t& count, int64_t* numRead)
+{
+    if (m_mapped == NULL)
+    {
+        QFileImpl::read(dataOut, count, numRead);
+        return;
+    }
+    int64_t total = min(count, m_mapSize - m_pos);
+    memcpy(dataOut, m_mapped + m_pos, total);
+    m_pos += total;
+    if (numRead == NULL)
+    {
+        if (total != count) throw DataFileException("premature end of file in '" + m_fileName + "'");
+    } else {
+        *numRead = total;
+    }
+}
@@ -47,6 +47,8 @@ namespace caret {
         ///constructor that opens file
         CaretBinaryFile(const QString& filename, const OpenMode& fileMode = READ);
         void open(const QString& filename, const OpenMode& opmode = READ);
+        ///open read-only, memory mapping the file when possible (falls back to normal reading for compressed files or when mapping fails)
+        void openMapped(const QString& filename);
         void close();
         QString getFilename() const;//not a reference because when no file is open, m_impl is NULL
         bool getOpenForRead();
@@ -55,7 +57,15 @@ namespace caret {
         int64_t pos();
         void read(void* dataOut, const int64_t& count, int64_t* numRead = NULL);//throw if numRead is NULL and (error or end of file reached early)
         void write(const void* dataIn, const int64_t& count);//failure to complete write is always an exception
+        //positional read, doesn't use or change pos(), same error behavior as read()
+        //multiple threads may call it concurrently only when hasThreadSafeReadAt() returns true (uncompressed and read-only)
+        void readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead = NULL);
+        bool hasThreadSafeReadAt() const;
         int64_t size();//may return -1 if size cannot be determined efficiently
+        const char* getMappedData() const;//returns NULL if the file is not memory mapped, otherwise the start of the file contents (size() bytes long)
+        ///options for compressed files opened for writing after this call, level is zlib's 0 to 9 (or -1 for the zlib default), numThreads 0 means the default number of threads
+        static void setCompressionOptions(const int& level, const int& numThreads);
+        static void getCompressionOptions(int& level, int& numThreads);
         class ImplInterface
         {
         protected:
@@ -69,6 +79,9 @@ namespace caret {
             virtual int64_t size() = 0;
             virtual void read(void* dataOut, const int64_t& count, int64_t* numRead) = 0;
             virtual void write(const void* dataIn, const int64_t& count) = 0;
+            virtual const char* getMappedData() const { return NULL; }
+            virtual void readAt(void* dataOut, const int64_t& count, const int64_t& position, int64_t* numRead) { seek(position); read(dataOut, count, numRead); }//NOT thread-safe, override when possible
+            virtual bool hasThreadSafeReadAt() const { return false; }
             virtual ~ImplInterface();
         };
     private:
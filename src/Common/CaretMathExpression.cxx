@@ -22,12 +22,16 @@
 #include "CaretException.h"
 #include "CaretLogger.h"
 #include "CaretMathExpression.h"
+#include "CaretOMP.h"
 
+#include <algorithm>
 #include <cmath>
 
 using namespace caret;
 using namespace std;
 
+const int CaretMathExpression::BLOCK_SIZE;
+
 CaretMathExpression::CaretMathExpression(const AString& expression)
 {
     m_input = expression;
@@ -39,6 +43,8 @@ CaretMathExpression::CaretMathExpression(const AString& expression)
         throw CaretException("extra characters on end of expression input: '" + m_input.mid(m_position) + "'");
     }
     CaretLogFiner("parsed '" + expression + "' as '" + toString() + "'");
+    m_numRegisters = 0;
+    compileNode(*m_root, 0);
 }
 
 double CaretMathExpression::evaluate(const vector<float>& variableValues) const
@@ -47,6 +53,330 @@ double CaretMathExpression::evaluate(const vector<float>& variableValues) const
     return m_root->eval(variableValues);
 }
 
+void CaretMathExpression::evaluateMany(const vector<const float*>& variableData, float* output, const int64_t& count) const
+{
+    evaluateMany(variableData, vector<int64_t>(variableData.size(), 1), output, count);
+}
+
+void CaretMathExpression::evaluateMany(const vector<const float*>& variableData, const vector<int64_t>& variableStrides, float* output, const int64_t& count) const
+{
+    CaretAssert(variableData.size() == m_varNames.size());
+    CaretAssert(variableStrides.size() == m_varNames.size());
+    const int64_t numBlocks = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+#pragma omp CARET_PAR if (numBlocks > 1)
+    {
+        vector<double> registers(m_numRegisters * BLOCK_SIZE);
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t block = 0; block < numBlocks; ++block)
+        {
+            const int64_t start = block * BLOCK_SIZE;
+            runProgram(variableData, variableStrides, start, (int)min((int64_t)BLOCK_SIZE, count - start), output, registers.data());
+        }
+    }
+}
+
+void CaretMathExpression::compileNode(const MathNode& node, const int& dest)
+{//same semantics as MathNode::eval, except that && and || evaluate all arguments, which gives the same result since nothing has side effects
+    m_numRegisters = max(m_numRegisters, dest + 1);
+    switch (node.m_type)
+    {
+        case MathNode::OR:
+        case MathNode::AND:
+        case MathNode::EQUAL:
+        case MathNode::GREATERLESS:
+        case MathNode::ADDSUB:
+        case MathNode::MULTDIV:
+        {
+            int end = (int)node.m_arguments.size();
+            CaretAssert(end > 1);
+            compileNode(*(node.m_arguments[0]), dest);
+            for (int i = 1; i < end; ++i)
+            {
+                compileNode(*(node.m_arguments[i]), dest + 1);
+                Instruction::OpCode op = Instruction::ADD;
+                switch (node.m_type)
+                {
+                    case MathNode::OR:
+                        op = Instruction::OR;
+                        break;
+                    case MathNode::AND:
+                        op = Instruction::AND;
+                        break;
+                    case MathNode::EQUAL:
+                        op = node.m_invert[i] ? Instruction::NOT_EQUAL : Instruction::EQUAL;
+                        break;
+                    case MathNode::GREATERLESS:
+                        if (node.m_inclusive[i])
+                        {
+                            op = node.m_invert[i] ? Instruction::LESS_EQUAL : Instruction::GREATER_EQUAL;
+                        } else {
+                            op = node.m_invert[i] ? Instruction::LESS : Instruction::GREATER;
+                        }
+                        break;
+                    case MathNode::ADDSUB:
+                        op = node.m_invert[i] ? Instruction::SUBTRACT : Instruction::ADD;
+                        break;
+                    case MathNode::MULTDIV:
+                        op = node.m_invert[i] ? Instruction::DIVIDE : Instruction::MULTIPLY;
+                        break;
+                    default:
+                        CaretAssert(false);
+                }
+                m_program.push_back(Instruction(op, dest, dest, dest + 1));
+            }
+            break;
+        }
+        case MathNode::NOT:
+            CaretAssert(node.m_arguments.size() == 1);
+            compileNode(*(node.m_arguments[0]), dest);
+            m_program.push_back(Instruction(Instruction::NOT, dest, dest));
+            break;
+        case MathNode::NEGATE:
+            CaretAssert(node.m_arguments.size() == 1);
+            compileNode(*(node.m_arguments[0]), dest);
+            m_program.push_back(Instruction(Instruction::NEGATE, dest, dest));
+            break;
+        case MathNode::POW:
+            CaretAssert(node.m_arguments.size() == 2);
+            compileNode(*(node.m_arguments[0]), dest);
+            compileNode(*(node.m_arguments[1]), dest + 1);
+            m_program.push_back(Instruction(Instruction::POWER, dest, dest, dest + 1));
+            break;
+        case MathNode::FUNC:
+        {
+            int numArgs = (int)node.m_arguments.size();
+            CaretAssert(numArgs <= 3);
+            if (node.m_function == MathFunctionEnum::INVALID)
+            {
+                CaretAssertMessage(0, "MathNode is type FUNC but INVALID function");
+                throw CaretException("parsing problem in CaretMathExpression");
+            }
+            Instruction myInst(Instruction::FUNC, dest);
+            myInst.m_function = node.m_function;
+            for (int i = 0; i < numArgs; ++i)
+            {
+                compileNode(*(node.m_arguments[i]), dest + i);
+                myInst.m_args[i] = dest + i;
+            }
+            m_program.push_back(myInst);
+            break;
+        }
+        case MathNode::VAR:
+        {
+            Instruction myInst(Instruction::LOAD_VAR, dest);
+            myInst.m_varIndex = node.m_varIndex;
+            m_program.push_back(myInst);
+            break;
+        }
+        case MathNode::CONST:
+        {
+            Instruction myInst(Instruction::LOAD_CONST, dest);
+            myInst.m_constVal = node.m_constVal;
+            m_program.push_back(myInst);
+            break;
+        }
+        case MathNode::INVALID:
+            CaretAssertMessage(0, "parsing left INVALID MathNode");
+            throw CaretException("parsing problem in CaretMathExpression");
+    }
+}
+
+void CaretMathExpression::runProgram(const vector<const float*>& variableData, const vector<int64_t>& variableStrides, const int64_t& start, const int& count,
+                                     float* output, double* registers) const
+{//each instruction is a simple loop over the block, so that the compiler can vectorize the arithmetic and comparisons
+    const int numInsts = (int)m_program.size();
+    for (int inst = 0; inst < numInsts; ++inst)
+    {
+        const Instruction& myInst = m_program[inst];
+        double* out = registers + myInst.m_dest * BLOCK_SIZE;
+        const double* a = (myInst.m_args[0] < 0 ? NULL : registers + myInst.m_args[0] * BLOCK_SIZE);
+        const double* b = (myInst.m_args[1] < 0 ? NULL : registers + myInst.m_args[1] * BLOCK_SIZE);
+        switch (myInst.m_op)
+        {
+            case Instruction::LOAD_VAR:
+            {
+                CaretAssertVectorIndex(variableData, myInst.m_varIndex);
+                const int64_t stride = variableStrides[myInst.m_varIndex];
+                const float* varData = variableData[myInst.m_varIndex] + start * stride;
+                if (stride == 1)
+                {
+                    for (int i = 0; i < count; ++i) out[i] = varData[i];
+                } else {
+                    for (int i = 0; i < count; ++i) out[i] = varData[i * stride];
+                }
+                break;
+            }
+            case Instruction::LOAD_CONST:
+                for (int i = 0; i < count; ++i) out[i] = myInst.m_constVal;
+                break;
+            case Instruction::ADD:
+                for (int i = 0; i < count; ++i) out[i] = a[i] + b[i];
+                break;
+            case Instruction::SUBTRACT:
+                for (int i = 0; i < count; ++i) out[i] = a[i] - b[i];
+                break;
+            case Instruction::MULTIPLY:
+                for (int i = 0; i < count; ++i) out[i] = a[i] * b[i];
+                break;
+            case Instruction::DIVIDE:
+                for (int i = 0; i < count; ++i) out[i] = a[i] / b[i];
+                break;
+            case Instruction::POWER:
+                for (int i = 0; i < count; ++i) out[i] = pow(a[i], b[i]);
+                break;
+            case Instruction::GREATER:
+                for (int i = 0; i < count; ++i) out[i] = (a[i] > b[i] ? 1.0 : 0.0);
+                break;
+            case Instruction::LESS:
+                for (int i = 0; i < count; ++i) out[i] = (a[i] < b[i] ? 1.0 : 0.0);
+                break;
+            case Instruction::GREATER_EQUAL://same fudge factor as in MathNode::eval, including the float precision of it
+                for (int i = 0; i < count; ++i)
+                {
+                    float adjust = min(abs(a[i]), abs(b[i])) / 1000000;
+                    out[i] = (a[i] >= b[i] - adjust ? 1.0 : 0.0);
+                }
+                break;
+            case Instruction::LESS_EQUAL:
+                for (int i = 0; i < count; ++i)
+                {
+                    float adjust = min(abs(a[i]), abs(b[i])) / 1000000;
+                    out[i] = (a[i] <= b[i] + adjust ? 1.0 : 0.0);
+                }
+                break;
+            case Instruction::EQUAL:
+                for (int i = 0; i < count; ++i)
+                {
+                    float adjust = min(abs(a[i]), abs(b[i])) / 1000000;
+                    out[i] = ((a[i] >= b[i] - adjust) && (a[i] <= b[i] + adjust) ? 1.0 : 0.0);
+                }
+                break;
+            case Instruction::NOT_EQUAL:
+                for (int i = 0; i < count; ++i)
+                {
+                    float adjust = min(abs(a[i]), abs(b[i])) / 1000000;
+                    out[i] = ((a[i] >= b[i] - adjust) && (a[i] <= b[i] + adjust) ? 0.0 : 1.0);
+                }
+                break;
+            case Instruction::AND:
+                for (int i = 0; i < count; ++i) out[i] = ((a[i] > 0.0) && (b[i] > 0.0) ? 1.0 : 0.0);
+                break;
+            case Instruction::OR:
+                for (int i = 0; i < count; ++i) out[i] = ((a[i] > 0.0) || (b[i] > 0.0) ? 1.0 : 0.0);
+                break;
+            case Instruction::NOT:
+                for (int i = 0; i < count; ++i) out[i] = (a[i] > 0.0 ? 0.0 : 1.0);
+                break;
+            case Instruction::NEGATE:
+                for (int i = 0; i < count; ++i) out[i] = -a[i];
+                break;
+            case Instruction::FUNC:
+            {
+                const double* c = (myInst.m_args[2] < 0 ? NULL : registers + myInst.m_args[2] * BLOCK_SIZE);
+                switch (myInst.m_function)
+                {
+                    case MathFunctionEnum::SIN:
+                        for (int i = 0; i < count; ++i) out[i] = sin(a[i]);
+                        break;
+                    case MathFunctionEnum::COS:
+                        for (int i = 0; i < count; ++i) out[i] = cos(a[i]);
+                        break;
+                    case MathFunctionEnum::TAN:
+                        for (int i = 0; i < count; ++i) out[i] = tan(a[i]);
+                        break;
+                    case MathFunctionEnum::ASIN:
+                        for (int i = 0; i < count; ++i) out[i] = asin(a[i]);
+                        break;
+                    case MathFunctionEnum::ACOS:
+                        for (int i = 0; i < count; ++i) out[i] = acos(a[i]);
+                        break;
+                    case MathFunctionEnum::ATAN:
+                        for (int i = 0; i < count; ++i) out[i] = atan(a[i]);
+                        break;
+                    case MathFunctionEnum::SINH:
+                        for (int i = 0; i < count; ++i) out[i] = sinh(a[i]);
+                        break;
+                    case MathFunctionEnum::COSH:
+                        for (int i = 0; i < count; ++i) out[i] = cosh(a[i]);
+                        break;
+                    case MathFunctionEnum::TANH:
+                        for (int i = 0; i < count; ++i) out[i] = tanh(a[i]);
+                        break;
+                    case MathFunctionEnum::ASINH://same formulas as MathNode::eval
+                        for (int i = 0; i < count; ++i)
+                        {
+                            if (a[i] > 0)
+                            {
+                                out[i] = log(a[i] + sqrt(a[i] * a[i] + 1));
+                            } else {
+                                out[i] = -log(-a[i] + sqrt(a[i] * a[i] + 1));
+                            }
+                        }
+                        break;
+                    case MathFunctionEnum::ACOSH:
+                        for (int i = 0; i < count; ++i) out[i] = log(a[i] + sqrt(a[i] * a[i] - 1));
+                        break;
+                    case MathFunctionEnum::ATANH:
+                        for (int i = 0; i < count; ++i) out[i] = 0.5 * log((1 + a[i]) / (1 - a[i]));
+                        break;
+                    case MathFunctionEnum::LN:
+                        for (int i = 0; i < count; ++i) out[i] = log(a[i]);
+                        break;
+                    case MathFunctionEnum::EXP:
+                        for (int i = 0; i < count; ++i) out[i] = exp(a[i]);
+                        break;
+                    case MathFunctionEnum::LOG:
+                        for (int i = 0; i < count; ++i) out[i] = log10(a[i]);
+                        break;
+                    case MathFunctionEnum::SQRT:
+                        for (int i = 0; i < count; ++i) out[i] = sqrt(a[i]);
+                        break;
+                    case MathFunctionEnum::ABS:
+                        for (int i = 0; i < count; ++i) out[i] = abs(a[i]);
+                        break;
+                    case MathFunctionEnum::FLOOR:
+                        for (int i = 0; i < count; ++i) out[i] = floor(a[i]);
+                        break;
+                    case MathFunctionEnum::ROUND:
+                        for (int i = 0; i < count; ++i) out[i] = (a[i] > 0.0 ? floor(a[i] + 0.5) : ceil(a[i] - 0.5));
+                        break;
+                    case MathFunctionEnum::CEIL:
+                        for (int i = 0; i < count; ++i) out[i] = ceil(a[i]);
+                        break;
+                    case MathFunctionEnum::ATAN2:
+                        for (int i = 0; i < count; ++i) out[i] = atan2(a[i], b[i]);
+                        break;
+                    case MathFunctionEnum::MIN:
+                        for (int i = 0; i < count; ++i) out[i] = (a[i] > b[i] ? b[i] : a[i]);
+                        break;
+                    case MathFunctionEnum::MAX:
+                        for (int i = 0; i < count; ++i) out[i] = (a[i] < b[i] ? b[i] : a[i]);
+                        break;
+                    case MathFunctionEnum::MOD:
+                        for (int i = 0; i < count; ++i) out[i] = (b[i] == 0.0 ? 0.0 : a[i] - b[i] * floor(a[i] / b[i]));
+                        break;
+                    case MathFunctionEnum::CLAMP:
+                        for (int i = 0; i < count; ++i)
+                        {
+                            double temp = a[i];
+                            if (temp < b[i]) temp = b[i];
+                            if (temp > c[i]) temp = c[i];
+                            out[i] = temp;
+                        }
+                        break;
+                    case MathFunctionEnum::INVALID://compileNode checks for this, and we can't throw from inside the parallel region
+                        CaretAssertMessage(0, "FUNC instruction with INVALID function");
+                        break;
+                }
+                break;
+            }
+        }
+    }
+    const double* result = registers;//compileNode was called with 0 for the root
+    float* outBlock = output + start;
+    for (int i = 0; i < count; ++i) outBlock[i] = (float)result[i];
+}
+
 vector<AString> CaretMathExpression::getVarNames() const
 {
     vector<AString> ret(m_varNames.size());
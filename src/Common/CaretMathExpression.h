@@ -28,6 +28,8 @@
 #include <map>
 #include <vector>
 
+#include "stdint.h"
+
 namespace caret {
 
 class CaretMathExpression
@@ -63,6 +65,45 @@ class CaretMathExpression
         double eval(const std::vector<float>& values) const;
         AString toString(const std::vector<AString>& varNames) const;
     };
+    struct Instruction
+    {//one step of the compiled form, each operates on a block of elements, arguments and result are register indices
+        enum OpCode
+        {
+            LOAD_VAR,
+            LOAD_CONST,
+            ADD,
+            SUBTRACT,
+            MULTIPLY,
+            DIVIDE,
+            POWER,
+            GREATER,
+            LESS,
+            GREATER_EQUAL,
+            LESS_EQUAL,
+            EQUAL,
+            NOT_EQUAL,
+            AND,
+            OR,
+            NOT,
+            NEGATE,
+            FUNC
+        };
+        OpCode m_op;
+        MathFunctionEnum::Enum m_function;
+        int m_dest, m_args[3];
+        int m_varIndex;
+        double m_constVal;
+        Instruction(const OpCode& op, const int& dest, const int& arg1 = -1, const int& arg2 = -1, const int& arg3 = -1)
+        {
+            m_op = op; m_function = MathFunctionEnum::INVALID; m_dest = dest; m_args[0] = arg1; m_args[1] = arg2; m_args[2] = arg3; m_varIndex = -1; m_constVal = 0.0;
+        }
+    };
+    static const int BLOCK_SIZE = 256;//elements per register
+    std::vector<Instruction> m_program;
+    int m_numRegisters;
+    void compileNode(const MathNode& node, const int& dest);//puts the result in register dest, uses higher registers as scratch
+    void runProgram(const std::vector<const float*>& variableData, const std::vector<int64_t>& variableStrides, const int64_t& start, const int& count,
+                    float* output, double* registers) const;
     std::map<AString, int> m_varNames;
     AString m_input;
     int m_position, m_end;
@@ -86,6 +127,10 @@ public:
     static bool getNamedConstant(const AString& name, double& valueOut);
     CaretMathExpression(const AString& expression);
     double evaluate(const std::vector<float>& variableValues) const;
+    ///evaluate count elements at once, using multiple threads when count is large enough, variable i of element j is variableData[i][j]
+    void evaluateMany(const std::vector<const float*>& variableData, float* output, const int64_t& count) const;
+    ///same, but variable i of element j is variableData[i][j * variableStrides[i]], so a stride of 0 uses the same value for every element
+    void evaluateMany(const std::vector<const float*>& variableData, const std::vector<int64_t>& variableStrides, float* output, const int64_t& count) const;
     std::vector<AString> getVarNames() const;
     AString toString() const;//the expression, with a lot of parentheses added
 };
@@ -0,0 +1,74 @@
+#ifndef __CARET_OMP_EXCEPTION_HOLDER_H__
+#define __CARET_OMP_EXCEPTION_HOLDER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretOMP.h"
+
+#include <exception>
+
+namespace caret {
+    
+    ///exceptions can't propagate out of an omp region, so catch everything inside it, give it to capture(), and call rethrowIfFailed()
+    ///after the region - this keeps the original exception type (DataFileException, bad_alloc, etc), rather than slicing it
+    class CaretOMPExceptionHolder
+    {
+        std::exception_ptr m_first;
+        bool m_failed;
+        CaretOMPExceptionHolder(const CaretOMPExceptionHolder&);
+        CaretOMPExceptionHolder& operator=(const CaretOMPExceptionHolder&);
+    public:
+        CaretOMPExceptionHolder() { m_failed = false; }
+        
+        ///call only from inside a catch block, keeps the first exception captured
+        void capture()
+        {
+#pragma omp critical(CaretOMPExceptionHolder)
+            {
+                if (!m_failed)
+                {
+                    m_first = std::current_exception();
+                    m_failed = true;
+                }
+            }
+        }
+        
+        ///for skipping the remaining work after something failed
+        bool failed()
+        {
+            bool ret;
+#pragma omp critical(CaretOMPExceptionHolder)
+            {
+                ret = m_failed;
+            }
+            return ret;
+        }
+        
+        ///call after the parallel region has ended
+        void rethrowIfFailed()
+        {
+            if (m_failed) std::rethrow_exception(m_first);
+        }
+    };
+    
+}
+
+#endif //__CARET_OMP_EXCEPTION_HOLDER_H__
@@ -19,12 +19,148 @@
 /*LICENSE_END*/
 
 #include "CaretPointLocator.h"
+#include "CaretAssert.h"
 #include "CaretHeap.h"
+#include "CaretOMP.h"
+
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    const int FLAT_STACK_SIZE = 128;//median splits halve the point count, so depth can't get near this
+    const int64_t PARALLEL_MIN_TARGETS = 4096;
+    
+    struct AxisCompare
+    {
+        const float* m_coords;
+        int m_axis;
+        AxisCompare(const float* coords, const int& axis) : m_coords(coords), m_axis(axis) { }
+        bool operator()(const int64_t& left, const int64_t& right) const { return m_coords[left * 3 + m_axis] < m_coords[right * 3 + m_axis]; }
+    };
+    
+    struct StackEntry
+    {
+        int64_t m_node;
+        float m_dist2;
+    };
+    
+    struct KNNEntry
+    {
+        float m_dist2;
+        int64_t m_pos;
+    };
+    
+    struct RangeHit
+    {
+        int64_t m_index;
+        int32_t m_set;
+        float m_dist;
+        bool operator<(const RangeHit& rhs) const
+        {//same order as LocatorInfo
+            if (m_set == rhs.m_set) return m_index < rhs.m_index;
+            return m_set < rhs.m_set;
+        }
+    };
+    
+    inline float boxDist2(const float minBox[3], const float maxBox[3], const float target[3])
+    {
+        float ret = 0.0f;
+        for (int i = 0; i < 3; ++i)
+        {
+            float temp = max(0.0f, max(minBox[i] - target[i], target[i] - maxBox[i]));
+            ret += temp * temp;
+        }
+        return ret;
+    }
+    
+    //kept separate from the comparisons so that it vectorizes
+    inline void leafDistances(const float* x, const float* y, const float* z, const int& count, const float target[3], float* dist2Out)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            float dx = x[i] - target[0], dy = y[i] - target[1], dz = z[i] - target[2];
+            dist2Out[i] = dx * dx + dy * dy + dz * dz;
+        }
+    }
+    
+    //visitors for searchFlatTree, positions are into the flat arrays
+    struct ClosestVisitor
+    {
+        float m_bestDist2;
+        int64_t m_bestPos;
+        ClosestVisitor(const float& maxDist2) : m_bestDist2(maxDist2), m_bestPos(-1) { }
+        float bound() const { return m_bestDist2; }
+        void leaf(const int64_t& base, const int& count, const float* dist2)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                if (dist2[i] < m_bestDist2 || (m_bestPos == -1 && dist2[i] <= m_bestDist2))//like closestPointLimited, maxDist itself is allowed
+                {
+                    m_bestDist2 = dist2[i];
+                    m_bestPos = base + i;
+                }
+            }
+        }
+    };
+    
+    struct KNNVisitor
+    {
+        vector<KNNEntry>& m_best;//sorted by distance, size is k
+        int m_numFound;
+        float m_bound;
+        KNNVisitor(vector<KNNEntry>& best) : m_best(best), m_numFound(0), m_bound(numeric_limits<float>::infinity()) { }
+        float bound() const { return m_bound; }
+        void leaf(const int64_t& base, const int& count, const float* dist2)
+        {
+            const int k = (int)m_best.size();
+            for (int i = 0; i < count; ++i)
+            {
+                if (dist2[i] < m_bound)
+                {//insertion into the sorted list, k is expected to be small
+                    int pos = (m_numFound < k ? m_numFound++ : k - 1);
+                    while (pos > 0 && m_best[pos - 1].m_dist2 > dist2[i])
+                    {
+                        m_best[pos] = m_best[pos - 1];
+                        --pos;
+                    }
+                    m_best[pos].m_dist2 = dist2[i];
+                    m_best[pos].m_pos = base + i;
+                    if (m_numFound == k) m_bound = m_best[k - 1].m_dist2;
+                }
+            }
+        }
+    };
+    
+    struct RangeVisitor
+    {
+        vector<RangeHit>& m_hits;
+        const int64_t* m_index;
+        const int32_t* m_set;
+        float m_maxDist2;
+        RangeVisitor(vector<RangeHit>& hits, const int64_t* index, const int32_t* set, const float& maxDist2) : m_hits(hits), m_index(index), m_set(set), m_maxDist2(maxDist2) { }
+        float bound() const { return m_maxDist2; }
+        void leaf(const int64_t& base, const int& count, const float* dist2)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                if (dist2[i] <= m_maxDist2)
+                {
+                    RangeHit thisHit;
+                    thisHit.m_index = m_index[base + i];
+                    thisHit.m_set = m_set[base + i];
+                    thisHit.m_dist = sqrt(dist2[i]);
+                    m_hits.push_back(thisHit);
+                }
+            }
+        }
+    };
+}
+
 void CaretPointLocator::addPoint(Oct<LeafVector<Point> >* thisOct, const float point[3], const int64_t index, const int32_t pointSet)
 {
     if (thisOct->m_leaf)
@@ -97,6 +233,7 @@ int32_t CaretPointLocator::addPointSet(const float* coordsIn, const int64_t numC
         m_tree = m_tree->makeContains(coordsIn + i3);//make new root if needed
         addPoint(m_tree, coordsIn + i3, i, setNum);//and add the point
     }
+    invalidateFlatTree();
     return setNum;
 }
 
@@ -367,6 +504,7 @@ void CaretPointLocator::removePointSet(int32_t whichSet)
     CaretMutexLocker locked(&m_modifyMutex);
     m_unusedIndexes.push_back(whichSet);
     removeSetHelper(m_tree, whichSet);
+    invalidateFlatTree();
 }
 
 void CaretPointLocator::removeSetHelper(Oct<LeafVector<CaretPointLocator::Point> >* thisOct, int32_t thisSet)
@@ -411,3 +549,266 @@ void CaretPointLocator::removeSetHelper(Oct<LeafVector<CaretPointLocator::Point>
         }
     }
 }
+
+void CaretPointLocator::invalidateFlatTree()
+{
+    m_flatTree.grabNew(NULL);//queries that are running keep their own reference to the old one
+}
+
+void CaretPointLocator::buildFlatNode(vector<FlatNode>& nodes, const vector<float>& coords, vector<int64_t>& order, const int64_t& start, const int64_t& end)
+{
+    int64_t myNode = (int64_t)nodes.size();
+    nodes.push_back(FlatNode());
+    FlatNode& thisNode = nodes.back();
+    thisNode.m_start = start;
+    thisNode.m_end = end;
+    thisNode.m_right = -1;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        thisNode.m_min[axis] = coords[order[start] * 3 + axis];
+        thisNode.m_max[axis] = thisNode.m_min[axis];
+    }
+    for (int64_t i = start + 1; i < end; ++i)
+    {
+        const float* thisCoord = coords.data() + order[i] * 3;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (thisCoord[axis] < thisNode.m_min[axis]) thisNode.m_min[axis] = thisCoord[axis];
+            if (thisCoord[axis] > thisNode.m_max[axis]) thisNode.m_max[axis] = thisCoord[axis];
+        }
+    }
+    if (end - start <= FLAT_LEAF_SIZE) return;
+    int splitAxis = 0;
+    for (int axis = 1; axis < 3; ++axis)
+    {
+        if (thisNode.m_max[axis] - thisNode.m_min[axis] > thisNode.m_max[splitAxis] - thisNode.m_min[splitAxis]) splitAxis = axis;
+    }
+    if (!(thisNode.m_max[splitAxis] > thisNode.m_min[splitAxis])) return;//all points identical, splitting won't help
+    int64_t mid = start + (end - start) / 2;
+    nth_element(order.begin() + start, order.begin() + mid, order.begin() + end, AxisCompare(coords.data(), splitAxis));
+    buildFlatNode(nodes, coords, order, start, mid);//left child is always myNode + 1
+    int64_t rightNode = (int64_t)nodes.size();
+    buildFlatNode(nodes, coords, order, mid, end);
+    nodes[myNode].m_right = rightNode;//thisNode may have been invalidated by push_back
+}
+
+CaretPointer<const CaretPointLocator::FlatTree> CaretPointLocator::getFlatTree() const
+{
+    CaretMutexLocker locked(&m_modifyMutex);//the same lock as modifications, so the point sets can't change while we copy them
+    if (m_flatTree.getPointer() == NULL)
+    {
+        CaretPointer<FlatTree> newTree(new FlatTree());
+        vector<float> coords;
+        vector<int64_t> indices;
+        vector<int32_t> sets;
+        if (m_tree != NULL)
+        {
+            vector<Oct<LeafVector<Point> >*> myStack;
+            myStack.push_back(m_tree);
+            while (!myStack.empty())
+            {
+                Oct<LeafVector<Point> >* thisOct = myStack.back();
+                myStack.pop_back();
+                if (thisOct->m_leaf)
+                {
+                    vector<Point>& myVecRef = *(thisOct->m_data.m_vector);
+                    int curSize = (int)myVecRef.size();
+                    for (int i = 0; i < curSize; ++i)
+                    {
+                        coords.push_back(myVecRef[i].m_point[0]);
+                        coords.push_back(myVecRef[i].m_point[1]);
+                        coords.push_back(myVecRef[i].m_point[2]);
+                        indices.push_back(myVecRef[i].m_index);
+                        sets.push_back(myVecRef[i].m_mySet);
+                    }
+                } else {
+                    for (int ii = 0; ii < 2; ++ii)
+                    {
+                        for (int ij = 0; ij < 2; ++ij)
+                        {
+                            for (int ik = 0; ik < 2; ++ik)
+                            {
+                                myStack.push_back(thisOct->m_children[ii][ij][ik]);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        int64_t numPoints = (int64_t)indices.size();
+        if (numPoints > 0)
+        {
+            vector<int64_t> order(numPoints);
+            for (int64_t i = 0; i < numPoints; ++i)
+            {
+                order[i] = i;
+            }
+            buildFlatNode(newTree->m_nodes, coords, order, 0, numPoints);
+            newTree->m_x.resize(numPoints);
+            newTree->m_y.resize(numPoints);
+            newTree->m_z.resize(numPoints);
+            newTree->m_index.resize(numPoints);
+            newTree->m_set.resize(numPoints);
+            for (int64_t i = 0; i < numPoints; ++i)
+            {
+                newTree->m_x[i] = coords[order[i] * 3];
+                newTree->m_y[i] = coords[order[i] * 3 + 1];
+                newTree->m_z[i] = coords[order[i] * 3 + 2];
+                newTree->m_index[i] = indices[order[i]];
+                newTree->m_set[i] = sets[order[i]];
+            }
+        }
+        m_flatTree = newTree;
+    }
+    return m_flatTree;
+}
+
+template<typename Visitor>
+void CaretPointLocator::searchFlatTree(const FlatTree& tree, const float target[3], Visitor& visitor)
+{//depth first, nearer child first, skips nodes farther than visitor.bound() (squared distance, which may shrink as points are found)
+    if (tree.m_nodes.empty()) return;
+    float dist2[FLAT_LEAF_SIZE];
+    StackEntry myStack[FLAT_STACK_SIZE];
+    myStack[0].m_node = 0;
+    myStack[0].m_dist2 = boxDist2(tree.m_nodes[0].m_min, tree.m_nodes[0].m_max, target);
+    int stackSize = 1;
+    while (stackSize > 0)
+    {
+        --stackSize;
+        if (myStack[stackSize].m_dist2 > visitor.bound()) continue;
+        const int64_t nodeIndex = myStack[stackSize].m_node;
+        const FlatNode& thisNode = tree.m_nodes[nodeIndex];
+        if (thisNode.m_right < 0)
+        {
+            for (int64_t base = thisNode.m_start; base < thisNode.m_end; base += FLAT_LEAF_SIZE)
+            {
+                int count = (int)min<int64_t>(FLAT_LEAF_SIZE, thisNode.m_end - base);
+                leafDistances(tree.m_x.data() + base, tree.m_y.data() + base, tree.m_z.data() + base, count, target, dist2);
+                visitor.leaf(base, count, dist2);
+            }
+        } else {
+            const FlatNode& leftNode = tree.m_nodes[nodeIndex + 1], &rightNode = tree.m_nodes[thisNode.m_right];
+            float leftDist2 = boxDist2(leftNode.m_min, leftNode.m_max, target), rightDist2 = boxDist2(rightNode.m_min, rightNode.m_max, target);
+            CaretAssert(stackSize + 2 <= FLAT_STACK_SIZE);
+            if (leftDist2 <= rightDist2)
+            {//push the farther one first, so the closer one gets searched first
+                myStack[stackSize].m_node = thisNode.m_right; myStack[stackSize].m_dist2 = rightDist2;
+                myStack[stackSize + 1].m_node = nodeIndex + 1; myStack[stackSize + 1].m_dist2 = leftDist2;
+            } else {
+                myStack[stackSize].m_node = nodeIndex + 1; myStack[stackSize].m_dist2 = leftDist2;
+                myStack[stackSize + 1].m_node = thisNode.m_right; myStack[stackSize + 1].m_dist2 = rightDist2;
+            }
+            stackSize += 2;
+        }
+    }
+}
+
+void CaretPointLocator::closestPoints(const float* targets, const int64_t& numTargets, int64_t* indicesOut, float* distancesOut, int32_t* setsOut) const
+{
+    closestPointsHelper(targets, numTargets, numeric_limits<float>::infinity(), indicesOut, distancesOut, setsOut);
+}
+
+void CaretPointLocator::closestPointsLimited(const float* targets, const int64_t& numTargets, const float& maxDist, int64_t* indicesOut, float* distancesOut, int32_t* setsOut) const
+{
+    closestPointsHelper(targets, numTargets, maxDist * maxDist, indicesOut, distancesOut, setsOut);
+}
+
+void CaretPointLocator::closestPointsHelper(const float* targets, const int64_t& numTargets, const float& maxDist2, int64_t* indicesOut, float* distancesOut, int32_t* setsOut) const
+{
+    CaretPointer<const FlatTree> myTree = getFlatTree();
+    const FlatTree& treeRef = *myTree;
+#pragma omp CARET_PARFOR schedule(dynamic, 256) if (numTargets >= PARALLEL_MIN_TARGETS)
+    for (int64_t t = 0; t < numTargets; ++t)
+    {
+        ClosestVisitor myVisitor(maxDist2);
+        searchFlatTree(treeRef, targets + t * 3, myVisitor);
+        if (myVisitor.m_bestPos == -1)
+        {
+            indicesOut[t] = -1;
+            if (distancesOut != NULL) distancesOut[t] = -1.0f;
+            if (setsOut != NULL) setsOut[t] = -1;
+        } else {
+            indicesOut[t] = treeRef.m_index[myVisitor.m_bestPos];
+            if (distancesOut != NULL) distancesOut[t] = sqrt(myVisitor.m_bestDist2);
+            if (setsOut != NULL) setsOut[t] = treeRef.m_set[myVisitor.m_bestPos];
+        }
+    }
+}
+
+void CaretPointLocator::nearestPoints(const float* targets, const int64_t& numTargets, const int& k, int64_t* indicesOut, float* distancesOut, int32_t* setsOut) const
+{
+    CaretAssert(k > 0);
+    if (k < 1) return;
+    CaretPointer<const FlatTree> myTree = getFlatTree();
+    const FlatTree& treeRef = *myTree;
+#pragma omp CARET_PAR if (numTargets >= PARALLEL_MIN_TARGETS)
+    {
+        vector<KNNEntry> best(k);
+#pragma omp CARET_FOR schedule(dynamic, 256)
+        for (int64_t t = 0; t < numTargets; ++t)
+        {
+            KNNVisitor myVisitor(best);
+            searchFlatTree(treeRef, targets + t * 3, myVisitor);
+            int64_t outBase = t * k;
+            for (int i = 0; i < k; ++i)
+            {
+                if (i < myVisitor.m_numFound)
+                {
+                    indicesOut[outBase + i] = treeRef.m_index[best[i].m_pos];
+                    if (distancesOut != NULL) distancesOut[outBase + i] = sqrt(best[i].m_dist2);
+                    if (setsOut != NULL) setsOut[outBase + i] = treeRef.m_set[best[i].m_pos];
+                } else {
+                    indicesOut[outBase + i] = -1;
+                    if (distancesOut != NULL) distancesOut[outBase + i] = -1.0f;
+                    if (setsOut != NULL) setsOut[outBase + i] = -1;
+                }
+            }
+        }
+    }
+}
+
+void CaretPointLocator::pointsInRange(const float* targets, const int64_t& numTargets, const float& maxDist, vector<int64_t>& offsetsOut,
+                                      vector<int64_t>& indicesOut, vector<float>* distancesOut, vector<int32_t>* setsOut) const
+{
+    const int64_t CHUNK_SIZE = 1024;//targets per chunk, each chunk collects its hits separately, then they get concatenated
+    CaretPointer<const FlatTree> myTree = getFlatTree();
+    const FlatTree& treeRef = *myTree;
+    const float maxDist2 = maxDist * maxDist;
+    const int64_t numChunks = (numTargets + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    vector<vector<RangeHit> > chunkHits(numChunks);
+    offsetsOut.resize(numTargets + 1);
+#pragma omp CARET_PARFOR schedule(dynamic) if (numTargets >= PARALLEL_MIN_TARGETS)
+    for (int64_t chunk = 0; chunk < numChunks; ++chunk)
+    {
+        vector<RangeHit>& myHits = chunkHits[chunk];
+        const int64_t chunkEnd = min(numTargets, (chunk + 1) * CHUNK_SIZE);
+        for (int64_t t = chunk * CHUNK_SIZE; t < chunkEnd; ++t)
+        {
+            const int64_t hitStart = (int64_t)myHits.size();
+            RangeVisitor myVisitor(myHits, treeRef.m_index.data(), treeRef.m_set.data(), maxDist2);
+            searchFlatTree(treeRef, targets + t * 3, myVisitor);
+            sort(myHits.begin() + hitStart, myHits.end());
+            offsetsOut[t + 1] = (int64_t)myHits.size() - hitStart;//counts for now, converted to offsets below
+        }
+    }
+    offsetsOut[0] = 0;
+    for (int64_t t = 0; t < numTargets; ++t)
+    {
+        offsetsOut[t + 1] += offsetsOut[t];
+    }
+    const int64_t totalHits = offsetsOut[numTargets];
+    indicesOut.resize(totalHits);
+    if (distancesOut != NULL) distancesOut->resize(totalHits);
+    if (setsOut != NULL) setsOut->resize(totalHits);
+    for (int64_t chunk = 0; chunk < numChunks; ++chunk)
+    {
+        const vector<RangeHit>& myHits = chunkHits[chunk];
+        const int64_t outBase = offsetsOut[chunk * CHUNK_SIZE], numHits = (int64_t)myHits.size();
+        for (int64_t i = 0; i < numHits; ++i)
+        {
+            indicesOut[outBase + i] = myHits[i].m_index;
+            if (distancesOut != NULL) (*distancesOut)[outBase + i] = myHits[i].m_dist;
+            if (setsOut != NULL) (*setsOut)[outBase + i] = myHits[i].m_set;
+        }
+    }
+}
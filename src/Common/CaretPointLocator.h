@@ -23,6 +23,7 @@
 /*LICENSE_END*/
 
 #include "CaretMutex.h"
+#include "CaretPointer.h"
 #include "OctTree.h"
 #include "Vector3D.h"
 
@@ -63,7 +64,21 @@ namespace caret {
                 m_mySet = mySet;
             }
         };
-        CaretMutex m_modifyMutex;//thread safety, don't let multiple threads modify the point sets at once
+        struct FlatNode
+        {
+            float m_min[3], m_max[3];
+            int64_t m_start, m_end;//range of points in the flat arrays
+            int64_t m_right;//left child is the next node, -1 for leaves
+        };
+        struct FlatTree
+        {//k-d tree with the points reordered so each leaf is a contiguous range, coordinates split into separate arrays for the leaf scans
+            std::vector<FlatNode> m_nodes;
+            std::vector<float> m_x, m_y, m_z;
+            std::vector<int64_t> m_index;
+            std::vector<int32_t> m_set;
+        };
+        mutable CaretMutex m_modifyMutex;//thread safety, don't let multiple threads modify the point sets at once, or build m_flatTree while they change
+        mutable CaretPointer<const FlatTree> m_flatTree;//built on first batch query, queries use a copy of the pointer so it can be replaced while they run
         Oct<LeafVector<Point> >* m_tree;
         int32_t m_nextSetIndex;
         std::vector<int32_t> m_unusedIndexes;
@@ -71,6 +86,13 @@ namespace caret {
         int32_t newIndex();
         static const int NUM_POINTS_SPLIT = 100;
         void removeSetHelper(Oct<LeafVector<Point> >* thisOct, const int32_t thisSet);
+        static const int FLAT_LEAF_SIZE = 16;
+        static void buildFlatNode(std::vector<FlatNode>& nodes, const std::vector<float>& coords, std::vector<int64_t>& order, const int64_t& start, const int64_t& end);
+        CaretPointer<const FlatTree> getFlatTree() const;
+        void invalidateFlatTree();//caller must hold m_modifyMutex
+        template<typename Visitor>
+        static void searchFlatTree(const FlatTree& tree, const float target[3], Visitor& visitor);
+        void closestPointsHelper(const float* targets, const int64_t& numTargets, const float& maxDist2, int64_t* indicesOut, float* distancesOut, int32_t* setsOut) const;
         CaretPointLocator();
     public:
         ///make an empty point locator with given bounding box (bounding box can expand later, but may be less efficient
@@ -86,6 +108,18 @@ namespace caret {
         int64_t closestPointLimited(const float target[3], const float& maxDist, LocatorInfo* infoOut = NULL) const;
         std::set<LocatorInfo> pointsInRange(const float target[3], const float& maxDist) const;
         bool anyInRange(const float target[3], const float& maxDist) const;
+        
+        //batch queries: targets is numTargets xyz triples, these use a flattened copy of the point sets that is built on the first batch query
+        //(and again after the point sets change), are safe to call from multiple threads, and use multiple threads themselves for large batches
+        //distancesOut and setsOut may be NULL, indices are -1 where nothing was found
+        void closestPoints(const float* targets, const int64_t& numTargets, int64_t* indicesOut, float* distancesOut = NULL, int32_t* setsOut = NULL) const;
+        void closestPointsLimited(const float* targets, const int64_t& numTargets, const float& maxDist, int64_t* indicesOut,
+                                  float* distancesOut = NULL, int32_t* setsOut = NULL) const;
+        ///k nearest points to each target in order of distance, outputs are numTargets * k, padded with index -1 when there are fewer than k points
+        void nearestPoints(const float* targets, const int64_t& numTargets, const int& k, int64_t* indicesOut, float* distancesOut = NULL, int32_t* setsOut = NULL) const;
+        ///points within maxDist of each target, target t's results are [offsetsOut[t], offsetsOut[t + 1]) in the other outputs, sorted like pointsInRange
+        void pointsInRange(const float* targets, const int64_t& numTargets, const float& maxDist, std::vector<int64_t>& offsetsOut,
+                           std::vector<int64_t>& indicesOut, std::vector<float>* distancesOut = NULL, std::vector<int32_t>* setsOut = NULL) const;
     };
 }
 
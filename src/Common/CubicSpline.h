@@ -35,6 +35,9 @@ namespace caret {
         static CubicSpline bspline(float frac, bool lowEdge, bool highEdge);
 
         //splines will be reused, so this part should be fast for the majority case (testing for if it is an edge case would slow it down for the majority case)
+        ///the weight of each of the 4 samples, edge versions have zero weight for the missing sample
+        inline float getWeight(const int& which) const { return m_weights[which]; }
+        
         ///evaluate the spline with these samples
         inline float evaluate(const float p0, const float p1, const float p2, const float p3) const
         {
@@ -23,6 +23,18 @@ inline double dsdot (const float *a, const float *b, int n)
     sum += a[k] * b[k];
   return sum;
 }  // dsdot()
+inline void dsdot4 (const float *a, const float *const *b, int n, double *res)
+{
+  double sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+  for (int k = 0; k < n; k++)
+  {
+    sum0 += a[k] * b[0][k];
+    sum1 += a[k] * b[1][k];
+    sum2 += a[k] * b[2][k];
+    sum3 += a[k] * b[3][k];
+  }
+  res[0] = sum0; res[1] = sum1; res[2] = sum2; res[3] = sum3;
+}  // dsdot4()
 //copy enum from dot.h
 //renamed to dot_flags in both files for less conflict chance
 typedef enum {
@@ -24,14 +24,49 @@
 #include "ByteSwapping.h"
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "CaretOMPExceptionHolder.h"
 #include "FileInformation.h"
 
 #include <QByteArray>
 
+#include <cstring>
+
 using namespace caret;
 using namespace std;
 
 const char magic[] = "\0\0\0\0cst\0";
+const char magicCompressed[] = "\0\0\0\0csz\0";
+
+const AString CaretSparseFile::CONTENTS_METADATA_KEY = "WorkbenchSparseContents";
+const AString CaretSparseFile::CONTENTS_RESAMPLING_MATRIX = "ResamplingMatrix";
+
+namespace
+{//unsigned LEB128, 7 bits per byte, low bits first
+    void appendVarint(vector<char>& bytes, uint64_t value)
+    {
+        while (value >= 128)
+        {
+            bytes.push_back((char)((value & 127) | 128));
+            value >>= 7;
+        }
+        bytes.push_back((char)value);
+    }
+    
+    uint64_t readVarint(const unsigned char*& pos, const unsigned char* end)
+    {
+        uint64_t ret = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= end) throw DataFileException("compressed row data ends early, file is corrupt");
+            unsigned char byte = *pos;
+            ++pos;
+            ret |= ((uint64_t)(byte & 127)) << shift;
+            if (!(byte & 128)) return ret;
+        }
+        throw DataFileException("invalid varint in compressed row data, file is corrupt");
+    }
+}
 
 CaretSparseFile::CaretSparseFile(const AString& fileName)
 {
@@ -45,13 +80,18 @@ void CaretSparseFile::readFile(const AString& filename)
     {
         throw DataFileException("wbsparse files cannot be read while compressed");
     }
-    m_file.open(filename);
+    m_file.openMapped(filename);
+    m_threadSafeRead = m_file.hasThreadSafeReadAt();
     FileInformation fileInfo(filename);//useful later for file size, but create it now to reduce the amount of time between file open and size check
     char buf[8];
     m_file.read(buf, 8);
-    for (int i = 0; i < 8; ++i)
+    if (memcmp(buf, magic, 8) == 0)
     {
-        if (buf[i] != magic[i]) throw DataFileException("file has the wrong magic string");
+        m_compressed = false;
+    } else if (memcmp(buf, magicCompressed, 8) == 0) {
+        m_compressed = true;
+    } else {
+        throw DataFileException("file has the wrong magic string");
     }
     m_file.read(m_dims, 2 * sizeof(int64_t));
     if (ByteOrderEnum::isSystemBigEndian())
@@ -72,8 +112,30 @@ void CaretSparseFile::readFile(const AString& filename)
         if (lengthArray[i] > m_dims[0] || lengthArray[i] < 0) throw DataFileException("impossible value found in length array");
         m_indexArray[i + 1] = m_indexArray[i] + lengthArray[i];
     }
-    m_valuesOffset = 8 + 2 * sizeof(int64_t) + m_dims[1] * sizeof(int64_t);
-    int64_t xml_offset = m_valuesOffset + m_indexArray[m_dims[1]] * 2 * sizeof(int64_t);
+    int64_t xml_offset;
+    if (m_compressed)
+    {
+        vector<int64_t> byteEnds(m_dims[1]);
+        m_file.read(byteEnds.data(), m_dims[1] * sizeof(int64_t));
+        if (ByteOrderEnum::isSystemBigEndian())
+        {
+            ByteSwapping::swapBytes(byteEnds.data(), m_dims[1]);
+        }
+        m_rowByteStart.resize(m_dims[1] + 1);
+        m_rowByteStart[0] = 0;
+        for (int64_t i = 0; i < m_dims[1]; ++i)
+        {//every nonzero takes at least 3 bytes: one for the index gap, one for each half of the value
+            if (byteEnds[i] > fileInfo.size()) throw DataFileException("impossible value found in row offset array");//also keeps the offset arithmetic below from overflowing
+            if (byteEnds[i] - m_rowByteStart[i] < 3 * lengthArray[i]) throw DataFileException("impossible value found in row offset array");
+            m_rowByteStart[i + 1] = byteEnds[i];
+        }
+        m_valuesOffset = 8 + 2 * sizeof(int64_t) + 2 * m_dims[1] * sizeof(int64_t);
+        xml_offset = m_valuesOffset + m_rowByteStart[m_dims[1]];
+    } else {
+        m_rowByteStart.clear();
+        m_valuesOffset = 8 + 2 * sizeof(int64_t) + m_dims[1] * sizeof(int64_t);
+        xml_offset = m_valuesOffset + m_indexArray[m_dims[1]] * 2 * sizeof(int64_t);
+    }
     if (xml_offset >= fileInfo.size()) throw DataFileException("file is truncated");
     int64_t xml_length = fileInfo.size() - xml_offset;
     if (xml_length < 1) throw DataFileException("file is truncated");
@@ -100,22 +162,83 @@ CaretSparseFile::~CaretSparseFile()
 {
 }
 
-void CaretSparseFile::getRow(const int64_t& index, int64_t* rowOut)
+void CaretSparseFile::readBytes(void* dataOut, const int64_t& numBytes, const int64_t& position)
+{
+    if (m_threadSafeRead)
+    {
+        m_file.readAt(dataOut, numBytes, position);
+    } else {
+        CaretMutexLocker locked(&m_readMutex);
+        m_file.readAt(dataOut, numBytes, position);
+    }
+}
+
+const int64_t* CaretSparseFile::getRowData(const int64_t& index, vector<int64_t>& scratch)
 {
     CaretAssert(index >= 0 && index < m_dims[1]);
     int64_t start = m_indexArray[index], end = m_indexArray[index + 1];
     int64_t numToRead = (end - start) * 2;
-    m_scratchArray.resize(numToRead);
-    m_file.seek(m_valuesOffset + start * sizeof(int64_t) * 2);
-    m_file.read(m_scratchArray.data(), numToRead * sizeof(int64_t));
+    const char* mapped = m_file.getMappedData();
+    if (m_compressed)
+    {
+        int64_t numBytes = m_rowByteStart[index + 1] - m_rowByteStart[index];
+        int64_t position = m_valuesOffset + m_rowByteStart[index];
+        scratch.resize(numToRead);
+        if (numToRead == 0) return scratch.data();
+        vector<char> byteScratch;
+        const unsigned char* pos;
+        if (mapped != NULL)
+        {
+            pos = (const unsigned char*)(mapped + position);
+        } else {
+            byteScratch.resize(numBytes);
+            readBytes(byteScratch.data(), numBytes, position);
+            pos = (const unsigned char*)byteScratch.data();
+        }
+        const unsigned char* rowEnd = pos + numBytes;
+        int64_t numNonzero = end - start, lastIndex = -1;
+        for (int64_t i = 0; i < numNonzero; ++i)
+        {
+            uint64_t gap = readVarint(pos, rowEnd);
+            if (gap >= (uint64_t)m_dims[0]) throw DataFileException("impossible index value found in file");
+            lastIndex += 1 + (int64_t)gap;//callers check the range
+            scratch[i * 2] = lastIndex;
+        }
+        for (int64_t i = 0; i < numNonzero; ++i)
+        {
+            uint64_t high = readVarint(pos, rowEnd);
+            uint64_t low = readVarint(pos, rowEnd);
+            if (high >= (1ULL<<32) || low >= (1ULL<<32)) throw DataFileException("invalid value in compressed row data, file is corrupt");
+            scratch[i * 2 + 1] = (int64_t)((high<<32) | low);
+        }
+        if (pos != rowEnd) throw DataFileException("compressed row data has the wrong length, file is corrupt");
+        return scratch.data();
+    }
+    int64_t position = m_valuesOffset + start * sizeof(int64_t) * 2;
+    if (mapped != NULL && !ByteOrderEnum::isSystemBigEndian())
+    {//the values start at a multiple of 8 bytes, so this is aligned
+        return (const int64_t*)(mapped + position);
+    }
+    scratch.resize(numToRead);
+    if (numToRead == 0) return scratch.data();
+    readBytes(scratch.data(), numToRead * sizeof(int64_t), position);
     if (ByteOrderEnum::isSystemBigEndian())
     {
-        ByteSwapping::swapBytes(m_scratchArray.data(), numToRead);
+        ByteSwapping::swapBytes(scratch.data(), numToRead);
     }
+    return scratch.data();
+}
+
+void CaretSparseFile::getRow(const int64_t& index, int64_t* rowOut)
+{
+    CaretAssert(index >= 0 && index < m_dims[1]);
+    int64_t numToRead = (m_indexArray[index + 1] - m_indexArray[index]) * 2;
+    vector<int64_t> scratch;
+    const int64_t* rowData = getRowData(index, scratch);
     int64_t curIndex = 0;
     for (int64_t i = 0; i < numToRead; i += 2)
     {
-        int64_t index = m_scratchArray[i];
+        int64_t index = rowData[i];
         if (index < curIndex || index >= m_dims[0]) throw DataFileException("impossible index value found in file");
         while (curIndex < index)
         {
@@ -123,7 +246,7 @@ void CaretSparseFile::getRow(const int64_t& index, int64_t* rowOut)
             ++curIndex;
         }
         ++curIndex;
-        rowOut[index] = m_scratchArray[i + 1];
+        rowOut[index] = rowData[i + 1];
     }
     while (curIndex < m_dims[0])
     {
@@ -135,22 +258,16 @@ void CaretSparseFile::getRow(const int64_t& index, int64_t* rowOut)
 void CaretSparseFile::getRowSparse(const int64_t& index, vector<int64_t>& indicesOut, vector<int64_t>& valuesOut)
 {
     CaretAssert(index >= 0 && index < m_dims[1]);
-    int64_t start = m_indexArray[index], end = m_indexArray[index + 1];
-    int64_t numToRead = (end - start) * 2, numNonzero = end - start;
-    m_scratchArray.resize(numToRead);
-    m_file.seek(m_valuesOffset + start * sizeof(int64_t) * 2);
-    m_file.read(m_scratchArray.data(), numToRead * sizeof(int64_t));
-    if (ByteOrderEnum::isSystemBigEndian())
-    {
-        ByteSwapping::swapBytes(m_scratchArray.data(), numToRead);
-    }
+    int64_t numNonzero = m_indexArray[index + 1] - m_indexArray[index];
+    vector<int64_t> scratch;
+    const int64_t* rowData = getRowData(index, scratch);
     indicesOut.resize(numNonzero);
     valuesOut.resize(numNonzero);
     int64_t lastIndex = -1;
     for (int64_t i = 0; i < numNonzero; ++i)
     {
-        indicesOut[i] = m_scratchArray[i * 2];
-        valuesOut[i] = m_scratchArray[i * 2 + 1];
+        indicesOut[i] = rowData[i * 2];
+        valuesOut[i] = rowData[i * 2 + 1];
         if (indicesOut[i] <= lastIndex || indicesOut[i] >= m_dims[0]) throw DataFileException("impossible index value found in file");
         lastIndex = indicesOut[i];
     }
@@ -158,30 +275,88 @@ void CaretSparseFile::getRowSparse(const int64_t& index, vector<int64_t>& indice
 
 void CaretSparseFile::getFibersRow(const int64_t& index, FiberFractions* rowOut)
 {
-    if (m_scratchRow.size() != (size_t)m_dims[0]) m_scratchRow.resize(m_dims[0]);
-    getRow(index, (int64_t*)m_scratchRow.data());
+    vector<int64_t> fullRow(m_dims[0]);
+    getRow(index, fullRow.data());
     for (int64_t i = 0; i < m_dims[0]; ++i)
     {
-        if (m_scratchRow[i] == 0)
+        if (fullRow[i] == 0)
         {
             rowOut[i].zero();
         } else {
-             decodeFibers(m_scratchRow[i], rowOut[i]);
+             decodeFibers((uint64_t)fullRow[i], rowOut[i]);
         }
     }
 }
 
 void CaretSparseFile::getFibersRowSparse(const int64_t& index, vector<int64_t>& indicesOut, vector<FiberFractions>& valuesOut)
 {
-    getRowSparse(index, indicesOut, m_scratchSparseRow);
-    size_t numNonzero = m_scratchSparseRow.size();
+    vector<int64_t> codedValues;
+    getRowSparse(index, indicesOut, codedValues);
+    size_t numNonzero = codedValues.size();
+    valuesOut.resize(numNonzero);
+    for (size_t i = 0; i < numNonzero; ++i)
+    {
+        decodeFibers((uint64_t)codedValues[i], valuesOut[i]);
+    }
+}
+
+void CaretSparseFile::getWeightsRowSparse(const int64_t& index, vector<int64_t>& indicesOut, vector<float>& valuesOut)
+{
+    vector<int64_t> codedValues;
+    getRowSparse(index, indicesOut, codedValues);
+    size_t numNonzero = codedValues.size();
     valuesOut.resize(numNonzero);
     for (size_t i = 0; i < numNonzero; ++i)
     {
-        decodeFibers(((uint64_t*)m_scratchSparseRow.data())[i], valuesOut[i]);
+        uint32_t bits = (uint32_t)((uint64_t)codedValues[i]);
+        memcpy(&(valuesOut[i]), &bits, sizeof(float));
+    }
+}
+
+namespace
+{//so the batch functions can share one implementation
+    void getRowSparseAny(CaretSparseFile& myFile, const int64_t& index, vector<int64_t>& indicesOut, vector<int64_t>& valuesOut)
+    {
+        myFile.getRowSparse(index, indicesOut, valuesOut);
+    }
+    
+    void getRowSparseAny(CaretSparseFile& myFile, const int64_t& index, vector<int64_t>& indicesOut, vector<FiberFractions>& valuesOut)
+    {
+        myFile.getFibersRowSparse(index, indicesOut, valuesOut);
     }
 }
 
+template<typename T>
+void CaretSparseFile::getRowsSparseImpl(const vector<int64_t>& rowIndices, vector<vector<int64_t> >& indicesOut, vector<vector<T> >& valuesOut)
+{
+    int64_t numRows = (int64_t)rowIndices.size();
+    indicesOut.resize(numRows);
+    valuesOut.resize(numRows);
+    CaretOMPExceptionHolder errors;
+#pragma omp CARET_PARFOR schedule(dynamic) if(numRows > 1)
+    for (int64_t i = 0; i < numRows; ++i)
+    {
+        if (errors.failed()) continue;
+        try
+        {
+            getRowSparseAny(*this, rowIndices[i], indicesOut[i], valuesOut[i]);
+        } catch (...) {
+            errors.capture();
+        }
+    }
+    errors.rethrowIfFailed();
+}
+
+void CaretSparseFile::getRowsSparse(const vector<int64_t>& rowIndices, vector<vector<int64_t> >& indicesOut, vector<vector<int64_t> >& valuesOut)
+{
+    getRowsSparseImpl(rowIndices, indicesOut, valuesOut);
+}
+
+void CaretSparseFile::getFibersRowsSparse(const vector<int64_t>& rowIndices, vector<vector<int64_t> >& indicesOut, vector<vector<FiberFractions> >& valuesOut)
+{
+    getRowsSparseImpl(rowIndices, indicesOut, valuesOut);
+}
+
 void CaretSparseFile::decodeFibers(const uint64_t& coded, FiberFractions& decoded)
 {
     decoded.fiberFractions.resize(3);
@@ -206,11 +381,19 @@ void FiberFractions::zero()
     distance = 0.0f;
 }
 
-CaretSparseFileWriter::CaretSparseFileWriter(const AString& fileName, const CiftiXML& xml)
+CaretSparseFileWriter::CaretSparseFileWriter(const AString& fileName, const CiftiXML& xml, const bool& compressed)
 {
-    if (!fileName.endsWith(".trajTEMP.wbsparse"))
-    {//for now (and maybe forever), this format is single-purpose
-        CaretLogWarning("sparse trajectory file '" + fileName + "' should be saved ending in .trajTEMP.wbsparse");
+    if (xml.getFileMetaData()->get(CaretSparseFile::CONTENTS_METADATA_KEY) == CaretSparseFile::CONTENTS_RESAMPLING_MATRIX)
+    {
+        if (!fileName.endsWith(".resample.wbsparse"))
+        {
+            CaretLogWarning("sparse resampling matrix file '" + fileName + "' should be saved ending in .resample.wbsparse");
+        }
+    } else {
+        if (!fileName.endsWith(".trajTEMP.wbsparse"))
+        {//for now (and maybe forever), this format is single-purpose
+            CaretLogWarning("sparse trajectory file '" + fileName + "' should be saved ending in .trajTEMP.wbsparse");
+        }
     }
     m_finished = false;
     int64_t dimensions[2] = { xml.getDimensionLength(CiftiXML::ALONG_ROW), xml.getDimensionLength(CiftiXML::ALONG_COLUMN) };
@@ -222,8 +405,9 @@ CaretSparseFileWriter::CaretSparseFileWriter(const AString& fileName, const Cift
     {
         throw DataFileException("wbsparse files cannot be written compressed");
     }//because after we finish writing the data, we have to come back and write the lengths array
+    m_compressed = compressed;
     m_file.open(fileName, CaretBinaryFile::WRITE_TRUNCATE);
-    m_file.write(magic, 8);
+    m_file.write(m_compressed ? magicCompressed : magic, 8);
     int64_t tempdims[2] = { m_dims[0], m_dims[1] };
     if (ByteOrderEnum::isSystemBigEndian())
     {
@@ -232,70 +416,95 @@ CaretSparseFileWriter::CaretSparseFileWriter(const AString& fileName, const Cift
     m_file.write(tempdims, 2 * sizeof(int64_t));
     m_lengthArray.resize(m_dims[1], 0);//initialize the memory so that valgrind won't complain
     m_file.write(m_lengthArray.data(), m_dims[1] * sizeof(uint64_t));//write it to get the file to the correct length
-    m_nextRowIndex = 0;
     m_valuesOffset = 8 + 2 * sizeof(int64_t) + m_dims[1] * sizeof(int64_t);
+    if (m_compressed)
+    {
+        m_rowByteEnd.resize(m_dims[1], 0);
+        m_file.write(m_rowByteEnd.data(), m_dims[1] * sizeof(int64_t));
+        m_valuesOffset += m_dims[1] * sizeof(int64_t);
+    }
+    m_nextRowIndex = 0;
+    m_dataBytes = 0;
 }
 
 void CaretSparseFileWriter::writeRow(const int64_t& index, const int64_t* row)
 {
-    CaretAssert(index < m_dims[1]);
-    CaretAssert(index >= m_nextRowIndex);
-    while (m_nextRowIndex < index)
-    {
-        m_lengthArray[m_nextRowIndex] = 0;
-        ++m_nextRowIndex;
-    }
-    m_scratchArray.clear();
-    int64_t count = 0;
+    m_scratchIndices.clear();
+    m_scratchValues.clear();
     for (int64_t i = 0; i < m_dims[0]; ++i)
     {
         if (row[i] != 0)
         {
-            m_scratchArray.push_back(i);
-            m_scratchArray.push_back(row[i]);
-            ++count;
+            m_scratchIndices.push_back(i);
+            m_scratchValues.push_back(row[i]);
         }
     }
-    m_lengthArray[index] = count;
-    if (ByteOrderEnum::isSystemBigEndian())
-    {
-        ByteSwapping::swapBytes(m_scratchArray.data(), m_scratchArray.size());
-    }
-    m_file.write(m_scratchArray.data(), m_scratchArray.size() * sizeof(int64_t));
-    m_nextRowIndex = index + 1;
-    if (m_nextRowIndex == m_dims[1]) finish();
+    writeRowSparse(index, m_scratchIndices, m_scratchValues);
 }
 
-void CaretSparseFileWriter::writeRowSparse(const int64_t& index, const vector<int64_t>& indices, const vector<int64_t>& values)
+void CaretSparseFileWriter::encodeRowSparse(const vector<int64_t>& indices, const vector<int64_t>& values, vector<char>& encodedOut) const
 {
-    CaretAssert(index < m_dims[1]);
-    CaretAssert(index >= m_nextRowIndex);
     CaretAssert(indices.size() == values.size());
-    while (m_nextRowIndex < index)
-    {
-        m_lengthArray[m_nextRowIndex] = 0;
-        ++m_nextRowIndex;
-    }
-    m_scratchArray.clear();
     size_t numNonzero = indices.size();//assume no zeros
-    m_lengthArray[index] = numNonzero;
     int64_t lastIndex = -1;
     for (size_t i = 0; i < numNonzero; ++i)
     {
         if (indices[i] <= lastIndex || indices[i] >= m_dims[0]) throw DataFileException("indices must be sorted when writing sparse rows");
         lastIndex = indices[i];
-        m_scratchArray.push_back(indices[i]);
-        m_scratchArray.push_back(values[i]);
     }
-    if (ByteOrderEnum::isSystemBigEndian())
+    if (m_compressed)
+    {//all index gaps first, then the values, so each block has similar-sized varints
+        encodedOut.clear();
+        lastIndex = -1;
+        for (size_t i = 0; i < numNonzero; ++i)
+        {
+            appendVarint(encodedOut, (uint64_t)(indices[i] - lastIndex - 1));
+            lastIndex = indices[i];
+        }
+        for (size_t i = 0; i < numNonzero; ++i)
+        {//same split as the fiber encoding, totalCount is in the high half
+            uint64_t value = (uint64_t)values[i];
+            appendVarint(encodedOut, value>>32);
+            appendVarint(encodedOut, value & ((1ULL<<32) - 1));
+        }
+    } else {
+        encodedOut.resize(numNonzero * 2 * sizeof(int64_t));
+        for (size_t i = 0; i < numNonzero; ++i)
+        {
+            int64_t pair[2] = { indices[i], values[i] };
+            if (ByteOrderEnum::isSystemBigEndian())
+            {
+                ByteSwapping::swapBytes(pair, 2);
+            }
+            memcpy(encodedOut.data() + i * sizeof(pair), pair, sizeof(pair));
+        }
+    }
+}
+
+void CaretSparseFileWriter::writeEncodedRow(const int64_t& index, const int64_t& numNonzero, const vector<char>& encoded)
+{
+    CaretAssert(index < m_dims[1]);
+    CaretAssert(index >= m_nextRowIndex);
+    while (m_nextRowIndex < index)
     {
-        ByteSwapping::swapBytes(m_scratchArray.data(), m_scratchArray.size());
+        m_lengthArray[m_nextRowIndex] = 0;
+        if (m_compressed) m_rowByteEnd[m_nextRowIndex] = m_dataBytes;
+        ++m_nextRowIndex;
     }
-    m_file.write(m_scratchArray.data(), m_scratchArray.size() * sizeof(int64_t));
+    m_lengthArray[index] = numNonzero;
+    if (!encoded.empty()) m_file.write(encoded.data(), encoded.size());
+    m_dataBytes += encoded.size();
+    if (m_compressed) m_rowByteEnd[index] = m_dataBytes;
     m_nextRowIndex = index + 1;
     if (m_nextRowIndex == m_dims[1]) finish();
 }
 
+void CaretSparseFileWriter::writeRowSparse(const int64_t& index, const vector<int64_t>& indices, const vector<int64_t>& values)
+{
+    encodeRowSparse(indices, values, m_scratchEncoded);
+    writeEncodedRow(index, (int64_t)indices.size(), m_scratchEncoded);
+}
+
 void CaretSparseFileWriter::writeFibersRow(const int64_t& index, const FiberFractions* row)
 {
     if (m_scratchRow.size() != (size_t)m_dims[0]) m_scratchRow.resize(m_dims[0]);
@@ -322,6 +531,75 @@ void CaretSparseFileWriter::writeFibersRowSparse(const int64_t& index, const vec
     writeRowSparse(index, indices, m_scratchSparseRow);
 }
 
+void CaretSparseFileWriter::writeWeightsRowSparse(const int64_t& index, const vector<int64_t>& indices, const vector<float>& values)
+{
+    size_t numNonzero = values.size();
+    m_scratchSparseRow.resize(numNonzero);
+    for (size_t i = 0; i < numNonzero; ++i)
+    {
+        uint32_t bits;
+        memcpy(&bits, &(values[i]), sizeof(float));
+        m_scratchSparseRow[i] = bits;//zero-extended, so the stored value is never negative
+    }
+    writeRowSparse(index, indices, m_scratchSparseRow);
+}
+
+void CaretSparseFileWriter::encodeValues(const vector<int64_t>& values, vector<int64_t>& encodedOut)
+{
+    encodedOut = values;
+}
+
+void CaretSparseFileWriter::encodeValues(const vector<FiberFractions>& values, vector<int64_t>& encodedOut)
+{
+    size_t numNonzero = values.size();
+    encodedOut.resize(numNonzero);
+    for (size_t i = 0; i < numNonzero; ++i)
+    {
+        encodeFibers(values[i], ((uint64_t*)encodedOut.data())[i]);
+    }
+}
+
+template<typename T>
+void CaretSparseFileWriter::writeRowsSparseImpl(const int64_t& firstIndex, const vector<vector<int64_t> >& indices, const vector<vector<T> >& values)
+{
+    CaretAssert(indices.size() == values.size());
+    int64_t numRows = (int64_t)indices.size();
+    CaretAssert(firstIndex >= m_nextRowIndex && firstIndex + numRows <= m_dims[1]);
+    vector<vector<char> > encoded(numRows);
+    CaretOMPExceptionHolder errors;
+#pragma omp CARET_PAR if(numRows > 1)
+    {
+        vector<int64_t> codedValues;
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t i = 0; i < numRows; ++i)
+        {
+            if (errors.failed()) continue;
+            try
+            {
+                encodeValues(values[i], codedValues);
+                encodeRowSparse(indices[i], codedValues, encoded[i]);
+            } catch (...) {
+                errors.capture();
+            }
+        }
+    }
+    errors.rethrowIfFailed();
+    for (int64_t i = 0; i < numRows; ++i)
+    {
+        writeEncodedRow(firstIndex + i, (int64_t)indices[i].size(), encoded[i]);
+    }
+}
+
+void CaretSparseFileWriter::writeRowsSparse(const int64_t& firstIndex, const vector<vector<int64_t> >& indices, const vector<vector<int64_t> >& values)
+{
+    writeRowsSparseImpl(firstIndex, indices, values);
+}
+
+void CaretSparseFileWriter::writeFibersRowsSparse(const int64_t& firstIndex, const vector<vector<int64_t> >& indices, const vector<vector<FiberFractions> >& values)
+{
+    writeRowsSparseImpl(firstIndex, indices, values);
+}
+
 void CaretSparseFileWriter::finish()
 {
     if (m_finished) return;
@@ -329,6 +607,7 @@ void CaretSparseFileWriter::finish()
     while (m_nextRowIndex < m_dims[1])
     {
         m_lengthArray[m_nextRowIndex] = 0;
+        if (m_compressed) m_rowByteEnd[m_nextRowIndex] = m_dataBytes;
         ++m_nextRowIndex;
     }
     QByteArray myXMLBytes = m_xml.writeXMLToQByteArray();
@@ -337,8 +616,13 @@ void CaretSparseFileWriter::finish()
     if (ByteOrderEnum::isSystemBigEndian())
     {
         ByteSwapping::swapBytes(m_lengthArray.data(), m_lengthArray.size());
+        ByteSwapping::swapBytes(m_rowByteEnd.data(), m_rowByteEnd.size());
     }
     m_file.write(m_lengthArray.data(), m_lengthArray.size() * sizeof(uint64_t));
+    if (m_compressed)
+    {//the offset table immediately follows the lengths
+        m_file.write(m_rowByteEnd.data(), m_rowByteEnd.size() * sizeof(int64_t));
+    }
     m_file.close();
 }
 
@@ -26,6 +26,7 @@
 
 #include "AString.h"
 #include "CaretBinaryFile.h"
+#include "CaretMutex.h"
 #include "CiftiXML.h"
 #include "DataFile.h"
 #include "DataFileException.h"
@@ -40,19 +41,40 @@ namespace caret {
         void zero();
     };
     
+    //NOTE: the file is memory mapped when possible, and all of the get functions only use their arguments and local memory as scratch space,
+    //      so multiple threads can read rows from the same CaretSparseFile at once (reads are serialized internally if the file couldn't be mapped
+    //      and the platform has no positional reads)
+    //
+    //      there are two versions of the format, the reader handles both:
+    //      original: magic, dims, int64 length of each row, then each row as interleaved int64 index, value pairs, then the cifti XML
+    //      compressed: magic, dims, int64 length of each row, int64 end byte offset of each row, then each row as varints: the gaps between
+    //          the (sorted) indices, then each value as its high 32 bits followed by its low 32 bits (for fibers, totalCount and then the
+    //          packed fractions and distance), then the cifti XML.  The offset table keeps random row access O(1).
     class CaretSparseFile /* : public DataFile */
     {
         static void decodeFibers(const uint64_t& coded, FiberFractions& decoded);//takes a uint because right shift on signed is implementation dependent
         CaretBinaryFile m_file;
         int64_t m_dims[2], m_valuesOffset;
-        std::vector<uint64_t> m_indexArray, m_scratchRow;
-        std::vector<int64_t> m_scratchArray, m_scratchSparseRow;
+        std::vector<uint64_t> m_indexArray;
+        std::vector<int64_t> m_rowByteStart;//compressed only, has one extra element
+        bool m_compressed, m_threadSafeRead;
+        CaretMutex m_readMutex;//only used when !m_threadSafeRead
         CaretSparseFile(const CaretSparseFile& rhs);
         CiftiXML m_xml;
+        void readBytes(void* dataOut, const int64_t& numBytes, const int64_t& position);
+        ///returns the interleaved index, value pairs of a row, either pointing into the mapped file, or into scratch after reading or decoding them
+        const int64_t* getRowData(const int64_t& index, std::vector<int64_t>& scratch);
+        template<typename T>
+        void getRowsSparseImpl(const std::vector<int64_t>& rowIndices, std::vector<std::vector<int64_t> >& indicesOut, std::vector<std::vector<T> >& valuesOut);
     public:
+        ///cifti file metadata key that records what kind of data a sparse file holds, fiber trajectory files don't set it
+        static const AString CONTENTS_METADATA_KEY;
+        ///CONTENTS_METADATA_KEY value for resampling weight matrices
+        static const AString CONTENTS_RESAMPLING_MATRIX;
+        
         const int64_t* getDimensions() { return m_dims; }
 
-        CaretSparseFile() {};
+        CaretSparseFile() { m_compressed = false; m_threadSafeRead = false; };
         
         virtual void readFile(const AString& filename);
         
@@ -63,6 +85,9 @@ namespace caret {
         ///get a reference to the XML data
         const CiftiXML& getCiftiXML() const { return m_xml; }
         
+        ///whether the file uses the compressed version of the format
+        bool isCompressed() const { return m_compressed; }
+        
         void getRow(const int64_t& index, int64_t* rowOut);
         
         void getRowSparse(const int64_t& index, std::vector<int64_t>& indicesOut, std::vector<int64_t>& valuesOut);
@@ -71,22 +96,41 @@ namespace caret {
         
         void getFibersRowSparse(const int64_t& index, std::vector<int64_t>& indicesOut, std::vector<FiberFractions>& valuesOut);
 
+        ///for files of float weights, such as resampling matrices, where each value is the bit pattern of a float
+        void getWeightsRowSparse(const int64_t& index, std::vector<int64_t>& indicesOut, std::vector<float>& valuesOut);
+        
+        ///decode many rows in parallel, same as calling getRowSparse for each index in rowIndices
+        void getRowsSparse(const std::vector<int64_t>& rowIndices, std::vector<std::vector<int64_t> >& indicesOut, std::vector<std::vector<int64_t> >& valuesOut);
+        
+        ///decode many rows in parallel, same as calling getFibersRowSparse for each index in rowIndices
+        void getFibersRowsSparse(const std::vector<int64_t>& rowIndices, std::vector<std::vector<int64_t> >& indicesOut, std::vector<std::vector<FiberFractions> >& valuesOut);
+
         virtual ~CaretSparseFile();
     };
     
     class CaretSparseFileWriter
     {
         static void encodeFibers(const FiberFractions& orig, uint64_t& coded);
+        static void encodeValues(const std::vector<int64_t>& values, std::vector<int64_t>& encodedOut);
+        static void encodeValues(const std::vector<FiberFractions>& values, std::vector<int64_t>& encodedOut);
         static uint32_t myclamp(const int& x);
         CaretBinaryFile m_file;
-        int64_t m_dims[2], m_valuesOffset, m_nextRowIndex;
-        bool m_finished;
+        int64_t m_dims[2], m_valuesOffset, m_nextRowIndex, m_dataBytes;
+        bool m_finished, m_compressed;
         std::vector<uint64_t> m_lengthArray, m_scratchRow;
-        std::vector<int64_t> m_scratchArray, m_scratchSparseRow;
+        std::vector<int64_t> m_rowByteEnd;//compressed only
+        std::vector<int64_t> m_scratchIndices, m_scratchValues, m_scratchSparseRow;
+        std::vector<char> m_scratchEncoded;
         CaretSparseFileWriter(const CaretSparseFileWriter& rhs);
         CiftiXML m_xml;
+        ///checks the indices and converts the row to the bytes that go in the file
+        void encodeRowSparse(const std::vector<int64_t>& indices, const std::vector<int64_t>& values, std::vector<char>& encodedOut) const;
+        void writeEncodedRow(const int64_t& index, const int64_t& numNonzero, const std::vector<char>& encoded);
+        template<typename T>
+        void writeRowsSparseImpl(const int64_t& firstIndex, const std::vector<std::vector<int64_t> >& indices, const std::vector<std::vector<T> >& values);
     public:
-        CaretSparseFileWriter(const AString& fileName, const CiftiXML& xml);
+        ///compressed uses the smaller version of the format, which older versions of workbench can't read
+        CaretSparseFileWriter(const AString& fileName, const CiftiXML& xml, const bool& compressed = false);
         
         ~CaretSparseFileWriter();
         
@@ -102,6 +146,15 @@ namespace caret {
         ///you must write the rows in order, though you can skip empty rows
         void writeFibersRowSparse(const int64_t& index, const std::vector<int64_t>& indices, const std::vector<FiberFractions>& values);
         
+        ///you must write the rows in order, though you can skip empty rows, zero weights are written as-is
+        void writeWeightsRowSparse(const int64_t& index, const std::vector<int64_t>& indices, const std::vector<float>& values);
+        
+        ///write indices.size() consecutive rows starting at firstIndex, encoding them in parallel, rows are still written to the file in order
+        void writeRowsSparse(const int64_t& firstIndex, const std::vector<std::vector<int64_t> >& indices, const std::vector<std::vector<int64_t> >& values);
+        
+        ///write indices.size() consecutive rows starting at firstIndex, encoding them in parallel, rows are still written to the file in order
+        void writeFibersRowsSparse(const int64_t& firstIndex, const std::vector<std::vector<int64_t> >& indices, const std::vector<std::vector<FiberFractions> >& values);
+        
         ///call this if no rows remain to be written
         void finish();
     };
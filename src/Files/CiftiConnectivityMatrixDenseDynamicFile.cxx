@@ -212,6 +212,23 @@ CiftiConnectivityMatrixDenseDynamicFile::getDataForColumn(float* /*dataOut*/,
     CaretLogSevere(msg);
 }
 
+/**
+ * Load data for the given columns.
+ *
+ * @param dataOut
+ *     Output with data.
+ * @param indices
+ *     Indices of the columns.
+ */
+void
+CiftiConnectivityMatrixDenseDynamicFile::getDataForColumns(float* /*dataOut*/,
+                                                           const std::vector<int64_t>& /*indices*/) const
+{
+    const AString msg("Should never be called for Dense Dynamic File");
+    CaretAssertMessage(0, msg);
+    CaretLogSevere(msg);
+}
+
 /**
  * Load data for the given row.
  *
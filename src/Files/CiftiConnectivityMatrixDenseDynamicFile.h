@@ -57,6 +57,8 @@ namespace caret {
     protected:
         virtual void getDataForColumn(float* dataOut, const int64_t& index) const;
         
+        virtual void getDataForColumns(float* dataOut, const std::vector<int64_t>& indices) const;
+        
         virtual void getDataForRow(float* dataOut, const int64_t& index) const;
                 
         virtual void getProcessedDataForColumn(float* dataOut, const int64_t& index) const;
@@ -19,6 +19,7 @@
  */
 /*LICENSE_END*/
 
+#include <algorithm>
 #include <map>
 #include <set>
 
@@ -1388,9 +1389,6 @@ CiftiFiberTrajectoryFile::loadRowsForAveraging(const std::vector<int64_t>& rowIn
     const CiftiXML& trajXML = m_sparseFile->getCiftiXML();
     const int64_t numberOfColumns = trajXML.getDimensionLength(CiftiXML::ALONG_ROW);
     
-    std::vector<FiberFractions> fiberFractionsForRowVector(numberOfColumns);
-    FiberFractions* fiberFractionsForRow = &fiberFractionsForRowVector[0];
-    
     const int64_t numberOfRowsToLoad = static_cast<int64_t>(rowIndices.size());
     if (numberOfRowsToLoad <= 0) {
         return false;
@@ -1415,11 +1413,20 @@ CiftiFiberTrajectoryFile::loadRowsForAveraging(const std::vector<int64_t>& rowIn
     
     bool userCancelled = false;
     
-    for (int64_t iRow = 0; iRow < numberOfRowsToLoad; iRow++) {
-        const int64_t rowIndex = rowIndices[iRow];
-        
-        if ((iRow % progressUpdateInterval) == 0) {
-            progressEvent.setProgress(iRow,
+    /*
+     * Rows are decoded in parallel a block at a time, and only the nonzero
+     * elements are added, the zero elements of each column are counted
+     * and added at the end.
+     */
+    const int64_t rowsPerBlock = 64;
+    std::vector<int64_t> nonzeroCounts(numberOfColumns, 0);
+    std::vector<int64_t> blockRowIndices;
+    std::vector<std::vector<int64_t> > blockFiberIndices;
+    std::vector<std::vector<FiberFractions> > blockFiberFractions;
+    
+    for (int64_t blockStart = 0; blockStart < numberOfRowsToLoad; blockStart += rowsPerBlock) {
+        if (((blockStart / rowsPerBlock) % progressUpdateInterval) == 0) {
+            progressEvent.setProgress(blockStart,
                                       "");
             EventManager::get()->sendEvent(progressEvent.getPointer());
             if (progressEvent.isCancelled()) {
@@ -1428,12 +1435,25 @@ CiftiFiberTrajectoryFile::loadRowsForAveraging(const std::vector<int64_t>& rowIn
             }
         }
         
-        m_sparseFile->getFibersRow(rowIndex,
-                                   fiberFractionsForRow);
+        const int64_t blockEnd = std::min(blockStart + rowsPerBlock,
+                                          numberOfRowsToLoad);
+        blockRowIndices.assign(rowIndices.begin() + blockStart,
+                               rowIndices.begin() + blockEnd);
+        m_sparseFile->getFibersRowsSparse(blockRowIndices,
+                                          blockFiberIndices,
+                                          blockFiberFractions);
         
-        for (int64_t iCol = 0; iCol < numberOfColumns; iCol++) {
-            FiberOrientationTrajectory* fot = m_fiberOrientationTrajectories[iCol];
-            fot->addFiberFractionsForAveraging(fiberFractionsForRow[iCol]);
+        for (int64_t iBlockRow = 0; iBlockRow < (blockEnd - blockStart); iBlockRow++) {
+            const std::vector<int64_t>& fiberIndices = blockFiberIndices[iBlockRow];
+            const std::vector<FiberFractions>& fiberFractions = blockFiberFractions[iBlockRow];
+            const int64_t numFibers = static_cast<int64_t>(fiberIndices.size());
+            for (int64_t iFiber = 0; iFiber < numFibers; iFiber++) {
+                const int64_t iCol = fiberIndices[iFiber];
+                CaretAssertVectorIndex(m_fiberOrientationTrajectories, iCol);
+                FiberOrientationTrajectory* fot = m_fiberOrientationTrajectories[iCol];
+                fot->addFiberFractionsForAveraging(fiberFractions[iFiber]);
+                nonzeroCounts[iCol]++;
+            }
         }
     }
     
@@ -1442,6 +1462,11 @@ CiftiFiberTrajectoryFile::loadRowsForAveraging(const std::vector<int64_t>& rowIn
         return false;
     }
     
+    for (int64_t iCol = 0; iCol < numberOfColumns; iCol++) {
+        FiberOrientationTrajectory* fot = m_fiberOrientationTrajectories[iCol];
+        fot->addZeroFiberFractionsForAveraging(numberOfRowsToLoad - nonzeroCounts[iCol]);
+    }
+    
     finishFiberOrientationTrajectoriesAveraging();
     
     return true;
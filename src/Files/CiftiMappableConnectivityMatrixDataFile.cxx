@@ -35,6 +35,8 @@
 #include "SceneClass.h"
 #include "SceneClassAssistant.h"
 
+#include <algorithm>
+
 using namespace caret;
 
 
@@ -371,22 +373,45 @@ CiftiMappableConnectivityMatrixDataFile::getRowColumnAverageForIndices(const std
     const int64_t numIndices = static_cast<int64_t>(indices.size());
     if (numIndices > 0) {
         std::vector<double> sum(dataLength, 0.0);
-        std::vector<float>  data(dataLength);
         
-        for (std::vector<int64_t>::const_iterator iter = indices.begin();
-             iter != indices.end();
-             iter++) {
-            if (doRowsFlag) {
+        if (doRowsFlag) {
+            std::vector<float>  data(dataLength);
+            for (std::vector<int64_t>::const_iterator iter = indices.begin();
+                 iter != indices.end();
+                 iter++) {
                 getDataForRow(&data[0], *iter);
+                
+                for (int64_t i = 0; i < dataLength; i++) {
+                    CaretAssertVectorIndex(sum, i);
+                    CaretAssertVectorIndex(data, i);
+                    sum[i] += data[i];
+                }
             }
-            else {
-                getDataForColumn(&data[0], *iter);
-            }
-            
-            for (int64_t i = 0; i < dataLength; i++) {
-                CaretAssertVectorIndex(sum, i);
-                CaretAssertVectorIndex(data, i);
-                sum[i] += data[i];
+        }
+        else {
+            /*
+             * Read columns in groups, each group is a single pass
+             * through the file instead of reading each column
+             * one element at a time.
+             */
+            const int64_t maximumGroupBytes = 256 * 1024 * 1024;
+            const int64_t groupSize = std::max(static_cast<int64_t>(1),
+                                               std::min(numIndices,
+                                                        maximumGroupBytes / static_cast<int64_t>(dataLength * sizeof(float))));
+            std::vector<float> data(groupSize * dataLength);
+            for (int64_t groupStart = 0; groupStart < numIndices; groupStart += groupSize) {
+                const int64_t groupEnd = std::min(groupStart + groupSize, numIndices);
+                const std::vector<int64_t> groupIndices(indices.begin() + groupStart,
+                                                        indices.begin() + groupEnd);
+                getDataForColumns(&data[0], groupIndices);
+                
+                for (int64_t j = 0; j < (groupEnd - groupStart); j++) {
+                    const float* columnData = &data[j * dataLength];
+                    for (int64_t i = 0; i < dataLength; i++) {
+                        CaretAssertVectorIndex(sum, i);
+                        sum[i] += columnData[i];
+                    }
+                }
             }
         }
 
@@ -580,6 +605,23 @@ CiftiMappableConnectivityMatrixDataFile::getDataForColumn(float* dataOut, const
                            index);
 }
 
+/**
+ * Load raw data for the given columns, reading the file
+ * once instead of once per column.
+ *
+ * @param dataOut
+ *     Output with data, column indices[i] starts at
+ *     dataOut[i * number of rows].
+ * @param indices
+ *     Indices of the columns.
+ */
+void
+CiftiMappableConnectivityMatrixDataFile::getDataForColumns(float* dataOut, const std::vector<int64_t>& indices) const
+{
+    m_ciftiFile->getColumns(dataOut,
+                            indices);
+}
+
 /**
  * Load data for the given row.
  *
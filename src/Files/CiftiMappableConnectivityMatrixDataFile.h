@@ -130,6 +130,8 @@ namespace caret {
         
         virtual void getDataForColumn(float* dataOut, const int64_t& index) const;
         
+        virtual void getDataForColumns(float* dataOut, const std::vector<int64_t>& indices) const;
+        
         virtual void getDataForRow(float* dataOut, const int64_t& index) const;
         
         virtual void processRowAverageData(std::vector<float>& rowAverageData);
@@ -6583,17 +6583,25 @@ CiftiMappableDataFile::helpMapFileLoadChartDataMatrixRGBA(int32_t& numberOfRowsO
     /*
      * Get each column, color it using its label table, and then
      * add the column's coloring into the output coloring.
+     * All of the columns are read in one pass through the file,
+     * the RGBA output is four times this size anyway.
      */
-    std::vector<float> columnData(numberOfRowsOut);
+    std::vector<int64_t> allColumnIndices(numberOfColumnsOut);
+    for (int32_t iCol = 0; iCol < numberOfColumnsOut; iCol++) {
+        allColumnIndices[iCol] = iCol;
+    }
+    const int64_t numberOfRowsInFile = m_ciftiFile->getNumberOfRows();
+    std::vector<float> allColumnData(numberOfRowsInFile * numberOfColumnsOut);
+    m_ciftiFile->getColumns(&allColumnData[0],
+                            allColumnIndices);
     std::vector<float> columnRGBA(numberOfRowsOut * 4);
     for (int32_t iCol = 0; iCol < numberOfColumnsOut; iCol++) {
         CaretAssertVectorIndex(m_mapContent, iCol);
-        m_ciftiFile->getColumn(&columnData[0],
-                               iCol);
+        float* columnDataPointer = &allColumnData[iCol * numberOfRowsInFile];
         if (useLabelTableFlag) {
             const GiftiLabelTable* labelTable = getMapLabelTable(iCol);
             NodeAndVoxelColoring::colorIndicesWithLabelTable(labelTable,
-                                                             &columnData[0],
+                                                             columnDataPointer,
                                                              numberOfRowsOut,
                                                              &columnRGBA[0]);
         }
@@ -6603,9 +6611,9 @@ CiftiMappableDataFile::helpMapFileLoadChartDataMatrixRGBA(int32_t& numberOfRowsO
             
             NodeAndVoxelColoring::colorScalarsWithPalette(nonConstMapFile->getFileFastStatistics(),
                                                           pcm,
-                                                          &columnData[0],
+                                                          columnDataPointer,
                                                           pcm,
-                                                          &columnData[0],
+                                                          columnDataPointer,
                                                           numberOfRowsOut,
                                                           &columnRGBA[0]);
         }
@@ -0,0 +1,98 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiRowPipeline.h"
+
+#include "CaretAssert.h"
+#include "CaretOMP.h"
+#include "CaretOMPExceptionHolder.h"
+#include "CiftiFile.h"
+#include "MultiDimIterator.h"
+
+using namespace caret;
+using namespace std;
+
+CiftiRowPipeline::CiftiRowPipeline(CiftiFile* output)
+{
+    CaretAssert(output != NULL);
+    m_output = output;
+}
+
+void CiftiRowPipeline::run(RowWorker& worker)
+{
+    const vector<int64_t>& outDims = m_output->getDimensions();
+    CaretAssert(outDims.size() > 0);
+    vector<vector<int64_t> > outIndices;
+    for (MultiDimIterator<int64_t> iter(vector<int64_t>(outDims.begin() + 1, outDims.end())); !iter.atEnd(); ++iter)
+    {// + 1 to exclude row dimension, because getRow/setRow
+        outIndices.push_back(*iter);
+    }
+    run(worker, outIndices);
+}
+
+void CiftiRowPipeline::run(RowWorker& worker, const vector<vector<int64_t> >& outIndices)
+{
+    const int64_t rowLength = m_output->getDimensions()[0];
+    const int64_t numJobs = (int64_t)outIndices.size();
+#ifdef CARET_OMP
+    const int numSlots = omp_get_max_threads();
+#else
+    const int numSlots = 1;
+#endif
+    worker.allocateSlots(numSlots);
+    vector<vector<float> > outRows(numSlots, vector<float>(rowLength));
+    CaretOMPExceptionHolder errors;
+    //dynamic schedule hands out rows in increasing order, and "ordered" makes each thread wait for the previous row to be written before writing
+    //its own, so while one thread is in setRow, the others are already reading and computing the following rows
+#pragma omp CARET_PARFOR schedule(dynamic) ordered
+    for (int64_t job = 0; job < numJobs; ++job)
+    {
+#ifdef CARET_OMP
+        const int slot = omp_get_thread_num();
+#else
+        const int slot = 0;
+#endif
+        CaretAssertVectorIndex(outRows, slot);
+        bool skip = errors.failed();
+        if (!skip)
+        {
+            try
+            {
+                worker.computeRow(outIndices[job], outRows[slot].data(), slot);
+            } catch (...) {
+                errors.capture();
+                skip = true;
+            }
+        }
+#pragma omp ordered
+        {
+            if (!skip && !errors.failed())//don't keep writing after an error
+            {
+                try
+                {
+                    m_output->setRow(outRows[slot].data(), outIndices[job]);
+                } catch (...) {
+                    errors.capture();
+                }
+            }
+        }
+    }
+    errors.rethrowIfFailed();
+}
@@ -0,0 +1,63 @@
+#ifndef __CIFTI_ROW_PIPELINE_H__
+#define __CIFTI_ROW_PIPELINE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+//NOTE: this is for the common "getRow -> compute -> setRow" loop over a cifti file, so that reading, computing and writing of different rows
+//      overlap, instead of the CPU waiting on the disk and vice versa.  Rows are handed to threads in order (so reads stay mostly sequential,
+//      which matters for readahead), and the output rows are written in order by whichever thread has the next one, while later rows are
+//      still being read and computed.  The number of rows in flight is bounded by the number of threads.
+//
+//NOTE: computeRow() is called from multiple threads at once, with a different outRow buffer and slot number on each concurrent call,
+//      so it must only use per-slot scratch memory, and read its inputs with CiftiFile::getRow (which is thread-safe).
+
+#include "stdint.h"
+#include <vector>
+
+namespace caret {
+
+    class CiftiFile;
+
+    class CiftiRowPipeline
+    {
+    public:
+        class RowWorker
+        {
+        public:
+            ///called before any computeRow, with the number of distinct slot values that will be used
+            virtual void allocateSlots(const int& numSlots) { }
+            ///read the needed input rows for output row outIndex, and compute it into outRow, using only scratch memory for this slot
+            virtual void computeRow(const std::vector<int64_t>& outIndex, float* outRow, const int& slot) = 0;
+            virtual ~RowWorker() { }
+        };
+        CiftiRowPipeline(CiftiFile* output);
+        ///process every row of the output file, in the same order as MultiDimIterator over the non-row dimensions
+        void run(RowWorker& worker);
+        ///process only the specified output rows, in the order given
+        void run(RowWorker& worker, const std::vector<std::vector<int64_t> >& outIndices);
+    private:
+        CiftiFile* m_output;
+        CiftiRowPipeline();
+    };
+
+}
+
+#endif //__CIFTI_ROW_PIPELINE_H__
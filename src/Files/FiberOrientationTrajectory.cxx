@@ -114,6 +114,24 @@ FiberOrientationTrajectory::addFiberFractionsForAveraging(const FiberFractions&
     }
 }
 
+/**
+ * Add fiber fractions with a total count of zero for averaging, same as
+ * calling addFiberFractionsForAveraging() with zeroed fiber fractions
+ * the given number of times.
+ *
+ * @param count
+ *    Number of zero fiber fractions that are added.
+ */
+void
+FiberOrientationTrajectory::addZeroFiberFractionsForAveraging(const int64_t count)
+{
+    const bool includeZeroTotalCountWhenAveraging = true;
+    
+    if (includeZeroTotalCountWhenAveraging) {
+        m_countForAveraging += count;
+    }
+}
+
 /**
  * Set a fiber fraction.
  *
@@ -41,6 +41,8 @@ namespace caret {
         
         void addFiberFractionsForAveraging(const FiberFractions& fiberFraction);
         
+        void addZeroFiberFractionsForAveraging(const int64_t count);
+        
         void setFiberFractions(const FiberFractions& fiberFraction);
         
         /**
@@ -0,0 +1,144 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "GeodesicAllPairsHelper.h"
+
+#include "CaretAssert.h"
+#include "GeodesicHelper.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int32_t MAX_BUCKETS = 1 << 12;//limits time spent stepping through empty buckets for meshes with a few tiny edges
+}
+
+GeodesicAllPairsHelper::GeodesicAllPairsHelper(const GeodesicHelperBase& baseIn, const bool& smooth)
+{
+    CaretPointer<Graph> myGraph(new Graph());
+    const int32_t numNodes = baseIn.numNodes;
+    myGraph->m_numNodes = numNodes;
+    myGraph->m_offsets.resize(numNodes + 1);
+    myGraph->m_offsets[0] = 0;
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        int64_t count = baseIn.neighOffsets[i + 1] - baseIn.neighOffsets[i];
+        if (smooth) count += baseIn.neigh2Offsets[i + 1] - baseIn.neigh2Offsets[i];
+        myGraph->m_offsets[i + 1] = myGraph->m_offsets[i] + count;
+    }
+    myGraph->m_neighbors.resize(myGraph->m_offsets[numNodes]);
+    myGraph->m_distances.resize(myGraph->m_offsets[numNodes]);
+    for (int32_t i = 0; i < numNodes; ++i)
+    {//merge the two neighbor lists of each node, so the search only has one loop
+        int64_t index = myGraph->m_offsets[i];
+        for (int64_t j = baseIn.neighOffsets[i]; j < baseIn.neighOffsets[i + 1]; ++j)
+        {
+            myGraph->m_neighbors[index] = baseIn.nodeNeighbors[j];
+            myGraph->m_distances[index] = baseIn.distances[j];
+            ++index;
+        }
+        if (smooth)
+        {
+            for (int64_t j = baseIn.neigh2Offsets[i]; j < baseIn.neigh2Offsets[i + 1]; ++j)
+            {
+                myGraph->m_neighbors[index] = baseIn.nodeNeighbors2[j];
+                myGraph->m_distances[index] = baseIn.distances2[j];
+                ++index;
+            }
+        }
+        CaretAssert(index == myGraph->m_offsets[i + 1]);
+    }
+    float minEdge = numeric_limits<float>::max(), maxEdge = 0.0f;
+    for (int64_t j = 0; j < myGraph->m_offsets[numNodes]; ++j)
+    {
+        minEdge = min(minEdge, myGraph->m_distances[j]);
+        maxEdge = max(maxEdge, myGraph->m_distances[j]);
+    }
+    float bucketWidth = max(minEdge, maxEdge / (MAX_BUCKETS - 2));
+    if (!(bucketWidth > 0.0f)) bucketWidth = 1.0f;//no edges, or all zero length
+    myGraph->m_bucketWidth = bucketWidth;
+    myGraph->m_numBuckets = (int32_t)(maxEdge / bucketWidth) + 3;//the farthest a relaxation can reach past the current bucket, plus some for rounding
+    m_graph = myGraph;
+    m_buckets.resize(m_graph->m_numBuckets);
+    m_dists.resize(numNodes);
+}
+
+GeodesicAllPairsHelper::GeodesicAllPairsHelper(const GeodesicAllPairsHelper& other)
+{
+    m_graph = other.m_graph;
+    m_buckets.resize(m_graph->m_numBuckets);
+    m_dists.resize(m_graph->m_numNodes);
+}
+
+void GeodesicAllPairsHelper::getGeoFromNode(const int32_t& root, float* valuesOut, const float& maxDist)
+{
+    const Graph& myGraph = *m_graph;
+    const int32_t numNodes = myGraph.m_numNodes;
+    CaretAssert(root >= 0 && root < numNodes);
+    const float infinity = numeric_limits<float>::infinity();
+    const float limit = (maxDist > 0.0f ? maxDist : infinity);
+    const int64_t* offsets = myGraph.m_offsets.data();
+    const int32_t* neighbors = myGraph.m_neighbors.data();
+    const float* edgeDists = myGraph.m_distances.data();
+    const float invWidth = 1.0f / myGraph.m_bucketWidth;
+    const int64_t numBuckets = myGraph.m_numBuckets;
+    float* dists = m_dists.data();
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        dists[i] = infinity;
+    }
+    dists[root] = 0.0f;
+    m_buckets[0].push_back(BucketEntry(root, 0.0f));
+    int64_t numPending = 1, current = 0;//current is the absolute bucket number, the array index is modulo numBuckets
+    while (numPending > 0)
+    {
+        vector<BucketEntry>& myBucket = m_buckets[current % numBuckets];
+        while (!myBucket.empty())//entries can get added to the current bucket while processing it
+        {
+            const BucketEntry myEntry = myBucket.back();
+            myBucket.pop_back();
+            --numPending;
+            if (myEntry.m_dist > dists[myEntry.m_node]) continue;//stale, it was improved after being added
+            const int64_t end = offsets[myEntry.m_node + 1];
+            for (int64_t j = offsets[myEntry.m_node]; j < end; ++j)
+            {
+                const int32_t neigh = neighbors[j];
+                const float newDist = myEntry.m_dist + edgeDists[j];
+                if (newDist < dists[neigh] && newDist <= limit)
+                {
+                    dists[neigh] = newDist;
+                    const int64_t bucket = max(current, (int64_t)(newDist * invWidth));//rounding can't put it behind the current bucket
+                    CaretAssert(bucket - current < numBuckets);
+                    m_buckets[bucket % numBuckets].push_back(BucketEntry(neigh, newDist));
+                    ++numPending;
+                }
+            }
+        }
+        ++current;
+    }
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        valuesOut[i] = (dists[i] == infinity ? -1.0f : dists[i]);
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef __GEODESIC_ALL_PAIRS_HELPER_H__
+#define __GEODESIC_ALL_PAIRS_HELPER_H__
+
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+//NOTE: this is for computing distances from a large number of vertices, such as every vertex of a surface.  It merges the two neighbor lists
+//      of a GeodesicHelperBase into a single compressed array (the triangle crawling neighbors are only included when smooth), and replaces the
+//      heap with a circular array of buckets of distance ranges.  When the bucket width is no more than the shortest edge, every vertex
+//      in the lowest bucket is final, so each vertex is expanded once.  If edges are so short that this would need too many buckets, the
+//      buckets get wider and improved vertices are simply expanded again, so the result is still exact, just slower.
+
+#include "CaretPointer.h"
+
+#include "stdint.h"
+#include <vector>
+
+namespace caret {
+
+    class GeodesicHelperBase;
+
+    class GeodesicAllPairsHelper
+    {
+        struct Graph
+        {
+            std::vector<int64_t> m_offsets;//neighbors of node i are m_neighbors[m_offsets[i]] to m_neighbors[m_offsets[i + 1] - 1]
+            std::vector<int32_t> m_neighbors;
+            std::vector<float> m_distances;
+            int32_t m_numNodes;
+            float m_bucketWidth;
+            int32_t m_numBuckets;
+        };
+        struct BucketEntry
+        {
+            int32_t m_node;
+            float m_dist;
+            BucketEntry(const int32_t& node, const float& dist) : m_node(node), m_dist(dist) { }
+        };
+        CaretPointer<const Graph> m_graph;//shared between copies, everything else is scratch space
+        std::vector<std::vector<BucketEntry> > m_buckets;
+        std::vector<float> m_dists;
+        GeodesicAllPairsHelper();
+        GeodesicAllPairsHelper& operator=(const GeodesicAllPairsHelper&);
+    public:
+        GeodesicAllPairsHelper(const GeodesicHelperBase& baseIn, const bool& smooth = true);
+        ///copies share the neighbor arrays, so make one copy per thread
+        GeodesicAllPairsHelper(const GeodesicAllPairsHelper& other);
+        int32_t getNumberOfNodes() const { return m_graph->m_numNodes; }
+        ///distances from root to every node, unreachable nodes and nodes beyond maxDist (if positive) get -1 - valuesOut must be allocated to the number of nodes
+        void getGeoFromNode(const int32_t& root, float* valuesOut, const float& maxDist = -1.0f);
+    };
+
+}
+
+#endif //__GEODESIC_ALL_PAIRS_HELPER_H__
@@ -27,7 +27,10 @@
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
 
+#include "CaretOMP.h"
+
 #include <cmath>
+#include <limits>
 #include <stdint.h>
 
 using namespace caret;
@@ -39,8 +42,6 @@ GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn, const float
     TopologyHelper topoHelpIn(topoBase);//leave this building one privately, to not introduce even worse dependencies regarding SurfaceFile
     m_corrAreaSmallestFactor = 1.0f;
     numNodes = surfaceIn->getNumberOfNodes();
-    nodeNeighbors.resize(numNodes);
-    distances.resize(numNodes);
     nodeCoords.resize(numNodes);
     vector<float> sqrtCorrAreas;//each edge has 2 vertices that influence it - assume that each influences a piece of the edge with a ratio depending on the square roots of the vertex areas
     vector<float> sqrtVertAreas;//we also assume isometric expansion at each vertex
@@ -54,49 +55,61 @@ GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn, const float
             sqrtVertAreas[i] = sqrt(sqrtVertAreas[i]);
         }
     }
-    Vector3D tempvec;
-    float tempf, abmag, efmag, cdmag;
-    double nodeSpacingAccum = 0.0f;//since we may be using corrected areas, find average node spacing manually
-    int32_t numEdges = 0;
-    bool firstCorrArea = true;//if all corrected vertex areas are significantly larger than 1, we can make A* faster by multiplying all euclidean distances by it, so find the actual smallest
+    neighOffsets.resize(numNodes + 1);
+    neighOffsets[0] = 0;
     for (int32_t i = 0; i < numNodes; ++i)
-    {//get neighbors
-        vector<int32_t>& neighbors = nodeNeighbors[i];
-        neighbors = topoHelpIn.getNodeNeighbors(i);
+    {
         nodeCoords[i] = surfaceIn->getCoordinate(i);
+        neighOffsets[i + 1] = neighOffsets[i] + topoHelpIn.getNodeNumberOfNeighbors(i);
+    }
+    nodeNeighbors.resize(neighOffsets[numNodes]);
+    distances.resize(neighOffsets[numNodes]);
+    //if all corrected vertex areas are significantly larger than 1, we can make A* faster by multiplying all euclidean distances by it, so find the actual smallest
+    const float NO_FACTOR = numeric_limits<float>::max();
+    vector<float> nodeSmallestFactor(numNodes, NO_FACTOR);
+    vector<double> nodeSpacingAccum(numNodes, 0.0);//since we may be using corrected areas, find average node spacing manually
+    vector<int32_t> nodeEdgeCount(numNodes, 0);
+#pragma omp CARET_PARFOR schedule(dynamic, 1024)
+    for (int32_t i = 0; i < numNodes; ++i)
+    {//get neighbors
+        const vector<int32_t>& neighbors = topoHelpIn.getNodeNeighbors(i);
         const Vector3D baseCoord = nodeCoords[i];
+        const int64_t base = neighOffsets[i];
         int numNeigh = (int)neighbors.size();
-        distances[i].resize(numNeigh);
         for (int32_t j = 0; j < numNeigh; ++j)
         {
-            Vector3D neighCoord = surfaceIn->getCoordinate(neighbors[j]);
-            tempvec = baseCoord - neighCoord;
-            distances[i][j] = tempvec.length();//precompute for speed in other calls
+            nodeNeighbors[base + j] = neighbors[j];
+            float& thisDist = distances[base + j];
+            thisDist = (baseCoord - nodeCoords[neighbors[j]]).length();//precompute for speed in other calls
             if (correctedAreas != NULL)
             {
                 float correctionFactor = (sqrtCorrAreas[i] + sqrtCorrAreas[neighbors[j]]) / (sqrtVertAreas[i] + sqrtVertAreas[neighbors[j]]);
-                if (firstCorrArea || correctionFactor < m_corrAreaSmallestFactor)
-                {
-                    m_corrAreaSmallestFactor = correctionFactor;//if this is zero anywhere, it just means that the euclidean part of the heuristic must be ignored (worst case, it does dijkstra)
-                    firstCorrArea = false;
-                }
-                distances[i][j] *= correctionFactor;
+                if (correctionFactor < nodeSmallestFactor[i]) nodeSmallestFactor[i] = correctionFactor;
+                thisDist *= correctionFactor;
             }
             if (i < neighbors[j])
             {
-                nodeSpacingAccum += distances[i][j];
-                ++numEdges;
+                nodeSpacingAccum[i] += thisDist;
+                ++nodeEdgeCount[i];
             }
         }//so few floating point operations, this should turn out symmetric
     }
-    m_avgNodeSpacing = nodeSpacingAccum / numEdges;
-    std::vector<int32_t> tempneigh2;
-    std::vector<float> tempdist2;
-    nodeNeighbors2.resize(numNodes);
-    distances2.resize(numNodes);
-    neighbors2PathInfo.resize(numNodes);
+    float smallestFactor = NO_FACTOR;
+    double spacingAccum = 0.0;
+    int32_t numEdges = 0;
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        if (nodeSmallestFactor[i] < smallestFactor) smallestFactor = nodeSmallestFactor[i];
+        spacingAccum += nodeSpacingAccum[i];
+        numEdges += nodeEdgeCount[i];
+    }
+    m_avgNodeSpacing = spacingAccum / numEdges;
     const vector<TopologyEdgeInfo>& myEdgeInfo = topoHelpIn.getEdgeInfo();
     CaretAssert(numEdges == (int32_t)myEdgeInfo.size());//SurfaceFile checks for triangles with duplicated nodes
+    vector<CrawlInfo> edgeCrawlInfo(numEdges);//crawl path across each edge, as seen from the far node
+    vector<float> edgeCrawlDist(numEdges, -1.0f);//negative means no valid crawl path for this edge
+    vector<float> edgeCrawlFactor(numEdges, NO_FACTOR);
+#pragma omp CARET_PARFOR schedule(dynamic, 1024)
     for (int i = 0; i < numEdges; ++i)
     {
         if (myEdgeInfo[i].numTiles < 2)
@@ -115,19 +128,13 @@ GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn, const float
         CrawlInfo tempInfo;
         tempInfo.edgeNodes[0] = neigh1Node;
         tempInfo.edgeNodes[1] = neigh2Node;
-        const int32_t num_reserve = 8;//uses 8 in case it is used on a mesh with haphazard topology
-        nodeNeighbors2[baseNode].reserve(num_reserve);//reserve should be fast if capacity is already num_reserve, and better than reallocating at 2 and 4, if vector allocation is naive doubling
-        nodeNeighbors2[farNode].reserve(num_reserve);//in the extremely rare case of a node with more than num_reserve neighbors, a second allocation plus copy isn't much of a cost
-        distances2[baseNode].reserve(num_reserve);
-        distances2[farNode].reserve(num_reserve);
-        neighbors2PathInfo[baseNode].reserve(num_reserve);
-        neighbors2PathInfo[farNode].reserve(num_reserve);
+        float tempf, abmag, efmag, cdmag;
         Vector3D abhat = (neigh2Coord - neigh1Coord).normal(&abmag);//a is neigh1, b is neigh2, b - a = (vector)ab
         Vector3D ac = farCoord - neigh1Coord;//c is farnode, c - a = (vector)ac
         Vector3D ad = abhat * abhat.dot(ac);//d is the point on the shared edge that farnode (c) is closest to
         Vector3D d = neigh1Coord + ad;//this way we can "unfold" the triangles by projecting the distance of cd, from point d, along the unit vector of the base node to closest point on shared edge
         Vector3D ea = neigh1Coord - baseCoord;//e is the base node, a - e = (vector)ea
-        tempvec = abhat * abhat.dot(ea);//find vector fa, f being the point on shared edge closest to e, the base node
+        Vector3D tempvec = abhat * abhat.dot(ea);//find vector fa, f being the point on shared edge closest to e, the base node
         Vector3D efhat = (ea - tempvec).normal(&efmag);//and subtract it to obtain only the perpendicular, normalize to get unit vector
         cdmag = (d - farCoord).length();//get the length from shared edge to far point
         Vector3D g = d + efhat * cdmag;//get point g, the unfolded position of farnode
@@ -139,28 +146,55 @@ GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn, const float
         if (tempf <= 0.0f || tempf >= abmag) continue;//tetralateral is concave or triangular (degenerate), our path is invalid or not shorter, so consider next edge
         tempInfo.edgeWeight = 1.0f - tempf / abmag;//if tempf is almost zero, then the weight of point a (neigh1) is almost 1
         tempf = eg.length();//this is our path length
-        tempInfo.pieceDists[1] = eh.length();//we currently add things to farNode's neighbor info before baseNode's
+        tempInfo.pieceDists[1] = eh.length();//pieces are in order from the far node
         if (correctedAreas != NULL)//apply area correction approximation
         {
             float correctionFactor = (sqrtCorrAreas[baseNode] + sqrtCorrAreas[farNode]) / (sqrtVertAreas[baseNode] + sqrtVertAreas[farNode]);
-            if (correctionFactor < m_corrAreaSmallestFactor)
-            {
-                m_corrAreaSmallestFactor = correctionFactor;//if this is zero anywhere, it just means that the euclidean part of the heuristic must be ignored (worst case, it does dijkstra)
-            }
+            edgeCrawlFactor[i] = correctionFactor;
             tempf *= correctionFactor;
             tempInfo.pieceDists[1] *= correctionFactor;
         }//for now, assume it only depends on the expansion of the endpoints, and affects each part equally
         tempInfo.pieceDists[0] = tempf - tempInfo.pieceDists[1];
-        nodeNeighbors2[farNode].push_back(baseNode);//record it at both ends, because we are looping through edges
-        distances2[farNode].push_back(tempf);
-        neighbors2PathInfo[farNode].push_back(tempInfo);
-        
+        edgeCrawlInfo[i] = tempInfo;
+        edgeCrawlDist[i] = tempf;
+    }
+    neigh2Offsets.resize(numNodes + 1, 0);//count first, then fill in edge order, so each node's list is in the same order as the edges
+    for (int i = 0; i < numEdges; ++i)
+    {
+        if (edgeCrawlDist[i] < 0.0f) continue;
+        ++neigh2Offsets[myEdgeInfo[i].tiles[0].node3 + 1];
+        ++neigh2Offsets[myEdgeInfo[i].tiles[1].node3 + 1];
+        if (edgeCrawlFactor[i] < smallestFactor) smallestFactor = edgeCrawlFactor[i];
+    }
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        neigh2Offsets[i + 1] += neigh2Offsets[i];
+    }
+    nodeNeighbors2.resize(neigh2Offsets[numNodes]);
+    distances2.resize(neigh2Offsets[numNodes]);
+    neighbors2PathInfo.resize(neigh2Offsets[numNodes]);
+    vector<int64_t> fillPos(neigh2Offsets.begin(), neigh2Offsets.end() - 1);
+    for (int i = 0; i < numEdges; ++i)
+    {
+        if (edgeCrawlDist[i] < 0.0f) continue;
+        int32_t baseNode = myEdgeInfo[i].tiles[0].node3;
+        int32_t farNode = myEdgeInfo[i].tiles[1].node3;
+        CrawlInfo tempInfo = edgeCrawlInfo[i];
+        int64_t index = fillPos[farNode]++;//record it at both ends, because we are looping through edges
+        nodeNeighbors2[index] = baseNode;
+        distances2[index] = edgeCrawlDist[i];
+        neighbors2PathInfo[index] = tempInfo;
         float tempf2 = tempInfo.pieceDists[0];//swap the piece distances around for the baseNode info
         tempInfo.pieceDists[0] = tempInfo.pieceDists[1];
         tempInfo.pieceDists[1] = tempf2;
-        nodeNeighbors2[baseNode].push_back(farNode);
-        distances2[baseNode].push_back(tempf);
-        neighbors2PathInfo[baseNode].push_back(tempInfo);
+        index = fillPos[baseNode]++;
+        nodeNeighbors2[index] = farNode;
+        distances2[index] = edgeCrawlDist[i];
+        neighbors2PathInfo[index] = tempInfo;
+    }
+    if (smallestFactor != NO_FACTOR)
+    {
+        m_corrAreaSmallestFactor = smallestFactor;//if this is zero anywhere, it just means that the euclidean part of the heuristic must be ignored (worst case, it does dijkstra)
     }
 }
 
@@ -171,6 +205,8 @@ GeodesicHelper::GeodesicHelper(const CaretPointer<const GeodesicHelperBase>& bas
     numNodes = m_myBase->numNodes;
     m_avgNodeSpacing = m_myBase->m_avgNodeSpacing;
     m_corrAreaSmallestFactor = m_myBase->m_corrAreaSmallestFactor;
+    neighOffsets = m_myBase->neighOffsets.data();
+    neigh2Offsets = m_myBase->neigh2Offsets.data();
     distances = m_myBase->distances.data();
     distances2 = m_myBase->distances2.data();
     nodeNeighbors = m_myBase->nodeNeighbors.data();
@@ -218,6 +254,7 @@ void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, std::vect
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     marked[root] |= 4;
@@ -232,14 +269,15 @@ void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, std::vect
         nodes.push_back(whichnode);
         dists.push_back(output[whichnode]);
         marked[whichnode] |= 1;//anything pulled from heap will already be marked as having a valid value (flag 4)
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];//isn't precomputation wonderful
+                tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                 if (tempf <= maxdist)
                 {//keep it off the heap if it is too far
                     if (!(marked[whichneigh] & 4))
@@ -259,14 +297,15 @@ void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, std::vect
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];
+                    tempf = output[whichnode] + neighDists[j];
                     if (tempf <= maxdist)
                     {//keep it off the heap if it is too far
                         if (!(marked[whichneigh] & 4))
@@ -296,6 +335,7 @@ void GeodesicHelper::dijkstra(const int32_t root, bool smooth)
 {//straightforward dijkstra, no cutoffs, full surface
     int32_t i, j, whichnode, whichneigh, numNeigh;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     parent[root] = -1;//idiom for end of path
@@ -305,14 +345,15 @@ void GeodesicHelper::dijkstra(const int32_t root, bool smooth)
     {
         whichnode = m_active.pop();
         marked[whichnode] |= 1;
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];
+                tempf = output[whichnode] + neighDists[j];
                 if (!(marked[whichneigh] & 4))
                 {
                     marked[whichneigh] |= 4;
@@ -328,14 +369,15 @@ void GeodesicHelper::dijkstra(const int32_t root, bool smooth)
         }
         if (smooth)
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];
+                    tempf = output[whichnode] + neighDists[j];
                     if (!(marked[whichneigh] & 4))
                     {
                         marked[whichneigh] |= 4;
@@ -427,6 +469,7 @@ void GeodesicHelper::dijkstra(const int32_t root, const std::vector<int32_t>& in
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0, remain = 0;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     j = interested.size();
     for (i = 0; i < j; ++i)
@@ -456,14 +499,15 @@ void GeodesicHelper::dijkstra(const int32_t root, const std::vector<int32_t>& in
             --remain;
         }
         marked[whichnode] |= 1;//anything pulled from heap will already be marked as having a valid value (flag 4), so already in changed list
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];//isn't precomputation wonderful
+                tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                 if (!(marked[whichneigh] & 4))
                 {
                     if (!marked[whichneigh])
@@ -483,14 +527,15 @@ void GeodesicHelper::dijkstra(const int32_t root, const std::vector<int32_t>& in
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];
+                    tempf = output[whichnode] + neighDists[j];
                     if (!(marked[whichneigh] & 4))
                     {
                         if (!marked[whichneigh])
@@ -520,6 +565,7 @@ int32_t GeodesicHelper::dijkstra(const vector<int32_t>& startList, const vector<
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0, ret = -1;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     m_active.clear();
     j = (int32_t)startList.size();
@@ -552,14 +598,15 @@ int32_t GeodesicHelper::dijkstra(const vector<int32_t>& startList, const vector<
             break;
         }
         marked[whichnode] |= 1;//anything pulled from heap will already be marked as having a valid value (flag 4), so already in changed list
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];
+                tempf = output[whichnode] + neighDists[j];
                 if (tempf <= maxDist)
                 {
                     if (!(marked[whichneigh] & 4))
@@ -582,14 +629,15 @@ int32_t GeodesicHelper::dijkstra(const vector<int32_t>& startList, const vector<
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];
+                    tempf = output[whichnode] + neighDists[j];
                     if (tempf <= maxDist)
                     {
                         if (!(marked[whichneigh] & 4))
@@ -623,6 +671,7 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, const floa
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0, ret = -1;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     changed[numChanged++] = root;
@@ -640,14 +689,15 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, const floa
             break;
         }
         marked[whichnode] |= 1;//anything pulled from heap will already be marked as having a valid value (flag 4), so already in changed list
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];//isn't precomputation wonderful
+                tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                 if (tempf <= maxdist)
                 {
                     if (!(marked[whichneigh] & 4))
@@ -670,14 +720,15 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, const floa
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];//isn't precomputation wonderful
+                    tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                     if (tempf <= maxdist)
                     {
                         if (!(marked[whichneigh] & 4))
@@ -711,6 +762,7 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, bool smoot
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0, ret = -1;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     changed[numChanged++] = root;
@@ -727,14 +779,15 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, bool smoot
             break;
         }
         marked[whichnode] |= 1;//anything pulled from heap will already be marked as having a valid value (flag 4), so already in changed list
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];//isn't precomputation wonderful
+                tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                 if (!(marked[whichneigh] & 4))
                 {
                     parent[whichneigh] = whichnode;
@@ -754,14 +807,15 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, bool smoot
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];//isn't precomputation wonderful
+                    tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                     if (!(marked[whichneigh] & 4))
                     {
                         parent[whichneigh] = whichnode;
@@ -792,6 +846,7 @@ void GeodesicHelper::aStar(const int32_t root, const int32_t endpoint, bool smoo
 {
     int32_t whichnode, whichneigh, numNeigh, numChanged = 0;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     changed[numChanged++] = root;
@@ -806,14 +861,15 @@ void GeodesicHelper::aStar(const int32_t root, const int32_t endpoint, bool smoo
         whichnode = m_active.pop();//we use a modifiable heap, so we don't need to check for duplicates
         marked[whichnode] |= 1;//frozen - will already be in changed list, due to being in heap
         if (whichnode == endpoint) break;
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (int32_t j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];
+                tempf = output[whichnode] + neighDists[j];
                 if (!(marked[whichneigh] & 4))
                 {
                     heurVal[whichneigh] = m_corrAreaSmallestFactor * (nodeCoords[whichneigh] - nodeCoords[endpoint]).length();
@@ -831,14 +887,15 @@ void GeodesicHelper::aStar(const int32_t root, const int32_t endpoint, bool smoo
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (int32_t j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];
+                    tempf = output[whichnode] + neighDists[j];
                     if (!(marked[whichneigh] & 4))
                     {
                         heurVal[whichneigh] = m_corrAreaSmallestFactor * (nodeCoords[whichneigh] - nodeCoords[endpoint]).length();
@@ -894,6 +951,7 @@ void GeodesicHelper::aStarLine(const int32_t& root, const int32_t& endpoint, con
     int32_t whichnode, whichneigh, numNeigh, numChanged = 0;
     float penaltyScale = 0.5f / m_avgNodeSpacing;//to prevent change in scale from changing the optimal path - 0.5f is ostensibly for averaging between endpoints, but is largely arbitrary
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     changed[numChanged++] = root;
@@ -908,14 +966,15 @@ void GeodesicHelper::aStarLine(const int32_t& root, const int32_t& endpoint, con
         whichnode = m_active.pop();//we use a modifiable heap, so we don't need to check for duplicates
         marked[whichnode] |= 1;//frozen - will already be in changed list, due to being in heap
         if (whichnode == endpoint) break;
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (int32_t j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j] + penaltyScale * distances[whichnode][j] * (linePenalty(nodeCoords[whichnode], linep1, linep2, segment) + linePenalty(nodeCoords[whichneigh], linep1, linep2, segment));
+                tempf = output[whichnode] + neighDists[j] + penaltyScale * neighDists[j] * (linePenalty(nodeCoords[whichnode], linep1, linep2, segment) + linePenalty(nodeCoords[whichneigh], linep1, linep2, segment));
                 if (!(marked[whichneigh] & 4))
                 {
                     remainEucl = (nodeCoords[whichneigh] - nodeCoords[endpoint]).length();
@@ -943,6 +1002,7 @@ void GeodesicHelper::aStarData(const int32_t& root, const int32_t& endpoint, con
 {//NOTE: for consistent behavior, data must not contain negatives (or anything non-numeric)
     int32_t whichnode, whichneigh, numNeigh, numChanged = 0;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     changed[numChanged++] = root;
@@ -956,14 +1016,15 @@ void GeodesicHelper::aStarData(const int32_t& root, const int32_t& endpoint, con
         whichnode = m_active.pop();//we use a modifiable heap, so we don't need to check for duplicates
         marked[whichnode] |= 1;//frozen - will already be in changed list, due to being in heap
         if (whichnode == endpoint) break;
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (int32_t j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if ((roiData == NULL || roiData[whichneigh] > 0.0f) && !(marked[whichneigh] & 1))
             {//skip floating point math if frozen or outside roi
-                tempf = output[whichnode] + distances[whichnode][j] * (1.0f + followStrength * (data[whichnode] + data[whichneigh]));//integrate 1 + strength * value to get distance plus path-integrated data
+                tempf = output[whichnode] + neighDists[j] * (1.0f + followStrength * (data[whichnode] + data[whichneigh]));//integrate 1 + strength * value to get distance plus path-integrated data
                 if (!(marked[whichneigh] & 4))
                 {
                     heurVal[whichneigh] = m_corrAreaSmallestFactor * (nodeCoords[whichneigh] - nodeCoords[endpoint]).length();
@@ -981,16 +1042,17 @@ void GeodesicHelper::aStarData(const int32_t& root, const int32_t& endpoint, con
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
-            const GeodesicHelperBase::CrawlInfo* pathInfo = neighbors2PathInfo[whichnode].data();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
+            const GeodesicHelperBase::CrawlInfo* pathInfo = neighbors2PathInfo + neigh2Offsets[whichnode];
             for (int32_t j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if ((roiData == NULL || roiData[whichneigh] > 0.0f) && !(marked[whichneigh] & 1))
                 {//skip floating point math if frozen or outside roi
-                    tempf = output[whichnode] + distances2[whichnode][j] + followStrength * (data[whichnode] * pathInfo[j].pieceDists[0] + data[whichneigh] * pathInfo[j].pieceDists[1]
-                                + distances2[whichnode][j] * (data[pathInfo[j].edgeNodes[0]] * pathInfo[j].edgeWeight + data[pathInfo[j].edgeNodes[1]] * (1.0f - pathInfo[j].edgeWeight)));
+                    tempf = output[whichnode] + neighDists[j] + followStrength * (data[whichnode] * pathInfo[j].pieceDists[0] + data[whichneigh] * pathInfo[j].pieceDists[1]
+                                + neighDists[j] * (data[pathInfo[j].edgeNodes[0]] * pathInfo[j].edgeWeight + data[pathInfo[j].edgeNodes[1]] * (1.0f - pathInfo[j].edgeWeight)));
                     if (!(marked[whichneigh] & 4))
                     {
                         heurVal[whichneigh] = m_corrAreaSmallestFactor * (nodeCoords[whichneigh] - nodeCoords[endpoint]).length();
@@ -49,9 +49,12 @@ namespace caret {
         GeodesicHelperBase();//can't construct without arguments
         GeodesicHelperBase& operator=(const GeodesicHelperBase& right);//can't assign
         GeodesicHelperBase(const GeodesicHelperBase& right);//can't use copy constructor
-        std::vector<std::vector<float> > distances, distances2;
-        std::vector<std::vector<int32_t> > nodeNeighbors, nodeNeighbors2;
-        std::vector<std::vector<CrawlInfo> > neighbors2PathInfo;
+        //neighbors are stored compressed: the neighbors of node i are nodeNeighbors[neighOffsets[i]] through nodeNeighbors[neighOffsets[i + 1] - 1],
+        //with the matching distances at the same indices, and the same for the crawl neighbors with neigh2Offsets
+        std::vector<int64_t> neighOffsets, neigh2Offsets;
+        std::vector<int32_t> nodeNeighbors, nodeNeighbors2;
+        std::vector<float> distances, distances2;
+        std::vector<CrawlInfo> neighbors2PathInfo;//matched with nodeNeighbors2
         std::vector<Vector3D> nodeCoords;//for line-following and A*
         int32_t numNodes;
         float m_avgNodeSpacing;//to use for balancing line following penalty
@@ -59,6 +62,7 @@ namespace caret {
     public:
         explicit GeodesicHelperBase(const SurfaceFile* surfaceIn, const float* correctedAreas = NULL);//NOTE: this is only an APPROXIMATE correction, use the real surface whenever possible
         friend class GeodesicHelper;//let it grab the private variables it needs
+        friend class GeodesicAllPairsHelper;
     };
 
     class GeodesicHelper
@@ -66,9 +70,10 @@ namespace caret {
         CaretPointer<const GeodesicHelperBase> m_myBase;//mostly just for automatic memory management
         CaretMutex inUse;//could add a function and a locker pointer to be able to lock to thread once, then call repeatedly without locking, if mutex overhead is actually a factor
         CaretMinHeap<int32_t, float> m_active;//save and reuse the allocated space
-        const std::vector<float>* distances, *distances2;
-        const std::vector<int32_t>* nodeNeighbors, *nodeNeighbors2;
-        const std::vector<GeodesicHelperBase::CrawlInfo>* neighbors2PathInfo;
+        const int64_t* neighOffsets, *neigh2Offsets;
+        const float* distances, *distances2;
+        const int32_t* nodeNeighbors, *nodeNeighbors2;
+        const GeodesicHelperBase::CrawlInfo* neighbors2PathInfo;
         const Vector3D* nodeCoords;
         float* output;
         int32_t* parent;
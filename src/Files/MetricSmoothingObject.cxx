@@ -22,16 +22,27 @@
 
 #include "CaretAssert.h"
 #include "CaretException.h"
+#include "CaretLogger.h"
 #include "SurfaceFile.h"
 #include "MetricFile.h"
 #include "GeodesicHelper.h"
 #include "TopologyHelper.h"
 #include "CaretOMP.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QFile>
+
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 using namespace std;
 using namespace caret;
 
+const int32_t MetricSmoothingObject::FRAME_BLOCK_SIZE;
+AString MetricSmoothingObject::s_weightCacheDirectory;
+
 MetricSmoothingObject::MetricSmoothingObject(const SurfaceFile* mySurf, const float& kernel, const MetricFile* myRoi, Method myMethod, const float* nodeAreas)
 {
     CaretAssert(mySurf != NULL);
@@ -39,14 +50,176 @@ MetricSmoothingObject::MetricSmoothingObject(const SurfaceFile* mySurf, const fl
     {
         throw CaretException("roi number of nodes doesn't match the surface");
     }
+    AString cacheFileName;
+    if (!s_weightCacheDirectory.isEmpty())
+    {
+        cacheFileName = s_weightCacheDirectory + "/" + getCacheFileName(mySurf, kernel, myRoi, myMethod, nodeAreas);
+        if (readWeightCache(cacheFileName, mySurf->getNumberOfNodes())) return;
+    }
     precomputeWeights(mySurf, kernel, myRoi, myMethod, nodeAreas);
+    convertToCSR();
+    if (!cacheFileName.isEmpty())
+    {
+        writeWeightCache(cacheFileName);
+    }
+}
+
+void MetricSmoothingObject::convertToCSR()
+{
+    m_numNodes = (int32_t)m_weightLists.size();
+    m_csrOffsets.resize(m_numNodes + 1);
+    m_weightSums.resize(m_numNodes);
+    m_csrOffsets[0] = 0;
+    for (int32_t i = 0; i < m_numNodes; ++i)
+    {
+        CaretAssert(m_weightLists[i].m_nodes.size() == m_weightLists[i].m_weights.size());
+        m_csrOffsets[i + 1] = m_csrOffsets[i] + m_weightLists[i].m_nodes.size();
+        m_weightSums[i] = m_weightLists[i].m_weightSum;
+    }
+    m_csrNodes.resize(m_csrOffsets[m_numNodes]);
+    m_csrWeights.resize(m_csrOffsets[m_numNodes]);
+    for (int32_t i = 0; i < m_numNodes; ++i)
+    {
+        std::copy(m_weightLists[i].m_nodes.begin(), m_weightLists[i].m_nodes.end(), m_csrNodes.begin() + m_csrOffsets[i]);
+        std::copy(m_weightLists[i].m_weights.begin(), m_weightLists[i].m_weights.end(), m_csrWeights.begin() + m_csrOffsets[i]);
+    }
+    vector<WeightList>().swap(m_weightLists);//release the memory, the lists are only used while precomputing
+    m_offsetsPointer = m_csrOffsets.data();
+    m_nodesPointer = m_csrNodes.data();
+    m_weightsPointer = m_csrWeights.data();
+    m_weightSumsPointer = m_weightSums.data();
+}
+
+namespace
+{
+    const char CACHE_MAGIC[8] = { 'W', 'B', 'S', 'M', 'O', 'O', 'T', 'H' };
+    const int32_t CACHE_VERSION = 1;
+    struct CacheHeader
+    {//all arrays after the header are 4 or 8 byte aligned, offsets first
+        char m_magic[8];
+        int32_t m_version;
+        int32_t m_byteOrder;//1 in native order, so a file from a machine with different endianness doesn't match
+        int32_t m_numNodes;
+        int32_t m_padding;
+        int64_t m_numWeights;
+    };
+}
+
+AString MetricSmoothingObject::getCacheFileName(const SurfaceFile* mySurf, const float& myKernel, const MetricFile* theRoi, const Method& myMethod, const float* nodeAreas) const
+{
+    QCryptographicHash myHash(QCryptographicHash::Sha1);
+    int32_t numNodes = mySurf->getNumberOfNodes(), numTris = mySurf->getNumberOfTriangles();
+    int32_t version = CACHE_VERSION, methodInt = (int32_t)myMethod;
+    myHash.addData((const char*)&version, sizeof(int32_t));
+    myHash.addData((const char*)&numNodes, sizeof(int32_t));
+    myHash.addData((const char*)&numTris, sizeof(int32_t));
+    myHash.addData((const char*)&methodInt, sizeof(int32_t));
+    myHash.addData((const char*)&myKernel, sizeof(float));
+    myHash.addData((const char*)mySurf->getCoordinateData(), numNodes * 3 * sizeof(float));
+    if (numTris > 0) myHash.addData((const char*)mySurf->getTriangle(0), numTris * 3 * sizeof(int32_t));
+    if (nodeAreas != NULL)
+    {//without corrected areas, they are computed from the surface, which is already in the hash
+        myHash.addData("areas", 5);
+        myHash.addData((const char*)nodeAreas, numNodes * sizeof(float));
+    }
+    if (theRoi != NULL)
+    {
+        myHash.addData("roi", 3);
+        myHash.addData((const char*)theRoi->getValuePointerForColumn(0), numNodes * sizeof(float));
+    }
+    return "wb_smoothing_weights_" + AString(myHash.result().toHex()) + ".bin";
+}
+
+bool MetricSmoothingObject::readWeightCache(const AString& filename, const int32_t& numNodes)
+{
+    if (!QFile::exists(filename)) return false;
+    try
+    {
+        m_cacheFile.openMapped(filename);
+        const char* mapped = m_cacheFile.getMappedData();
+        const int64_t fileSize = m_cacheFile.size();
+        if (mapped == NULL || fileSize < (int64_t)sizeof(CacheHeader))
+        {
+            throw CaretException("file could not be mapped, or is too small");
+        }
+        CacheHeader myHeader;
+        memcpy(&myHeader, mapped, sizeof(CacheHeader));
+        if (memcmp(myHeader.m_magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || myHeader.m_version != CACHE_VERSION || myHeader.m_byteOrder != 1 ||
+            myHeader.m_numNodes != numNodes || myHeader.m_numWeights < 0)
+        {
+            throw CaretException("file header doesn't match");
+        }
+        const int64_t numWeights = myHeader.m_numWeights;
+        const int64_t expectedSize = sizeof(CacheHeader) + sizeof(int64_t) * (numNodes + 1) + sizeof(float) * numNodes + (sizeof(int32_t) + sizeof(float)) * numWeights;
+        if (fileSize != expectedSize)
+        {
+            throw CaretException("file is the wrong size");
+        }
+        const int64_t* offsets = (const int64_t*)(mapped + sizeof(CacheHeader));
+        const float* weightSums = (const float*)(offsets + numNodes + 1);
+        const int32_t* nodes = (const int32_t*)(weightSums + numNodes);
+        const float* weights = (const float*)(nodes + numWeights);
+        if (offsets[0] != 0 || offsets[numNodes] != numWeights)
+        {
+            throw CaretException("file contents are inconsistent");
+        }
+        for (int32_t i = 0; i < numNodes; ++i)
+        {//make sure a damaged file can't make us read out of bounds
+            if (offsets[i + 1] < offsets[i]) throw CaretException("file contents are inconsistent");
+        }
+        for (int64_t j = 0; j < numWeights; ++j)
+        {
+            if (nodes[j] < 0 || nodes[j] >= numNodes) throw CaretException("file contents are inconsistent");
+        }
+        m_numNodes = numNodes;
+        m_offsetsPointer = offsets;
+        m_weightSumsPointer = weightSums;
+        m_nodesPointer = nodes;
+        m_weightsPointer = weights;
+    } catch (CaretException& e) {
+        CaretLogWarning("ignoring smoothing weights cache file '" + filename + "': " + e.whatString());
+        m_cacheFile.close();
+        return false;
+    }
+    CaretLogFine("using smoothing weights from cache file '" + filename + "'");
+    return true;
+}
+
+void MetricSmoothingObject::writeWeightCache(const AString& filename) const
+{//write to a temporary name and then rename, so that other processes never see a partial file
+    const AString tempName = filename + "." + AString::number(QCoreApplication::applicationPid()) + ".tmp";
+    try
+    {
+        CacheHeader myHeader;
+        memcpy(myHeader.m_magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        myHeader.m_version = CACHE_VERSION;
+        myHeader.m_byteOrder = 1;
+        myHeader.m_numNodes = m_numNodes;
+        myHeader.m_padding = 0;
+        myHeader.m_numWeights = m_csrOffsets[m_numNodes];
+        CaretBinaryFile outFile(tempName, CaretBinaryFile::WRITE_TRUNCATE);
+        outFile.write(&myHeader, sizeof(CacheHeader));
+        outFile.write(m_csrOffsets.data(), sizeof(int64_t) * m_csrOffsets.size());
+        outFile.write(m_weightSums.data(), sizeof(float) * m_weightSums.size());
+        outFile.write(m_csrNodes.data(), sizeof(int32_t) * m_csrNodes.size());
+        outFile.write(m_csrWeights.data(), sizeof(float) * m_csrWeights.size());
+        outFile.close();
+    } catch (CaretException& e) {
+        CaretLogWarning("failed to write smoothing weights cache file '" + tempName + "': " + e.whatString());
+        QFile::remove(tempName);
+        return;
+    }
+    if (!QFile::rename(tempName, filename))
+    {//another process may have written it first, which is fine
+        QFile::remove(tempName);
+    }
 }
 
 void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* columnOut, const MetricFile* roi, const bool& fixZeros) const
 {
     CaretAssert(metricIn != NULL);
     CaretAssert(columnOut != NULL);
-    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    if (metricIn->getNumberOfNodes() != m_numNodes)
     {
         throw CaretException("metric does not match surface number of nodes");
     }
@@ -54,36 +227,37 @@ void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int&
     {
         throw CaretException("invalid column number");
     }
-    if (columnOut->getNumberOfNodes() != (int32_t)m_weightLists.size() || columnOut->getNumberOfColumns() != 1)
+    if (columnOut->getNumberOfNodes() != m_numNodes || columnOut->getNumberOfColumns() != 1)
     {
-        columnOut->setNumberOfNodesAndColumns(m_weightLists.size(), 1);
+        columnOut->setNumberOfNodesAndColumns(m_numNodes, 1);
     }
-    vector<float> scratch(metricIn->getNumberOfNodes());
+    vector<float> scratch(m_numNodes);
+    const float* roiColumn = NULL;
     if (roi != NULL)
     {
-        if (roi->getNumberOfNodes() != (int32_t)m_weightLists.size())
+        if (roi->getNumberOfNodes() != m_numNodes)
         {
             throw CaretException("roi does not match surface number of nodes");
         }
-        smoothColumnInternal(scratch.data(), metricIn, whichColumn, columnOut, 0, roi, 0, fixZeros);
-    } else {
-        smoothColumnInternal(scratch.data(), metricIn, whichColumn, columnOut, 0, fixZeros);
+        roiColumn = roi->getValuePointerForColumn(0);
     }
+    smoothFrames(metricIn->getValuePointerForColumn(whichColumn), scratch.data(), 1, roiColumn, fixZeros);
+    columnOut->setValuesForColumn(0, scratch.data());
 }
 
 void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi, const int& whichRoiColumn, const bool& fixZeros) const
 {
     CaretAssert(metricIn != NULL);
     CaretAssert(metricOut != NULL);
-    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    if (metricIn->getNumberOfNodes() != m_numNodes)
     {
         throw CaretException("metric does not match surface number of nodes");
     }
-    if (metricOut->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    if (metricOut->getNumberOfNodes() != m_numNodes)
     {
         throw CaretException("output metric does not match surface number of nodes");
     }
-    if (roi != NULL && (roi->getNumberOfNodes() != (int32_t)m_weightLists.size()))
+    if (roi != NULL && (roi->getNumberOfNodes() != m_numNodes))
     {
         throw CaretException("roi does not match surface number of nodes");
     }
@@ -99,13 +273,11 @@ void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int&
     {
         throw CaretException("invalid input column number");
     }
-    vector<float> scratch(metricIn->getNumberOfNodes());
-    if (roi != NULL)
-    {
-        smoothColumnInternal(scratch.data(), metricIn, whichColumn, metricOut, whichOutColumn, roi, whichRoiColumn, fixZeros);
-    } else {
-        smoothColumnInternal(scratch.data(), metricIn, whichColumn, metricOut, whichOutColumn, fixZeros);
-    }
+    vector<float> scratch(m_numNodes);
+    const float* roiColumn = NULL;
+    if (roi != NULL) roiColumn = roi->getValuePointerForColumn(whichRoiColumn);
+    smoothFrames(metricIn->getValuePointerForColumn(whichColumn), scratch.data(), 1, roiColumn, fixZeros);
+    metricOut->setValuesForColumn(whichOutColumn, scratch.data());
 }
 
 void MetricSmoothingObject::smoothMetric(const MetricFile* metricIn, MetricFile* metricOut, const MetricFile* roi, const bool& fixZeros) const
@@ -113,168 +285,131 @@ void MetricSmoothingObject::smoothMetric(const MetricFile* metricIn, MetricFile*
     CaretAssert(metricIn != NULL);
     CaretAssert(metricOut != NULL);
     int32_t numCols = metricIn->getNumberOfColumns();
-    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    if (metricIn->getNumberOfNodes() != m_numNodes)
     {
         throw CaretException("metric does not match surface number of nodes");
     }
-    if (metricOut->getNumberOfNodes() != (int32_t)m_weightLists.size() || metricOut->getNumberOfColumns() != numCols)
+    if (metricOut->getNumberOfNodes() != m_numNodes || metricOut->getNumberOfColumns() != numCols)
     {
-        metricOut->setNumberOfNodesAndColumns(m_weightLists.size(), numCols);
+        metricOut->setNumberOfNodesAndColumns(m_numNodes, numCols);
     }
-    vector<float> scratch(metricIn->getNumberOfNodes());
+    const float* roiColumn = NULL;
     if (roi != NULL)
     {
-        if (roi->getNumberOfNodes() != (int32_t)m_weightLists.size())
+        if (roi->getNumberOfNodes() != m_numNodes)
         {
             throw CaretException("roi does not match surface number of nodes");
         }
-        for (int32_t i = 0; i < numCols; ++i)
-        {
-            smoothColumnInternal(scratch.data(), metricIn, i, metricOut, i, roi, 0, fixZeros);
-        }
-    } else {
-        for (int32_t i = 0; i < numCols; ++i)
+        roiColumn = roi->getValuePointerForColumn(0);
+    }
+    //smooth blocks of columns at once, so that each weight is loaded once per block rather than once per column
+    const int32_t blockSize = min(numCols, FRAME_BLOCK_SIZE);
+    vector<float> framesIn((int64_t)m_numNodes * blockSize), framesOut((int64_t)m_numNodes * blockSize), scratch(m_numNodes);
+    vector<const float*> columnPointers(blockSize);
+    for (int32_t blockStart = 0; blockStart < numCols; blockStart += blockSize)
+    {
+        const int32_t thisBlock = min(blockSize, numCols - blockStart);
+        for (int32_t b = 0; b < thisBlock; ++b)
         {
-            smoothColumnInternal(scratch.data(), metricIn, i, metricOut, i, fixZeros);
+            columnPointers[b] = metricIn->getValuePointerForColumn(blockStart + b);
         }
-    }
-}
-
-void MetricSmoothingObject::smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const bool& fixZeros) const
-{
-    CaretAssert(metricIn != NULL);//asserts only, and only basic checks, these functions are private
-    CaretAssert(metricOut != NULL);
-    CaretAssert(scratch != NULL);
-    CaretAssert(whichColumn >= 0 && whichColumn < metricIn->getNumberOfColumns());
-    CaretAssert(whichOutColumn >= 0 && whichOutColumn < metricOut->getNumberOfColumns());
-    const float* myColumn = metricIn->getValuePointerForColumn(whichColumn);
-    int32_t numNodes = metricIn->getNumberOfNodes();
-    if (fixZeros)//special case early to keep branching down
-    {
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int32_t i = 0; i < numNodes; ++i)
+#pragma omp CARET_PARFOR schedule(static)
+        for (int32_t i = 0; i < m_numNodes; ++i)
         {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (myWeightRef.m_weightSum != 0.0f)//skip nodes with no neighbors quickly
+            float* nodeFrames = framesIn.data() + (int64_t)i * thisBlock;
+            for (int32_t b = 0; b < thisBlock; ++b)
             {
-                float sum = 0.0f, weightsum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
-                {
-                    float value = myColumn[myWeightRef.m_nodes[j]];
-                    if (value != 0.0f)
-                    {
-                        float weight = myWeightRef.m_weights[j];
-                        sum += weight * value;
-                        weightsum += weight;
-                    }
-                }
-                if (weightsum != 0.0f)
-                {
-                    scratch[i] = sum / weightsum;
-                } else {
-                    scratch[i] = 0.0f;
-                }
-            } else {
-                scratch[i] = 0.0f;//but we do need to zero what we skip, so a list of nodes to check may not help
+                nodeFrames[b] = columnPointers[b][i];
             }
         }
-    } else {
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int32_t i = 0; i < numNodes; ++i)
+        smoothFrames(framesIn.data(), framesOut.data(), thisBlock, roiColumn, fixZeros);
+        for (int32_t b = 0; b < thisBlock; ++b)
         {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (myWeightRef.m_weightSum != 0.0f)
+            for (int32_t i = 0; i < m_numNodes; ++i)
             {
-                float sum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
-                {
-                    sum += myWeightRef.m_weights[j] * myColumn[myWeightRef.m_nodes[j]];
-                }
-                scratch[i] = sum / myWeightRef.m_weightSum;
-            } else {
-                scratch[i] = 0.0f;
+                scratch[i] = framesOut[(int64_t)i * thisBlock + b];
             }
+            metricOut->setValuesForColumn(blockStart + b, scratch.data());
         }
     }
-    metricOut->setValuesForColumn(whichOutColumn, scratch);
 }
 
-void MetricSmoothingObject::smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi, const int& whichRoiColumn, const bool& fixZeros) const
+void MetricSmoothingObject::smoothFrames(const float* framesIn, float* framesOut, const int32_t& numFrames, const float* roiColumn, const bool& fixZeros) const
 {
-    CaretAssert(metricIn != NULL);//asserts only, and only basic checks, these functions are private
-    CaretAssert(metricOut != NULL);
-    CaretAssert(scratch != NULL);
-    CaretAssert(roi != NULL);
-    CaretAssert(whichColumn >= 0 && whichColumn < metricIn->getNumberOfColumns());
-    CaretAssert(whichOutColumn >= 0 && whichOutColumn < metricOut->getNumberOfColumns());
-    CaretAssert(whichRoiColumn >= 0 && whichRoiColumn < roi->getNumberOfColumns());
-    const float* myColumn = metricIn->getValuePointerForColumn(whichColumn);
-    const float* roiColumn = roi->getValuePointerForColumn(whichRoiColumn);
-    int32_t numNodes = metricIn->getNumberOfNodes();
-    if (fixZeros)//special case early to keep branching down
-    {
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int32_t i = 0; i < numNodes; ++i)
+    CaretAssert(framesIn != NULL);
+    CaretAssert(framesOut != NULL);
+    CaretAssert(numFrames > 0);
+    const int64_t* offsets = m_offsetsPointer;
+    const int32_t* csrNodes = m_nodesPointer;
+    const float* csrWeights = m_weightsPointer;
+#pragma omp CARET_PAR
+    {
+        vector<float> sums(numFrames), weightSums(numFrames);//per thread accumulators, weightSums only used with fixZeros
+#pragma omp CARET_FOR schedule(dynamic, 64)
+        for (int32_t i = 0; i < m_numNodes; ++i)
         {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (roiColumn[i] > 0.0f && myWeightRef.m_weightSum != 0.0f)//skip nodes with no neighbors quickly
+            float* nodeOut = framesOut + (int64_t)i * numFrames;
+            if (m_weightSumsPointer[i] == 0.0f || (roiColumn != NULL && !(roiColumn[i] > 0.0f)))//skip nodes with no neighbors quickly
+            {
+                for (int32_t f = 0; f < numFrames; ++f) nodeOut[f] = 0.0f;//but we do need to zero what we skip
+                continue;
+            }
+            for (int32_t f = 0; f < numFrames; ++f)
             {
-                float sum = 0.0f, weightsum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
+                sums[f] = 0.0f;
+                weightSums[f] = 0.0f;
+            }
+            float weightSum = 0.0f;//same for all frames when not using fixZeros
+            const int64_t rowEnd = offsets[i + 1];
+            for (int64_t j = offsets[i]; j < rowEnd; ++j)
+            {
+                const int32_t neighbor = csrNodes[j];
+                if (roiColumn != NULL && !(roiColumn[neighbor] > 0.0f)) continue;
+                const float weight = csrWeights[j];
+                const float* neighborIn = framesIn + (int64_t)neighbor * numFrames;
+                if (fixZeros)
                 {
-                    int32_t neighbor = myWeightRef.m_nodes[j];
-                    float value = myColumn[neighbor];
-                    if (roiColumn[neighbor] > 0.0f && value != 0.0f)
+                    for (int32_t f = 0; f < numFrames; ++f)
                     {
-                        float weight = myWeightRef.m_weights[j];
-                        sum += weight * value;
-                        weightsum += weight;
+                        if (neighborIn[f] != 0.0f)
+                        {
+                            sums[f] += weight * neighborIn[f];
+                            weightSums[f] += weight;
+                        }
                     }
-                }
-                if (weightsum != 0.0f)
-                {
-                    scratch[i] = sum / weightsum;
                 } else {
-                    scratch[i] = 0.0f;
+                    for (int32_t f = 0; f < numFrames; ++f)
+                    {
+                        sums[f] += weight * neighborIn[f];
+                    }
+                    weightSum += weight;
                 }
-            } else {
-                scratch[i] = 0.0f;//but we do need to zero what we skip, so a list of nodes to check may not help
             }
-        }
-    } else {
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int32_t i = 0; i < numNodes; ++i)
-        {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (roiColumn[i] > 0.0f && myWeightRef.m_weightSum != 0.0f)
+            if (fixZeros)
             {
-                float sum = 0.0f, weightsum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
+                for (int32_t f = 0; f < numFrames; ++f)
                 {
-                    int32_t neighbor = myWeightRef.m_nodes[j];
-                    if (roiColumn[neighbor] > 0.0f)
+                    if (weightSums[f] != 0.0f)
                     {
-                        float weight = myWeightRef.m_weights[j];
-                        sum += weight * myColumn[neighbor];
-                        weightsum += weight;
+                        nodeOut[f] = sums[f] / weightSums[f];
+                    } else {
+                        nodeOut[f] = 0.0f;
                     }
                 }
-                if (weightsum != 0.0f)
+            } else {
+                if (roiColumn == NULL) weightSum = m_weightSumsPointer[i];//without an roi, the sum is precomputed
+                for (int32_t f = 0; f < numFrames; ++f)
                 {
-                    scratch[i] = sum / weightsum;
-                } else {
-                    scratch[i] = 0.0f;
+                    if (weightSum != 0.0f)
+                    {
+                        nodeOut[f] = sums[f] / weightSum;
+                    } else {
+                        nodeOut[f] = 0.0f;
+                    }
                 }
-            } else {
-                scratch[i] = 0.0f;
             }
         }
     }
-    metricOut->setValuesForColumn(whichOutColumn, scratch);
 }
 
 void MetricSmoothingObject::precomputeWeightsGeoGauss(const SurfaceFile* mySurf, float myKernel, const float* nodeAreas)
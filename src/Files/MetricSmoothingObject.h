@@ -27,9 +27,18 @@
 //NOTE: this object contains no mutable members, multiple threads can call the same function on the same instance and expect consistent behavior, while running concurrently,
 //      as long as they don't call it with output arguments that overlap (same instance, same row, or one row plus full metric, etc)
 //
+//NOTE: the weights are stored as a sparse matrix in CSR form, and smoothMetric applies them to blocks of columns at once, which is much faster than
+//      smoothing each column separately when there are many columns (timeseries).
+//
+//NOTE: when a cache directory is set, the weights are saved there in a file named from a hash of everything that affects them (surface, kernel,
+//      method, areas, constructor ROI), and later objects with the same inputs memory map that file instead of recomputing the weights.
+//
 //NOTE: for a static ROI, it is (sometimes much) more efficient to use it in the constructor, and provide no ROI (NULL) to the functions, using both an ROI in constructor and in method
 //      will result in the effective ROI being the logical AND of the two (intersection).
 
+#include "AString.h"
+#include "CaretBinaryFile.h"
+
 #include "stdint.h"
 #include "stddef.h"
 #include <vector>
@@ -52,6 +61,11 @@ namespace caret {
         void smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* columnOut, const MetricFile* roi = NULL, const bool& fixZeros = false) const;
         void smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi = NULL, const int& whichRoiColumn = 0, const bool& fixZeros = false) const;
         void smoothMetric(const MetricFile* metricIn, MetricFile* metricOut, const MetricFile* roi = NULL, const bool& fixZeros = false) const;
+        ///smooth many frames at once, with frames contiguous: framesIn[node * numFrames + frame], roiColumn may be NULL
+        void smoothFrames(const float* framesIn, float* framesOut, const int32_t& numFrames, const float* roiColumn = NULL, const bool& fixZeros = false) const;
+        ///directory to save and reuse precomputed weights in, empty disables it (the default)
+        static void setWeightCacheDirectory(const AString& directory) { s_weightCacheDirectory = directory; }
+        static const AString& getWeightCacheDirectory() { return s_weightCacheDirectory; }
     private:
         struct WeightList
         {
@@ -59,9 +73,24 @@ namespace caret {
             std::vector<float> m_weights;
             float m_weightSum;
         };
-        std::vector<WeightList> m_weightLists;
-        void smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const bool& fixZeros) const;
-        void smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi, const int& whichRoiColumn, const bool& fixZeros) const;
+        std::vector<WeightList> m_weightLists;//only used while precomputing, then converted to the CSR arrays
+        int32_t m_numNodes;
+        std::vector<int64_t> m_csrOffsets;//weights for node i are from m_csrOffsets[i] to m_csrOffsets[i + 1]
+        std::vector<int32_t> m_csrNodes;
+        std::vector<float> m_csrWeights;
+        std::vector<float> m_weightSums;
+        //the kernel uses these, which point either to the above vectors, or into the memory mapped cache file
+        const int64_t* m_offsetsPointer;
+        const int32_t* m_nodesPointer;
+        const float* m_weightsPointer;
+        const float* m_weightSumsPointer;
+        CaretBinaryFile m_cacheFile;
+        static AString s_weightCacheDirectory;
+        AString getCacheFileName(const SurfaceFile* mySurf, const float& myKernel, const MetricFile* theRoi, const Method& myMethod, const float* nodeAreas) const;
+        bool readWeightCache(const AString& filename, const int32_t& numNodes);
+        void writeWeightCache(const AString& filename) const;
+        static const int32_t FRAME_BLOCK_SIZE = 32;//number of columns smoothMetric does at once
+        void convertToCSR();
         void precomputeWeights(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, Method myMethod, const float* nodeAreas);
         void precomputeWeightsGeoGauss(const SurfaceFile* mySurf, float myKernel, const float* nodeAreas);
         void precomputeWeightsROIGeoGauss(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, const float* nodeAreas);
@@ -70,6 +99,8 @@ namespace caret {
         void precomputeWeightsGeoGaussEqual(const SurfaceFile* mySurf, float myKernel, const float* nodeAreas);
         void precomputeWeightsROIGeoGaussEqual(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, const float* nodeAreas);
         MetricSmoothingObject();
+        MetricSmoothingObject(const MetricSmoothingObject&);//pointers would point to the other object's vectors
+        MetricSmoothingObject& operator=(const MetricSmoothingObject&);
     };
     
 }
@@ -0,0 +1,163 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "ResamplingMatrix.h"
+
+#include "CaretAssert.h"
+#include "CaretOMP.h"
+#include "CaretSparseFile.h"
+#include "DataFileException.h"
+
+using namespace caret;
+using namespace std;
+
+ResamplingMatrix::ResamplingMatrix()
+{
+    m_rowStart.push_back(0);
+}
+
+void ResamplingMatrix::setSpaces(const CiftiBrainModelsMap& inputSpace, const CiftiBrainModelsMap& outputSpace)
+{
+    m_xml = CiftiXML();
+    m_xml.setNumberOfDimensions(2);
+    m_xml.setMap(CiftiXML::ALONG_ROW, inputSpace);
+    m_xml.setMap(CiftiXML::ALONG_COLUMN, outputSpace);
+    m_xml.getFileMetaData()->set(CaretSparseFile::CONTENTS_METADATA_KEY, CaretSparseFile::CONTENTS_RESAMPLING_MATRIX);
+    m_rowStart.assign(outputSpace.getLength() + 1, 0);
+    m_indices.clear();
+    m_weights.clear();
+}
+
+void ResamplingMatrix::setWeights(const vector<map<int64_t, float> >& rowWeights)
+{
+    int64_t numRows = getNumberOfOutputs(), numInputs = getNumberOfInputs();
+    CaretAssert((int64_t)rowWeights.size() == numRows);
+    m_indices.clear();
+    m_weights.clear();
+    m_rowStart[0] = 0;
+    for (int64_t i = 0; i < numRows; ++i)
+    {
+        for (map<int64_t, float>::const_iterator iter = rowWeights[i].begin(); iter != rowWeights[i].end(); ++iter)
+        {
+            CaretAssert(iter->first >= 0 && iter->first < numInputs);
+            m_indices.push_back(iter->first);
+            m_weights.push_back(iter->second);
+        }
+        m_rowStart[i + 1] = (int64_t)m_indices.size();
+    }
+}
+
+void ResamplingMatrix::getRow(const int64_t& row, vector<int64_t>& indicesOut, vector<float>& weightsOut) const
+{
+    CaretAssert(row >= 0 && row < getNumberOfOutputs());
+    indicesOut.assign(m_indices.begin() + m_rowStart[row], m_indices.begin() + m_rowStart[row + 1]);
+    weightsOut.assign(m_weights.begin() + m_rowStart[row], m_weights.begin() + m_rowStart[row + 1]);
+}
+
+void ResamplingMatrix::readFile(const AString& filename)
+{
+    CaretSparseFile myFile(filename);
+    const CiftiXML& myXML = myFile.getCiftiXML();
+    if (myXML.getNumberOfDimensions() != 2 ||
+        myXML.getMappingType(CiftiXML::ALONG_ROW) != CiftiMappingType::BRAIN_MODELS ||
+        myXML.getMappingType(CiftiXML::ALONG_COLUMN) != CiftiMappingType::BRAIN_MODELS)
+    {
+        throw DataFileException("file '" + filename + "' is not a resampling matrix, it must have brain models along both dimensions");
+    }
+    if (myXML.getFileMetaData()->get(CaretSparseFile::CONTENTS_METADATA_KEY) != CaretSparseFile::CONTENTS_RESAMPLING_MATRIX)
+    {//trajectory files also have brain models on both dimensions
+        throw DataFileException("file '" + filename + "' is not a resampling matrix, it is missing the '" + CaretSparseFile::CONTENTS_METADATA_KEY + "' metadata");
+    }
+    m_xml = myXML;
+    int64_t numRows = myXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
+    m_rowStart.resize(numRows + 1);
+    m_indices.clear();
+    m_weights.clear();
+    m_rowStart[0] = 0;
+    vector<int64_t> rowIndices;
+    vector<float> rowWeights;
+    for (int64_t i = 0; i < numRows; ++i)
+    {
+        myFile.getWeightsRowSparse(i, rowIndices, rowWeights);
+        m_indices.insert(m_indices.end(), rowIndices.begin(), rowIndices.end());
+        m_weights.insert(m_weights.end(), rowWeights.begin(), rowWeights.end());
+        m_rowStart[i + 1] = (int64_t)m_indices.size();
+    }
+}
+
+void ResamplingMatrix::writeFile(const AString& filename) const
+{
+    CaretSparseFileWriter myWriter(filename, m_xml);
+    int64_t numRows = getNumberOfOutputs();
+    vector<int64_t> rowIndices;
+    vector<float> rowWeights;
+    for (int64_t i = 0; i < numRows; ++i)
+    {
+        if (m_rowStart[i] == m_rowStart[i + 1]) continue;//writer allows skipping empty rows
+        rowIndices.assign(m_indices.begin() + m_rowStart[i], m_indices.begin() + m_rowStart[i + 1]);
+        rowWeights.assign(m_weights.begin() + m_rowStart[i], m_weights.begin() + m_rowStart[i + 1]);
+        myWriter.writeWeightsRowSparse(i, rowIndices, rowWeights);
+    }
+    myWriter.finish();
+}
+
+void ResamplingMatrix::multiply(const float* input, const int64_t& numColumns, float* output, const float& invalidVal) const
+{
+    int64_t numRows = getNumberOfOutputs();
+    const int64_t* rowStart = m_rowStart.data(), *indices = m_indices.data();
+    const float* weights = m_weights.data();
+    //each output row is a short sum of input rows, so do all columns of a row together - the inner loops are contiguous and vectorize
+    //accumulate in double like SurfaceResamplingHelper::resampleNormal, so the result matches -metric-resample and -cifti-resample
+#pragma omp CARET_PAR if(numRows * numColumns > 65536)
+    {
+        vector<double> accum(numColumns);
+#pragma omp CARET_FOR schedule(dynamic, 16)
+        for (int64_t i = 0; i < numRows; ++i)
+        {
+            float* outRow = output + i * numColumns;
+            int64_t start = rowStart[i], end = rowStart[i + 1];
+            if (start == end)
+            {
+                for (int64_t c = 0; c < numColumns; ++c)
+                {
+                    outRow[c] = invalidVal;
+                }
+                continue;
+            }
+            for (int64_t c = 0; c < numColumns; ++c)
+            {
+                accum[c] = 0.0;
+            }
+            for (int64_t e = start; e < end; ++e)
+            {
+                const float weight = weights[e];
+                const float* inRow = input + indices[e] * numColumns;
+                for (int64_t c = 0; c < numColumns; ++c)
+                {
+                    accum[c] += inRow[c] * weight;//float product, same as resampleNormal
+                }
+            }
+            for (int64_t c = 0; c < numColumns; ++c)
+            {
+                outRow[c] = accum[c];
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef __RESAMPLING_MATRIX_H__
+#define __RESAMPLING_MATRIX_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+//NOTE: this stores the weights that a linear resampling computed, so they can be applied to other data in the same spaces without recomputing
+//      them, for instance when resampling many subjects from native meshes to the same standard mesh.  Each output brainordinate (row) is
+//      a weighted sum of input brainordinates (columns).  On disk it is a wbsparse file with the input space along rows and the output
+//      space along columns in its cifti XML, and the float weights in the value fields (see CaretSparseFile::getWeightsRowSparse).
+
+#include "AString.h"
+#include "CiftiXML.h"
+
+#include <map>
+#include <vector>
+#include "stdint.h"
+
+namespace caret
+{
+    class ResamplingMatrix
+    {
+        CiftiXML m_xml;
+        std::vector<int64_t> m_rowStart, m_indices;//compressed sparse rows, m_rowStart has one extra element
+        std::vector<float> m_weights;
+    public:
+        ResamplingMatrix();
+
+        ///set the input and output spaces, which removes all weights
+        void setSpaces(const CiftiBrainModelsMap& inputSpace, const CiftiBrainModelsMap& outputSpace);
+
+        ///set the weights for every output index, keys are input indices
+        void setWeights(const std::vector<std::map<int64_t, float> >& rowWeights);
+
+        void readFile(const AString& filename);
+        void writeFile(const AString& filename) const;
+
+        const CiftiXML& getCiftiXML() const { return m_xml; }
+        const CiftiBrainModelsMap& getInputSpace() const { return m_xml.getBrainModelsMap(CiftiXML::ALONG_ROW); }
+        const CiftiBrainModelsMap& getOutputSpace() const { return m_xml.getBrainModelsMap(CiftiXML::ALONG_COLUMN); }
+        int64_t getNumberOfInputs() const { return m_xml.getDimensionLength(CiftiXML::ALONG_ROW); }
+        int64_t getNumberOfOutputs() const { return (int64_t)m_rowStart.size() - 1; }
+        
+        ///get the input indices and weights for one output index
+        void getRow(const int64_t& row, std::vector<int64_t>& indicesOut, std::vector<float>& weightsOut) const;
+
+        ///output = matrix * input for numColumns columns at once, input is getNumberOfInputs() rows of numColumns contiguous values,
+        ///output is getNumberOfOutputs() rows of numColumns values, rows with no weights get invalidVal
+        void multiply(const float* input, const int64_t& numColumns, float* output, const float& invalidVal = 0.0f) const;
+    };
+}
+
+#endif //__RESAMPLING_MATRIX_H__
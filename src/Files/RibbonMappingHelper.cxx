@@ -48,13 +48,17 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "RibbonMappingHelper.h"
 
 #include "CaretException.h"
+#include "CiftiBrainModelsMap.h"
 #include "FloatMatrix.h"
 #include "MathFunctions.h"
+#include "ResamplingMatrix.h"
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
 #include "VolumeSpace.h"
 
 #include <cmath>
+#include <limits>
+#include <map>
 
 using namespace caret;
 using namespace std;
@@ -80,13 +84,24 @@ namespace
         QuadInfo() {};
     };
     
+    struct BoundBox
+    {
+        float m_low[3], m_high[3];
+        BoundBox();
+        void add(const float* xyz);
+        bool overlaps(const float* low, const float* high) const;
+    };
+    
     struct PolyInfo
     {
         std::vector<TriInfo> m_tris;
         std::vector<QuadInfo> m_quads;
+        std::vector<BoundBox> m_faceBounds;//one per triangle, then one per quad
+        BoundBox m_bounds;
         PolyInfo(const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const int32_t node, const bool& thinColumn = false);//surfaces MUST be in node correspondence, otherwise SEVERE strangeness, possible crashes
         PolyInfo() {};
         int isInside(const float* xyz);//0 for no, 2 for yes, 1 for if only half the triangulations (between the two triangulations of one of the quad faces)
+        bool mayCross(const float* low, const float* high) const;//false if no face can pass through the box, so every point in it has the same isInside result
     private:
         void addTri(const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const int32_t* myTri, const int rootIndex, const bool& thinColumn);//adds the tri for each surface, plus the quad
     };
@@ -123,6 +138,44 @@ namespace
         }
     }
 
+    BoundBox::BoundBox()
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            m_low[i] = numeric_limits<float>::max();
+            m_high[i] = -numeric_limits<float>::max();
+        }
+    }
+    
+    void BoundBox::add(const float* xyz)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            if (xyz[i] < m_low[i]) m_low[i] = xyz[i];
+            if (xyz[i] > m_high[i]) m_high[i] = xyz[i];
+        }
+    }
+    
+    bool BoundBox::overlaps(const float* low, const float* high) const
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            if (high[i] < m_low[i] || low[i] > m_high[i]) return false;
+        }
+        return true;
+    }
+    
+    bool PolyInfo::mayCross(const float* low, const float* high) const
+    {
+        if (!m_bounds.overlaps(low, high)) return false;
+        int numFaces = (int)m_faceBounds.size();
+        for (int i = 0; i < numFaces; ++i)
+        {
+            if (m_faceBounds[i].overlaps(low, high)) return true;
+        }
+        return false;
+    }
+    
     int PolyInfo::isInside(const float* xyz)
     {
         int i, temp, numQuads = (int)m_quads.size();
@@ -162,6 +215,28 @@ namespace
                 }
             }
         }
+        for (int i = 0; i < (int)m_tris.size(); ++i)
+        {
+            BoundBox thisBox;
+            for (int j = 0; j < 3; ++j)
+            {
+                thisBox.add(m_tris[i].m_xyz[j]);
+                m_bounds.add(m_tris[i].m_xyz[j]);
+            }
+            m_faceBounds.push_back(thisBox);
+        }
+        for (int i = 0; i < (int)m_quads.size(); ++i)
+        {//both triangulations use the same 4 vertices, and the first one covers all of them
+            BoundBox thisBox;
+            for (int j = 0; j < 2; ++j)
+            {
+                for (int k = 0; k < 3; ++k)
+                {
+                    thisBox.add(m_quads[i].m_tris[0][j].m_xyz[k]);
+                }
+            }
+            m_faceBounds.push_back(thisBox);
+        }
     }
 
     QuadInfo::QuadInfo(const float* xyz1, const float* xyz2, const float* xyz3, const float* xyz4)
@@ -237,26 +312,91 @@ namespace
         return inside;
     }
     
+    //counts the same subvoxel samples as testing each one, but only subdivides the parts of the voxel that some face of the polyhedron could pass through,
+    //since everything else is entirely inside or outside - most voxels near a vertex only need one or a few tests, instead of divisions^3
+    struct VoxelSampler
+    {
+        PolyInfo& m_poly;
+        Vector3D m_lowCorner, m_firstSample, m_istep, m_jstep, m_kstep;
+        VoxelSampler(PolyInfo& poly, const Vector3D& lowCorner, const Vector3D& istep, const Vector3D& jstep, const Vector3D& kstep) : m_poly(poly)
+        {
+            m_lowCorner = lowCorner;
+            m_istep = istep;
+            m_jstep = jstep;
+            m_kstep = kstep;
+            m_firstSample = lowCorner + istep * 0.5f + jstep * 0.5f + kstep * 0.5f;
+        }
+        int sample(const int& i, const int& j, const int& k)
+        {//same arithmetic as the old brute force loop, so single samples give identical results
+            Vector3D tempVeci = m_firstSample + m_istep * i;
+            Vector3D tempVecj = tempVeci + m_jstep * j;
+            Vector3D thisPoint = tempVecj + m_kstep * k;
+            return m_poly.isInside(thisPoint);
+        }
+        int countInside(const int* start, const int* end)//sums isInside over the samples in [start, end)
+        {
+            int count = (end[0] - start[0]) * (end[1] - start[1]) * (end[2] - start[2]);
+            if (count == 1) return sample(start[0], start[1], start[2]);
+            BoundBox cellBox;//the sub-box of the voxel that contains these samples, in world coordinates
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                Vector3D thisCorner = m_lowCorner + m_istep * ((corner & 1) ? end[0] : start[0]) +
+                                                    m_jstep * ((corner & 2) ? end[1] : start[1]) +
+                                                    m_kstep * ((corner & 4) ? end[2] : start[2]);
+                cellBox.add(thisCorner);
+            }
+            if (!m_poly.mayCross(cellBox.m_low, cellBox.m_high))
+            {
+                return count * sample(start[0], start[1], start[2]);
+            }
+            int mid[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                mid[i] = (start[i] + end[i]) / 2;//equal to start when there is only one sample along this axis, which skips the empty half below
+            }
+            int ret = 0;
+            for (int child = 0; child < 8; ++child)
+            {
+                int childStart[3], childEnd[3];
+                bool empty = false;
+                for (int i = 0; i < 3; ++i)
+                {
+                    if (child & (1 << i))
+                    {
+                        childStart[i] = mid[i];
+                        childEnd[i] = end[i];
+                    } else {
+                        childStart[i] = start[i];
+                        childEnd[i] = mid[i];
+                    }
+                    if (childStart[i] == childEnd[i]) empty = true;
+                }
+                if (!empty) ret += countInside(childStart, childEnd);
+            }
+            return ret;
+        }
+    };
+    
     float computeVoxelFraction(const VolumeSpace& myVolSpace, const int64_t* ijk, PolyInfo& myPoly, const int divisions,
-                               const Vector3D& ivec, const Vector3D& jvec, const Vector3D& kvec)
+                               const Vector3D& ivec, const Vector3D& jvec, const Vector3D& kvec, const bool& adaptiveSampling)
     {
         Vector3D myLowCorner;
         myVolSpace.indexToSpace(ijk[0] - 0.5f, ijk[1] - 0.5f, ijk[2] - 0.5f, myLowCorner);
+        VoxelSampler mySampler(myPoly, myLowCorner, ivec / divisions, jvec / divisions, kvec / divisions);
         int inside = 0;
-        Vector3D istep = ivec / divisions;
-        Vector3D jstep = jvec / divisions;
-        Vector3D kstep = kvec / divisions;
-        myLowCorner += istep * 0.5f + jstep * 0.5f + kstep * 0.5f;
-        for (int i = 0; i < divisions; ++i)
+        if (adaptiveSampling)
         {
-            Vector3D tempVeci = myLowCorner + istep * i;
-            for (int j = 0; j < divisions; ++j)
+            int start[3] = { 0, 0, 0 }, end[3] = { divisions, divisions, divisions };
+            inside = mySampler.countInside(start, end);
+        } else {
+            for (int i = 0; i < divisions; ++i)
             {
-                Vector3D tempVecj = tempVeci + jstep * j;
-                for (int k = 0; k < divisions; ++k)
+                for (int j = 0; j < divisions; ++j)
                 {
-                    Vector3D thisPoint = tempVecj + kstep * k;
-                    inside += myPoly.isInside(thisPoint);
+                    for (int k = 0; k < divisions; ++k)
+                    {
+                        inside += mySampler.sample(i, j, k);
+                    }
                 }
             }
         }
@@ -266,7 +406,7 @@ namespace
 }
 
 void RibbonMappingHelper::computeWeightsRibbon(vector<vector<VoxelWeight> >& myWeightsOut, const VolumeSpace& myVolSpace, const SurfaceFile* innerSurf, const SurfaceFile* outerSurf,
-                                               const float* roiFrame, const int& numDivisions, const bool& thinColumn)
+                                               const float* roiFrame, const int& numDivisions, const bool& thinColumn, const bool& adaptiveSampling)
 {
     if (!innerSurf->hasNodeCorrespondence(*outerSurf))
     {
@@ -339,7 +479,7 @@ void RibbonMappingHelper::computeWeightsRibbon(vector<vector<VoxelWeight> >& myW
                     {
                         if (roiFrame == NULL || roiFrame[myVolSpace.getIndex(ijk)] > 0.0f)
                         {
-                            tempf = computeVoxelFraction(myVolSpace, ijk, myPoly, numDivisions, ivec, jvec, kvec);
+                            tempf = computeVoxelFraction(myVolSpace, ijk, myPoly, numDivisions, ivec, jvec, kvec, adaptiveSampling);
                             if (tempf != 0.0f)
                             {
                                 myWeightsOut[node].push_back(VoxelWeight(tempf, ijk));
@@ -355,3 +495,92 @@ void RibbonMappingHelper::computeWeightsRibbon(vector<vector<VoxelWeight> >& myW
         }
     }
 }
+
+void RibbonMappingHelper::weightsToMatrix(const vector<vector<VoxelWeight> >& myWeights, const VolumeSpace& myVolSpace, const StructureEnum::Enum& myStructure,
+                                          ResamplingMatrix& matrixOut)
+{
+    const int64_t* myDims = myVolSpace.getDims();
+    const int64_t frameSize = myDims[0] * myDims[1] * myDims[2];
+    int64_t numNodes = (int64_t)myWeights.size();
+    vector<int64_t> voxelToInput(frameSize, -1);
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        for (int i = 0; i < (int)myWeights[node].size(); ++i)
+        {
+            voxelToInput[myVolSpace.getIndex(myWeights[node][i].ijk)] = 0;
+        }
+    }
+    vector<int64_t> ijkList;
+    int64_t numInputs = 0;
+    for (int64_t index = 0; index < frameSize; ++index)
+    {
+        if (voxelToInput[index] == -1) continue;
+        voxelToInput[index] = numInputs;
+        ++numInputs;
+        ijkList.push_back(index % myDims[0]);
+        ijkList.push_back((index / myDims[0]) % myDims[1]);
+        ijkList.push_back(index / (myDims[0] * myDims[1]));
+    }
+    if (numInputs == 0)
+    {
+        throw CaretException("no voxels have ribbon mapping weights");
+    }
+    StructureEnum::Enum useStructure = myStructure;
+    if (useStructure == StructureEnum::INVALID) useStructure = StructureEnum::OTHER;
+    CiftiBrainModelsMap inSpace, outSpace;
+    inSpace.setVolumeSpace(myVolSpace);
+    inSpace.addVolumeModel(useStructure, ijkList);
+    outSpace.addSurfaceModel(numNodes, useStructure);
+    matrixOut.setSpaces(inSpace, outSpace);
+    vector<map<int64_t, float> > rowWeights(numNodes);
+    for (int64_t node = 0; node < numNodes; ++node)
+    {
+        const vector<VoxelWeight>& nodeWeights = myWeights[node];
+        double totalWeight = 0.0;
+        for (int i = 0; i < (int)nodeWeights.size(); ++i)
+        {
+            totalWeight += nodeWeights[i].weight;
+        }
+        if (totalWeight == 0.0) continue;//mapping gives 0 for these
+        for (int i = 0; i < (int)nodeWeights.size(); ++i)
+        {
+            rowWeights[node][voxelToInput[myVolSpace.getIndex(nodeWeights[i].ijk)]] += nodeWeights[i].weight / totalWeight;
+        }
+    }
+    matrixOut.setWeights(rowWeights);
+}
+
+void RibbonMappingHelper::matrixToWeights(const ResamplingMatrix& myMatrix, vector<vector<VoxelWeight> >& myWeightsOut)
+{
+    const CiftiBrainModelsMap& inSpace = myMatrix.getInputSpace(), &outSpace = myMatrix.getOutputSpace();
+    if (!inSpace.getSurfaceStructureList().empty() || !inSpace.hasVolumeData())
+    {
+        throw CaretException("matrix input must contain only voxels for volume to surface mapping");
+    }
+    if (outSpace.getSurfaceStructureList().size() != 1 || outSpace.hasVolumeData())
+    {
+        throw CaretException("matrix output must contain only one surface for volume to surface mapping");
+    }
+    StructureEnum::Enum outStructure = outSpace.getSurfaceStructureList()[0];
+    int64_t numNodes = outSpace.getSurfaceNumberOfNodes(outStructure);
+    vector<CiftiBrainModelsMap::VolumeMap> inputVoxels = inSpace.getFullVolumeMap();
+    vector<const int64_t*> inputToIJK(myMatrix.getNumberOfInputs(), NULL);
+    for (int64_t i = 0; i < (int64_t)inputVoxels.size(); ++i)
+    {
+        inputToIJK[inputVoxels[i].m_ciftiIndex] = inputVoxels[i].m_ijk;
+    }
+    myWeightsOut.clear();
+    myWeightsOut.resize(numNodes);
+    vector<int64_t> rowIndices;
+    vector<float> rowWeights;
+    vector<CiftiBrainModelsMap::SurfaceMap> outputNodes = outSpace.getSurfaceMap(outStructure);
+    for (int64_t i = 0; i < (int64_t)outputNodes.size(); ++i)
+    {
+        myMatrix.getRow(outputNodes[i].m_ciftiIndex, rowIndices, rowWeights);
+        vector<VoxelWeight>& nodeWeights = myWeightsOut[outputNodes[i].m_surfaceNode];
+        for (int j = 0; j < (int)rowIndices.size(); ++j)
+        {
+            nodeWeights.push_back(VoxelWeight(rowWeights[j], inputToIJK[rowIndices[j]]));
+        }
+    }
+}
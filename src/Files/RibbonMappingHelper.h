@@ -21,6 +21,8 @@
  */
 /*LICENSE_END*/
 
+#include "StructureEnum.h"
+
 #include "stdint.h"
 #include <cstddef>
 #include <vector>
@@ -28,6 +30,7 @@
 namespace caret
 {
     
+    class ResamplingMatrix;
     class SurfaceFile;
     class VolumeSpace;
     
@@ -49,9 +52,19 @@ namespace caret
     {
     public:
         ///compute per-vertex ribbon mapping weights - surfaces must have vertex correspondence, or an exception is thrown
+        ///adaptiveSampling = false tests every one of the numDivisions^3 samples in each voxel, which gives the same weights more slowly (for testing)
         static void computeWeightsRibbon(std::vector<std::vector<VoxelWeight> >& myWeightsOut, const VolumeSpace& myVolSpace,
                                          const SurfaceFile* innerSurf, const SurfaceFile* outerSurf,
-                                         const float* roiFrame = NULL, const int& numDivisions = 3, const bool& thinColumn = false);
+                                         const float* roiFrame = NULL, const int& numDivisions = 3, const bool& thinColumn = false,
+                                         const bool& adaptiveSampling = true);
+        
+        ///convert per-vertex weights to a matrix from the voxels that have weights to the vertices, with each row normalized to sum to 1 (rows that sum to 0 are left empty)
+        ///this is also the file format for saving ribbon weights, see ResamplingMatrix
+        static void weightsToMatrix(const std::vector<std::vector<VoxelWeight> >& myWeights, const VolumeSpace& myVolSpace, const StructureEnum::Enum& myStructure,
+                                    ResamplingMatrix& matrixOut);
+        
+        ///convert a volume to surface matrix back to per-vertex weights, throws if it doesn't map from voxels to a single surface
+        static void matrixToWeights(const ResamplingMatrix& myMatrix, std::vector<std::vector<VoxelWeight> >& myWeightsOut);
     };
 
 }
@@ -779,6 +779,18 @@ void SurfaceFile::getGeodesicHelper(CaretPointer<GeodesicHelper>& helpOut) const
     helpOut = ret;
 }
 
+CaretPointer<const GeodesicHelperBase> SurfaceFile::getGeodesicHelperBase() const
+{
+    CaretMutexLocker myLock(&m_geoHelperMutex);
+    if (m_geoBase == NULL)
+    {
+        m_geoHelpers.clear();
+        m_geoHelperIndex = 0;
+        m_geoBase.grabNew(new GeodesicHelperBase(this));
+    }
+    return m_geoBase;//copied before the locker is destroyed
+}
+
 CaretPointer<GeodesicHelper> SurfaceFile::getGeodesicHelper() const
 {//this convenience function is here because in order to guarantee thread safety, the real function explicitly copies to a reference argument before letting the mutex unlock
     CaretPointer<GeodesicHelper> ret;//the copy of a return should take place before destructors (including the locker for the helper mutex), but just to be safe
@@ -132,6 +132,9 @@ namespace caret {
         
         void getGeodesicHelper(CaretPointer<GeodesicHelper>& helpOut) const;
         
+        ///the neighbor lists that the geodesic helpers share, built on first use - for things that copy them, like GeodesicAllPairsHelper
+        CaretPointer<const GeodesicHelperBase> getGeodesicHelperBase() const;
+        
         CaretPointer<SignedDistanceHelper> getSignedDistanceHelper() const;
         
         void getSignedDistanceHelper(CaretPointer<SignedDistanceHelper>& helpOut) const;
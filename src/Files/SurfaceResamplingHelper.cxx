@@ -204,6 +204,19 @@ void SurfaceResamplingHelper::getResampleValidROI(float* output) const
     }
 }
 
+void SurfaceResamplingHelper::getNodeWeights(const int& newNode, vector<int>& nodesOut, vector<float>& weightsOut) const
+{
+    CaretAssert(newNode >= 0 && newNode < getNumberOfNewNodes());
+    nodesOut.clear();
+    weightsOut.clear();
+    WeightElem* end = m_weights[newNode + 1];
+    for (WeightElem* elem = m_weights[newNode]; elem != end; ++elem)
+    {
+        nodesOut.push_back(elem->node);
+        weightsOut.push_back(elem->weight);
+    }
+}
+
 void SurfaceResamplingHelper::resampleCutSurface(const SurfaceFile* cutSurfaceIn, const SurfaceFile* currentSphere, const SurfaceFile* newSphere, SurfaceFile* surfaceOut)
 {
     if (cutSurfaceIn->getNumberOfNodes() != currentSphere->getNumberOfNodes()) throw CaretException("input surface has different number of nodes than input sphere");
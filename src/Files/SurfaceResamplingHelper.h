@@ -64,6 +64,10 @@ namespace caret {
         void resampleLargest(const int32_t* input, int32_t* output, const int32_t& invalidVal = 0) const;
         ///get the ROI of nodes that have data within the input ROI
         void getResampleValidROI(float* output) const;
+        ///number of nodes in the new mesh
+        int getNumberOfNewNodes() const { return (int)m_weights.size() - 1; }
+        ///get the weights used for one new node, sorted by current node, for storing as a resampling matrix
+        void getNodeWeights(const int& newNode, std::vector<int>& nodesOut, std::vector<float>& weightsOut) const;
         
         ///resample a cut surface - not something you will apply multiple times, so static method
         static void resampleCutSurface(const SurfaceFile* cutSurfaceIn, const SurfaceFile* curSphere, const SurfaceFile* newSphere, SurfaceFile* surfaceOut);
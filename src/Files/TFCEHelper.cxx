@@ -0,0 +1,241 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "TFCEHelper.h"
+
+#include "CaretAssert.h"
+#include "CaretException.h"
+#include "SurfaceFile.h"
+#include "TopologyHelper.h"
+#include "VolumeSpace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    struct ValueGreater
+    {
+        const float* m_values;
+        ValueGreater(const float* values) : m_values(values) { }
+        bool operator()(const int32_t& left, const int32_t& right) const { return m_values[left] > m_values[right]; }
+    };
+}
+
+TFCEHelper::TFCEHelper(const SurfaceFile* mySurf, const float* areaData, const vector<int64_t>& nodeList)
+{
+    const int32_t numNodes = mySurf->getNumberOfNodes();
+    const int64_t numElements = (int64_t)nodeList.size();
+    if (numElements > numNodes) throw CaretException("TFCE vertex list is longer than the number of vertices");
+    CaretPointer<Graph> myGraph(new Graph());
+    myGraph->m_numElements = (int32_t)numElements;
+    vector<int32_t> elementOfNode(numNodes, -1);
+    for (int32_t i = 0; i < (int32_t)numElements; ++i)
+    {
+        CaretAssert(nodeList[i] >= 0 && nodeList[i] < numNodes);
+        elementOfNode[nodeList[i]] = i;
+    }
+    CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();
+    myGraph->m_offsets.resize(numElements + 1);
+    myGraph->m_offsets[0] = 0;
+    myGraph->m_areas.resize(numElements);
+    for (int32_t i = 0; i < (int32_t)numElements; ++i)
+    {
+        const vector<int32_t>& neighbors = myTopoHelp->getNodeNeighbors(nodeList[i]);
+        for (int j = 0; j < (int)neighbors.size(); ++j)
+        {
+            const int32_t neighElem = elementOfNode[neighbors[j]];
+            if (neighElem != -1) myGraph->m_neighbors.push_back(neighElem);
+        }
+        myGraph->m_offsets[i + 1] = (int64_t)myGraph->m_neighbors.size();
+        myGraph->m_areas[i] = areaData[nodeList[i]];
+    }
+    m_graph = myGraph;
+    allocateScratch();
+}
+
+TFCEHelper::TFCEHelper(const VolumeSpace& mySpace, const vector<int64_t>& ijkList)
+{
+    CaretAssert(ijkList.size() % 3 == 0);
+    const int64_t numElements = (int64_t)ijkList.size() / 3;
+    if (numElements > numeric_limits<int32_t>::max()) throw CaretException("too many voxels for TFCE");
+    const int64_t* dims = mySpace.getDims();
+    CaretPointer<Graph> myGraph(new Graph());
+    myGraph->m_numElements = (int32_t)numElements;
+    vector<int32_t> elementOfVoxel(dims[0] * dims[1] * dims[2], -1);
+    for (int32_t i = 0; i < (int32_t)numElements; ++i)
+    {
+        const int64_t* ijk = ijkList.data() + i * 3;
+        CaretAssert(mySpace.indexValid(ijk));
+        elementOfVoxel[mySpace.getIndex(ijk)] = i;
+    }
+    Vector3D ivec, jvec, kvec, origin;//compute the volume of a voxel so different resolutions have comparable values
+    mySpace.getSpacingVectors(ivec, jvec, kvec, origin);
+    const float voxelVolume = abs(ivec.dot(jvec.cross(kvec)));
+    const int STENCIL_SIZE = 18;
+    const int64_t stencil[STENCIL_SIZE] = { 0, 0, -1,
+                                            0, -1, 0,
+                                            -1, 0, 0,
+                                            1, 0, 0,
+                                            0, 1, 0,
+                                            0, 0, 1 };
+    myGraph->m_offsets.resize(numElements + 1);
+    myGraph->m_offsets[0] = 0;
+    myGraph->m_areas.resize(numElements, voxelVolume);
+    for (int32_t i = 0; i < (int32_t)numElements; ++i)
+    {
+        const int64_t* ijk = ijkList.data() + i * 3;
+        for (int j = 0; j < STENCIL_SIZE; j += 3)
+        {
+            const int64_t neighIJK[3] = { ijk[0] + stencil[j], ijk[1] + stencil[j + 1], ijk[2] + stencil[j + 2] };
+            if (mySpace.indexValid(neighIJK))
+            {
+                const int32_t neighElem = elementOfVoxel[mySpace.getIndex(neighIJK)];
+                if (neighElem != -1) myGraph->m_neighbors.push_back(neighElem);
+            }
+        }
+        myGraph->m_offsets[i + 1] = (int64_t)myGraph->m_neighbors.size();
+    }
+    m_graph = myGraph;
+    allocateScratch();
+}
+
+TFCEHelper::TFCEHelper(const TFCEHelper& other)
+{
+    m_graph = other.m_graph;
+    allocateScratch();
+}
+
+void TFCEHelper::allocateScratch()
+{
+    const int32_t numElements = m_graph->m_numElements;
+    m_order.resize(numElements);
+    m_parent.resize(numElements);
+    m_clusterSize.resize(numElements);
+    m_rootSegment.resize(numElements);
+    m_segmentNext.resize(numElements);
+    m_values.resize(numElements);
+    m_clusterArea.resize(numElements);
+    m_segmentTop.resize(numElements);
+    m_segmentSum.resize(numElements);
+}
+
+int32_t TFCEHelper::findRoot(int32_t element)
+{
+    while (m_parent[element] != element)
+    {
+        m_parent[element] = m_parent[m_parent[element]];//path halving
+        element = m_parent[element];
+    }
+    return element;
+}
+
+void TFCEHelper::compute(const float* dataIn, float* dataOut, const float& param_e, const float& param_h)
+{
+    const int32_t numElements = m_graph->m_numElements;
+    for (int32_t i = 0; i < numElements; ++i)
+    {
+        dataOut[i] = 0.0f;
+    }
+    computeSign(dataIn, dataOut, false, param_e, param_h);
+    computeSign(dataIn, dataOut, true, param_e, param_h);//positive and negative elements don't overlap, and neither pass touches the others' output
+}
+
+void TFCEHelper::computeSign(const float* dataIn, float* dataOut, const bool& negate, const float& param_e, const float& param_h)
+{
+    const Graph& myGraph = *m_graph;
+    const int32_t numElements = myGraph.m_numElements;
+    const int64_t* offsets = myGraph.m_offsets.data();
+    const int32_t* neighbors = myGraph.m_neighbors.data();
+    int32_t numActive = 0;
+    for (int32_t i = 0; i < numElements; ++i)
+    {
+        const float value = (negate ? -dataIn[i] : dataIn[i]);
+        m_parent[i] = -1;//not added yet
+        if (value > 0.0f)//also excludes NaN
+        {
+            m_values[i] = value;
+            m_order[numActive] = i;
+            ++numActive;
+        }
+    }
+    sort(m_order.begin(), m_order.begin() + numActive, ValueGreater(m_values.data()));
+    const double integrated_h = param_h + 1.0;//integral(x^h) = (x^(h + 1))/(h + 1) + C
+    for (int32_t index = 0; index < numActive; ++index)
+    {
+        const int32_t element = m_order[index];
+        const double top = pow((double)m_values[element], integrated_h);
+        int32_t root = element;
+        double area = myGraph.m_areas[element];
+        m_parent[element] = element;
+        m_clusterSize[element] = 1;
+        for (int64_t j = offsets[element]; j < offsets[element + 1]; ++j)
+        {
+            const int32_t neigh = neighbors[j];
+            if (m_parent[neigh] == -1) continue;
+            const int32_t neighRoot = findRoot(neigh);
+            if (neighRoot == root) continue;
+            const int32_t finished = m_rootSegment[neighRoot];//the cluster grows at this threshold, so its current segment ends here
+            if (m_segmentTop[finished] != top)
+            {
+                m_segmentSum[finished] = pow(m_clusterArea[neighRoot], (double)param_e) * (m_segmentTop[finished] - top) / integrated_h;
+            } else {
+                m_segmentSum[finished] = 0.0;
+            }
+            m_segmentNext[finished] = element;
+            area += m_clusterArea[neighRoot];
+            if (m_clusterSize[neighRoot] > m_clusterSize[root])//union by size
+            {
+                m_parent[root] = neighRoot;
+                m_clusterSize[neighRoot] += m_clusterSize[root];
+                root = neighRoot;
+            } else {
+                m_parent[neighRoot] = root;
+                m_clusterSize[root] += m_clusterSize[neighRoot];
+            }
+        }
+        m_clusterArea[root] = area;
+        m_rootSegment[root] = element;//segments are identified by the element that started them
+        m_segmentTop[element] = top;
+        m_segmentNext[element] = -1;
+    }
+    for (int32_t index = 0; index < numActive; ++index)
+    {//finish the to-zero slice of each remaining cluster
+        const int32_t element = m_order[index];
+        if (m_parent[element] == element)
+        {
+            const int32_t finished = m_rootSegment[element];
+            m_segmentSum[finished] = pow(m_clusterArea[element], (double)param_e) * m_segmentTop[finished] / integrated_h;
+        }
+    }
+    for (int32_t index = numActive - 1; index >= 0; --index)
+    {//the next segment was always started by an element later in the sorted order, so it already contains the sum of everything after it
+        const int32_t element = m_order[index];
+        if (m_segmentNext[element] != -1)
+        {
+            m_segmentSum[element] += m_segmentSum[m_segmentNext[element]];
+        }
+        dataOut[element] = (float)(negate ? -m_segmentSum[element] : m_segmentSum[element]);
+    }
+}
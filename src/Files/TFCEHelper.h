@@ -0,0 +1,74 @@
+#ifndef __TFCE_HELPER_H__
+#define __TFCE_HELPER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+//NOTE: this is for running TFCE on many maps with the same domain, such as permutation testing.  The neighbor graph of the elements (the
+//      vertices or voxels to use, in the order given) is built once as a compressed array.  For each map, the elements are sorted by value
+//      and added in decreasing order to a union-find structure.  Every added element starts a new segment of the cluster it ends up in,
+//      and a cluster's previous segment is finished at that threshold and pointed at the new one, so the TFCE value of an element is the
+//      sum of the segments from its own to the last one, which is computed in one pass over the elements in increasing order.
+//
+//      All scratch memory is allocated in the constructor, so compute() doesn't allocate.  Copies share the graph, so make one copy per thread.
+
+#include "CaretPointer.h"
+
+#include "stdint.h"
+#include <vector>
+
+namespace caret {
+
+    class SurfaceFile;
+    class VolumeSpace;
+
+    class TFCEHelper
+    {
+        struct Graph
+        {
+            std::vector<int64_t> m_offsets;//neighbors of element i are m_neighbors[m_offsets[i]] to m_neighbors[m_offsets[i + 1] - 1]
+            std::vector<int32_t> m_neighbors;
+            std::vector<float> m_areas;
+            int32_t m_numElements;
+        };
+        CaretPointer<const Graph> m_graph;//shared between copies, everything else is scratch space
+        std::vector<int32_t> m_order, m_parent, m_clusterSize, m_rootSegment, m_segmentNext;
+        std::vector<float> m_values;
+        std::vector<double> m_clusterArea, m_segmentTop, m_segmentSum;
+        void allocateScratch();
+        int32_t findRoot(int32_t element);
+        void computeSign(const float* dataIn, float* dataOut, const bool& negate, const float& param_e, const float& param_h);
+        TFCEHelper();
+        TFCEHelper& operator=(const TFCEHelper&);
+    public:
+        ///elements are the vertices in nodeList, connected by surface edges, areaData is indexed by vertex
+        TFCEHelper(const SurfaceFile* mySurf, const float* areaData, const std::vector<int64_t>& nodeList);
+        ///elements are the voxels in ijkList (3 values per voxel), connected by faces, with the volume of a voxel as their size
+        TFCEHelper(const VolumeSpace& mySpace, const std::vector<int64_t>& ijkList);
+        ///copies share the neighbor arrays, so make one copy per thread
+        TFCEHelper(const TFCEHelper& other);
+        int32_t getNumberOfElements() const { return m_graph->m_numElements; }
+        ///TFCE of positive and negative values, with the sign of the input - dataIn and dataOut are indexed by element, and must not overlap
+        void compute(const float* dataIn, float* dataOut, const float& param_e, const float& param_h);
+    };
+
+}
+
+#endif //__TFCE_HELPER_H__
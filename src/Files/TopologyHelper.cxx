@@ -21,6 +21,7 @@
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
 #include "CaretAssert.h"
+#include "CaretOMP.h"
 #include <cmath>
 
 using namespace caret;
@@ -96,12 +97,16 @@ TopologyHelperBase::TopologyHelperBase(const SurfaceFile* surfIn, bool sortFlag)
         }
     }//neighbor, edge and tile info done
     m_edgeInfo = tempEdgeInfo;//copy edge info into member to get allocation correct
-    CaretArray<int32_t> scratch2(m_numTris, -1);
     if (sortFlag)
-    {
-        for (int32_t i = 0; i < m_numNodes; ++i)
+    {//each node's sorting only changes that node's info, so give each thread its own mark arrays
+#pragma omp CARET_PAR
         {
-            sortNeighbors(surfIn, i, scratch, scratch2);//not a member function of node info object because I need m_edgeInfo and m_nodeInfo
+            CaretArray<int32_t> nodeScratch(m_numNodes, -1), tileScratch(m_numTris, -1);
+#pragma omp CARET_FOR schedule(dynamic, 1024)
+            for (int32_t i = 0; i < m_numNodes; ++i)
+            {
+                sortNeighbors(surfIn, i, nodeScratch, tileScratch);//not a member function of node info object because I need m_edgeInfo and m_nodeInfo
+            }
         }
         m_neighborsSorted = true;
     } else {
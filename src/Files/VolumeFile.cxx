@@ -228,7 +228,7 @@ void VolumeFile::readFile(const AString& filename)
         const NiftiHeader& inHeader = myIO.getHeader();
         for (int i = 0; i < (int)inHeader.m_extensions.size(); ++i)
         {//check for actually being cifti
-            if (inHeader.m_extensions[i]->m_ecode == NIFTI_ECODE_CIFTI)
+            if (inHeader.m_extensions[i]->m_ecode == NIFTI_ECODE_CIFTI || inHeader.m_extensions[i]->m_ecode == NIFTI_ECODE_WB_TILED_CIFTI)
             {
                 throw DataFileException(filename, "Cifti files cannot be used as volume files");
             }
@@ -0,0 +1,336 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "VolumeResamplingHelper.h"
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "CubicSpline.h"
+#include "Vector3D.h"
+#include "VolumeSpline.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const double BATCH_MEM_BUDGET_GB = 2.0;//total for the output frames and cubic splines held by one batch of frames
+}
+
+VolumeResamplingHelper::VolumeResamplingHelper(const VolumeSpace& inSpace, const FloatMatrix& targetToSource, const VolumeSpace& outSpace, const VolumeFile::InterpType& method)
+{
+    setup(inSpace, &targetToSource, NULL, outSpace, method);
+}
+
+VolumeResamplingHelper::VolumeResamplingHelper(const VolumeSpace& inSpace, const VolumeFile* warpfield, const VolumeSpace& outSpace, const VolumeFile::InterpType& method)
+{
+    CaretAssert(warpfield != NULL);
+    setup(inSpace, NULL, warpfield, outSpace, method);
+}
+
+void VolumeResamplingHelper::setup(const VolumeSpace& inSpace, const FloatMatrix* targetToSource, const VolumeFile* warpfield, const VolumeSpace& outSpace, const VolumeFile::InterpType& method)
+{
+    m_method = method;
+    const int64_t* inDims = inSpace.getDims(), *outDims = outSpace.getDims();
+    m_inDims[0] = inDims[0];
+    m_inDims[1] = inDims[1];
+    m_inDims[2] = inDims[2];
+    if (m_inDims[0] == 1 || m_inDims[1] == 1 || m_inDims[2] == 1)
+    {
+        m_method = VolumeFile::ENCLOSING_VOXEL;//VolumeFile does the same for single slices
+    }
+    m_outFrameSize = outDims[0] * outDims[1] * outDims[2];
+    m_sliceStart.resize(outDims[2] + 1);
+    Vector3D xvec, yvec, zvec, offset;
+    if (targetToSource != NULL)
+    {
+        const FloatMatrix& myMat = *targetToSource;
+        xvec[0] = myMat[0][0]; xvec[1] = myMat[1][0]; xvec[2] = myMat[2][0];
+        yvec[0] = myMat[0][1]; yvec[1] = myMat[1][1]; yvec[2] = myMat[2][1];
+        zvec[0] = myMat[0][2]; zvec[1] = myMat[1][2]; zvec[2] = myMat[2][2];
+        offset[0] = myMat[0][3]; offset[1] = myMat[1][3]; offset[2] = myMat[2][3];
+    }
+    const int64_t numSlices = outDims[2], sliceSize = outDims[0] * outDims[1];
+    vector<SliceVoxels> slices(numSlices);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t k = 0; k < numSlices; ++k)
+    {
+        SliceVoxels& mySlice = slices[k];
+        int64_t outIndex = k * sliceSize;
+        for (int64_t j = 0; j < outDims[1]; ++j)
+        {
+            for (int64_t i = 0; i < outDims[0]; ++i)
+            {
+                Vector3D outCoord, inCoord;
+                outSpace.indexToSpace(i, j, k, outCoord);
+                if (warpfield != NULL)
+                {
+                    bool validDisplacement = false;
+                    Vector3D displacement;
+                    displacement[0] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, &validDisplacement, 0);
+                    if (validDisplacement)
+                    {
+                        displacement[1] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 1);
+                        displacement[2] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 2);
+                        inCoord = outCoord + displacement;
+                    }
+                    if (!validDisplacement)
+                    {
+                        ++outIndex;
+                        continue;
+                    }
+                } else {
+                    inCoord = xvec * outCoord[0] + yvec * outCoord[1] + zvec * outCoord[2] + offset;
+                }
+                float index[3];
+                inSpace.spaceToIndex(inCoord, index);
+                if (addVoxel(index, mySlice)) mySlice.m_outIndex.push_back(outIndex);
+                ++outIndex;
+            }
+        }
+    }
+    int64_t numValid = 0;
+    for (int64_t k = 0; k < numSlices; ++k)
+    {
+        numValid += (int64_t)slices[k].m_outIndex.size();
+    }
+    m_outIndex.reserve(numValid);
+    if (m_method != VolumeFile::CUBIC) m_base.reserve(numValid);
+    if (m_method != VolumeFile::ENCLOSING_VOXEL)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            m_frac[axis].reserve(numValid);
+            if (m_method == VolumeFile::CUBIC) m_low[axis].reserve(numValid);
+        }
+    }
+    for (int64_t k = 0; k < numSlices; ++k)
+    {
+        m_sliceStart[k] = (int64_t)m_outIndex.size();
+        SliceVoxels& mySlice = slices[k];
+        m_outIndex.insert(m_outIndex.end(), mySlice.m_outIndex.begin(), mySlice.m_outIndex.end());
+        m_base.insert(m_base.end(), mySlice.m_base.begin(), mySlice.m_base.end());
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            m_frac[axis].insert(m_frac[axis].end(), mySlice.m_frac[axis].begin(), mySlice.m_frac[axis].end());
+            m_low[axis].insert(m_low[axis].end(), mySlice.m_low[axis].begin(), mySlice.m_low[axis].end());
+        }
+        mySlice = SliceVoxels();//free it as we go, so we don't hold two copies of everything
+    }
+    m_sliceStart[numSlices] = (int64_t)m_outIndex.size();
+}
+
+bool VolumeResamplingHelper::addVoxel(const float index[3], SliceVoxels& sliceOut) const
+{
+    switch (m_method)
+    {
+        case VolumeFile::ENCLOSING_VOXEL:
+        {
+            int64_t ijk[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                ijk[axis] = (int64_t)floor(0.5f + index[axis]);
+                if (ijk[axis] < 0 || ijk[axis] >= m_inDims[axis]) return false;
+            }
+            sliceOut.m_base.push_back(ijk[0] + m_inDims[0] * (ijk[1] + m_inDims[1] * ijk[2]));
+            return true;
+        }
+        case VolumeFile::TRILINEAR:
+        {
+            int64_t low[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                low[axis] = (int64_t)floor(index[axis]);
+                if (low[axis] < 0 || low[axis] + 1 >= m_inDims[axis]) return false;
+            }
+            sliceOut.m_base.push_back(low[0] + m_inDims[0] * (low[1] + m_inDims[1] * low[2]));
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                sliceOut.m_frac[axis].push_back(index[axis] - low[axis]);
+            }
+            return true;
+        }
+        case VolumeFile::CUBIC:
+        {
+            int64_t low[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                low[axis] = (int64_t)floor(index[axis]);
+                if (low[axis] < 0 || low[axis] + 1 >= m_inDims[axis]) return false;//same test as interpolateValue
+            }
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                sliceOut.m_low[axis].push_back((int32_t)low[axis]);
+                sliceOut.m_frac[axis].push_back(index[axis] - low[axis]);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void VolumeResamplingHelper::sampleSlice(const float* inFrame, float* outFrame, const int64_t& slice) const
+{
+    const int64_t start = m_sliceStart[slice], end = m_sliceStart[slice + 1];
+    const int64_t* outIndex = m_outIndex.data();
+    switch (m_method)
+    {
+        case VolumeFile::ENCLOSING_VOXEL:
+        {
+            const int64_t* base = m_base.data();
+            for (int64_t e = start; e < end; ++e)
+            {
+                outFrame[outIndex[e]] = inFrame[base[e]];
+            }
+            break;
+        }
+        case VolumeFile::TRILINEAR:
+        {
+            const int64_t* base = m_base.data();
+            const float* fracX = m_frac[0].data(), *fracY = m_frac[1].data(), *fracZ = m_frac[2].data();
+            const int64_t ystep = m_inDims[0], zstep = m_inDims[0] * m_inDims[1];
+            for (int64_t e = start; e < end; ++e)
+            {//same order of operations as interpolateValue
+                const float* corner = inFrame + base[e];
+                const float xhigh = fracX[e], xlow = 1.0f - xhigh;
+                const float yhigh = fracY[e], ylow = 1.0f - yhigh;
+                const float zhigh = fracZ[e], zlow = 1.0f - zhigh;
+                float x00 = xlow * corner[0] + xhigh * corner[1];
+                float x10 = xlow * corner[ystep] + xhigh * corner[ystep + 1];
+                float x01 = xlow * corner[zstep] + xhigh * corner[zstep + 1];
+                float x11 = xlow * corner[ystep + zstep] + xhigh * corner[ystep + zstep + 1];
+                float y0 = ylow * x00 + yhigh * x10;
+                float y1 = ylow * x01 + yhigh * x11;
+                outFrame[outIndex[e]] = zlow * y0 + zhigh * y1;
+            }
+            break;
+        }
+        case VolumeFile::CUBIC:
+        {
+            const int32_t* lowAxis[3] = { m_low[0].data(), m_low[1].data(), m_low[2].data() };
+            const float* fracAxis[3] = { m_frac[0].data(), m_frac[1].data(), m_frac[2].data() };
+            const int64_t stride[3] = { 1, m_inDims[0], m_inDims[0] * m_inDims[1] };
+            for (int64_t e = start; e < end; ++e)
+            {
+                int64_t offset[3][4];
+                float weight[3][4];
+                for (int axis = 0; axis < 3; ++axis)
+                {//same edge handling as VolumeSpline::sample
+                    const int64_t low = lowAxis[axis][e];
+                    CubicSpline mySpline = CubicSpline::bspline(fracAxis[axis][e], low < 1, low >= m_inDims[axis] - 2);
+                    for (int t = 0; t < 4; ++t)
+                    {
+                        const int64_t sample = min(max(low - 1 + t, (int64_t)0), m_inDims[axis] - 1);//off-edge samples have zero weight, but must still be in bounds
+                        offset[axis][t] = sample * stride[axis];
+                        weight[axis][t] = mySpline.getWeight(t);
+                    }
+                }
+                float ktemp[4];
+                for (int k = 0; k < 4; ++k)
+                {
+                    float jtemp[4];
+                    for (int j = 0; j < 4; ++j)
+                    {
+                        const float* row = inFrame + offset[2][k] + offset[1][j];
+                        jtemp[j] = row[offset[0][0]] * weight[0][0] + row[offset[0][1]] * weight[0][1] + row[offset[0][2]] * weight[0][2] + row[offset[0][3]] * weight[0][3];
+                    }
+                    ktemp[k] = jtemp[0] * weight[1][0] + jtemp[1] * weight[1][1] + jtemp[2] * weight[1][2] + jtemp[3] * weight[1][3];
+                }
+                outFrame[outIndex[e]] = ktemp[0] * weight[2][0] + ktemp[1] * weight[2][1] + ktemp[2] * weight[2][2] + ktemp[3] * weight[2][3];
+            }
+            break;
+        }
+    }
+}
+
+void VolumeResamplingHelper::resample(const VolumeFile* inVol, VolumeFile* outVol) const
+{
+    const int64_t* inDims = inVol->getDimensionsPtr(), *outDims = outVol->getDimensionsPtr();
+    CaretAssert(inDims[0] == m_inDims[0] && inDims[1] == m_inDims[1] && inDims[2] == m_inDims[2]);
+    CaretAssert(outDims[0] * outDims[1] * outDims[2] == m_outFrameSize);
+    CaretAssert(inDims[3] == outDims[3] && inDims[4] == outDims[4]);
+    const int64_t numMaps = inDims[3], numFrames = inDims[3] * inDims[4], numSlices = (int64_t)m_sliceStart.size() - 1;
+#ifdef CARET_OMP
+    int64_t batchSize = max(1, omp_get_max_threads());
+#else
+    int64_t batchSize = 1;
+#endif
+    double frameBytes = (double)m_outFrameSize * sizeof(float);
+    if (m_method == VolumeFile::CUBIC) frameBytes += (double)m_inDims[0] * m_inDims[1] * m_inDims[2] * sizeof(float);//the deconvolved frame
+    batchSize = max((int64_t)1, min(batchSize, (int64_t)(BATCH_MEM_BUDGET_GB * 1024 * 1024 * 1024 / frameBytes)));//slices still split across threads
+    //a batch of frames at a time, so that a few large frames or many small ones both keep all threads busy, without holding every output frame
+    vector<float> outScratch(min(batchSize, numFrames) * m_outFrameSize);
+    vector<VolumeSpline> splines;
+    vector<const float*> sampleFrom;
+    for (int64_t batchStart = 0; batchStart < numFrames; batchStart += batchSize)
+    {
+        const int64_t batchFrames = min(batchSize, numFrames - batchStart);
+        sampleFrom.resize(batchFrames);
+        if (m_method == VolumeFile::CUBIC)
+        {
+            splines.resize(batchFrames);
+            if (batchFrames > 1)
+            {
+#pragma omp CARET_PARFOR schedule(dynamic)
+                for (int64_t f = 0; f < batchFrames; ++f)
+                {
+                    const int64_t frame = batchStart + f;
+                    splines[f] = VolumeSpline(inVol->getFrame(frame % numMaps, frame / numMaps), m_inDims);
+                }
+            } else {
+                splines[0] = VolumeSpline(inVol->getFrame(batchStart % numMaps, batchStart / numMaps), m_inDims);//parallel internally
+            }
+            for (int64_t f = 0; f < batchFrames; ++f)
+            {
+                if (splines[f].ignoredNonNumeric())
+                {
+                    CaretLogWarning("ignored non-numeric input value when calculating cubic splines in volume '" + inVol->getFileName() + "', frame #" + AString::number(batchStart + f + 1));
+                }
+                sampleFrom[f] = splines[f].getDeconvolved();
+            }
+        } else {
+            for (int64_t f = 0; f < batchFrames; ++f)
+            {
+                const int64_t frame = batchStart + f;
+                sampleFrom[f] = inVol->getFrame(frame % numMaps, frame / numMaps);
+            }
+        }
+        for (int64_t i = 0; i < batchFrames * m_outFrameSize; ++i)
+        {
+            outScratch[i] = VolumeFile::INVALID_INTERP_VALUE;
+        }
+        const int64_t numJobs = batchFrames * numSlices;
+#pragma omp CARET_PARFOR schedule(dynamic)
+        for (int64_t job = 0; job < numJobs; ++job)
+        {
+            const int64_t f = job / numSlices, slice = job % numSlices;
+            sampleSlice(sampleFrom[f], outScratch.data() + f * m_outFrameSize, slice);
+        }
+        for (int64_t f = 0; f < batchFrames; ++f)
+        {
+            const int64_t frame = batchStart + f;
+            outVol->setFrame(outScratch.data() + f * m_outFrameSize, frame % numMaps, frame / numMaps);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef __VOLUME_RESAMPLING_HELPER_H__
+#define __VOLUME_RESAMPLING_HELPER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+//NOTE: the sampling geometry of a volume resampling is the same for every frame, so this computes the source voxels and interpolation
+//      weights of each output voxel once (in the constructor), then applies them to every frame.  The results match
+//      VolumeFile::interpolateValue, including which output voxels are invalid (they get VolumeFile::INVALID_INTERP_VALUE).
+//      CUBIC stores the low corner and fractional position, and computes the separable 4x4x4 b-spline weights from them while sampling
+//      the deconvolved frame from VolumeSpline, because storing the 12 weights and offsets would take several times the memory of the frames.
+//
+//      The weights are stored as separate arrays per axis so that the sampling loops are simple gathers the compiler can vectorize.
+
+#include "FloatMatrix.h"
+#include "VolumeFile.h"
+
+#include <vector>
+#include "stdint.h"
+
+namespace caret
+{
+    class VolumeResamplingHelper
+    {
+        VolumeFile::InterpType m_method;
+        int64_t m_inDims[3], m_outFrameSize;
+        std::vector<int64_t> m_outIndex, m_sliceStart;//which output voxels are valid, and where each output slice starts in that list
+        std::vector<int64_t> m_base;//ENCLOSING_VOXEL and TRILINEAR: the input voxel, or low corner
+        std::vector<float> m_frac[3];//TRILINEAR and CUBIC: position between the low corner and the next voxel along each axis
+        std::vector<int32_t> m_low[3];//CUBIC: low corner along each axis, needed for the edge handling
+
+        struct SliceVoxels
+        {//the valid voxels of one output slice, with the same layout as the members above, so slices can be set up in parallel
+            std::vector<int64_t> m_outIndex, m_base;
+            std::vector<float> m_frac[3];
+            std::vector<int32_t> m_low[3];
+        };
+        void setup(const VolumeSpace& inSpace, const FloatMatrix* targetToSource, const VolumeFile* warpfield, const VolumeSpace& outSpace, const VolumeFile::InterpType& method);
+        bool addVoxel(const float index[3], SliceVoxels& sliceOut) const;
+        void sampleSlice(const float* inFrame, float* outFrame, const int64_t& slice) const;
+        VolumeResamplingHelper();
+    public:
+        ///targetToSource maps output coordinates to input coordinates, like the inverse of the affine given to AlgorithmVolumeAffineResample
+        VolumeResamplingHelper(const VolumeSpace& inSpace, const FloatMatrix& targetToSource, const VolumeSpace& outSpace, const VolumeFile::InterpType& method);
+        ///warpfield is sampled at the output coordinate, and gives the displacement to the input coordinate
+        VolumeResamplingHelper(const VolumeSpace& inSpace, const VolumeFile* warpfield, const VolumeSpace& outSpace, const VolumeFile::InterpType& method);
+
+        ///resample every frame of inVol into outVol, which must already have the output space and the same number of frames
+        void resample(const VolumeFile* inVol, VolumeFile* outVol) const;
+    };
+}
+
+#endif //__VOLUME_RESAMPLING_HELPER_H__
@@ -49,6 +49,11 @@ const int32_t NIFTI_INTENT_CONNECTIVITY_PARCELLATED_PARCELLATED_SERIES=3011;
 const int32_t NIFTI_INTENT_CONNECTIVITY_PARCELLATED_PARCELLATED_SCALAR=3012;
 
 const int32_t NIFTI_ECODE_CIFTI=32;
+//NOT a registered ecode, only workbench reads it: cifti XML stored with the data in square tiles instead of the standard layout, see CiftiFile.cxx
+//the header also gets the private intent code below and the actual tile dimensions, rather than the cifti intent and matrix dimensions,
+//so that other readers don't mistake the tiles for rows of a cifti matrix
+const int32_t NIFTI_ECODE_WB_TILED_CIFTI=5742;
+const int32_t NIFTI_INTENT_WB_TILED_CIFTI=5742;
 
 #define NIFTI2_VERSION(h) \
     (h).sizeof_hdr == 348 ? 1 : (\
@@ -28,14 +28,17 @@
 #include "ByteOrderEnum.h"
 #include "ByteSwapping.h"
 #include "CaretAssert.h"
+#include "CaretBinaryFile.h"
 #include "CaretLogger.h"
 #include "DataCompressZLib.h"
+#include "DataFileException.h"
 
 //#include "FileUtilities.h"
 #include "FastStatistics.h"
 #include "GiftiDataArray.h"
 #include "GiftiFile.h"
 #include "GiftiMetaDataXmlElements.h"
+#include "GiftiStreamDecoder.h"
 #include "GiftiXmlElements.h"
 #include "Histogram.h"
 #include "NiftiEnums.h"
@@ -589,15 +592,13 @@ GiftiDataArray::readFromText(const AString text,
                              const int64_t externalFileOffsetForReading,
                              const bool isReadOnlyMetaData)
 {
-   const NiftiDataTypeEnum::Enum requiredDataType = dataType;
-   dataType = dataTypeForReading;
-   encoding = encodingForReading;
-   endian   = dataEndianForReading;
-   arraySubscriptingOrder = arraySubscriptingOrderForReading;
-   setDimensions(dimensionsForReading);
-   if (dimensionsForReading.size() == 0) {
-      throw GiftiException("Data array has no dimensions.");
-   }
+   NiftiDataTypeEnum::Enum requiredDataType;
+   unsigned char* dataBuffer = startBinaryRead(dataEndianForReading,
+                                               arraySubscriptingOrderForReading,
+                                               dataTypeForReading,
+                                               dimensionsForReading,
+                                               encodingForReading,
+                                               requiredDataType);
    //setExternalFileInformation(externalFileNameForReading,
    //                           externalFileOffsetForReading);//TSC: don't set the external filename on the array, because that is what it uses when writing the array
                               
@@ -651,21 +652,18 @@ GiftiDataArray::readFromText(const AString text,
             }
             break;
           case GiftiEncodingEnum::BASE64_BINARY:
+          case GiftiEncodingEnum::GZIP_BASE64_BINARY:
             {
                //
-               // Decode the Base64 data using VTK's algorithm
+               // Decode (and uncompress) straight into the data, GiftiFileSaxReader normally
+               // does this while parsing instead of calling this function
                //
-               const uint64_t numDecoded =
-                     Base64::decode((const unsigned char*)(text.toStdString().c_str()),
-                                                data.size(),
-                                                &data[0]);
-               if (numDecoded != data.size()) {
-                  std::ostringstream str;
-                  str << "Decoding of Base64 Binary data failed.\n"
-                   << "Decoded " << AString::number(numDecoded).toStdString() << " bytes but should be "
-                      << AString::number(static_cast<int>(data.size())).toStdString() << " bytes.";
-                  throw GiftiException(AString::fromStdString(str.str()));
-               }
+               GiftiStreamDecoder decoder(dataBuffer,
+                                          data.size(),
+                                          (encoding == GiftiEncodingEnum::GZIP_BASE64_BINARY));
+               const QByteArray textBytes = text.toLatin1();
+               decoder.addText(textBytes.constData(), textBytes.size());
+               decoder.finish();
                
                //
                // Is byte swapping needed ?
@@ -675,148 +673,124 @@ GiftiDataArray::readFromText(const AString text,
                }
             }
             break;
-          case GiftiEncodingEnum::GZIP_BASE64_BINARY:
+          case GiftiEncodingEnum::EXTERNAL_FILE_BINARY:
             {
-               //
-               // Decode the Base64 data using VTK's algorithm
-               //
-               unsigned char* dataBuffer = new unsigned char[data.size()];
-               //const char* textChars = text.toLatin1().constData();
-               const uint64_t numDecoded =
-                     Base64::decode((unsigned char*)text.toStdString().c_str(),
-                                                data.size(),
-                                                dataBuffer);
-               if (numDecoded == 0) {
-                   std::ostringstream str;
-                   str << "Decoding of GZip Base64 Binary data failed."
-                   << "Decoded " << AString::number(numDecoded).toStdString() << " bytes but should be "
-                   << AString::number(static_cast<int>(data.size())).toStdString() << " bytes.";
-                   throw GiftiException(AString::fromStdString(str.str()));
-               }
-               
-               
-               //
-               // Uncompress the data using VTK's algorithm
-               // 
-                DataCompressZLib compressor;
-                const uint64_t uncompressedDataLength = 
-                                   compressor.uncompressData(dataBuffer,
-                                                          numDecoded,
-                                                          (unsigned char*)&data[0],
-                                                          data.size());
-               if (uncompressedDataLength != data.size()) {
-                  std::ostringstream str;
-                  str << "Decompression of Binary data failed.\n"
-                   << "Uncompressed " << AString::number(uncompressedDataLength).toStdString() << " bytes but should be "
-                   << AString::number(static_cast<uint64_t>(data.size())).toStdString() << " bytes.";
-                  throw GiftiException(AString::fromStdString(str.str()));
+               if (externalFileNameForReading.length() <= 0) {
+                  throw GiftiException("External file name is empty.");
                }
                
                //
-               // Free memory
+               // Memory map the file when possible, so the data is copied
+               // directly from the page cache
                //
-               delete[] dataBuffer;
+               if (dataTypeSize == 0) {
+                  throw GiftiException("DataType " + NiftiDataTypeEnum::toName(dataType) + " not supported in GIFTI");
+               }
+               const int64_t numberOfBytesToRead = numElements * dataTypeSize;
+               CaretAssert(numberOfBytesToRead <= static_cast<int64_t>(data.size()));
+               try {
+                  CaretBinaryFile extBinFile;
+                  extBinFile.openMapped(externalFileNameForReading);
+                  extBinFile.readAt(dataBuffer,
+                                    numberOfBytesToRead,
+                                    externalFileOffsetForReading);
+               }
+               catch (const DataFileException& e) {
+                  throw GiftiException("Tried to read "
+                                       + AString::number(numberOfBytesToRead)
+                                       + " bytes from offset "
+                                       + AString::number(externalFileOffsetForReading)
+                                       + " in \""
+                                       + externalFileNameForReading
+                                       + "\" but failed: "
+                                       + e.whatString());
+               }
                
                //
-               // Is byte swapping needed ? 
+               // Is byte swapping needed ?
                //
                if (endian != getSystemEndian()) {
                   byteSwapData(getSystemEndian());
                }
             }
             break;
-          case GiftiEncodingEnum::EXTERNAL_FILE_BINARY:
-            {
-               if (externalFileNameForReading.length() <= 0) {
-                  throw GiftiException("External file name is empty.");
-               }
-               
-                std::ifstream extBinFile(externalFileNameForReading.toStdString().c_str(),
-                                         std::ifstream::in | std::ifstream::binary);
-                if (extBinFile.good() == false) {
-                        throw GiftiException("Error opening \""
-                                            + externalFileNameForReading
-                                            + "\"");
-                }
-                else {
-                  //
-                  // Move to the offset of the data
-                  //
-                  extBinFile.seekg(externalFileOffsetForReading, std::ios::beg);
-                  if (extBinFile.good() == false) {
-                        throw GiftiException("Error seeking to \""
-                                             + AString::number(externalFileOffsetForReading)
-                                             + "\" in \""
-                                             + externalFileNameForReading
-                                             + "\"");
-                  }
-                    
-                  //
-                  // Set the number of bytes that must be read
-                  //
-                    std::streamsize numberOfBytesToRead = 0;
-                  char* pointerToForReadingData = NULL;
-                  switch (dataType) {
-                     case NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32:
-                        numberOfBytesToRead = numElements * sizeof(float);
-                        pointerToForReadingData = (char*)dataPointerFloat;
-                        break;
-                     case NiftiDataTypeEnum::NIFTI_TYPE_INT32:
-                        numberOfBytesToRead = numElements * sizeof(int32_t);
-                        pointerToForReadingData = (char*)dataPointerInt;
-                        break;
-                     case NiftiDataTypeEnum::NIFTI_TYPE_UINT8:
-                        numberOfBytesToRead = numElements * sizeof(uint8_t);
-                        pointerToForReadingData = (char*)dataPointerUByte;
-                        break;
-                      default:
-                          throw GiftiException("DataType " + NiftiDataTypeEnum::toName(dataType) + " not supported in GIFTI");
-                  }
-               
-                  //
-                  // Read the data
-                  //
-                  extBinFile.read((char*)pointerToForReadingData,
-                                    numberOfBytesToRead);
-                  if(extBinFile.good() == false) {
-                     throw GiftiException("Tried to read "
-                                         + AString::number((int64_t)numberOfBytesToRead)
-                                         + " from "
-                                         + externalFileOffsetForReading
-                                         + " but failed");
-                  }
-                  
-                  //
-                  // Is byte swapping needed ?
-                  //
-                  if (endian != getSystemEndian()) {
-                     byteSwapData(getSystemEndian());
-                  }
-               }
-            }
-            break;
       }
    
-      //
-      // Check if data type needs to be converted
-      //
-      if (requiredDataType != dataType) {
-          if (intent != NiftiIntentEnum::NIFTI_INTENT_POINTSET) {
-            convertToDataType(requiredDataType);
-         }
-      }
-      
-       //
-       // Are array indices in opposite order
-       //
-       if (arraySubscriptingOrderForReading == GiftiArrayIndexingOrderEnum::COLUMN_MAJOR_ORDER) {
-           convertArrayIndexingOrder();
-       }
+      convertAfterReading(requiredDataType);
    } // If NOT metadata only
    
    setModified();
 }
 
+/**
+ * Set up the data array for reading binary data, and allocate it.
+ * 
+ * @param requiredDataTypeOut
+ *    Output, the data type the array must be converted to after reading,
+ *    pass it to finishBinaryRead().
+ * @return
+ *    Pointer to the data, which is getDataSizeInBytes() bytes long.
+ */
+unsigned char*
+GiftiDataArray::startBinaryRead(const GiftiEndianEnum::Enum dataEndianForReading,
+                                const GiftiArrayIndexingOrderEnum::Enum arraySubscriptingOrderForReading,
+                                const NiftiDataTypeEnum::Enum dataTypeForReading,
+                                const std::vector<int64_t>& dimensionsForReading,
+                                const GiftiEncodingEnum::Enum encodingForReading,
+                                NiftiDataTypeEnum::Enum& requiredDataTypeOut)
+{
+   requiredDataTypeOut = dataType;
+   dataType = dataTypeForReading;
+   encoding = encodingForReading;
+   endian   = dataEndianForReading;
+   arraySubscriptingOrder = arraySubscriptingOrderForReading;
+   setDimensions(dimensionsForReading);
+   if (dimensionsForReading.size() == 0) {
+      throw GiftiException("Data array has no dimensions.");
+   }
+   if (data.empty()) {
+      return NULL;
+   }
+   return &data[0];
+}
+
+/**
+ * Finish reading after the data from startBinaryRead() has been filled
+ * in: byte swap, convert the data type, and convert the indexing order.
+ */
+void
+GiftiDataArray::finishBinaryRead(const NiftiDataTypeEnum::Enum requiredDataType)
+{
+   if (endian != getSystemEndian()) {
+      byteSwapData(getSystemEndian());
+   }
+   convertAfterReading(requiredDataType);
+   setModified();
+}
+
+/**
+ * Convert to the required data type and to row major order after reading.
+ */
+void
+GiftiDataArray::convertAfterReading(const NiftiDataTypeEnum::Enum requiredDataType)
+{
+   //
+   // Check if data type needs to be converted
+   //
+   if (requiredDataType != dataType) {
+      if (intent != NiftiIntentEnum::NIFTI_INTENT_POINTSET) {
+         convertToDataType(requiredDataType);
+      }
+   }
+   
+   //
+   // Are array indices in opposite order
+   //
+   if (arraySubscriptingOrder == GiftiArrayIndexingOrderEnum::COLUMN_MAJOR_ORDER) {
+      convertArrayIndexingOrder();
+   }
+}
+
 /**
  * convert array indexing order of data.
  */
@@ -123,6 +123,17 @@ namespace caret {
                           const int64_t externalFileOffsetForReading,
                           const bool isReadOnlyMetaData);
         
+        // set up and allocate for binary data that the caller decodes into the returned pointer (getDataSizeInBytes() bytes)
+        unsigned char* startBinaryRead(const GiftiEndianEnum::Enum dataEndianForReading,
+                                       const GiftiArrayIndexingOrderEnum::Enum arraySubscriptingOrderForReading,
+                                       const NiftiDataTypeEnum::Enum dataTypeForReading,
+                                       const std::vector<int64_t>& dimensionsForReading,
+                                       const GiftiEncodingEnum::Enum encodingForReading,
+                                       NiftiDataTypeEnum::Enum& requiredDataTypeOut);
+        
+        // byte swap and convert after the data from startBinaryRead has been filled in
+        void finishBinaryRead(const NiftiDataTypeEnum::Enum requiredDataType);
+        
         // write the data as XML
         void writeAsXML(std::ostream& stream, 
                         std::ostream* externalBinaryOutputStream,
@@ -324,6 +335,9 @@ namespace caret {
         /// convert array indexing order of data
         void convertArrayIndexingOrder();
         
+        // convert data type and indexing order after reading
+        void convertAfterReading(const NiftiDataTypeEnum::Enum requiredDataType);
+        
         /// the data
         std::vector<uint8_t> data;
         
@@ -18,6 +18,7 @@
  */
 /*LICENSE_END*/
 
+#include <cstring>
 #include <sstream>
 
 #include "CaretLogger.h"
@@ -28,6 +29,7 @@
 #include "GiftiFileSaxReader.h"
 #include "GiftiLabelTableSaxReader.h"
 #include "GiftiMetaDataSaxReader.h"
+#include "GiftiStreamDecoder.h"
 #include "GiftiXmlElements.h"
 
 #include "NiftiEnums.h"
@@ -50,6 +52,7 @@ GiftiFileSaxReader::GiftiFileSaxReader(GiftiFile* giftiFileIn)
     this->labelTableSaxReader = NULL;
     this->metaDataSaxReader = NULL;
     this->dataArrayDataHasBeenRead = false;
+    this->requiredDataTypeForStreamedData = NiftiDataTypeEnum::NIFTI_TYPE_FLOAT32;
 }
 
 /**
@@ -138,6 +141,7 @@ GiftiFileSaxReader::startElement(const AString& namespaceURI,
          }
          else if (qName == GiftiXmlElements::TAG_DATA) {
             this->state = STATE_DATA_ARRAY_DATA;
+            this->startStreamedArrayData();
          }
          else if (qName == GiftiXmlElements::TAG_COORDINATE_TRANSFORMATION_MATRIX) {
             this->state = STATE_DATA_ARRAY_MATRIX;
@@ -516,6 +520,12 @@ GiftiFileSaxReader::processArrayData()
 
     CaretAssert(dataArray);
     try {
+        if (this->streamDecoder != NULL) {
+            this->streamDecoder->finish();
+            this->streamDecoder.grabNew(NULL);
+            dataArray->finishBinaryRead(this->requiredDataTypeForStreamedData);
+            return;
+        }
         dataArray->readFromText(elementText,
                                 this->endianForReadingArrayData,
                                 arraySubscriptingOrderForReadingArrayData,
@@ -531,6 +541,38 @@ GiftiFileSaxReader::processArrayData()
     }
 }
 
+/**
+ * Set up decoding of BASE64_BINARY and GZIP_BASE64_BINARY data as
+ * the characters arrive, straight into the data array, so that the
+ * (possibly very large) text doesn't need to be kept.
+ */
+void
+GiftiFileSaxReader::startStreamedArrayData()
+{
+    if (this->giftiFile->getReadMetaDataOnlyFlag()) {
+        return;
+    }
+    if ((encodingForReadingArrayData != GiftiEncodingEnum::BASE64_BINARY)
+        && (encodingForReadingArrayData != GiftiEncodingEnum::GZIP_BASE64_BINARY)) {
+        return;
+    }
+    CaretAssert(dataArray);
+    try {
+        unsigned char* dataBuffer = dataArray->startBinaryRead(this->endianForReadingArrayData,
+                                                               arraySubscriptingOrderForReadingArrayData,
+                                                               dataTypeForReadingArrayData,
+                                                               dimensionsForReadingArrayData,
+                                                               encodingForReadingArrayData,
+                                                               this->requiredDataTypeForStreamedData);
+        this->streamDecoder.grabNew(new GiftiStreamDecoder(dataBuffer,
+                                                           dataArray->getDataSizeInBytes(),
+                                                           (encodingForReadingArrayData == GiftiEncodingEnum::GZIP_BASE64_BINARY)));
+    }
+    catch (const GiftiException& e) {
+        throw XmlSaxParserException(e.whatString());
+    }
+}
+
 /**
  * get characters in an element.
  */
@@ -543,6 +585,18 @@ GiftiFileSaxReader::characters(const char* ch)
     else if (this->labelTableSaxReader != NULL) {
         this->labelTableSaxReader->characters(ch);
     }
+    else if (this->streamDecoder != NULL) {
+        try {
+            this->streamDecoder->addText(ch, strlen(ch));
+        }
+        catch (const GiftiException& e) {
+            throw XmlSaxParserException(e.whatString());
+        }
+    }
+    else if ((this->state == STATE_DATA_ARRAY_DATA)
+             && this->giftiFile->getReadMetaDataOnlyFlag()) {
+        //array data isn't used when only reading metadata
+    }
     else {
         elementText += ch;
     }
@@ -41,6 +41,7 @@ namespace caret {
     class GiftiFile;
     class GiftiLabelTableSaxReader;
     class GiftiMetaDataSaxReader;
+    class GiftiStreamDecoder;
     class GiftiFile;
     class Matrix4x4;
     class XmlAttributes;
@@ -106,6 +107,9 @@ namespace caret {
         // create a data array
         void createDataArray(const XmlAttributes& attributes);
         
+        // start decoding base64 array data as it arrives, instead of saving the text
+        void startStreamedArrayData();
+        
         /// file reading state
         STATE state;
         
@@ -162,6 +166,12 @@ namespace caret {
         
         /// tracks if data has been read since external binary may not have DATA tag
         bool dataArrayDataHasBeenRead;
+        
+        /// decoder for base64 encoded array data, only while reading its DATA element
+        CaretPointer<GiftiStreamDecoder> streamDecoder;
+        
+        /// data type the array must be converted to after streamed decoding
+        NiftiDataTypeEnum::Enum requiredDataTypeForStreamedData;
     };
 
 } // namespace
@@ -0,0 +1,254 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "GiftiStreamDecoder.h"
+
+#include "AString.h"
+#include "Base64.h"
+#include "CaretAssert.h"
+#include "GiftiException.h"
+
+#include "zlib.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int64_t COMPRESSED_BUFFER_SIZE = 1 << 16;
+    
+    inline int base64Value(const unsigned char c)
+    {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+') return 62;
+        if (c == '/') return 63;
+        return -1;
+    }
+    
+    inline bool isWhitespace(const unsigned char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+}
+
+GiftiStreamDecoder::GiftiStreamDecoder(unsigned char* output, const int64_t& outputSize, const bool& compressed)
+{
+    m_output = output;
+    m_outputSize = outputSize;
+    m_written = 0;
+    m_compressed = compressed;
+    m_paddingSeen = false;
+    m_streamEnded = false;
+    m_quadCount = 0;
+    m_compressedUsed = 0;
+    m_zStream = NULL;
+    if (m_compressed)
+    {
+        m_compressedBuffer = CaretArray<unsigned char>(COMPRESSED_BUFFER_SIZE);
+        m_zStream = new z_stream();
+        memset(m_zStream, 0, sizeof(z_stream));
+        if (inflateInit2(m_zStream, 15 + 32) != Z_OK)//32 means accept either zlib or gzip headers
+        {
+            delete m_zStream;
+            m_zStream = NULL;
+            throw GiftiException("failed to initialize zlib for decompressing data array");
+        }
+    }
+}
+
+GiftiStreamDecoder::~GiftiStreamDecoder()
+{
+    if (m_zStream != NULL)
+    {
+        inflateEnd(m_zStream);
+        delete m_zStream;
+    }
+}
+
+void GiftiStreamDecoder::getDecodeSpace(unsigned char*& spaceOut, int64_t& sizeOut)
+{
+    if (m_compressed)
+    {
+        if (COMPRESSED_BUFFER_SIZE - m_compressedUsed < 32)//Base64::decodeRun wants some room
+        {
+            inflateBuffer();
+        }
+        spaceOut = m_compressedBuffer.getArray() + m_compressedUsed;
+        sizeOut = COMPRESSED_BUFFER_SIZE - m_compressedUsed;
+    } else {
+        spaceOut = m_output + m_written;
+        sizeOut = m_outputSize - m_written;
+    }
+}
+
+void GiftiStreamDecoder::decodedBytes(const int64_t& count)
+{
+    if (m_compressed)
+    {
+        m_compressedUsed += count;
+        CaretAssert(m_compressedUsed <= COMPRESSED_BUFFER_SIZE);
+    } else {
+        m_written += count;
+        CaretAssert(m_written <= m_outputSize);
+    }
+}
+
+void GiftiStreamDecoder::addBytes(const unsigned char* bytes, const int& count)
+{
+    unsigned char* space = NULL;
+    int64_t spaceSize = 0;
+    getDecodeSpace(space, spaceSize);
+    if (spaceSize < count)
+    {//can only happen when not compressed
+        throw GiftiException("Decoding of Base64 Binary data failed.\nData is larger than the expected " + AString::number(m_outputSize) + " bytes.");
+    }
+    memcpy(space, bytes, count);
+    decodedBytes(count);
+}
+
+void GiftiStreamDecoder::addText(const char* text, const int64_t& length)
+{
+    int64_t i = 0;
+    while (i < length)
+    {
+        if (m_paddingSeen) break;//like Base64::decode, ignore anything after padding
+        if (m_quadCount == 0 && length - i >= 4)
+        {//fast path for runs of whole groups
+            unsigned char* space = NULL;
+            int64_t spaceSize = 0, used = 0;
+            getDecodeSpace(space, spaceSize);
+            decodedBytes(Base64::decodeRun(text + i, length - i, space, spaceSize, &used));
+            i += used;
+            if (i >= length) break;
+        }
+        const unsigned char c = (unsigned char)text[i];
+        ++i;
+        if (isWhitespace(c)) continue;
+        unsigned char bytes[3];
+        if (c == '=')
+        {
+            switch (m_quadCount)
+            {
+                case 0://extra padding after a complete group, like the end marker of Base64::encode, Base64::decode also stops here
+                    break;
+                case 2:
+                    bytes[0] = (unsigned char)((m_quad[0] << 2) | (m_quad[1] >> 4));
+                    addBytes(bytes, 1);
+                    break;
+                case 3:
+                    bytes[0] = (unsigned char)((m_quad[0] << 2) | (m_quad[1] >> 4));
+                    bytes[1] = (unsigned char)((m_quad[1] << 4) | (m_quad[2] >> 2));
+                    addBytes(bytes, 2);
+                    break;
+                default:
+                    throw GiftiException("Decoding of Base64 Binary data failed.\nPadding character found in an invalid position.");
+            }
+            m_quadCount = 0;
+            m_paddingSeen = true;
+            continue;
+        }
+        int value = base64Value(c);
+        if (value < 0)
+        {
+            throw GiftiException("Decoding of Base64 Binary data failed.\nInvalid character with code " + AString::number((int)c) + " found.");
+        }
+        m_quad[m_quadCount] = (unsigned char)value;
+        ++m_quadCount;
+        if (m_quadCount == 4)
+        {
+            bytes[0] = (unsigned char)((m_quad[0] << 2) | (m_quad[1] >> 4));
+            bytes[1] = (unsigned char)((m_quad[1] << 4) | (m_quad[2] >> 2));
+            bytes[2] = (unsigned char)((m_quad[2] << 6) | m_quad[3]);
+            addBytes(bytes, 3);
+            m_quadCount = 0;
+        }
+    }
+}
+
+void GiftiStreamDecoder::inflateBuffer()
+{
+    CaretAssert(m_zStream != NULL);
+    m_zStream->next_in = m_compressedBuffer.getArray();
+    m_zStream->avail_in = (uInt)m_compressedUsed;
+    while (!m_streamEnded)
+    {
+        const uInt chunk = (uInt)min(m_outputSize - m_written, int64_t(1) << 30);//avail_out is only 32 bits
+        m_zStream->next_out = m_output + m_written;
+        m_zStream->avail_out = chunk;
+        int ret = inflate(m_zStream, Z_NO_FLUSH);
+        m_written += chunk - m_zStream->avail_out;
+        if (ret == Z_STREAM_END)
+        {
+            m_streamEnded = true;
+        } else if (ret == Z_BUF_ERROR) {
+            break;//no progress possible, out of input or out of room
+        } else if (ret != Z_OK) {
+            throw GiftiException("Decompression of Binary data failed.\n" + AString(m_zStream->msg != NULL ? m_zStream->msg : "unknown zlib error"));
+        } else if (m_zStream->avail_in == 0 && m_zStream->avail_out != 0) {
+            break;//used all input, and had room for all output
+        }
+    }
+    if (!m_streamEnded && m_zStream->avail_in != 0)
+    {
+        throw GiftiException("Decompression of Binary data failed.\nData is larger than the expected " + AString::number(m_outputSize) + " bytes.");
+    }
+    m_compressedUsed = 0;//anything after the end of the compressed stream is ignored
+}
+
+void GiftiStreamDecoder::finish()
+{
+    unsigned char bytes[2];
+    switch (m_quadCount)
+    {//tolerate missing padding
+        case 0:
+            break;
+        case 2:
+            bytes[0] = (unsigned char)((m_quad[0] << 2) | (m_quad[1] >> 4));
+            addBytes(bytes, 1);
+            break;
+        case 3:
+            bytes[0] = (unsigned char)((m_quad[0] << 2) | (m_quad[1] >> 4));
+            bytes[1] = (unsigned char)((m_quad[1] << 4) | (m_quad[2] >> 2));
+            addBytes(bytes, 2);
+            break;
+        default:
+            throw GiftiException("Decoding of Base64 Binary data failed.\nData ends in the middle of a group of 4 characters.");
+    }
+    m_quadCount = 0;
+    if (m_compressed)
+    {
+        inflateBuffer();
+        if (!m_streamEnded)
+        {
+            throw GiftiException("Decompression of Binary data failed.\nCompressed data is incomplete, uncompressed "
+                                 + AString::number(m_written) + " bytes but should be " + AString::number(m_outputSize) + " bytes.");
+        }
+    }
+    if (m_written != m_outputSize)
+    {
+        throw GiftiException(AString(m_compressed ? "Decompression" : "Decoding") + " of Binary data failed.\nDecoded "
+                             + AString::number(m_written) + " bytes but should be " + AString::number(m_outputSize) + " bytes.");
+    }
+}
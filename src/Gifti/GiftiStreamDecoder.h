@@ -0,0 +1,68 @@
+#ifndef __GIFTI_STREAM_DECODER_H__
+#define __GIFTI_STREAM_DECODER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CaretPointer.h"
+
+#include "stdint.h"
+
+struct z_stream_s;//so zlib.h isn't needed here
+
+namespace caret {
+    
+    /// decodes BASE64_BINARY or GZIP_BASE64_BINARY data array text in pieces, as the XML parser delivers it, directly into the array's memory
+    class GiftiStreamDecoder
+    {
+    public:
+        ///output must have room for exactly outputSize bytes, which is also how many must be decoded by finish()
+        GiftiStreamDecoder(unsigned char* output, const int64_t& outputSize, const bool& compressed);
+        ~GiftiStreamDecoder();
+        
+        ///decode some text, whitespace is skipped, throws GiftiException on invalid characters or too much data
+        void addText(const char* text, const int64_t& length);
+        
+        ///finish decoding, throws GiftiException if the wrong amount of data was decoded
+        void finish();
+        
+        int64_t getBytesDecoded() const { return m_written; }
+    private:
+        GiftiStreamDecoder(const GiftiStreamDecoder&);
+        GiftiStreamDecoder& operator=(const GiftiStreamDecoder&);
+        
+        unsigned char* m_output;
+        int64_t m_outputSize, m_written;
+        bool m_compressed, m_paddingSeen, m_streamEnded;
+        unsigned char m_quad[4];//base64 values of a partial group of 4 characters
+        int m_quadCount;
+        CaretArray<unsigned char> m_compressedBuffer;//base64 decoded, but not yet inflated
+        int64_t m_compressedUsed;
+        z_stream_s* m_zStream;
+        
+        void getDecodeSpace(unsigned char*& spaceOut, int64_t& sizeOut);
+        void decodedBytes(const int64_t& count);
+        void addBytes(const unsigned char* bytes, const int& count);
+        void inflateBuffer();
+    };
+    
+}
+
+#endif //__GIFTI_STREAM_DECODER_H__
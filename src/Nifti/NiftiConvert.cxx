@@ -0,0 +1,198 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "NiftiConvert.h"
+
+#include "ByteSwapping.h"
+
+#include <cmath>
+#include <limits>
+
+#ifdef CARET_DOTFCN
+extern "C"
+{
+#include "cpuinfo.h"
+}
+#endif
+
+using namespace caret;
+using namespace std;
+
+namespace caret
+{//AVX2 kernels, in their own file because it is compiled with -mavx2
+#ifdef CARET_DOTFCN
+    void niftiFloatFromInt16AVX2(float* out, const int16_t* in, int64_t count, bool doScale, double mult, double offset);
+    void niftiFloatFromUint8AVX2(float* out, const uint8_t* in, int64_t count, bool doScale, double mult, double offset);
+    void niftiFloatFromFloatAVX2(float* out, const float* in, int64_t count, bool doScale, double mult, double offset);
+    void niftiInt16FromFloatAVX2(int16_t* out, const float* in, int64_t count, bool doScale, double mult, double offset);
+    void niftiUint8FromFloatAVX2(uint8_t* out, const float* in, int64_t count, bool doScale, double mult, double offset);
+    void niftiSwap16AVX2(void* data, int64_t count);
+    void niftiSwap32AVX2(void* data, int64_t count);
+    void niftiSwap64AVX2(void* data, int64_t count);
+#endif
+}
+
+namespace
+{//plain versions, kept simple so the compiler can vectorize them where possible
+    template<typename FROM>
+    void floatFromNaive(float* out, const FROM* in, int64_t count, bool doScale, double mult, double offset)
+    {
+        if (doScale)
+        {
+            for (int64_t i = 0; i < count; ++i)
+            {
+                out[i] = (float)(offset + mult * (double)in[i]);
+            }
+        } else {
+            for (int64_t i = 0; i < count; ++i)
+            {
+                out[i] = (float)in[i];
+            }
+        }
+    }
+
+    template<typename TO>
+    void intFromFloatNaive(TO* out, const float* in, int64_t count, bool doScale, double mult, double offset)
+    {
+        const double lowest = numeric_limits<TO>::lowest(), highest = numeric_limits<TO>::max();
+        for (int64_t i = 0; i < count; ++i)
+        {
+            double temp = in[i];
+            if (doScale) temp = (temp - offset) / mult;
+            temp = floor(0.5 + temp);
+            if (!(temp >= lowest))//NaN goes to the lowest value, same as the AVX2 version
+            {
+                temp = lowest;
+            } else if (temp > highest) {
+                temp = highest;
+            }
+            out[i] = (TO)temp;
+        }
+    }
+
+    void floatFromInt16Naive(float* out, const int16_t* in, int64_t count, bool doScale, double mult, double offset)
+    { floatFromNaive(out, in, count, doScale, mult, offset); }
+    void floatFromUint8Naive(float* out, const uint8_t* in, int64_t count, bool doScale, double mult, double offset)
+    { floatFromNaive(out, in, count, doScale, mult, offset); }
+    void floatFromFloatNaive(float* out, const float* in, int64_t count, bool doScale, double mult, double offset)
+    { floatFromNaive(out, in, count, doScale, mult, offset); }
+    void int16FromFloatNaive(int16_t* out, const float* in, int64_t count, bool doScale, double mult, double offset)
+    { intFromFloatNaive(out, in, count, doScale, mult, offset); }
+    void uint8FromFloatNaive(uint8_t* out, const float* in, int64_t count, bool doScale, double mult, double offset)
+    { intFromFloatNaive(out, in, count, doScale, mult, offset); }
+    void swap16Naive(void* data, int64_t count) { ByteSwapping::swapArray((int16_t*)data, count); }
+    void swap32Naive(void* data, int64_t count) { ByteSwapping::swapArray((int32_t*)data, count); }
+    void swap64Naive(void* data, int64_t count) { ByteSwapping::swapArray((int64_t*)data, count); }
+}
+
+NiftiConvert::ReadInt16Func* NiftiConvert::s_floatFromInt16 = &NiftiConvert::floatFromInt16Select;
+NiftiConvert::ReadUint8Func* NiftiConvert::s_floatFromUint8 = &NiftiConvert::floatFromUint8Select;
+NiftiConvert::ReadFloatFunc* NiftiConvert::s_floatFromFloat = &NiftiConvert::floatFromFloatSelect;
+NiftiConvert::WriteInt16Func* NiftiConvert::s_int16FromFloat = &NiftiConvert::int16FromFloatSelect;
+NiftiConvert::WriteUint8Func* NiftiConvert::s_uint8FromFloat = &NiftiConvert::uint8FromFloatSelect;
+NiftiConvert::SwapFunc* NiftiConvert::s_swap16 = &NiftiConvert::swap16Select;
+NiftiConvert::SwapFunc* NiftiConvert::s_swap32 = &NiftiConvert::swap32Select;
+NiftiConvert::SwapFunc* NiftiConvert::s_swap64 = &NiftiConvert::swap64Select;
+
+DotSIMDEnum::Enum NiftiConvert::setImpl(const DotSIMDEnum::Enum& impl)
+{
+#ifdef CARET_DOTFCN
+    switch (impl)
+    {
+        case DOT_AUTO:
+        case DOT_AVX512FMA:
+        case DOT_AVX512:
+        case DOT_AVXFMA:
+        case DOT_AVX:
+            if (hasAVX() && hasAVX2())
+            {
+                s_floatFromInt16 = &niftiFloatFromInt16AVX2;
+                s_floatFromUint8 = &niftiFloatFromUint8AVX2;
+                s_floatFromFloat = &niftiFloatFromFloatAVX2;
+                s_int16FromFloat = &niftiInt16FromFloatAVX2;
+                s_uint8FromFloat = &niftiUint8FromFloatAVX2;
+                s_swap16 = &niftiSwap16AVX2;
+                s_swap32 = &niftiSwap32AVX2;
+                s_swap64 = &niftiSwap64AVX2;
+                return DOT_AVX;
+            }
+            break;
+        default:
+            break;
+    }
+#endif
+    s_floatFromInt16 = &floatFromInt16Naive;
+    s_floatFromUint8 = &floatFromUint8Naive;
+    s_floatFromFloat = &floatFromFloatNaive;
+    s_int16FromFloat = &int16FromFloatNaive;
+    s_uint8FromFloat = &uint8FromFloatNaive;
+    s_swap16 = &swap16Naive;
+    s_swap32 = &swap32Naive;
+    s_swap64 = &swap64Naive;
+    return DOT_NAIVE;
+}
+
+void NiftiConvert::floatFromInt16Select(float* out, const int16_t* in, int64_t count, bool doScale, double mult, double offset)
+{
+    setImpl(DOT_AUTO);
+    (*s_floatFromInt16)(out, in, count, doScale, mult, offset);
+}
+
+void NiftiConvert::floatFromUint8Select(float* out, const uint8_t* in, int64_t count, bool doScale, double mult, double offset)
+{
+    setImpl(DOT_AUTO);
+    (*s_floatFromUint8)(out, in, count, doScale, mult, offset);
+}
+
+void NiftiConvert::floatFromFloatSelect(float* out, const float* in, int64_t count, bool doScale, double mult, double offset)
+{
+    setImpl(DOT_AUTO);
+    (*s_floatFromFloat)(out, in, count, doScale, mult, offset);
+}
+
+void NiftiConvert::int16FromFloatSelect(int16_t* out, const float* in, int64_t count, bool doScale, double mult, double offset)
+{
+    setImpl(DOT_AUTO);
+    (*s_int16FromFloat)(out, in, count, doScale, mult, offset);
+}
+
+void NiftiConvert::uint8FromFloatSelect(uint8_t* out, const float* in, int64_t count, bool doScale, double mult, double offset)
+{
+    setImpl(DOT_AUTO);
+    (*s_uint8FromFloat)(out, in, count, doScale, mult, offset);
+}
+
+void NiftiConvert::swap16Select(void* data, int64_t count)
+{
+    setImpl(DOT_AUTO);
+    (*s_swap16)(data, count);
+}
+
+void NiftiConvert::swap32Select(void* data, int64_t count)
+{
+    setImpl(DOT_AUTO);
+    (*s_swap32)(data, count);
+}
+
+void NiftiConvert::swap64Select(void* data, int64_t count)
+{
+    setImpl(DOT_AUTO);
+    (*s_swap64)(data, count);
+}
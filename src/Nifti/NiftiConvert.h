@@ -0,0 +1,88 @@
+#ifndef __NIFTI_CONVERT_H__
+#define __NIFTI_CONVERT_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+//NOTE: these are the conversions that NiftiIO spends most of its time in when the file is already in memory (page cache or mmap),
+//      most importantly scaled INT16 dtseries to float.  The kernels do the scaling in double rather than long double, and the
+//      implementation is chosen at runtime in the same way as the dot product functions (see dot_wrapper.h), with only two
+//      levels: plain C++ (which the compiler can vectorize for the baseline instruction set) and AVX2.
+
+#include "dot_wrapper.h"
+
+#include "stdint.h"
+
+namespace caret
+{
+    class NiftiConvert
+    {
+    public:
+        //reading: out = offset + mult * in, when doScale
+        static void floatFromInt16(float* out, const int16_t* in, const int64_t& count, const bool& doScale, const double& mult, const double& offset)
+        { (*s_floatFromInt16)(out, in, count, doScale, mult, offset); }
+        static void floatFromUint8(float* out, const uint8_t* in, const int64_t& count, const bool& doScale, const double& mult, const double& offset)
+        { (*s_floatFromUint8)(out, in, count, doScale, mult, offset); }
+        static void floatFromFloat(float* out, const float* in, const int64_t& count, const bool& doScale, const double& mult, const double& offset)
+        { (*s_floatFromFloat)(out, in, count, doScale, mult, offset); }
+
+        //writing: out = round to nearest and clamp of (in - offset) / mult, when doScale
+        static void int16FromFloat(int16_t* out, const float* in, const int64_t& count, const bool& doScale, const double& mult, const double& offset)
+        { (*s_int16FromFloat)(out, in, count, doScale, mult, offset); }
+        static void uint8FromFloat(uint8_t* out, const float* in, const int64_t& count, const bool& doScale, const double& mult, const double& offset)
+        { (*s_uint8FromFloat)(out, in, count, doScale, mult, offset); }
+
+        //in-place byte swapping of 2, 4, and 8 byte elements
+        static void swap16(void* data, const int64_t& count) { (*s_swap16)(data, count); }
+        static void swap32(void* data, const int64_t& count) { (*s_swap32)(data, count); }
+        static void swap64(void* data, const int64_t& count) { (*s_swap64)(data, count); }
+
+        ///like dot_set_impl, returns what was actually selected: DOT_AVX for the AVX2 kernels, otherwise DOT_NAIVE
+        static DotSIMDEnum::Enum setImpl(const DotSIMDEnum::Enum& impl);
+
+        typedef void (ReadInt16Func)(float*, const int16_t*, int64_t, bool, double, double);
+        typedef void (ReadUint8Func)(float*, const uint8_t*, int64_t, bool, double, double);
+        typedef void (ReadFloatFunc)(float*, const float*, int64_t, bool, double, double);
+        typedef void (WriteInt16Func)(int16_t*, const float*, int64_t, bool, double, double);
+        typedef void (WriteUint8Func)(uint8_t*, const float*, int64_t, bool, double, double);
+        typedef void (SwapFunc)(void*, int64_t);
+    private:
+        static ReadInt16Func* s_floatFromInt16;
+        static ReadUint8Func* s_floatFromUint8;
+        static ReadFloatFunc* s_floatFromFloat;
+        static WriteInt16Func* s_int16FromFloat;
+        static WriteUint8Func* s_uint8FromFloat;
+        static SwapFunc* s_swap16;
+        static SwapFunc* s_swap32;
+        static SwapFunc* s_swap64;
+
+        //these select the implementation on first use, then call it
+        static void floatFromInt16Select(float* out, const int16_t* in, int64_t count, bool doScale, double mult, double offset);
+        static void floatFromUint8Select(float* out, const uint8_t* in, int64_t count, bool doScale, double mult, double offset);
+        static void floatFromFloatSelect(float* out, const float* in, int64_t count, bool doScale, double mult, double offset);
+        static void int16FromFloatSelect(int16_t* out, const float* in, int64_t count, bool doScale, double mult, double offset);
+        static void uint8FromFloatSelect(uint8_t* out, const float* in, int64_t count, bool doScale, double mult, double offset);
+        static void swap16Select(void* data, int64_t count);
+        static void swap32Select(void* data, int64_t count);
+        static void swap64Select(void* data, int64_t count);
+    };
+}
+
+#endif //__NIFTI_CONVERT_H__
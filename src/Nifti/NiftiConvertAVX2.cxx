@@ -0,0 +1,242 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+//this file is compiled with -mavx2 when SIMD is enabled, so nothing outside of these functions may be used unless the cpu supports AVX2,
+//see NiftiConvert::setImpl
+
+#ifdef CARET_DOTFCN
+
+#include <immintrin.h>
+
+#include "stdint.h"
+
+namespace
+{
+    //in[0..3] as doubles, scaled, to 4 floats
+    inline __m128 scaleToFloat(const __m256d& in, const bool& doScale, const __m256d& mult, const __m256d& offset)
+    {
+        if (doScale) return _mm256_cvtpd_ps(_mm256_add_pd(offset, _mm256_mul_pd(mult, in)));
+        return _mm256_cvtpd_ps(in);
+    }
+
+    inline __m256 combine(const __m128& low, const __m128& high)
+    {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+    }
+
+    //4 floats to rounded and clamped int32 values
+    inline __m128i roundClamp(const __m128& in, const bool& doScale, const __m256d& mult, const __m256d& offset, const __m256d& lowest, const __m256d& highest)
+    {
+        const __m256d half = _mm256_set1_pd(0.5);
+        __m256d temp = _mm256_cvtps_pd(in);
+        if (doScale) temp = _mm256_div_pd(_mm256_sub_pd(temp, offset), mult);
+        temp = _mm256_floor_pd(_mm256_add_pd(temp, half));
+        temp = _mm256_min_pd(_mm256_max_pd(temp, lowest), highest);//max returns the second operand for NaN, so NaN goes to lowest
+        return _mm256_cvttpd_epi32(temp);
+    }
+
+    //scalar floor without calling into libm, so the whole tail stays inside this file
+    inline double floorScalar(const double& in)
+    {
+        return _mm_cvtsd_f64(_mm_floor_sd(_mm_setzero_pd(), _mm_set_sd(in)));
+    }
+
+    //these must stay in the anonymous namespace: a header template like ByteSwapping::swapArray would get a weak AVX2 instantiation here
+    //that the linker could pick for the entire program
+    template<typename T>
+    inline void swapTail(T* data, const int64_t& count)
+    {
+        for (int64_t i = 0; i < count; ++i)
+        {
+            char* bytes = (char*)(data + i);
+            for (int j = 0; j < (int)sizeof(T) / 2; ++j)
+            {
+                char temp = bytes[j];
+                bytes[j] = bytes[sizeof(T) - j - 1];
+                bytes[sizeof(T) - j - 1] = temp;
+            }
+        }
+    }
+
+    inline void swapBytes(void* data, const int64_t& numBytes, const __m256i& mask)
+    {
+        char* myData = (char*)data;
+        int64_t i = 0;
+        for (; i + 32 <= numBytes; i += 32)
+        {
+            __m256i temp = _mm256_loadu_si256((const __m256i*)(myData + i));
+            _mm256_storeu_si256((__m256i*)(myData + i), _mm256_shuffle_epi8(temp, mask));
+        }
+    }
+}
+
+namespace caret
+{
+    void niftiFloatFromInt16AVX2(float* out, const int16_t* in, int64_t count, bool doScale, double mult, double offset)
+    {
+        const __m256d multv = _mm256_set1_pd(mult), offsetv = _mm256_set1_pd(offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i ints = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in + i)));
+            if (doScale)
+            {
+                __m128 low = scaleToFloat(_mm256_cvtepi32_pd(_mm256_castsi256_si128(ints)), true, multv, offsetv);
+                __m128 high = scaleToFloat(_mm256_cvtepi32_pd(_mm256_extracti128_si256(ints, 1)), true, multv, offsetv);
+                _mm256_storeu_ps(out + i, combine(low, high));
+            } else {
+                _mm256_storeu_ps(out + i, _mm256_cvtepi32_ps(ints));//int16 fits exactly in float
+            }
+        }
+        for (; i < count; ++i)
+        {
+            out[i] = (doScale ? (float)(offset + mult * in[i]) : (float)in[i]);
+        }
+    }
+
+    void niftiFloatFromUint8AVX2(float* out, const uint8_t* in, int64_t count, bool doScale, double mult, double offset)
+    {
+        const __m256d multv = _mm256_set1_pd(mult), offsetv = _mm256_set1_pd(offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i ints = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + i)));
+            if (doScale)
+            {
+                __m128 low = scaleToFloat(_mm256_cvtepi32_pd(_mm256_castsi256_si128(ints)), true, multv, offsetv);
+                __m128 high = scaleToFloat(_mm256_cvtepi32_pd(_mm256_extracti128_si256(ints, 1)), true, multv, offsetv);
+                _mm256_storeu_ps(out + i, combine(low, high));
+            } else {
+                _mm256_storeu_ps(out + i, _mm256_cvtepi32_ps(ints));
+            }
+        }
+        for (; i < count; ++i)
+        {
+            out[i] = (doScale ? (float)(offset + mult * in[i]) : (float)in[i]);
+        }
+    }
+
+    void niftiFloatFromFloatAVX2(float* out, const float* in, int64_t count, bool doScale, double mult, double offset)
+    {
+        const __m256d multv = _mm256_set1_pd(mult), offsetv = _mm256_set1_pd(offset);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 vals = _mm256_loadu_ps(in + i);
+            if (doScale)
+            {
+                __m128 low = scaleToFloat(_mm256_cvtps_pd(_mm256_castps256_ps128(vals)), true, multv, offsetv);
+                __m128 high = scaleToFloat(_mm256_cvtps_pd(_mm256_extractf128_ps(vals, 1)), true, multv, offsetv);
+                vals = combine(low, high);
+            }
+            _mm256_storeu_ps(out + i, vals);
+        }
+        for (; i < count; ++i)
+        {
+            out[i] = (doScale ? (float)(offset + mult * (double)in[i]) : in[i]);
+        }
+    }
+
+    void niftiInt16FromFloatAVX2(int16_t* out, const float* in, int64_t count, bool doScale, double mult, double offset)
+    {
+        const double lowest = -32768.0, highest = 32767.0;
+        const __m256d multv = _mm256_set1_pd(mult), offsetv = _mm256_set1_pd(offset);
+        const __m256d lowv = _mm256_set1_pd(lowest), highv = _mm256_set1_pd(highest);
+        int64_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i low = roundClamp(_mm_loadu_ps(in + i), doScale, multv, offsetv, lowv, highv);
+            __m128i high = roundClamp(_mm_loadu_ps(in + i + 4), doScale, multv, offsetv, lowv, highv);
+            _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(low, high));//already clamped, so saturation doesn't change anything
+        }
+        for (; i < count; ++i)
+        {
+            double temp = in[i];
+            if (doScale) temp = (temp - offset) / mult;
+            temp = floorScalar(0.5 + temp);
+            if (!(temp >= lowest))
+            {
+                temp = lowest;
+            } else if (temp > highest) {
+                temp = highest;
+            }
+            out[i] = (int16_t)temp;
+        }
+    }
+
+    void niftiUint8FromFloatAVX2(uint8_t* out, const float* in, int64_t count, bool doScale, double mult, double offset)
+    {
+        const double lowest = 0.0, highest = 255.0;
+        const __m256d multv = _mm256_set1_pd(mult), offsetv = _mm256_set1_pd(offset);
+        const __m256d lowv = _mm256_set1_pd(lowest), highv = _mm256_set1_pd(highest);
+        int64_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i ints0 = roundClamp(_mm_loadu_ps(in + i), doScale, multv, offsetv, lowv, highv);
+            __m128i ints1 = roundClamp(_mm_loadu_ps(in + i + 4), doScale, multv, offsetv, lowv, highv);
+            __m128i ints2 = roundClamp(_mm_loadu_ps(in + i + 8), doScale, multv, offsetv, lowv, highv);
+            __m128i ints3 = roundClamp(_mm_loadu_ps(in + i + 12), doScale, multv, offsetv, lowv, highv);
+            __m128i shorts0 = _mm_packs_epi32(ints0, ints1), shorts1 = _mm_packs_epi32(ints2, ints3);
+            _mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(shorts0, shorts1));
+        }
+        for (; i < count; ++i)
+        {
+            double temp = in[i];
+            if (doScale) temp = (temp - offset) / mult;
+            temp = floorScalar(0.5 + temp);
+            if (!(temp >= lowest))
+            {
+                temp = lowest;
+            } else if (temp > highest) {
+                temp = highest;
+            }
+            out[i] = (uint8_t)temp;
+        }
+    }
+
+    void niftiSwap16AVX2(void* data, int64_t count)
+    {
+        const __m256i mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                              1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        swapBytes(data, count * 2, mask);
+        const int64_t done = (count * 2 / 32) * 16;
+        swapTail(((int16_t*)data) + done, count - done);
+    }
+
+    void niftiSwap32AVX2(void* data, int64_t count)
+    {
+        const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                              3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        swapBytes(data, count * 4, mask);
+        const int64_t done = (count * 4 / 32) * 8;
+        swapTail(((int32_t*)data) + done, count - done);
+    }
+
+    void niftiSwap64AVX2(void* data, int64_t count)
+    {
+        const __m256i mask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                              7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+        swapBytes(data, count * 8, mask);
+        const int64_t done = (count * 8 / 32) * 4;
+        swapTail(((int64_t*)data) + done, count - done);
+    }
+}
+
+#endif //CARET_DOTFCN
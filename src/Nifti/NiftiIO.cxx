@@ -27,7 +27,7 @@ using namespace caret;
 
 void NiftiIO::openRead(const QString& filename)
 {
-    m_file.open(filename);
+    m_file.openMapped(filename);//uncompressed files get memory mapped, so readData can skip the file position and mutex
     m_header.read(m_file);
     if (m_header.getDataType() == DT_BINARY)
     {
@@ -67,6 +67,23 @@ void NiftiIO::close()
 {
     m_file.close();
     m_dims.clear();
+    CaretMutexLocker locked(&m_scratchPoolMutex);
+    m_scratchPool.clear();
+}
+
+void NiftiIO::takeScratch(vector<char>& scratchOut)
+{
+    CaretMutexLocker locked(&m_scratchPoolMutex);
+    if (m_scratchPool.empty()) return;//caller resizes it anyway
+    scratchOut.swap(m_scratchPool.back());
+    m_scratchPool.pop_back();
+}
+
+void NiftiIO::returnScratch(vector<char>& scratch)
+{
+    CaretMutexLocker locked(&m_scratchPoolMutex);
+    m_scratchPool.push_back(vector<char>());
+    m_scratchPool.back().swap(scratch);
 }
 
 int NiftiIO::getNumComponents() const
@@ -74,7 +91,27 @@ int NiftiIO::getNumComponents() const
     return m_header.getNumComponents();
 }
 
-int NiftiIO::numBytesPerElem()
+void NiftiIO::getSelectRange(const int& fullDims, const vector<int64_t>& indexSelect, int64_t& numElemsOut, int64_t& numSkipOut) const
+{
+    CaretAssert(fullDims >= 0 && fullDims <= (int)m_dims.size());
+    CaretAssert((size_t)fullDims + indexSelect.size() == m_dims.size());//could be >=, but should catch more stupid mistakes as ==
+    numElemsOut = getNumComponents();
+    int curDim;
+    for (curDim = 0; curDim < fullDims; ++curDim)
+    {
+        numElemsOut *= m_dims[curDim];
+    }
+    int64_t numDimSkip = numElemsOut;
+    numSkipOut = 0;
+    for (; curDim < (int)m_dims.size(); ++curDim)
+    {
+        CaretAssert(indexSelect[curDim - fullDims] >= 0 && indexSelect[curDim - fullDims] < m_dims[curDim]);
+        numSkipOut += indexSelect[curDim - fullDims] * numDimSkip;
+        numDimSkip *= m_dims[curDim];
+    }
+}
+
+int NiftiIO::numBytesPerElem() const
 {
     switch (m_header.getDataType())
     {
@@ -26,12 +26,14 @@
 #include "CaretBinaryFile.h"
 #include "CaretMutex.h"
 #include "DataFileException.h"
+#include "NiftiConvert.h"
 #include "NiftiHeader.h"
 
 #include <QString>
 
 #include <cmath>
 #include <limits>
+#include <stdint.h>
 #include <vector>
 
 namespace caret
@@ -44,13 +46,39 @@ namespace caret
         std::vector<int64_t> m_dims;
         std::vector<char> m_scratch;//scratch memory for byteswapping, type conversion, etc
         CaretMutex m_mutex;//protect multithreaded calls from each other
-        int numBytesPerElem();//for resizing scratch
+        std::vector<std::vector<char> > m_scratchPool;//scratch for concurrent positional reads, so each caller gets its own without reallocating every call
+        CaretMutex m_scratchPoolMutex;
+        void takeScratch(std::vector<char>& scratchOut);
+        void returnScratch(std::vector<char>& scratch);
+        int numBytesPerElem() const;//for resizing scratch
+        void getSelectRange(const int& fullDims, const std::vector<int64_t>& indexSelect, int64_t& numElemsOut, int64_t& numSkipOut) const;
+        template<typename T>
+        bool dataTypeMatches() const;//whether on-disk elements can be used as T without conversion (ignoring byte order and scaling)
+        template<typename T>
+        void convertReadAny(T* dataOut, char* in, const int64_t& numElems);//switch on datatype, swaps "in" in place if needed
         template<typename TO, typename FROM>
         void convertRead(TO* out, FROM* in, const int64_t& count);//for reading from file
         template<typename TO, typename FROM>
         void convertWrite(TO* out, const FROM* in, const int64_t& count);//for writing to file
         template<typename TO, typename FROM>
         static TO clamp(const FROM& in);//deal with integer cast being undefined when converting from outside range
+        template<typename T>
+        static void swapElements(T* data, const int64_t& count);//uses the vectorized swaps where possible
+        //vectorized versions of the most common conversions, the templates return false to fall back to the generic loops
+        template<typename TO, typename FROM>
+        static bool fastConvertRead(TO*, const FROM*, const int64_t&, const bool&, const double&, const double&) { return false; }
+        static bool fastConvertRead(float* out, const int16_t* in, const int64_t& count, const bool& doScale, const double& mult, const double& offset)
+        { NiftiConvert::floatFromInt16(out, in, count, doScale, mult, offset); return true; }
+        static bool fastConvertRead(float* out, const uint8_t* in, const int64_t& count, const bool& doScale, const double& mult, const double& offset)
+        { NiftiConvert::floatFromUint8(out, in, count, doScale, mult, offset); return true; }
+        static bool fastConvertRead(float* out, const float* in, const int64_t& count, const bool& doScale, const double& mult, const double& offset)
+        { NiftiConvert::floatFromFloat(out, in, count, doScale, mult, offset); return true; }
+        template<typename TO, typename FROM>
+        static bool fastConvertWrite(TO*, const FROM*, const int64_t&, const bool&, const double&, const double&) { return false; }
+        static bool fastConvertWrite(int16_t* out, const float* in, const int64_t& count, const bool& doScale, const double& mult, const double& offset)
+        { NiftiConvert::int16FromFloat(out, in, count, doScale, mult, offset); return true; }
+        static bool fastConvertWrite(uint8_t* out, const float* in, const int64_t& count, const bool& doScale, const double& mult, const double& offset)
+        { NiftiConvert::uint8FromFloat(out, in, count, doScale, mult, offset); return true; }
     public:
         void openRead(const QString& filename);
         void writeNew(const QString& filename, const NiftiHeader& header, const int& version = 1, const bool& withRead = false, const bool& swapEndian = false);
@@ -66,75 +94,144 @@ namespace caret
         void readData(T* dataOut, const int& fullDims, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead = false);
         template<typename T>
         void writeData(const T* dataIn, const int& fullDims, const std::vector<int64_t>& indexSelect);
+        //same selection semantics as readData, returns a pointer into the memory mapped file when the data can be used as-is
+        //(opened for reading, mapped, native byte order, no scaling, matching type), otherwise NULL - valid until close()
+        template<typename T>
+        const T* getDirectDataPointer(const int& fullDims, const std::vector<int64_t>& indexSelect);
     };
     
     template<typename T>
-    void NiftiIO::readData(T* dataOut, const int& fullDims, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead)
+    bool NiftiIO::dataTypeMatches() const
     {
-        CaretAssert(fullDims >= 0 && fullDims <= (int)m_dims.size());
-        CaretAssert((size_t)fullDims + indexSelect.size() == m_dims.size());//could be >=, but should catch more stupid mistakes as ==
-        int64_t numElems = getNumComponents();//for now, calculate read size on the fly, as the read call will be the slowest part
-        int curDim;
-        for (curDim = 0; curDim < fullDims; ++curDim)
+        if (getNumComponents() != 1 || numBytesPerElem() != (int)sizeof(T)) return false;
+        typedef std::numeric_limits<T> mylimits;
+        switch (m_header.getDataType())
         {
-            numElems *= m_dims[curDim];
+            case NIFTI_TYPE_FLOAT32:
+            case NIFTI_TYPE_FLOAT64:
+            case NIFTI_TYPE_FLOAT128:
+                return !mylimits::is_integer;
+            case NIFTI_TYPE_INT8:
+            case NIFTI_TYPE_INT16:
+            case NIFTI_TYPE_INT32:
+            case NIFTI_TYPE_INT64:
+                return mylimits::is_integer && mylimits::is_signed;
+            case NIFTI_TYPE_UINT8:
+            case NIFTI_TYPE_UINT16:
+            case NIFTI_TYPE_UINT32:
+            case NIFTI_TYPE_UINT64:
+                return mylimits::is_integer && !mylimits::is_signed;
+            default:
+                return false;
         }
-        int64_t numDimSkip = numElems, numSkip = 0;
-        for (; curDim < (int)m_dims.size(); ++curDim)
-        {
-            CaretAssert(indexSelect[curDim - fullDims] >= 0 && indexSelect[curDim - fullDims] < m_dims[curDim]);
-            numSkip += indexSelect[curDim - fullDims] * numDimSkip;
-            numDimSkip *= m_dims[curDim];
+    }
+    
+    template<typename T>
+    const T* NiftiIO::getDirectDataPointer(const int& fullDims, const std::vector<int64_t>& indexSelect)
+    {
+        const char* mapped = m_file.getMappedData();
+        if (mapped == NULL || m_header.isSwapped() || !dataTypeMatches<T>()) return NULL;
+        double mult, offset;
+        if (m_header.getDataScaling(mult, offset)) return NULL;
+        int64_t numElems, numSkip;
+        getSelectRange(fullDims, indexSelect, numElems, numSkip);
+        int64_t byteOffset = numSkip * numBytesPerElem() + m_header.getDataOffset();
+        if (byteOffset + numElems * numBytesPerElem() > m_file.size()) return NULL;//truncated file, let readData sort it out
+        const char* ret = mapped + byteOffset;
+        if (((uintptr_t)ret) % sizeof(T) != 0) return NULL;//vox_offset is normally a multiple of 16, but don't trust it
+        return (const T*)ret;
+    }
+    
+    template<typename T>
+    void NiftiIO::readData(T* dataOut, const int& fullDims, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead)
+    {
+        int64_t numElems, numSkip;//for now, calculate read size on the fly, as the read call will be the slowest part
+        getSelectRange(fullDims, indexSelect, numElems, numSkip);
+        const int64_t numBytes = numElems * numBytesPerElem(), byteOffset = numSkip * numBytesPerElem() + m_header.getDataOffset();
+        const char* mapped = m_file.getMappedData();
+        if (mapped != NULL && byteOffset + numBytes <= m_file.size())
+        {//memory mapped read-only file, we don't need the file position or the shared scratch space, so don't take the mutex
+            if (m_header.isSwapped())
+            {
+                std::vector<char> scratch;
+                takeScratch(scratch);
+                scratch.assign(mapped + byteOffset, mapped + byteOffset + numBytes);//can't swap in place in read-only mapped memory
+                convertReadAny(dataOut, scratch.data(), numElems);
+                returnScratch(scratch);
+            } else {
+                convertReadAny(dataOut, const_cast<char*>(mapped + byteOffset), numElems);//convertRead only modifies its input when swapping
+            }
+            return;
+        }
+        if (m_file.hasThreadSafeReadAt())
+        {//positional reads (pread) don't use the file position, so concurrent readers only need their own scratch space
+            std::vector<char> scratch;
+            takeScratch(scratch);
+            scratch.resize(numBytes);
+            int64_t numRead = 0;
+            m_file.readAt(scratch.data(), numBytes, byteOffset, &numRead);
+            if ((numRead != numBytes && !tolerateShortRead) || numRead < 0)
+            {
+                throw DataFileException("error while reading from nifti file '" + m_file.getFilename() + "'");
+            }
+            convertReadAny(dataOut, scratch.data(), numElems);
+            returnScratch(scratch);
+            return;
         }
         CaretMutexLocker locked(&m_mutex);//protect starting with resizing until we are done converting, because we use an internal variable for scratch space
         //we can't guarantee that the output memory is enough to use as scratch space, as we might be doing a narrowing conversion
-        //we are doing FILE ACCESS, so cpu performance isn't really something to worry about
-        m_scratch.resize(numElems * numBytesPerElem());
-        m_file.seek(numSkip * numBytesPerElem() + m_header.getDataOffset());
+        m_scratch.resize(numBytes);
+        m_file.seek(byteOffset);
         int64_t numRead = 0;
         m_file.read(m_scratch.data(), m_scratch.size(), &numRead);
         if ((numRead != (int64_t)m_scratch.size() && !tolerateShortRead) || numRead < 0)//for now, assume read giving -1 is always a problem
         {
             throw DataFileException("error while reading from nifti file '" + m_file.getFilename() + "'");
         }
+        convertReadAny(dataOut, m_scratch.data(), numElems);
+    }
+    
+    template<typename T>
+    void NiftiIO::convertReadAny(T* dataOut, char* in, const int64_t& numElems)
+    {
         switch (m_header.getDataType())
         {
             case NIFTI_TYPE_UINT8:
             case NIFTI_TYPE_RGB24://handled by components
-                convertRead(dataOut, (uint8_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (uint8_t*)in, numElems);
                 break;
             case NIFTI_TYPE_INT8:
-                convertRead(dataOut, (int8_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (int8_t*)in, numElems);
                 break;
             case NIFTI_TYPE_UINT16:
-                convertRead(dataOut, (uint16_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (uint16_t*)in, numElems);
                 break;
             case NIFTI_TYPE_INT16:
-                convertRead(dataOut, (int16_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (int16_t*)in, numElems);
                 break;
             case NIFTI_TYPE_UINT32:
-                convertRead(dataOut, (uint32_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (uint32_t*)in, numElems);
                 break;
             case NIFTI_TYPE_INT32:
-                convertRead(dataOut, (int32_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (int32_t*)in, numElems);
                 break;
             case NIFTI_TYPE_UINT64:
-                convertRead(dataOut, (uint64_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (uint64_t*)in, numElems);
                 break;
             case NIFTI_TYPE_INT64:
-                convertRead(dataOut, (int64_t*)m_scratch.data(), numElems);
+                convertRead(dataOut, (int64_t*)in, numElems);
                 break;
             case NIFTI_TYPE_FLOAT32:
             case NIFTI_TYPE_COMPLEX64://components
-                convertRead(dataOut, (float*)m_scratch.data(), numElems);
+                convertRead(dataOut, (float*)in, numElems);
                 break;
             case NIFTI_TYPE_FLOAT64:
             case NIFTI_TYPE_COMPLEX128:
-                convertRead(dataOut, (double*)m_scratch.data(), numElems);
+                convertRead(dataOut, (double*)in, numElems);
                 break;
             case NIFTI_TYPE_FLOAT128:
             case NIFTI_TYPE_COMPLEX256:
-                convertRead(dataOut, (long double*)m_scratch.data(), numElems);
+                convertRead(dataOut, (long double*)in, numElems);
                 break;
             default:
                 CaretAssert(0);
@@ -145,21 +242,8 @@ namespace caret
     template<typename T>
     void NiftiIO::writeData(const T* dataIn, const int& fullDims, const std::vector<int64_t>& indexSelect)
     {
-        CaretAssert(fullDims >= 0 && fullDims <= (int)m_dims.size());
-        CaretAssert((size_t)fullDims + indexSelect.size() == m_dims.size());//could be >=, but should catch more stupid mistakes as ==
-        int64_t numElems = getNumComponents();//for now, calculate read size on the fly, as the read call will be the slowest part
-        int curDim;
-        for (curDim = 0; curDim < fullDims; ++curDim)
-        {
-            numElems *= m_dims[curDim];
-        }
-        int64_t numDimSkip = numElems, numSkip = 0;
-        for (; curDim < (int)m_dims.size(); ++curDim)
-        {
-            CaretAssert(indexSelect[curDim - fullDims] >= 0 && indexSelect[curDim - fullDims] < m_dims[curDim]);
-            numSkip += indexSelect[curDim - fullDims] * numDimSkip;
-            numDimSkip *= m_dims[curDim];
-        }
+        int64_t numElems, numSkip;
+        getSelectRange(fullDims, indexSelect, numElems, numSkip);
         CaretMutexLocker locked(&m_mutex);//protect starting with resizing until we are done writing, because we use an internal variable for scratch space
         //we are doing FILE ACCESS, so cpu performance isn't really something to worry about
         m_scratch.resize(numElems * numBytesPerElem());
@@ -215,10 +299,11 @@ namespace caret
     {
         if (m_header.isSwapped())
         {
-            ByteSwapping::swapArray(in, count);
+            swapElements(in, count);
         }
         double mult, offset;
         bool doScale = m_header.getDataScaling(mult, offset);
+        if (fastConvertRead(out, in, count, doScale, mult, offset)) return;
         if (std::numeric_limits<TO>::is_integer)//do round to nearest when integer output type
         {
             if (doScale)
@@ -254,6 +339,11 @@ namespace caret
     {
         double mult, offset;
         bool doScale = m_header.getDataScaling(mult, offset);
+        if (fastConvertWrite(out, in, count, doScale, mult, offset))
+        {
+            if (m_header.isSwapped()) swapElements(out, count);
+            return;
+        }
         if (std::numeric_limits<TO>::is_integer)//do round to nearest when integer output type
         {//TODO: what about NaN?
             if (doScale)
@@ -282,7 +372,28 @@ namespace caret
                 }
             }
         }
-        if (m_header.isSwapped()) ByteSwapping::swapArray(out, count);
+        if (m_header.isSwapped()) swapElements(out, count);
+    }
+    
+    template<typename T>
+    void NiftiIO::swapElements(T* data, const int64_t& count)
+    {
+        switch (sizeof(T))
+        {
+            case 1:
+                break;
+            case 2:
+                NiftiConvert::swap16(data, count);
+                break;
+            case 4:
+                NiftiConvert::swap32(data, count);
+                break;
+            case 8:
+                NiftiConvert::swap64(data, count);
+                break;
+            default:
+                ByteSwapping::swapArray(data, count);
+        }
     }
     
     template<typename TO, typename FROM>
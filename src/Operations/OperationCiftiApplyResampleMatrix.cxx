@@ -0,0 +1,131 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "OperationCiftiApplyResampleMatrix.h"
+#include "OperationException.h"
+
+#include "CiftiFile.h"
+#include "ResamplingMatrix.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+AString OperationCiftiApplyResampleMatrix::getCommandSwitch()
+{
+    return "-cifti-apply-resample-matrix";
+}
+
+AString OperationCiftiApplyResampleMatrix::getShortDescription()
+{
+    return "RESAMPLE A CIFTI FILE WITH A SAVED RESAMPLING MATRIX";
+}
+
+OperationParameters* OperationCiftiApplyResampleMatrix::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    ret->addCiftiParameter(1, "cifti-in", "the cifti file to resample");
+    
+    ret->addStringParameter(2, "direction", "the direction of the input that should be resampled, ROW or COLUMN");
+    
+    ret->addStringParameter(3, "matrix", "the resampling matrix file");
+    
+    ret->addCiftiOutputParameter(4, "cifti-out", "the output cifti file");
+    
+    ret->setHelpText(
+        AString("Resamples a cifti file with a matrix from -cifti-resample-matrix, giving the same result as -cifti-resample with the options that were used to make the matrix, ") +
+        "except for floating point rounding differences in the volume components.  " +
+        "The brain models along <direction> must match the input space of the matrix.  " +
+        "Use COLUMN for the direction to resample dscalar or dtseries, which reads the entire input into memory.  " +
+        "With ROW, the input is processed a block of rows at a time.  " +
+        "Label data is not supported, because label resampling doesn't use weighted averages, use -cifti-resample for dlabel files."
+    );
+    return ret;
+}
+
+void OperationCiftiApplyResampleMatrix::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    const CiftiFile* myCiftiIn = myParams->getCifti(1);
+    AString myDirString = myParams->getString(2);
+    int direction = -1;
+    if (myDirString == "ROW")
+    {
+        direction = CiftiXML::ALONG_ROW;
+    } else if (myDirString == "COLUMN") {
+        direction = CiftiXML::ALONG_COLUMN;
+    } else {
+        throw OperationException("unrecognized direction string, use ROW or COLUMN");
+    }
+    ResamplingMatrix myMatrix;
+    myMatrix.readFile(myParams->getString(3));
+    CiftiFile* myCiftiOut = myParams->getOutputCifti(4);
+    const CiftiXML& inXML = myCiftiIn->getCiftiXML();
+    if (inXML.getNumberOfDimensions() != 2) throw OperationException("applying a resampling matrix only supports 2D cifti");
+    if (inXML.getMappingType(direction) != CiftiMappingType::BRAIN_MODELS) throw OperationException("direction for input must contain brain models");
+    if (inXML.getMappingType(1 - direction) == CiftiMappingType::LABELS) throw OperationException("label data can't be resampled with a matrix, use -cifti-resample");
+    if (*(inXML.getMap(direction)) != myMatrix.getInputSpace()) throw OperationException("input cifti brain models don't match the input space of the resampling matrix");
+    CiftiXML outXML = inXML;
+    outXML.setMap(direction, myMatrix.getOutputSpace());
+    myCiftiOut->setCiftiXML(outXML);
+    int64_t numIn = myMatrix.getNumberOfInputs(), numOut = myMatrix.getNumberOfOutputs();
+    if (direction == CiftiXML::ALONG_COLUMN)
+    {//each row is one brainordinate, so the whole file is already in the layout the matrix wants
+        int64_t rowLength = inXML.getDimensionLength(CiftiXML::ALONG_ROW);
+        vector<float> inData(numIn * rowLength), outData(numOut * rowLength);
+        for (int64_t i = 0; i < numIn; ++i)
+        {
+            myCiftiIn->getRow(inData.data() + i * rowLength, i);
+        }
+        myMatrix.multiply(inData.data(), rowLength, outData.data());
+        inData.clear();
+        for (int64_t i = 0; i < numOut; ++i)
+        {
+            myCiftiOut->setRow(outData.data() + i * rowLength, i);
+        }
+    } else {//each row is a map over brainordinates, transpose a block of rows so the matrix can do them all at once
+        const int64_t BLOCK_SIZE = 256;
+        int64_t numRows = inXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
+        vector<float> rowScratch(max(numIn, numOut)), inData(numIn * BLOCK_SIZE), outData(numOut * BLOCK_SIZE);
+        for (int64_t start = 0; start < numRows; start += BLOCK_SIZE)
+        {
+            int64_t blockRows = min(BLOCK_SIZE, numRows - start);
+            for (int64_t r = 0; r < blockRows; ++r)
+            {
+                myCiftiIn->getRow(rowScratch.data(), start + r);
+                for (int64_t i = 0; i < numIn; ++i)
+                {
+                    inData[i * blockRows + r] = rowScratch[i];
+                }
+            }
+            myMatrix.multiply(inData.data(), blockRows, outData.data());
+            for (int64_t r = 0; r < blockRows; ++r)
+            {
+                for (int64_t i = 0; i < numOut; ++i)
+                {
+                    rowScratch[i] = outData[i * blockRows + r];
+                }
+                myCiftiOut->setRow(rowScratch.data(), start + r);
+            }
+        }
+    }
+}
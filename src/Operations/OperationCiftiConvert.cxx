@@ -25,6 +25,7 @@
 #include "CaretLogger.h"
 #include "CaretPointer.h"
 #include "CiftiFile.h"
+#include "CiftiRowPipeline.h"
 #include "CiftiXML.h"
 #include "FloatMatrix.h"
 #include "GiftiFile.h"
@@ -42,6 +43,51 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    class FromGiftiRowWorker : public CiftiRowPipeline::RowWorker
+    {
+        const GiftiDataArray* m_array;
+        int64_t m_numCols;
+    public:
+        FromGiftiRowWorker(const GiftiDataArray* dataArray, const int64_t& numCols)
+        {
+            m_array = dataArray;
+            m_numCols = numCols;
+        }
+        void computeRow(const vector<int64_t>& outIndex, float* outRow, const int&)
+        {
+            for (int64_t j = 0; j < m_numCols; ++j)
+            {
+                int32_t indices[] = {(int32_t)outIndex[0], (int32_t)j};
+                outRow[j] = m_array->getDataFloat32(indices);
+            }
+        }
+    };
+    
+    class FromNiftiRowWorker : public CiftiRowPipeline::RowWorker
+    {
+        vector<const float*> m_frames;
+    public:
+        FromNiftiRowWorker(const VolumeFile* volume, const int64_t& numCols)
+        {
+            m_frames.resize(numCols);
+            for (int64_t j = 0; j < numCols; ++j)
+            {
+                m_frames[j] = volume->getFrame(j);
+            }
+        }
+        void computeRow(const vector<int64_t>& outIndex, float* outRow, const int&)
+        {
+            const int64_t i = outIndex[0];
+            for (int64_t j = 0; j < (int64_t)m_frames.size(); ++j)
+            {
+                outRow[j] = m_frames[j][i];
+            }
+        }
+    };
+}
+
 AString OperationCiftiConvert::getCommandSwitch()
 {
     return "-cifti-convert";
@@ -281,16 +327,8 @@ void OperationCiftiConvert::useParameters(OperationParameters* myParams, Progres
                 }
             }
         }
-        vector<float> scratchRow(numCols);
-        for (int i = 0; i < numRows; ++i)
-        {
-            for (int j = 0; j < numCols; ++j)
-            {
-                int32_t indices[] = {i, j};
-                scratchRow[j] = dataArrayRef->getDataFloat32(indices);
-            }
-            myOutFile->setRow(scratchRow.data(), i);
-        }
+        FromGiftiRowWorker myWorker(dataArrayRef, numCols);
+        CiftiRowPipeline(myOutFile).run(myWorker);
     }
     if (toNifti->m_present)
     {
@@ -406,15 +444,8 @@ void OperationCiftiConvert::useParameters(OperationParameters* myParams, Progres
                                      ", product of first three nifti dimensions is " + AString::number(myDims[0] * myDims[1] * myDims[2]) + ")");
         }
         myCiftiOut->setCiftiXML(outXML);
-        vector<float> rowscratch(numCols);
-        for (int64_t i = 0; i < numRows; ++i)
-        {
-            for (int64_t j = 0; j < numCols; ++j)
-            {
-                rowscratch[j] = myNiftiIn->getFrame(j)[i];
-            }
-            myCiftiOut->setRow(rowscratch.data(), i);
-        }
+        FromNiftiRowWorker myWorker(myNiftiIn, numCols);
+        CiftiRowPipeline(myCiftiOut).run(myWorker);
     }
     if (toText->m_present)
     {
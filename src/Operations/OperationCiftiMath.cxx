@@ -25,14 +25,109 @@
 #include "CaretLogger.h"
 #include "CaretMathExpression.h"
 #include "CiftiFile.h"
+#include "CiftiRowPipeline.h"
 #include "CiftiXML.h"
-#include "MultiDimIterator.h"
 
 #include <iostream>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    class MathRowWorker : public CiftiRowPipeline::RowWorker
+    {
+        const CaretMathExpression& m_expr;
+        const vector<CiftiFile*>& m_varFiles;
+        const vector<vector<int64_t> >& m_selectInfo;
+        int64_t m_rowLength;
+        bool m_nanfix;
+        float m_nanfixval;
+        struct SlotScratch
+        {
+            vector<const float*> varPointers;
+            vector<int64_t> varStrides;
+            vector<vector<float> > inputRows;
+            vector<vector<int64_t> > loadedRow;//to detect and prevent rereading the same row
+        };
+        vector<SlotScratch> m_slots;
+    public:
+        MathRowWorker(const CaretMathExpression& expr, const vector<CiftiFile*>& varFiles, const vector<vector<int64_t> >& selectInfo, const int64_t& rowLength,
+                      const bool& nanfix, const float& nanfixval) : m_expr(expr), m_varFiles(varFiles), m_selectInfo(selectInfo)
+        {
+            m_rowLength = rowLength;
+            m_nanfix = nanfix;
+            m_nanfixval = nanfixval;
+        }
+        void allocateSlots(const int& numSlots)
+        {
+            const int numVars = (int)m_varFiles.size();
+            m_slots.resize(numSlots);
+            for (int i = 0; i < numSlots; ++i)
+            {
+                m_slots[i].varPointers.resize(numVars);
+                m_slots[i].varStrides.resize(numVars);
+                m_slots[i].inputRows.resize(numVars);
+                m_slots[i].loadedRow.resize(numVars);
+                for (int v = 0; v < numVars; ++v)
+                {
+                    m_slots[i].inputRows[v].resize(m_varFiles[v]->getCiftiXML().getDimensionLength(CiftiXML::ALONG_ROW));
+                    m_slots[i].loadedRow[v].resize(m_varFiles[v]->getCiftiXML().getNumberOfDimensions() - 1, -1);//we always load a full row, so ignore first dim
+                }
+            }
+        }
+        void computeRow(const vector<int64_t>& outIndex, float* outRow, const int& slot)
+        {
+            CaretAssertVectorIndex(m_slots, slot);
+            SlotScratch& scratch = m_slots[slot];
+            const int numVars = (int)m_varFiles.size();
+            for (int v = 0; v < numVars; ++v)//first, retrieve whichever rows are needed
+            {
+                bool needToLoad = false;
+                for (int dim = 0; dim < (int)scratch.loadedRow[v].size(); ++dim)
+                {
+                    int64_t indexNeeded = -1;
+                    if (m_selectInfo[v][dim + 1] == -1)
+                    {
+                        CaretAssert(dim < (int)outIndex.size());//"match to output index" can't work past output dimensionality
+                        indexNeeded = outIndex[dim];//NOTE: outIndex also doesn't include the first dim
+                    } else {
+                        indexNeeded = m_selectInfo[v][dim + 1];
+                    }
+                    if (indexNeeded != scratch.loadedRow[v][dim])
+                    {
+                        needToLoad = true;
+                        scratch.loadedRow[v][dim] = indexNeeded;
+                    }
+                }
+                if (needToLoad)
+                {
+                    m_varFiles[v]->getRow(scratch.inputRows[v].data(), scratch.loadedRow[v]);
+                }
+            }
+            for (int v = 0; v < numVars; ++v)//now we check for select along row
+            {
+                if (m_selectInfo[v][0] == -1)
+                {
+                    scratch.varPointers[v] = scratch.inputRows[v].data();
+                    scratch.varStrides[v] = 1;
+                } else {
+                    scratch.varPointers[v] = scratch.inputRows[v].data() + m_selectInfo[v][0];
+                    scratch.varStrides[v] = 0;//same value for the whole row
+                }
+            }
+            m_expr.evaluateMany(scratch.varPointers, scratch.varStrides, outRow, m_rowLength);
+            if (m_nanfix)
+            {
+                for (int64_t j = 0; j < m_rowLength; ++j)
+                {
+                    if (outRow[j] != outRow[j]) outRow[j] = m_nanfixval;
+                }
+            }
+        }
+    };
+}
+
 AString OperationCiftiMath::getCommandSwitch()
 {
     return "-cifti-math";
@@ -235,57 +330,6 @@ void OperationCiftiMath::useParameters(OperationParameters* myParams, ProgressOb
     }
     if (outXML.getNumberOfDimensions() < 1) throw OperationException("output must have at least 1 dimension");
     myCiftiOut->setCiftiXML(outXML);
-    vector<float> values(numVars), scratchRow(outDims[0]);
-    vector<vector<float> > inputRows(numVars);
-    vector<vector<int64_t> > loadedRow(numVars);//to detect and prevent rereading the same row
-    for (int v = 0; v < numVars; ++v)
-    {
-        inputRows[v].resize(varCiftiFiles[v]->getCiftiXML().getDimensionLength(CiftiXML::ALONG_ROW));
-        loadedRow[v].resize(varCiftiFiles[v]->getCiftiXML().getNumberOfDimensions() - 1, -1);//we always load a full row, so ignore first dim
-    }
-    for (MultiDimIterator<int64_t> iter(vector<int64_t>(outDims.begin() + 1, outDims.end())); !iter.atEnd(); ++iter)
-    {
-        for (int v = 0; v < numVars; ++v)//first, retrieve whichever rows are needed
-        {
-            bool needToLoad = false;
-            for (int dim = 0; dim < (int)loadedRow[v].size(); ++dim)
-            {
-                int64_t indexNeeded = -1;
-                if (selectInfo[v][dim + 1] == -1)
-                {
-                    CaretAssert(dim + 1 < (int)outDims.size());//"match to output index" can't work past output dimensionality
-                    indexNeeded = (*iter)[dim];//NOTE: iter also doesn't include the first dim
-                } else {
-                    indexNeeded = selectInfo[v][dim + 1];
-                }
-                if (indexNeeded != loadedRow[v][dim])
-                {
-                    needToLoad = true;
-                    loadedRow[v][dim] = indexNeeded;
-                }
-            }
-            if (needToLoad)
-            {
-                varCiftiFiles[v]->getRow(inputRows[v].data(), loadedRow[v]);
-            }
-        }
-        for (int j = 0; j < outDims[0]; ++j)
-        {
-            for (int v = 0; v < numVars; ++v)//now we check for select along row
-            {
-                if (selectInfo[v][0] == -1)
-                {
-                    values[v] = inputRows[v][j];
-                } else {
-                    values[v] = inputRows[v][selectInfo[v][0]];
-                }
-            }
-            scratchRow[j] = (float)myExpr.evaluate(values);
-            if (nanfix && scratchRow[j] != scratchRow[j])
-            {
-                scratchRow[j] = nanfixval;
-            }
-        }
-        myCiftiOut->setRow(scratchRow.data(), *iter);
-    }
+    MathRowWorker myWorker(myExpr, varCiftiFiles, selectInfo, outDims[0], nanfix, nanfixval);
+    CiftiRowPipeline(myCiftiOut).run(myWorker);
 }
@@ -24,12 +24,57 @@
 #include "CaretAssert.h"
 #include "CaretPointer.h"
 #include "CiftiFile.h"
+#include "CiftiRowPipeline.h"
 
 #include <algorithm>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    class MergeRowWorker : public CiftiRowPipeline::RowWorker
+    {
+        const vector<const CiftiFile*>& m_inputs;
+        const vector<vector<int64_t> >& m_selectedColumns;//empty means use the whole row
+        int64_t m_scratchLength;
+        vector<vector<float> > m_scratchRows;//per slot
+    public:
+        MergeRowWorker(const vector<const CiftiFile*>& inputs, const vector<vector<int64_t> >& selectedColumns, const int64_t& scratchLength) :
+            m_inputs(inputs), m_selectedColumns(selectedColumns)
+        {
+            CaretAssert(m_inputs.size() == m_selectedColumns.size());
+            m_scratchLength = scratchLength;
+        }
+        void allocateSlots(const int& numSlots)
+        {
+            m_scratchRows.resize(numSlots, vector<float>(m_scratchLength));
+        }
+        void computeRow(const vector<int64_t>& outIndex, float* outRow, const int& slot)
+        {
+            CaretAssertVectorIndex(m_scratchRows, slot);
+            float* scratchRow = m_scratchRows[slot].data();
+            int64_t curCol = 0;
+            for (int i = 0; i < (int)m_inputs.size(); ++i)
+            {
+                const vector<int64_t>& thisSelect = m_selectedColumns[i];
+                if (thisSelect.empty())
+                {
+                    m_inputs[i]->getRow(outRow + curCol, outIndex);
+                    curCol += m_inputs[i]->getDimensions()[0];
+                } else {
+                    m_inputs[i]->getRow(scratchRow, outIndex);
+                    for (int64_t j = 0; j < (int64_t)thisSelect.size(); ++j)
+                    {
+                        outRow[curCol] = scratchRow[thisSelect[j]];
+                        ++curCol;
+                    }
+                }
+            }
+        }
+    };
+}
+
 AString OperationCiftiMerge::getCommandSwitch()
 {
     return "-cifti-merge";
@@ -255,54 +300,48 @@ void OperationCiftiMerge::useParameters(OperationParameters* myParams, ProgressO
             CaretAssert(false);
     }
     ciftiOut->setCiftiXML(outXML);
-    int64_t numRows = baseColMapping.getLength();
-    vector<float> outRow(numOutColumns), scratchRow(scratchRowLength);
-    for (int64_t row = 0; row < numRows; ++row)
+    vector<const CiftiFile*> inputFiles(numInputs);
+    vector<vector<int64_t> > selectedColumns(numInputs);//work out the -column options once, rather than for every row
+    curCol = 0;
+    for (int i = 0; i < numInputs; ++i)
     {
-        curCol = 0;
-        for (int i = 0; i < numInputs; ++i)
+        const CiftiFile* ciftiIn = myInputs[i]->getCifti(1);
+        inputFiles[i] = ciftiIn;
+        const CiftiXML& thisXML = ciftiIn->getCiftiXML();
+        const vector<ParameterComponent*>& columnOpts = *(myInputs[i]->getRepeatableParameterInstances(2));
+        int numColumnOpts = (int)columnOpts.size();
+        if (numColumnOpts > 0)
         {
-            const CiftiFile* ciftiIn = myInputs[i]->getCifti(1);
-            vector<int64_t> thisDims = ciftiIn->getDimensions();
-            const CiftiXML& thisXML = ciftiIn->getCiftiXML();
-            const vector<ParameterComponent*>& columnOpts = *(myInputs[i]->getRepeatableParameterInstances(2));
-            int numColumnOpts = (int)columnOpts.size();
-            if (numColumnOpts > 0)
+            for (int j = 0; j < numColumnOpts; ++j)
             {
-                ciftiIn->getRow(scratchRow.data(), row);
-                for (int j = 0; j < numColumnOpts; ++j)
+                int64_t initialColumn = thisXML.getMap(CiftiXML::ALONG_ROW)->getIndexFromNumberOrName(columnOpts[j]->getString(1));//this function has the 1-indexing convention built in
+                OptionalParameter* upToOpt = columnOpts[j]->getOptionalParameter(2);//we already checked that these strings give a valid column
+                if (upToOpt->m_present)
                 {
-                    int64_t initialColumn = thisXML.getMap(CiftiXML::ALONG_ROW)->getIndexFromNumberOrName(columnOpts[j]->getString(1));//this function has the 1-indexing convention built in
-                    OptionalParameter* upToOpt = columnOpts[j]->getOptionalParameter(2);//we already checked that these strings give a valid column
-                    if (upToOpt->m_present)
+                    int finalColumn = thisXML.getMap(CiftiXML::ALONG_ROW)->getIndexFromNumberOrName(upToOpt->getString(1));//ditto
+                    bool reverse = upToOpt->getOptionalParameter(2)->m_present;
+                    if (reverse)
                     {
-                        int finalColumn = thisXML.getMap(CiftiXML::ALONG_ROW)->getIndexFromNumberOrName(upToOpt->getString(1));//ditto
-                        bool reverse = upToOpt->getOptionalParameter(2)->m_present;
-                        if (reverse)
+                        for (int c = finalColumn; c >= initialColumn; --c)
                         {
-                            for (int c = finalColumn; c >= initialColumn; --c)
-                            {
-                                outRow[curCol] = scratchRow[c];
-                                ++curCol;
-                            }
-                        } else {
-                            for (int c = initialColumn; c <= finalColumn; ++c)
-                            {
-                                outRow[curCol] = scratchRow[c];
-                                ++curCol;
-                            }
+                            selectedColumns[i].push_back(c);
                         }
                     } else {
-                        outRow[curCol] = scratchRow[initialColumn];
-                        ++curCol;
+                        for (int c = initialColumn; c <= finalColumn; ++c)
+                        {
+                            selectedColumns[i].push_back(c);
+                        }
                     }
+                } else {
+                    selectedColumns[i].push_back(initialColumn);
                 }
-            } else {
-                ciftiIn->getRow(outRow.data() + curCol, row);
-                curCol += thisDims[0];
             }
+            curCol += (int64_t)selectedColumns[i].size();
+        } else {
+            curCol += ciftiIn->getDimensions()[0];
         }
-        CaretAssert(curCol == numOutColumns);
-        ciftiOut->setRow(outRow.data(), row);
     }
+    CaretAssert(curCol == numOutColumns);
+    MergeRowWorker myWorker(inputFiles, selectedColumns, scratchRowLength);
+    CiftiRowPipeline(ciftiOut).run(myWorker);
 }
@@ -0,0 +1,409 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "OperationCiftiResampleMatrix.h"
+#include "OperationException.h"
+
+#include "AffineFile.h"
+#include "CiftiFile.h"
+#include "FloatMatrix.h"
+#include "MetricFile.h"
+#include "ResamplingMatrix.h"
+#include "SurfaceFile.h"
+#include "SurfaceResamplingHelper.h"
+#include "Vector3D.h"
+#include "VolumeFile.h"
+#include "WarpfieldFile.h"
+
+#include <cmath>
+#include <map>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+AString OperationCiftiResampleMatrix::getCommandSwitch()
+{
+    return "-cifti-resample-matrix";
+}
+
+AString OperationCiftiResampleMatrix::getShortDescription()
+{
+    return "SAVE THE WEIGHTS OF A CIFTI RESAMPLING AS A MATRIX";
+}
+
+namespace
+{
+    void addSpheresOption(OptionalParameter* spheresOpt, const AString& name)
+    {
+        spheresOpt->addSurfaceParameter(1, "current-sphere", "a sphere with the same mesh as the current " + name + " surface");
+        spheresOpt->addSurfaceParameter(2, "new-sphere", "a sphere with the new " + name + " mesh that is in register with the current sphere");
+        OptionalParameter* areaSurfsOpt = spheresOpt->createOptionalParameter(3, "-" + name + "-area-surfs", "specify " + name + " surfaces to do vertex area correction based on");
+        areaSurfsOpt->addSurfaceParameter(1, "current-area", "a relevant " + name + " anatomical surface with current mesh");
+        areaSurfsOpt->addSurfaceParameter(2, "new-area", "a relevant " + name + " anatomical surface with new mesh");
+        OptionalParameter* areaMetricsOpt = spheresOpt->createOptionalParameter(4, "-" + name + "-area-metrics", "specify " + name + " vertex area metrics to do area correction based on");
+        areaMetricsOpt->addMetricParameter(1, "current-area", "a metric file with vertex areas for the current mesh");
+        areaMetricsOpt->addMetricParameter(2, "new-area", "a metric file with vertex areas for the new mesh");
+    }
+    
+    struct SphereInfo
+    {
+        const SurfaceFile* curSphere, *newSphere;
+        vector<float> curAreas, newAreas;
+        SphereInfo() { curSphere = NULL; newSphere = NULL; }
+    };
+    
+    void parseSpheresOption(OptionalParameter* spheresOpt, const AString& name, SphereInfo& infoOut)
+    {
+        if (!spheresOpt->m_present) return;
+        infoOut.curSphere = spheresOpt->getSurface(1);
+        infoOut.newSphere = spheresOpt->getSurface(2);
+        OptionalParameter* areaSurfsOpt = spheresOpt->getOptionalParameter(3);
+        if (areaSurfsOpt->m_present)
+        {
+            areaSurfsOpt->getSurface(1)->computeNodeAreas(infoOut.curAreas);
+            areaSurfsOpt->getSurface(2)->computeNodeAreas(infoOut.newAreas);
+        }
+        OptionalParameter* areaMetricsOpt = spheresOpt->getOptionalParameter(4);
+        if (areaMetricsOpt->m_present)
+        {
+            if (areaSurfsOpt->m_present)
+            {
+                throw OperationException("only one of -" + name + "-area-surfs and -" + name + "-area-metrics can be specified");
+            }
+            MetricFile* curAreaMetric = areaMetricsOpt->getMetric(1);
+            MetricFile* newAreaMetric = areaMetricsOpt->getMetric(2);
+            infoOut.curAreas.assign(curAreaMetric->getValuePointerForColumn(0), curAreaMetric->getValuePointerForColumn(0) + curAreaMetric->getNumberOfNodes());
+            infoOut.newAreas.assign(newAreaMetric->getValuePointerForColumn(0), newAreaMetric->getValuePointerForColumn(0) + newAreaMetric->getNumberOfNodes());
+        }
+    }
+    
+    int parseDirection(const AString& dirString)
+    {
+        if (dirString == "ROW") return CiftiXML::ALONG_ROW;
+        if (dirString == "COLUMN") return CiftiXML::ALONG_COLUMN;
+        throw OperationException("unrecognized direction string '" + dirString + "', use ROW or COLUMN");
+    }
+    
+    void addSurfaceWeights(const CiftiBrainModelsMap& inModels, const CiftiBrainModelsMap& outModels, const StructureEnum::Enum& myStruct, const SphereInfo& myInfo,
+                           const SurfaceResamplingMethodEnum::Enum& mySurfMethod, const bool& surfLargest, vector<map<int64_t, float> >& rowWeights)
+    {
+        const AString structName = StructureEnum::toGuiName(myStruct);
+        if (!inModels.hasSurfaceData(myStruct)) throw OperationException("input cifti missing surface information for structure: " + structName);
+        vector<CiftiBrainModelsMap::SurfaceMap> outMap = outModels.getSurfaceMap(myStruct);
+        if (myInfo.curSphere == NULL)
+        {//copy, same as -cifti-resample
+            if (inModels.getSurfaceNumberOfNodes(myStruct) != outModels.getSurfaceNumberOfNodes(myStruct)) throw OperationException(structName + " structure requires resampling spheres, does not match template");
+            for (int64_t i = 0; i < (int64_t)outMap.size(); ++i)
+            {
+                int64_t inIndex = inModels.getIndexForNode(outMap[i].m_surfaceNode, myStruct);
+                if (inIndex >= 0) rowWeights[outMap[i].m_ciftiIndex][inIndex] = 1.0f;
+            }
+            return;
+        }
+        if (myInfo.newSphere == NULL) throw OperationException("missing " + structName + " new sphere");
+        int curNodes = myInfo.curSphere->getNumberOfNodes();
+        if (curNodes != inModels.getSurfaceNumberOfNodes(myStruct)) throw OperationException(structName + " current sphere doesn't match input cifti");
+        if (myInfo.newSphere->getNumberOfNodes() != outModels.getSurfaceNumberOfNodes(myStruct)) throw OperationException(structName + " new sphere doesn't match template cifti");
+        const float* curAreaData = NULL, *newAreaData = NULL;
+        switch (mySurfMethod)
+        {
+            case SurfaceResamplingMethodEnum::ADAP_BARY_AREA:
+                if (myInfo.curAreas.empty() || myInfo.newAreas.empty()) throw OperationException(structName + " area data is missing");
+                if ((int)myInfo.curAreas.size() != curNodes) throw OperationException(structName + " current area data has the wrong number of vertices");
+                if ((int)myInfo.newAreas.size() != myInfo.newSphere->getNumberOfNodes()) throw OperationException(structName + " new area data has the wrong number of vertices");
+                curAreaData = myInfo.curAreas.data();
+                newAreaData = myInfo.newAreas.data();
+                break;
+            default:
+                break;
+        }
+        vector<CiftiBrainModelsMap::SurfaceMap> inMap = inModels.getSurfaceMap(myStruct);
+        vector<float> curRoi(curNodes, 0.0f);//-cifti-resample uses the input cifti's vertices as the current roi
+        vector<int64_t> nodeToIndex(curNodes, -1);
+        for (int64_t i = 0; i < (int64_t)inMap.size(); ++i)
+        {
+            curRoi[inMap[i].m_surfaceNode] = 1.0f;
+            nodeToIndex[inMap[i].m_surfaceNode] = inMap[i].m_ciftiIndex;
+        }
+        SurfaceResamplingHelper myHelp(mySurfMethod, myInfo.curSphere, myInfo.newSphere, curAreaData, newAreaData, curRoi.data());
+        vector<int> nodes;
+        vector<float> weights;
+        for (int64_t i = 0; i < (int64_t)outMap.size(); ++i)
+        {
+            myHelp.getNodeWeights(outMap[i].m_surfaceNode, nodes, weights);
+            if (nodes.empty()) continue;
+            map<int64_t, float>& thisRow = rowWeights[outMap[i].m_ciftiIndex];
+            if (surfLargest)
+            {
+                int best = 0;
+                for (int j = 1; j < (int)nodes.size(); ++j)
+                {
+                    if (weights[j] > weights[best]) best = j;
+                }
+                if (nodeToIndex[nodes[best]] >= 0) thisRow[nodeToIndex[nodes[best]]] = 1.0f;
+            } else {
+                for (int j = 0; j < (int)nodes.size(); ++j)
+                {
+                    if (nodeToIndex[nodes[j]] >= 0) thisRow[nodeToIndex[nodes[j]]] = weights[j];
+                }
+            }
+        }
+    }
+    
+    //the input coordinate for an output voxel, through the affine or the warpfield, false if the warpfield doesn't cover it
+    bool transformCoord(Vector3D outCoord, const FloatMatrix& targetToSource, const VolumeFile* warpfield, Vector3D& inCoord)
+    {
+        if (warpfield != NULL)
+        {
+            bool validDisplacement = false;
+            Vector3D displacement;
+            displacement[0] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, &validDisplacement, 0);
+            if (!validDisplacement) return false;
+            displacement[1] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 1);
+            displacement[2] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 2);
+            inCoord = outCoord + displacement;
+            return true;
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            inCoord[i] = targetToSource[i][0] * outCoord[0] + targetToSource[i][1] * outCoord[1] + targetToSource[i][2] * outCoord[2] + targetToSource[i][3];
+        }
+        return true;
+    }
+    
+    void addVolumeWeights(const CiftiBrainModelsMap& inModels, const CiftiBrainModelsMap& outModels, const StructureEnum::Enum& myStruct,
+                          const VolumeFile::InterpType& myVolMethod, const FloatMatrix& targetToSource, const VolumeFile* warpfield,
+                          vector<map<int64_t, float> >& rowWeights)
+    {
+        if (!inModels.hasVolumeData(myStruct)) throw OperationException(StructureEnum::toGuiName(myStruct) + " volume model missing from input cifti");
+        vector<CiftiBrainModelsMap::VolumeMap> inMap = inModels.getVolumeStructureMap(myStruct), outMap = outModels.getVolumeStructureMap(myStruct);
+        if (inMap.empty()) return;
+        int64_t offset[3], dims[3];//-cifti-resample works on the bounding box of the structure, with zeros outside the structure
+        for (int j = 0; j < 3; ++j)
+        {
+            int64_t low = inMap[0].m_ijk[j], high = inMap[0].m_ijk[j];
+            for (int64_t i = 1; i < (int64_t)inMap.size(); ++i)
+            {
+                if (inMap[i].m_ijk[j] < low) low = inMap[i].m_ijk[j];
+                if (inMap[i].m_ijk[j] > high) high = inMap[i].m_ijk[j];
+            }
+            offset[j] = low;
+            dims[j] = high - low + 1;
+        }
+        vector<int64_t> boxToIndex(dims[0] * dims[1] * dims[2], -1);
+        for (int64_t i = 0; i < (int64_t)inMap.size(); ++i)
+        {
+            boxToIndex[(inMap[i].m_ijk[0] - offset[0]) + dims[0] * ((inMap[i].m_ijk[1] - offset[1]) + dims[1] * (inMap[i].m_ijk[2] - offset[2]))] = inMap[i].m_ciftiIndex;
+        }
+        VolumeFile::InterpType useMethod = myVolMethod;
+        if (dims[0] == 1 || dims[1] == 1 || dims[2] == 1) useMethod = VolumeFile::ENCLOSING_VOXEL;//VolumeFile does the same for single slices
+        const VolumeSpace& inSpace = inModels.getVolumeSpace(), &outSpace = outModels.getVolumeSpace();
+        for (int64_t i = 0; i < (int64_t)outMap.size(); ++i)
+        {
+            Vector3D outCoord, inCoord;
+            outSpace.indexToSpace(outMap[i].m_ijk, outCoord);
+            if (!transformCoord(outCoord, targetToSource, warpfield, inCoord)) continue;
+            float index[3];
+            inSpace.spaceToIndex(inCoord, index);
+            for (int j = 0; j < 3; ++j) index[j] -= offset[j];
+            map<int64_t, float>& thisRow = rowWeights[outMap[i].m_ciftiIndex];
+            if (useMethod == VolumeFile::ENCLOSING_VOXEL)
+            {
+                int64_t ijk[3];
+                bool valid = true;
+                for (int j = 0; j < 3; ++j)
+                {
+                    ijk[j] = (int64_t)floor(0.5f + index[j]);
+                    if (ijk[j] < 0 || ijk[j] >= dims[j]) valid = false;
+                }
+                if (!valid) continue;
+                int64_t inIndex = boxToIndex[ijk[0] + dims[0] * (ijk[1] + dims[1] * ijk[2])];
+                if (inIndex >= 0) thisRow[inIndex] = 1.0f;
+            } else {//TRILINEAR
+                int64_t low[3];
+                float highWeight[3];
+                bool valid = true;
+                for (int j = 0; j < 3; ++j)
+                {
+                    low[j] = (int64_t)floor(index[j]);
+                    highWeight[j] = index[j] - low[j];
+                    if (low[j] < 0 || low[j] + 1 >= dims[j]) valid = false;
+                }
+                if (!valid) continue;
+                for (int corner = 0; corner < 8; ++corner)
+                {
+                    int64_t ijk[3];
+                    float weight = 1.0f;
+                    for (int j = 0; j < 3; ++j)
+                    {
+                        bool high = (corner >> j) & 1;
+                        ijk[j] = low[j] + (high ? 1 : 0);
+                        weight *= (high ? highWeight[j] : 1.0f - highWeight[j]);
+                    }
+                    int64_t inIndex = boxToIndex[ijk[0] + dims[0] * (ijk[1] + dims[1] * ijk[2])];
+                    if (inIndex >= 0 && weight != 0.0f) thisRow[inIndex] = weight;
+                }
+            }
+        }
+    }
+}
+
+OperationParameters* OperationCiftiResampleMatrix::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    
+    ret->addCiftiParameter(1, "cifti-in", "a cifti file in the cifti space to resample from");
+    
+    ret->addStringParameter(2, "direction", "the direction of the input that has the current space, ROW or COLUMN");
+    
+    ret->addCiftiParameter(3, "cifti-template", "a cifti file containing the cifti space to resample to");
+    
+    ret->addStringParameter(4, "template-direction", "the direction of the template to use as the resampling space, ROW or COLUMN");
+    
+    ret->addStringParameter(5, "surface-method", "specify a surface resampling method");
+    
+    ret->addStringParameter(6, "volume-method", "specify a volume interpolation method");
+    
+    ret->addStringParameter(7, "matrix-out", "output - the output resampling matrix file");//HACK: fake the output format since we don't have a wbsparse parameter type
+    
+    ret->createOptionalParameter(8, "-surface-largest", "use largest weight instead of weighted average when doing surface resampling");
+    
+    OptionalParameter* affineOpt = ret->createOptionalParameter(9, "-affine", "use an affine transformation on the volume components");
+    affineOpt->addStringParameter(1, "affine-file", "the affine file to use");
+    OptionalParameter* flirtOpt = affineOpt->createOptionalParameter(2, "-flirt", "MUST be used if affine is a flirt affine");
+    flirtOpt->addStringParameter(1, "source-volume", "the source volume used when generating the affine");
+    flirtOpt->addStringParameter(2, "target-volume", "the target volume used when generating the affine");
+    
+    OptionalParameter* warpfieldOpt = ret->createOptionalParameter(10, "-warpfield", "use a warpfield on the volume components");
+    warpfieldOpt->addStringParameter(1, "warpfield", "the warpfield to use");
+    OptionalParameter* fnirtOpt = warpfieldOpt->createOptionalParameter(2, "-fnirt", "MUST be used if using a fnirt warpfield");
+    fnirtOpt->addStringParameter(1, "source-volume", "the source volume used when generating the warpfield");
+    
+    addSpheresOption(ret->createOptionalParameter(11, "-left-spheres", "specify spheres for left surface resampling"), "left");
+    addSpheresOption(ret->createOptionalParameter(12, "-right-spheres", "specify spheres for right surface resampling"), "right");
+    addSpheresOption(ret->createOptionalParameter(13, "-cerebellum-spheres", "specify spheres for cerebellum surface resampling"), "cerebellum");
+    
+    AString myHelpText =
+        AString("Computes the weights that -cifti-resample would use for both surface and volume components, and saves them as a sparse matrix file, ") +
+        "which should be named ending in .resample.wbsparse.  " +
+        "Use -cifti-apply-resample-matrix to apply it to any number of cifti files with the same space as <cifti-in> along the resampled direction.  " +
+        "The options have the same meaning as in -cifti-resample.  " +
+        "Dilation is not a fixed linear operation, so it is not available here, apply -cifti-dilate to the output instead.\n\n" +
+        "CUBIC interpolation uses the whole volume to compute its spline coefficients, so it can't be stored as a sparse matrix, " +
+        "the <volume-method> argument must be one of the following:\n\n" +
+        "ENCLOSING_VOXEL\nTRILINEAR\n\n" +
+        "The <surface-method> argument must be one of the following:\n\n";
+    vector<SurfaceResamplingMethodEnum::Enum> allEnums;
+    SurfaceResamplingMethodEnum::getAllEnums(allEnums);
+    for (int i = 0; i < (int)allEnums.size(); ++i)
+    {
+        myHelpText += SurfaceResamplingMethodEnum::toName(allEnums[i]) + "\n";
+    }
+    ret->setHelpText(myHelpText);
+    return ret;
+}
+
+void OperationCiftiResampleMatrix::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    CiftiFile* myCiftiIn = myParams->getCifti(1);
+    int direction = parseDirection(myParams->getString(2));
+    CiftiFile* myTemplate = myParams->getCifti(3);
+    int templateDir = parseDirection(myParams->getString(4));
+    bool ok = false;
+    SurfaceResamplingMethodEnum::Enum mySurfMethod = SurfaceResamplingMethodEnum::fromName(myParams->getString(5), &ok);
+    if (!ok)
+    {
+        throw OperationException("invalid surface resampling method name");
+    }
+    AString myVolMethodString = myParams->getString(6);
+    VolumeFile::InterpType myVolMethod = VolumeFile::TRILINEAR;
+    if (myVolMethodString == "TRILINEAR")
+    {
+        myVolMethod = VolumeFile::TRILINEAR;
+    } else if (myVolMethodString == "ENCLOSING_VOXEL") {
+        myVolMethod = VolumeFile::ENCLOSING_VOXEL;
+    } else if (myVolMethodString == "CUBIC") {
+        throw OperationException("CUBIC interpolation can't be stored as a sparse matrix, use TRILINEAR or ENCLOSING_VOXEL");
+    } else {
+        throw OperationException("unrecognized volume interpolation method");
+    }
+    AString matrixOutName = myParams->getString(7);
+    bool surfLargest = myParams->getOptionalParameter(8)->m_present;
+    OptionalParameter* affineOpt = myParams->getOptionalParameter(9);
+    OptionalParameter* warpfieldOpt = myParams->getOptionalParameter(10);
+    if (affineOpt->m_present && warpfieldOpt->m_present) throw OperationException("you cannot specify both -affine and -warpfield");
+    AffineFile myAffine;//identity if not specified
+    WarpfieldFile myWarpfield;
+    const VolumeFile* warpfield = NULL;
+    if (affineOpt->m_present)
+    {
+        OptionalParameter* flirtOpt = affineOpt->getOptionalParameter(2);
+        if (flirtOpt->m_present)
+        {
+            myAffine.readFlirt(affineOpt->getString(1), flirtOpt->getString(1), flirtOpt->getString(2));
+        } else {
+            myAffine.readWorld(affineOpt->getString(1));
+        }
+    }
+    if (warpfieldOpt->m_present)
+    {
+        OptionalParameter* fnirtOpt = warpfieldOpt->getOptionalParameter(2);
+        if (fnirtOpt->m_present)
+        {
+            myWarpfield.readFnirt(warpfieldOpt->getString(1), fnirtOpt->getString(1));
+        } else {
+            myWarpfield.readWorld(warpfieldOpt->getString(1));
+        }
+        warpfield = myWarpfield.getWarpfield();
+    }
+    FloatMatrix targetToSource = myAffine.getMatrix();//same as AlgorithmVolumeAffineResample
+    targetToSource.resize(4, 4);
+    targetToSource[3][0] = 0.0f;
+    targetToSource[3][1] = 0.0f;
+    targetToSource[3][2] = 0.0f;
+    targetToSource[3][3] = 1.0f;
+    targetToSource = targetToSource.inverse();
+    map<StructureEnum::Enum, SphereInfo> sphereInfo;
+    parseSpheresOption(myParams->getOptionalParameter(11), "left", sphereInfo[StructureEnum::CORTEX_LEFT]);
+    parseSpheresOption(myParams->getOptionalParameter(12), "right", sphereInfo[StructureEnum::CORTEX_RIGHT]);
+    parseSpheresOption(myParams->getOptionalParameter(13), "cerebellum", sphereInfo[StructureEnum::CEREBELLUM]);
+    const CiftiXML& inXML = myCiftiIn->getCiftiXML(), &templateXML = myTemplate->getCiftiXML();
+    if (direction >= inXML.getNumberOfDimensions() || inXML.getMappingType(direction) != CiftiMappingType::BRAIN_MODELS) throw OperationException("direction for input must contain brain models");
+    if (templateDir >= templateXML.getNumberOfDimensions() || templateXML.getMappingType(templateDir) != CiftiMappingType::BRAIN_MODELS) throw OperationException("direction for template must contain brain models");
+    const CiftiBrainModelsMap& inModels = inXML.getBrainModelsMap(direction), &outModels = templateXML.getBrainModelsMap(templateDir);
+    vector<map<int64_t, float> > rowWeights(outModels.getLength());
+    vector<StructureEnum::Enum> surfList = outModels.getSurfaceStructureList(), volList = outModels.getVolumeStructureList();
+    for (int i = 0; i < (int)surfList.size(); ++i)
+    {
+        map<StructureEnum::Enum, SphereInfo>::const_iterator iter = sphereInfo.find(surfList[i]);
+        if (iter == sphereInfo.end()) throw OperationException("unsupported surface structure: " + StructureEnum::toGuiName(surfList[i]));
+        addSurfaceWeights(inModels, outModels, surfList[i], iter->second, mySurfMethod, surfLargest, rowWeights);
+    }
+    for (int i = 0; i < (int)volList.size(); ++i)
+    {
+        addVolumeWeights(inModels, outModels, volList[i], myVolMethod, targetToSource, warpfield, rowWeights);
+    }
+    ResamplingMatrix myMatrix;
+    myMatrix.setSpaces(inModels, outModels);
+    myMatrix.setWeights(rowWeights);
+    myMatrix.writeFile(matrixOutName);
+}
@@ -189,28 +189,46 @@ void OperationCiftiStats::useParameters(OperationParameters* myParams, ProgressO
     bool showMapName = myParams->getOptionalParameter(6)->m_present;
     const CiftiMappingType* rowMap = myXML.getMap(CiftiXML::ALONG_ROW);
     vector<float> colScratch(colLength);
-    int64_t columnStart, columnEnd;
+    vector<int64_t> columns;
     if (useColumn == -1)
     {
-        myInput->convertToInMemory();//we will be getting all columns, so read it all in first
-        if (roiCifti != NULL) roiCifti->convertToInMemory();//ditto
-        columnStart = 0;
-        columnEnd = numCols;
+        for (int64_t i = 0; i < numCols; ++i)
+        {
+            columns.push_back(i);
+        }
     } else {
-        if (roiCifti != NULL && !matchColumnMode) roiCifti->convertToInMemory();//matching maps with one column selected is the only time we don't need the whole ROI file
-        columnStart = useColumn;
-        columnEnd = useColumn + 1;
+        columns.push_back(useColumn);
+    }
+    const int64_t numUsed = (int64_t)columns.size();
+    vector<float> inColumns(numUsed * colLength), roiColumns;//get all the needed columns in one pass through the file, instead of reading element by element
+    myInput->getColumns(inColumns.data(), columns);
+    if (roiCifti != NULL)
+    {
+        if (matchColumnMode)
+        {
+            roiColumns.resize(numUsed * colLength);
+            roiCifti->getColumns(roiColumns.data(), columns);
+        } else {
+            vector<int64_t> allRois;
+            for (int64_t j = 0; j < numRois; ++j)
+            {
+                allRois.push_back(j);
+            }
+            roiColumns.resize(numRois * colLength);
+            roiCifti->getColumns(roiColumns.data(), allRois);
+        }
     }
-    for (int i = columnStart; i < columnEnd; ++i)
+    for (int64_t c = 0; c < numUsed; ++c)
     {
-        myInput->getColumn(colScratch.data(), i);
+        const int64_t i = columns[c];
+        colScratch.assign(inColumns.begin() + c * colLength, inColumns.begin() + (c + 1) * colLength);
         if (showMapName)
         {
             cout << AString::number(i + 1) << ":\t" << rowMap->getIndexName(i) << ":\t";
         }
         if (matchColumnMode)
         {//trick: matchColumn is only true when we have an roi
-            roiCifti->getColumn(roiData.data(), i);
+            roiData.assign(roiColumns.begin() + c * colLength, roiColumns.begin() + (c + 1) * colLength);
             float result;
             if (reduceOpt->m_present)
             {
@@ -225,7 +243,7 @@ void OperationCiftiStats::useParameters(OperationParameters* myParams, ProgressO
         } else {
             for (int64_t j = 0; j < numRois; ++j)
             {
-                if (roiCifti != NULL) roiCifti->getColumn(roiData.data(), j);
+                if (roiCifti != NULL) roiData.assign(roiColumns.begin() + j * colLength, roiColumns.begin() + (j + 1) * colLength);
                 float result;
                 if (reduceOpt->m_present)
                 {
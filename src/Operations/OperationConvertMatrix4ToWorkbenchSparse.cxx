@@ -22,6 +22,7 @@
 #include "OperationException.h"
 
 #include "CaretHeap.h"
+#include "CaretOMP.h"
 #include "CaretSparseFile.h"
 #include "CiftiFile.h"
 #include "OxfordSparseThreeFile.h"
@@ -64,9 +65,12 @@ OperationParameters* OperationConvertMatrix4ToWorkbenchSparse::getParameters()
     volumeOpt->addCiftiParameter(1, "cifti-template", "cifti file to use the volume mappings from");
     volumeOpt->addStringParameter(2, "direction", "dimension along the cifti file to take the mapping from, ROW or COLUMN");
     
+    ret->createOptionalParameter(9, "-compress", "write the output in the compressed wbsparse format");
+    
     ret->setHelpText(
         AString("Converts the matrix 4 output of probtrackx to workbench sparse file format.  ") +
-        "Exactly one of -surface-seeds and -volume-seeds must be specified."
+        "Exactly one of -surface-seeds and -volume-seeds must be specified.  " +
+        "The compressed format from -compress is usually much smaller, but older versions of wb_command and wb_view can't read it."
     );
     return ret;
 }
@@ -180,34 +184,48 @@ void OperationConvertMatrix4ToWorkbenchSparse::useParameters(OperationParameters
             rowReorder[i / 3] = tempInd;
         }
     }
-    CaretSparseFileWriter mywriter(outFileName, myXML);//NOTE: CaretSparseFile has a different encoding of fibers, ALWAYS use getFibersRow, etc
-    vector<int64_t> indicesIn, indicesOut;//this method knows about sparseness, does sorting of indexes in order to avoid scanning full rows
-    vector<FiberFractions> fibersIn, fibersOut;//can be slower if matrix isn't very sparse, but that is a problem for other reasons anyway
-    CaretMinHeap<FiberFractions, int64_t> myHeap;//use our heap to do heapsort, rather than coding a struct for stl sort
-    for (int64_t i = 0; i < sparseDims[1]; ++i)
+    CaretSparseFileWriter mywriter(outFileName, myXML, myParams->getOptionalParameter(9)->m_present);//NOTE: CaretSparseFile has a different encoding of fibers, ALWAYS use getFibersRow, etc
+    const int64_t BLOCK_ROWS = 1024;//the input file is read serially, but reordering and encoding are done in parallel a block at a time
+    vector<vector<int64_t> > indicesIn(BLOCK_ROWS), indicesOut(BLOCK_ROWS);//this method knows about sparseness, does sorting of indexes in order to avoid scanning full rows
+    vector<vector<FiberFractions> > fibersIn(BLOCK_ROWS), fibersOut(BLOCK_ROWS);//can be slower if matrix isn't very sparse, but that is a problem for other reasons anyway
+    for (int64_t blockStart = 0; blockStart < sparseDims[1]; blockStart += BLOCK_ROWS)
     {
-        inFile.getFibersRowSparse(i, indicesIn, fibersIn);
-        size_t numNonzero = indicesIn.size();
-        myHeap.reserve(numNonzero);
-        for (size_t j = 0; j < numNonzero; ++j)
+        int64_t blockRows = min(BLOCK_ROWS, sparseDims[1] - blockStart);
+        for (int64_t i = 0; i < blockRows; ++i)
         {
-            int64_t newIndex = rowReorder[indicesIn[j]];//reorder
-            if (newIndex != -1)
-            {
-                myHeap.push(fibersIn[j], newIndex);//heapify
-            }
+            inFile.getFibersRowSparse(blockStart + i, indicesIn[i], fibersIn[i]);
         }
-        indicesOut.resize(myHeap.size());
-        fibersOut.resize(myHeap.size());
-        int64_t curIndex = 0;
-        while (!myHeap.isEmpty())
+        indicesOut.resize(blockRows);
+        fibersOut.resize(blockRows);
+#pragma omp CARET_PAR
         {
-            int64_t newIndex;
-            fibersOut[curIndex] = myHeap.pop(&newIndex);
-            indicesOut[curIndex] = newIndex;
-            ++curIndex;
+            CaretMinHeap<FiberFractions, int64_t> myHeap;//use our heap to do heapsort, rather than coding a struct for stl sort
+#pragma omp CARET_FOR schedule(dynamic, 16)
+            for (int64_t i = 0; i < blockRows; ++i)
+            {
+                size_t numNonzero = indicesIn[i].size();
+                myHeap.reserve(numNonzero);
+                for (size_t j = 0; j < numNonzero; ++j)
+                {
+                    int64_t newIndex = rowReorder[indicesIn[i][j]];//reorder
+                    if (newIndex != -1)
+                    {
+                        myHeap.push(fibersIn[i][j], newIndex);//heapify
+                    }
+                }
+                indicesOut[i].resize(myHeap.size());
+                fibersOut[i].resize(myHeap.size());
+                int64_t curIndex = 0;
+                while (!myHeap.isEmpty())
+                {
+                    int64_t newIndex;
+                    fibersOut[i][curIndex] = myHeap.pop(&newIndex);
+                    indicesOut[i][curIndex] = newIndex;
+                    ++curIndex;
+                }
+            }
         }
-        mywriter.writeFibersRowSparse(i, indicesOut, fibersOut);
+        mywriter.writeFibersRowsSparse(blockStart, indicesOut, fibersOut);
     }
     mywriter.finish();
 }
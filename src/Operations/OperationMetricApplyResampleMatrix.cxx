@@ -0,0 +1,98 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "OperationMetricApplyResampleMatrix.h"
+#include "OperationException.h"
+
+#include "MetricFile.h"
+#include "PaletteColorMapping.h"
+#include "ResamplingMatrix.h"
+
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+AString OperationMetricApplyResampleMatrix::getCommandSwitch()
+{
+    return "-metric-apply-resample-matrix";
+}
+
+AString OperationMetricApplyResampleMatrix::getShortDescription()
+{
+    return "RESAMPLE A METRIC FILE WITH A SAVED RESAMPLING MATRIX";
+}
+
+OperationParameters* OperationMetricApplyResampleMatrix::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    ret->addMetricParameter(1, "metric-in", "the metric file to resample");
+    
+    ret->addStringParameter(2, "matrix", "the resampling matrix file");
+    
+    ret->addMetricOutputParameter(3, "metric-out", "the output metric");
+    
+    ret->setHelpText(
+        AString("Resamples all columns of a metric file at once with a matrix from -surface-resample-matrix.  ") +
+        "The result is the same as -metric-resample with the options that were used to make the matrix."
+    );
+    return ret;
+}
+
+void OperationMetricApplyResampleMatrix::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    MetricFile* metricIn = myParams->getMetric(1);
+    ResamplingMatrix myMatrix;
+    myMatrix.readFile(myParams->getString(2));
+    MetricFile* metricOut = myParams->getOutputMetric(3);
+    const CiftiBrainModelsMap& inSpace = myMatrix.getInputSpace(), &outSpace = myMatrix.getOutputSpace();
+    if (inSpace.getSurfaceStructureList().size() != 1 || inSpace.hasVolumeData() ||
+        outSpace.getSurfaceStructureList().size() != 1 || outSpace.hasVolumeData())
+    {
+        throw OperationException("resampling matrix is not for a single surface, use -cifti-apply-resample-matrix instead");
+    }
+    int64_t numInNodes = myMatrix.getNumberOfInputs(), numOutNodes = myMatrix.getNumberOfOutputs();
+    if (metricIn->getNumberOfNodes() != numInNodes) throw OperationException("input metric has different number of vertices than the resampling matrix input");
+    int64_t numColumns = metricIn->getNumberOfColumns();
+    vector<float> inData(numInNodes * numColumns), outData(numOutNodes * numColumns);
+    for (int64_t c = 0; c < numColumns; ++c)//matrix wants vertex-major data, so that each vertex's columns are contiguous
+    {
+        const float* inCol = metricIn->getValuePointerForColumn(c);
+        for (int64_t i = 0; i < numInNodes; ++i)
+        {
+            inData[i * numColumns + c] = inCol[i];
+        }
+    }
+    myMatrix.multiply(inData.data(), numColumns, outData.data());
+    metricOut->setNumberOfNodesAndColumns(numOutNodes, numColumns);
+    metricOut->setStructure(metricIn->getStructure());
+    vector<float> colScratch(numOutNodes);
+    for (int64_t c = 0; c < numColumns; ++c)
+    {
+        for (int64_t i = 0; i < numOutNodes; ++i)
+        {
+            colScratch[i] = outData[i * numColumns + c];
+        }
+        metricOut->setValuesForColumn(c, colScratch.data());
+        metricOut->setColumnName(c, metricIn->getColumnName(c));
+        *metricOut->getPaletteColorMapping(c) = *metricIn->getPaletteColorMapping(c);
+    }
+}
@@ -21,8 +21,9 @@
 #include "OperationSurfaceGeodesicDistanceAllToAll.h"
 #include "OperationException.h"
 
-#include "CaretOMP.h"
 #include "CiftiFile.h"
+#include "CiftiRowPipeline.h"
+#include "GeodesicAllPairsHelper.h"
 #include "GeodesicHelper.h"
 #include "MetricFile.h"
 #include "SurfaceFile.h"
@@ -30,6 +31,44 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    class GeodesicRowWorker : public CiftiRowPipeline::RowWorker
+    {
+        const GeodesicAllPairsHelper& m_helper;
+        const vector<CiftiBrainModelsMap::SurfaceMap>& m_surfMap;
+        float m_distLimit;
+        vector<CaretPointer<GeodesicAllPairsHelper> > m_slotHelpers;
+        vector<vector<float> > m_slotDists;
+    public:
+        GeodesicRowWorker(const GeodesicAllPairsHelper& helper, const vector<CiftiBrainModelsMap::SurfaceMap>& surfMap, const float& distLimit) :
+            m_helper(helper), m_surfMap(surfMap), m_distLimit(distLimit)
+        {
+        }
+        void allocateSlots(const int& numSlots)
+        {
+            m_slotHelpers.resize(numSlots);
+            m_slotDists.resize(numSlots);
+            for (int i = 0; i < numSlots; ++i)
+            {
+                m_slotHelpers[i].grabNew(new GeodesicAllPairsHelper(m_helper));//shares the neighbor arrays
+                m_slotDists[i].resize(m_helper.getNumberOfNodes());
+            }
+        }
+        void computeRow(const vector<int64_t>& outIndex, float* outRow, const int& slot)
+        {
+            CaretAssertVectorIndex(m_slotHelpers, slot);
+            vector<float>& dists = m_slotDists[slot];
+            m_slotHelpers[slot]->getGeoFromNode(m_surfMap[outIndex[0]].m_surfaceNode, dists.data(), m_distLimit);//nodes beyond the limit get -1
+            const int64_t mapLength = (int64_t)m_surfMap.size();
+            for (int64_t j = 0; j < mapLength; ++j)
+            {
+                outRow[j] = dists[m_surfMap[j].m_surfaceNode];
+            }
+        }
+    };
+}
+
 AString OperationSurfaceGeodesicDistanceAllToAll::getCommandSwitch()
 {
     return "-surface-geodesic-distance-all-to-all";
@@ -92,62 +131,32 @@ void OperationSurfaceGeodesicDistanceAllToAll::useParameters(OperationParameters
         distLimit = limitOpt->getDouble(1);
         if (!(distLimit > 0.0f)) throw OperationException("<limit-mm> must be positive");
     }
-    CaretPointer<GeodesicHelper> myHelp;
-    CaretPointer<GeodesicHelperBase> myBase;
     OptionalParameter* corrAreaOpt = myParams->getOptionalParameter(5);
+    const float* corrAreaData = NULL;
     if (corrAreaOpt->m_present)
     {
         MetricFile* corrAreas = corrAreaOpt->getMetric(1);
         if (corrAreas->getNumberOfNodes() != mySurf->getNumberOfNodes()) throw OperationException("corrected vertex areas metric does not match surface number of vertices");
-        myBase.grabNew(new GeodesicHelperBase(mySurf, corrAreas->getValuePointerForColumn(0)));
-        myHelp.grabNew(new GeodesicHelper(myBase));
-    } else {
-        myHelp = mySurf->getGeodesicHelper();
+        corrAreaData = corrAreas->getValuePointerForColumn(0);
     }
     bool naive = myParams->getOptionalParameter(6)->m_present;
     CiftiBrainModelsMap myMap;
     StructureEnum::Enum structure = mySurf->getStructure();
     myMap.addSurfaceModel(mySurf->getNumberOfNodes(), structure, roiData);
-    int64_t mapLength = myMap.getLength();
     vector<CiftiBrainModelsMap::SurfaceMap> surfMap = myMap.getSurfaceMap(structure);
     CiftiXML myXML;
     myXML.setNumberOfDimensions(2);
     myXML.setMap(CiftiXML::ALONG_ROW, myMap);
     myXML.setMap(CiftiXML::ALONG_COLUMN, myMap);
     ciftiOut->setCiftiXML(myXML);
-#pragma omp CARET_PAR
-    {
-        CaretPointer<GeodesicHelper> privHelper;
-        if (corrAreaOpt->m_present)
-        {
-            privHelper.grabNew(new GeodesicHelper(myBase));
-        } else {
-            privHelper = mySurf->getGeodesicHelper();
-        }
-#pragma omp CARET_FOR schedule(dynamic)
-        for (int64_t i = 0; i < mapLength; ++i)
-        {
-            vector<float> outRow(mapLength, -1.0f), outDists;
-            vector<int32_t> outNodes;
-            if (distLimit > 0.0f)
-            {
-                privHelper->getNodesToGeoDist(surfMap[i].m_surfaceNode, distLimit, outNodes, outDists, !naive);
-                for (int j = 0; j < int(outNodes.size()); ++j)
-                {
-                    int64_t index = myMap.getIndexForNode(outNodes[j], structure);//-1 if outside ROI
-                    if (index >= 0) outRow[index] = outDists[j];
-                }
-            } else {
-                privHelper->getGeoFromNode(surfMap[i].m_surfaceNode, outDists, !naive);
-                for (int64_t j = 0; j < mapLength; ++j)
-                {
-                    outRow[j] = outDists[surfMap[j].m_surfaceNode];
-                }
-            }
-#pragma omp critical
-            {
-                ciftiOut->setRow(outRow.data(), i);
-            }
-        }
+    CaretPointer<const GeodesicHelperBase> myBase;
+    if (corrAreaData == NULL)
+    {//the surface may already have built this, for instance in a batch script
+        myBase = mySurf->getGeodesicHelperBase();
+    } else {
+        myBase.grabNew(new GeodesicHelperBase(mySurf, corrAreaData));
     }
+    GeodesicAllPairsHelper myHelper(*myBase, !naive);//copies the neighbor lists
+    GeodesicRowWorker myWorker(myHelper, surfMap, distLimit);
+    CiftiRowPipeline(ciftiOut).run(myWorker);//writes rows in order while later rows are being computed
 }
@@ -0,0 +1,173 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "OperationSurfaceResampleMatrix.h"
+#include "OperationException.h"
+
+#include "CaretLogger.h"
+#include "MetricFile.h"
+#include "ResamplingMatrix.h"
+#include "SurfaceFile.h"
+#include "SurfaceResamplingHelper.h"
+
+#include <map>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+AString OperationSurfaceResampleMatrix::getCommandSwitch()
+{
+    return "-surface-resample-matrix";
+}
+
+AString OperationSurfaceResampleMatrix::getShortDescription()
+{
+    return "SAVE THE WEIGHTS OF A SURFACE RESAMPLING AS A MATRIX";
+}
+
+OperationParameters* OperationSurfaceResampleMatrix::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    ret->addSurfaceParameter(1, "current-sphere", "a sphere surface with the mesh that the data is currently on");
+    
+    ret->addSurfaceParameter(2, "new-sphere", "a sphere surface that is in register with <current-sphere> and has the desired output mesh");
+    
+    ret->addStringParameter(3, "method", "the method name");
+    
+    ret->addStringParameter(4, "matrix-out", "output - the output resampling matrix file");//HACK: fake the output format since we don't have a wbsparse parameter type
+    
+    OptionalParameter* areaSurfsOpt = ret->createOptionalParameter(5, "-area-surfs", "specify surfaces to do vertex area correction based on");
+    areaSurfsOpt->addSurfaceParameter(1, "current-area", "a relevant anatomical surface with <current-sphere> mesh");
+    areaSurfsOpt->addSurfaceParameter(2, "new-area", "a relevant anatomical surface with <new-sphere> mesh");
+    
+    OptionalParameter* areaMetricsOpt = ret->createOptionalParameter(6, "-area-metrics", "specify vertex area metrics to do area correction based on");
+    areaMetricsOpt->addMetricParameter(1, "current-area", "a metric file with vertex areas for <current-sphere> mesh");
+    areaMetricsOpt->addMetricParameter(2, "new-area", "a metric file with vertex areas for <new-sphere> mesh");
+    
+    OptionalParameter* roiOpt = ret->createOptionalParameter(7, "-current-roi", "use an input roi on the current mesh to exclude non-data vertices");
+    roiOpt->addMetricParameter(1, "roi-metric", "the roi, as a metric file");
+    
+    ret->createOptionalParameter(8, "-largest", "use only the vertex with the largest weight");
+    
+    AString myHelpText =
+        AString("Computes the same weights as -metric-resample, and saves them as a sparse matrix file, which should be named ending in .resample.wbsparse.  ") +
+        "Use -metric-apply-resample-matrix to apply it to any number of metric files on the same meshes, without recomputing the weights.  " +
+        "The options have the same meaning as in -metric-resample.\n\n" +
+        "The <method> argument must be one of the following:\n\n";
+    
+    vector<SurfaceResamplingMethodEnum::Enum> allEnums;
+    SurfaceResamplingMethodEnum::getAllEnums(allEnums);
+    for (int i = 0; i < (int)allEnums.size(); ++i)
+    {
+        myHelpText += SurfaceResamplingMethodEnum::toName(allEnums[i]) + "\n";
+    }
+    
+    ret->setHelpText(myHelpText);
+    return ret;
+}
+
+void OperationSurfaceResampleMatrix::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    SurfaceFile* curSphere = myParams->getSurface(1);
+    SurfaceFile* newSphere = myParams->getSurface(2);
+    bool ok = false;
+    SurfaceResamplingMethodEnum::Enum myMethod = SurfaceResamplingMethodEnum::fromName(myParams->getString(3), &ok);
+    if (!ok)
+    {
+        throw OperationException("invalid method name");
+    }
+    AString matrixOutName = myParams->getString(4);
+    vector<float> curAreas, newAreas;
+    OptionalParameter* areaSurfsOpt = myParams->getOptionalParameter(5);
+    if (areaSurfsOpt->m_present)
+    {
+        areaSurfsOpt->getSurface(1)->computeNodeAreas(curAreas);
+        areaSurfsOpt->getSurface(2)->computeNodeAreas(newAreas);
+    }
+    OptionalParameter* areaMetricsOpt = myParams->getOptionalParameter(6);
+    if (areaMetricsOpt->m_present)
+    {
+        if (areaSurfsOpt->m_present)
+        {
+            throw OperationException("only one of -area-surfs and -area-metrics can be specified");
+        }
+        MetricFile* curAreaMetric = areaMetricsOpt->getMetric(1);
+        MetricFile* newAreaMetric = areaMetricsOpt->getMetric(2);
+        curAreas.assign(curAreaMetric->getValuePointerForColumn(0), curAreaMetric->getValuePointerForColumn(0) + curAreaMetric->getNumberOfNodes());
+        newAreas.assign(newAreaMetric->getValuePointerForColumn(0), newAreaMetric->getValuePointerForColumn(0) + newAreaMetric->getNumberOfNodes());
+    }
+    const float* curAreaData = NULL, *newAreaData = NULL;
+    switch (myMethod)
+    {
+        case SurfaceResamplingMethodEnum::BARYCENTRIC:
+            if (areaSurfsOpt->m_present || areaMetricsOpt->m_present) CaretLogInfo("This method does not use area correction, area options are not needed");
+            break;
+        default:
+            if (curAreas.empty() || newAreas.empty()) throw OperationException("specified method does area correction, but no vertex area data given");
+            if ((int)curAreas.size() != curSphere->getNumberOfNodes()) throw OperationException("current vertex area data has different number of nodes than current sphere");
+            if ((int)newAreas.size() != newSphere->getNumberOfNodes()) throw OperationException("new vertex area data has different number of nodes than new sphere");
+            curAreaData = curAreas.data();
+            newAreaData = newAreas.data();
+    }
+    const float* roiData = NULL;
+    OptionalParameter* roiOpt = myParams->getOptionalParameter(7);
+    if (roiOpt->m_present)
+    {
+        MetricFile* roiMetric = roiOpt->getMetric(1);
+        if (roiMetric->getNumberOfNodes() != curSphere->getNumberOfNodes()) throw OperationException("roi metric has different number of nodes than current sphere");
+        roiData = roiMetric->getValuePointerForColumn(0);
+    }
+    bool largest = myParams->getOptionalParameter(8)->m_present;
+    SurfaceResamplingHelper myHelp(myMethod, curSphere, newSphere, curAreaData, newAreaData, roiData);
+    StructureEnum::Enum myStructure = curSphere->getStructure();
+    if (myStructure == StructureEnum::INVALID) myStructure = StructureEnum::OTHER;//cifti XML needs a real structure
+    CiftiBrainModelsMap inSpace, outSpace;
+    inSpace.addSurfaceModel(curSphere->getNumberOfNodes(), myStructure);
+    outSpace.addSurfaceModel(newSphere->getNumberOfNodes(), myStructure);
+    ResamplingMatrix myMatrix;
+    myMatrix.setSpaces(inSpace, outSpace);
+    int numNewNodes = newSphere->getNumberOfNodes();
+    vector<map<int64_t, float> > rowWeights(numNewNodes);
+    vector<int> nodes;
+    vector<float> weights;
+    for (int i = 0; i < numNewNodes; ++i)
+    {
+        myHelp.getNodeWeights(i, nodes, weights);
+        if (nodes.empty()) continue;
+        if (largest)
+        {
+            int best = 0;
+            for (int j = 1; j < (int)nodes.size(); ++j)
+            {
+                if (weights[j] > weights[best]) best = j;
+            }
+            rowWeights[i][nodes[best]] = 1.0f;
+        } else {
+            for (int j = 0; j < (int)nodes.size(); ++j)
+            {
+                rowWeights[i][nodes[j]] = weights[j];
+            }
+        }
+    }
+    myMatrix.setWeights(rowWeights);
+    myMatrix.writeFile(matrixOutName);
+}
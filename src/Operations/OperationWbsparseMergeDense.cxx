@@ -21,8 +21,11 @@
 #include "OperationWbsparseMergeDense.h"
 #include "OperationException.h"
 
+#include "CaretOMP.h"
 #include "CaretSparseFile.h"
 
+#include <algorithm>
+
 using namespace caret;
 using namespace std;
 
@@ -46,8 +49,12 @@ OperationParameters* OperationWbsparseMergeDense::getParameters()
     ParameterComponent* wbsparseOpt = ret->createRepeatableParameter(3, "-wbsparse", "specify an input wbsparse file");
     wbsparseOpt->addStringParameter(1, "wbsparse-in", "a wbsparse file to merge");
     
+    ret->createOptionalParameter(4, "-compress", "write the output in the compressed wbsparse format");
+    
     ret->setHelpText(
-        AString("The input wbsparse files must have matching mappings along the direction not specified, and the mapping along the specified direction must be brain models.")
+        AString("The input wbsparse files must have matching mappings along the direction not specified, and the mapping along the specified direction must be brain models.  ") +
+        "Input files may be in either the original or the compressed wbsparse format.  " +
+        "The compressed format is usually much smaller, but older versions of wb_command and wb_view can't read it."
     );
     return ret;
 }
@@ -152,88 +159,117 @@ void OperationWbsparseMergeDense::useParameters(OperationParameters* myParams, P
     int numOutModels = (int)sourceWbsparse.size();
     CaretAssert(numOutModels == (int)newDenseMap.getModelInfo().size());
     int64_t outColSize = outXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
-    CaretSparseFileWriter myWriter(outputName, outXML);
+    CaretSparseFileWriter myWriter(outputName, outXML, myParams->getOptionalParameter(4)->m_present);
     vector<CiftiBrainModelsMap::ModelInfo> outModelInfo = newDenseMap.getModelInfo();
     switch (myDir)
     {
         case CiftiXML::ALONG_ROW:
         {
-            for (int64_t i = 0; i < outColSize; ++i)
+            vector<int64_t> modelStart(numOutModels), modelEnd(numOutModels);//the range of each model in its source file doesn't change per row
+            for (int j = 0; j < numOutModels; ++j)//we could just do the entire row for each file, but doing it by structure could allow structure selection in the future
             {
-                int64_t curOffset = 0;
-                vector<int64_t> outIndices, outValues, inIndices, inValues;
-                int loaded = -1;
-                for (int j = 0; j < numOutModels; ++j)//we could just do the entire row for each file, but doing it by structure could allow structure selection in the future
+                const CiftiBrainModelsMap::ModelInfo& myInfo = outModelInfo[j];
+                const CiftiXML& thisXML = wbsparseList[sourceWbsparse[j]]->getCiftiXML();
+                const CiftiBrainModelsMap& thisDenseMap = thisXML.getBrainModelsMap(myDir);
+                int64_t startIndex = -1, endIndex = -1;
+                switch (myInfo.m_type)
                 {
-                    const CiftiBrainModelsMap::ModelInfo& myInfo = outModelInfo[j];
-                    const CiftiXML& thisXML = wbsparseList[sourceWbsparse[j]]->getCiftiXML();
-                    const CiftiBrainModelsMap& thisDenseMap = thisXML.getBrainModelsMap(myDir);
-                    int64_t startIndex = -1, endIndex = -1;
-                    switch (myInfo.m_type)
+                    case CiftiBrainModelsMap::SURFACE:
                     {
-                        case CiftiBrainModelsMap::SURFACE:
+                        vector<CiftiBrainModelsMap::SurfaceMap> tempMap = thisDenseMap.getSurfaceMap(myInfo.m_structure);
+                        if (tempMap.size() > 0)
                         {
-                            vector<CiftiBrainModelsMap::SurfaceMap> tempMap = thisDenseMap.getSurfaceMap(myInfo.m_structure);
-                            if (tempMap.size() > 0)
-                            {
-                                startIndex = tempMap[0].m_ciftiIndex;//NOTE: CiftiXML guarantees these are ordered by cifti index and contiguous
-                                endIndex = startIndex + tempMap.size();
-                            } else {
-                                startIndex = 0;
-                                endIndex = 0;
-                            }
-                            break;
+                            startIndex = tempMap[0].m_ciftiIndex;//NOTE: CiftiXML guarantees these are ordered by cifti index and contiguous
+                            endIndex = startIndex + tempMap.size();
+                        } else {
+                            startIndex = 0;
+                            endIndex = 0;
                         }
-                        case CiftiBrainModelsMap::VOXELS:
-                        {
-                            vector<CiftiBrainModelsMap::VolumeMap> tempMap = thisDenseMap.getVolumeStructureMap(myInfo.m_structure);
-                            if (tempMap.size() > 0)
-                            {
-                                startIndex = tempMap[0].m_ciftiIndex;//NOTE: CiftiXML guarantees these are ordered by cifti index and contiguous
-                                endIndex = startIndex + tempMap.size();
-                            } else {
-                                startIndex = 0;
-                                endIndex = 0;
-                            }
-                            break;
-                        }
-                        default:
-                            CaretAssert(false);
-                            break;
+                        break;
                     }
-                    if (endIndex > startIndex)
+                    case CiftiBrainModelsMap::VOXELS:
                     {
-                        if (loaded != sourceWbsparse[j])
+                        vector<CiftiBrainModelsMap::VolumeMap> tempMap = thisDenseMap.getVolumeStructureMap(myInfo.m_structure);
+                        if (tempMap.size() > 0)
                         {
-                            wbsparseList[sourceWbsparse[j]]->getRowSparse(i, inIndices, inValues);
-                            loaded = sourceWbsparse[j];
+                            startIndex = tempMap[0].m_ciftiIndex;//NOTE: CiftiXML guarantees these are ordered by cifti index and contiguous
+                            endIndex = startIndex + tempMap.size();
+                        } else {
+                            startIndex = 0;
+                            endIndex = 0;
                         }
-                        int64_t numSparse = (int64_t)inIndices.size();
-                        for (int64_t k = 0; k < numSparse; ++k)
+                        break;
+                    }
+                    default:
+                        CaretAssert(false);
+                        break;
+                }
+                modelStart[j] = startIndex;
+                modelEnd[j] = endIndex;
+            }
+            vector<bool> fileUsed(numCifti, false);
+            for (int j = 0; j < numOutModels; ++j)
+            {
+                if (modelEnd[j] > modelStart[j]) fileUsed[sourceWbsparse[j]] = true;
+            }
+            //decode a block of rows from each file in parallel, merge the rows in parallel, then encode and write them in parallel, in order
+            const int64_t BLOCK_ROWS = 1024;
+            vector<vector<vector<int64_t> > > inIndices(numCifti), inValues(numCifti);
+            vector<vector<int64_t> > outIndices, outValues;
+            vector<int64_t> rowList;
+            for (int64_t blockStart = 0; blockStart < outColSize; blockStart += BLOCK_ROWS)
+            {
+                int64_t blockRows = min(BLOCK_ROWS, outColSize - blockStart);
+                rowList.resize(blockRows);
+                for (int64_t i = 0; i < blockRows; ++i)
+                {
+                    rowList[i] = blockStart + i;
+                }
+                for (int f = 0; f < numCifti; ++f)
+                {
+                    if (fileUsed[f]) wbsparseList[f]->getRowsSparse(rowList, inIndices[f], inValues[f]);
+                }
+                outIndices.resize(blockRows);
+                outValues.resize(blockRows);
+#pragma omp CARET_PARFOR schedule(dynamic, 16)
+                for (int64_t i = 0; i < blockRows; ++i)
+                {
+                    outIndices[i].clear();
+                    outValues[i].clear();
+                    int64_t curOffset = 0;
+                    for (int j = 0; j < numOutModels; ++j)
+                    {
+                        if (modelEnd[j] > modelStart[j])
                         {
-                            if (inIndices[k] >= startIndex && inIndices[k] < endIndex)
+                            const vector<int64_t>& rowIndices = inIndices[sourceWbsparse[j]][i], &rowValues = inValues[sourceWbsparse[j]][i];
+                            int64_t numSparse = (int64_t)rowIndices.size();
+                            for (int64_t k = 0; k < numSparse; ++k)
                             {
-                                outIndices.push_back(inIndices[k] + curOffset);
-                                outValues.push_back(inValues[k]);
+                                if (rowIndices[k] >= modelStart[j] && rowIndices[k] < modelEnd[j])
+                                {
+                                    outIndices[i].push_back(rowIndices[k] - modelStart[j] + curOffset);
+                                    outValues[i].push_back(rowValues[k]);
+                                }
                             }
+                            curOffset += modelEnd[j] - modelStart[j];
                         }
-                        curOffset += endIndex - startIndex;
                     }
                 }
-                myWriter.writeRowSparse(i, outIndices, outValues);
-                outIndices.clear();//reset for next row
-                outValues.clear();
+                myWriter.writeRowsSparse(blockStart, outIndices, outValues);
             }
             break;
         }
         case CiftiXML::ALONG_COLUMN:
         {
-            vector<int64_t> inIndices, inValues;
+            const int64_t BLOCK_ROWS = 1024;
+            vector<vector<int64_t> > inIndices, inValues;
+            vector<int64_t> rowList;
             for (int j = 0; j < numOutModels; ++j)
             {
                 const CiftiBrainModelsMap::ModelInfo& myInfo = outModelInfo[j];
                 const CiftiXML& thisXML = wbsparseList[sourceWbsparse[j]]->getCiftiXML();
                 const CiftiBrainModelsMap& thisDenseMap = thisXML.getBrainModelsMap(myDir);
+                vector<int64_t> inRows, outRows;
                 switch (myInfo.m_type)
                 {
                     case CiftiBrainModelsMap::SURFACE:
@@ -244,8 +280,8 @@ void OperationWbsparseMergeDense::useParameters(OperationParameters* myParams, P
                         for (int64_t k = 0; k < mapSize; ++k)
                         {
                             CaretAssert(tempMap[k].m_surfaceNode == outMap[k].m_surfaceNode);
-                            wbsparseList[sourceWbsparse[j]]->getRowSparse(tempMap[k].m_ciftiIndex, inIndices, inValues);
-                            myWriter.writeRowSparse(outMap[k].m_ciftiIndex, inIndices, inValues);
+                            inRows.push_back(tempMap[k].m_ciftiIndex);
+                            outRows.push_back(outMap[k].m_ciftiIndex);
                         }
                         break;
                     }
@@ -259,8 +295,8 @@ void OperationWbsparseMergeDense::useParameters(OperationParameters* myParams, P
                             CaretAssert(tempMap[k].m_ijk[0] == outMap[k].m_ijk[0]);
                             CaretAssert(tempMap[k].m_ijk[1] == outMap[k].m_ijk[1]);
                             CaretAssert(tempMap[k].m_ijk[2] == outMap[k].m_ijk[2]);
-                            wbsparseList[sourceWbsparse[j]]->getRowSparse(tempMap[k].m_ciftiIndex, inIndices, inValues);
-                            myWriter.writeRowSparse(outMap[k].m_ciftiIndex, inIndices, inValues);
+                            inRows.push_back(tempMap[k].m_ciftiIndex);
+                            outRows.push_back(outMap[k].m_ciftiIndex);
                         }
                         break;
                     }
@@ -268,6 +304,15 @@ void OperationWbsparseMergeDense::useParameters(OperationParameters* myParams, P
                         CaretAssert(false);
                         break;
                 }
+                int64_t mapSize = (int64_t)inRows.size();
+                for (int64_t blockStart = 0; blockStart < mapSize; blockStart += BLOCK_ROWS)
+                {//output rows of a model are contiguous, so each block can be written as consecutive rows
+                    int64_t blockRows = min(BLOCK_ROWS, mapSize - blockStart);
+                    rowList.assign(inRows.begin() + blockStart, inRows.begin() + blockStart + blockRows);
+                    wbsparseList[sourceWbsparse[j]]->getRowsSparse(rowList, inIndices, inValues);
+                    CaretAssert(outRows[blockStart + blockRows - 1] == outRows[blockStart] + blockRows - 1);
+                    myWriter.writeRowsSparse(outRows[blockStart], inIndices, inValues);
+                }
             }
             break;
         }
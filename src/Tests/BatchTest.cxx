@@ -0,0 +1,219 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "BatchTest.h"
+
+#include "CommandException.h"
+#include "CommandFileCache.h"
+#include "CommandOperationManager.h"
+#include "CommandParser.h"
+#include "GiftiMetaData.h"
+#include "MetricFile.h"
+#include "NiftiIO.h"
+#include "ProgramParameters.h"
+
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+#include <fstream>
+#include <iostream>
+
+using namespace caret;
+using namespace std;
+
+BatchTest::BatchTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    vector<AString> makeList(const char* a = NULL, const char* b = NULL, const char* c = NULL)
+    {
+        vector<AString> ret;
+        if (a != NULL) ret.push_back(a);
+        if (b != NULL) ret.push_back(b);
+        if (c != NULL) ret.push_back(c);
+        return ret;
+    }
+    
+    void writeMetric(const AString& filename, const int& numNodes)
+    {
+        MetricFile myMetric;
+        myMetric.setNumberOfNodesAndColumns(numNodes, 1);
+        myMetric.setStructure(StructureEnum::CORTEX_LEFT);
+        for (int i = 0; i < numNodes; ++i)
+        {
+            myMetric.setValue(i, 0, i * 0.5f);
+        }
+        myMetric.writeFile(filename);
+    }
+}
+
+void BatchTest::checkSplit(const AString& line, const vector<AString>& expected)
+{
+    vector<AString> result = CommandOperationManager::splitCommandLine(line, 1);
+    if (result != expected)
+    {
+        AString message = "splitting <" + line + "> gave " + AString::number(result.size()) + " words:";
+        for (int i = 0; i < (int)result.size(); ++i)
+        {
+            message += " <" + result[i] + ">";
+        }
+        setFailed(message);
+    }
+}
+
+void BatchTest::testSplitCommandLine()
+{
+    checkSplit("", makeList());
+    checkSplit("   # only a comment", makeList());
+    checkSplit("  -metric-math  x+y\tout.func.gii ", makeList("-metric-math", "x+y", "out.func.gii"));
+    checkSplit("a 'b c' d", makeList("a", "b c", "d"));
+    checkSplit("'it''s' '\\n'", makeList("its", "\\n"));//single quotes are literal, including backslashes
+    checkSplit("\"a \\\"b\\\" \\\\ \\n\"", makeList("a \"b\" \\ \\n"));//in double quotes, backslash only escapes " and backslash
+    checkSplit("a\\ b c\\#d", makeList("a b", "c#d"));
+    checkSplit("x'y'\"z\" w", makeList("xyz", "w"));
+    checkSplit("'' \"\"", makeList("", ""));//empty quotes are still arguments
+    checkSplit("a#b # comment", makeList("a#b"));//# only starts a comment at the start of a word
+    checkSplit("trailing\\", makeList("trailing"));
+    bool threw = false;
+    try
+    {
+        CommandOperationManager::splitCommandLine("a 'b", 1);
+    } catch (CommandException&) {
+        threw = true;
+    }
+    if (!threw) setFailed("unterminated single quote didn't throw");
+    threw = false;
+    try
+    {
+        CommandOperationManager::splitCommandLine("a \"b\\\"", 1);
+    } catch (CommandException&) {
+        threw = true;
+    }
+    if (!threw) setFailed("unterminated double quote didn't throw");
+}
+
+void BatchTest::testFileCache()
+{
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid())
+    {
+        setFailed("failed to create temporary directory");
+        return;
+    }
+    const AString fileA = tempDir.path() + "/a.func.gii", fileB = tempDir.path() + "/b.func.gii";
+    writeMetric(fileA, 100);
+    writeMetric(fileB, 100);
+    const int64_t sizeA = QFileInfo(fileA).size(), sizeB = QFileInfo(fileB).size();
+    //without caching, every read is a new object
+    CaretPointer<MetricFile> first = CommandFileCache::readMetric(fileA), second = CommandFileCache::readMetric(fileA);
+    if (first == second) setFailed("file was reused when caching was disabled");
+    //room for both files
+    CommandFileCache::enable(sizeA + sizeB);
+    first = CommandFileCache::readMetric(fileA);
+    second = CommandFileCache::readMetric(fileA);
+    if (first != second) setFailed("unchanged file was not reused");
+    CaretPointer<MetricFile> otherB = CommandFileCache::readMetric(fileB);
+    if (otherB == first) setFailed("different files gave the same object");
+    if (CommandFileCache::readMetric(fileA) != first) setFailed("file was evicted while under the limit");
+    if (CommandFileCache::readMetric(fileB) != otherB) setFailed("second file was evicted while under the limit");
+    //an in-memory change must not leak into the next command
+    first->setValue(0, 0, 100.0f);
+    second = CommandFileCache::readMetric(fileA);
+    if (second == first) setFailed("modified file was reused");
+    if (second->getValue(0, 0) != 0.0f) setFailed("reread of modified file has the wrong value");
+    //room for only one, least recently used gets evicted
+    CommandFileCache::disable();
+    CommandFileCache::enable(max(sizeA, sizeB));
+    first = CommandFileCache::readMetric(fileA);
+    otherB = CommandFileCache::readMetric(fileB);
+    if (CommandFileCache::readMetric(fileB) != otherB) setFailed("most recent file was evicted");
+    second = CommandFileCache::readMetric(fileA);
+    if (second == first) setFailed("least recently used file was not evicted");
+    //disabling releases everything
+    CommandFileCache::disable();
+    CommandFileCache::enable(sizeA + sizeB);
+    if (CommandFileCache::readMetric(fileA) == second) setFailed("file was still cached after disabling");
+    CommandFileCache::disable();
+}
+
+void BatchTest::testGlobalOptions()
+{//options that are passed to each command, rather than set globally, must still apply to the lines of a batch script
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid())
+    {
+        setFailed("failed to create temporary directory");
+        return;
+    }
+    const AString inputName = tempDir.path() + "/a.func.gii", scriptName = tempDir.path() + "/script.txt";
+    const AString metricOut = tempDir.path() + "/out.func.gii", defaultOut = tempDir.path() + "/default.dscalar.nii", ownOut = tempDir.path() + "/own.dscalar.nii";
+    writeMetric(inputName, 100);
+    {
+        const AString scriptText = "-metric-math 'x * 2' '" + metricOut + "' -var x '" + inputName + "'\n" +
+                                   "-cifti-create-dense-scalar '" + defaultOut + "' -left-metric '" + inputName + "'\n" +
+                                   "-cifti-create-dense-scalar '" + ownOut + "' -left-metric '" + inputName + "' -cifti-output-datatype FLOAT64\n";
+        ofstream script(scriptName.toLocal8Bit().constData());
+        script << scriptText.toLocal8Bit().constData();
+    }
+    const char* programName = "wb_command";
+    ProgramParameters myParams(1, &programName);
+    myParams.addParameter("-disable-provenance");
+    myParams.addParameter("-cifti-output-datatype");
+    myParams.addParameter("INT16");
+    myParams.addParameter("-batch");
+    myParams.addParameter(scriptName);
+    try
+    {
+        CommandOperationManager::getCommandOperationManager()->runCommand(myParams);
+    } catch (CaretException& e) {
+        setFailed("batch script with global options failed: " + e.whatString());
+        return;
+    }
+    MetricFile outMetric;
+    outMetric.readFile(metricOut);
+    if (outMetric.getFileMetaData()->get(CommandParser::PROVENANCE_NAME) != "") setFailed("-disable-provenance given with -batch didn't apply to the script's lines");
+    NiftiIO defaultReader;
+    defaultReader.openRead(defaultOut);
+    if (defaultReader.getHeader().getDataType() != NIFTI_TYPE_INT16) setFailed("-cifti-output-datatype given with -batch didn't apply to the script's lines");
+    NiftiIO ownReader;
+    ownReader.openRead(ownOut);
+    if (ownReader.getHeader().getDataType() != NIFTI_TYPE_FLOAT64) setFailed("-cifti-output-datatype on a line of a batch script didn't override the one given with -batch");
+    //and without the option, provenance is written as usual
+    ProgramParameters plainParams(1, &programName);
+    plainParams.addParameter("-batch");
+    plainParams.addParameter(scriptName);
+    try
+    {
+        CommandOperationManager::getCommandOperationManager()->runCommand(plainParams);
+    } catch (CaretException& e) {
+        setFailed("batch script without global options failed: " + e.whatString());
+        return;
+    }
+    outMetric.readFile(metricOut);
+    if (outMetric.getFileMetaData()->get(CommandParser::PROVENANCE_NAME) == "") setFailed("batch script line didn't write provenance");
+}
+
+void BatchTest::execute()
+{
+    testSplitCommandLine();
+    testFileCache();
+    testGlobalOptions();
+    if (!failed()) cout << "batch splitting, file cache and global option tests successful" << endl;
+}
@@ -19,7 +19,15 @@
 /*LICENSE_END*/
 
 #include "CiftiFileTest.h"
+#include "AlgorithmCiftiTranspose.h"
 #include "CiftiFile.h"
+#include "CiftiSeriesMap.h"
+#include "NiftiIO.h"
+#include "nifti2.h"
+#include <QTemporaryDir>
+#include <algorithm>
+#include <iostream>
+#include <vector>
 using namespace caret;
 CiftiFileTest::CiftiFileTest(const AString &identifier) : TestInterface(identifier)
 {
@@ -199,3 +207,143 @@ void CiftiFileTest::testCiftiReadWriteOnDisk()
     delete [] testRow;
 }
 
+
+CiftiTiledTest::CiftiTiledTest(const AString &identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    //exactly representable in float, and different for every element
+    float matrixValue(const int64_t& row, const int64_t& col)
+    {
+        return row * 1000.0f + col + 0.5f;
+    }
+}
+
+void CiftiTiledTest::checkMatrix(const CiftiFile& file, const int64_t& numRows, const int64_t& numCols, const bool& transposed, const AString& descrip)
+{
+    if (file.getNumberOfRows() != numRows || file.getNumberOfColumns() != numCols)
+    {
+        setFailed(descrip + ": dimensions don't match");
+        return;
+    }
+    std::vector<float> scratch(std::max(numRows, numCols));
+    for (int64_t i = 0; i < numRows; ++i)
+    {
+        file.getRow(scratch.data(), i);
+        for (int64_t j = 0; j < numCols; ++j)
+        {
+            if (scratch[j] != (transposed ? matrixValue(j, i) : matrixValue(i, j)))
+            {
+                setFailed(descrip + ": row " + AString::number(i) + " doesn't match");
+                return;
+            }
+        }
+    }
+    for (int64_t j = 0; j < numCols; ++j)
+    {
+        file.getColumn(scratch.data(), j);
+        for (int64_t i = 0; i < numRows; ++i)
+        {
+            if (scratch[i] != (transposed ? matrixValue(j, i) : matrixValue(i, j)))
+            {
+                setFailed(descrip + ": column " + AString::number(j) + " doesn't match");
+                return;
+            }
+        }
+    }
+    std::vector<int64_t> colIndices;
+    for (int64_t j = numCols - 1; j >= 0; j -= 3) colIndices.push_back(j);
+    std::vector<float> columns(colIndices.size() * numRows);
+    file.getColumns(columns.data(), colIndices);
+    for (size_t c = 0; c < colIndices.size(); ++c)
+    {
+        for (int64_t i = 0; i < numRows; ++i)
+        {
+            if (columns[c * numRows + i] != (transposed ? matrixValue(colIndices[c], i) : matrixValue(i, colIndices[c])))
+            {
+                setFailed(descrip + ": getColumns result for column " + AString::number(colIndices[c]) + " doesn't match");
+                return;
+            }
+        }
+    }
+}
+
+void CiftiTiledTest::execute()
+{
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid())
+    {
+        setFailed("failed to create temporary directory");
+        return;
+    }
+    const int64_t NUM_ROWS = 97, NUM_COLS = 150, TILE_SIZE = 16;//not multiples of the tile size, to test the padding
+    CiftiXML myXML;
+    myXML.setNumberOfDimensions(2);
+    myXML.setMap(CiftiXML::ALONG_ROW, CiftiSeriesMap(NUM_COLS));
+    myXML.setMap(CiftiXML::ALONG_COLUMN, CiftiSeriesMap(NUM_ROWS));
+    const AString tiledName = tempDir.path() + "/tiled.dtseries.nii", untiledName = tempDir.path() + "/untiled.dtseries.nii";
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        CiftiFile writer;
+        if (pass == 0) writer.setWritingTiled(TILE_SIZE);
+        writer.setWritingFile(pass == 0 ? tiledName : untiledName);
+        writer.setCiftiXML(myXML);
+        std::vector<float> scratchRow(NUM_COLS);
+        for (int64_t i = 0; i < NUM_ROWS; ++i)
+        {
+            for (int64_t j = 0; j < NUM_COLS; ++j)
+            {
+                scratchRow[j] = matrixValue(i, j);
+            }
+            writer.setRow(scratchRow.data(), i);
+        }
+        writer.close();
+    }
+    {//a plain nifti reader must not see a cifti matrix in the tiled file
+        NiftiIO plainReader;
+        plainReader.openRead(tiledName);
+        const std::vector<int64_t>& plainDims = plainReader.getDimensions();
+        const int64_t tileCols = (NUM_COLS + TILE_SIZE - 1) / TILE_SIZE, tileRows = (NUM_ROWS + TILE_SIZE - 1) / TILE_SIZE;
+        if (plainReader.getHeader().getIntentCode() != NIFTI_INTENT_WB_TILED_CIFTI)
+        {
+            setFailed("tiled file has intent code " + AString::number(plainReader.getHeader().getIntentCode()));
+        }
+        if (plainDims.size() != 4 || plainDims[0] != TILE_SIZE || plainDims[1] != TILE_SIZE || plainDims[2] != tileCols || plainDims[3] != tileRows)
+        {
+            setFailed("tiled file header doesn't have the tile dimensions");
+        }
+        if (failed()) return;
+    }
+    CiftiFile tiledIn(tiledName), untiledIn(untiledName);
+    if (tiledIn.getTileSize() != TILE_SIZE) setFailed("tiled file was read with tile size " + AString::number(tiledIn.getTileSize()));
+    if (untiledIn.getTileSize() != 0) setFailed("untiled file was read as tiled");
+    checkMatrix(tiledIn, NUM_ROWS, NUM_COLS, false, "tiled file");
+    checkMatrix(untiledIn, NUM_ROWS, NUM_COLS, false, "untiled file");
+    if (failed()) return;
+    //the three transpose paths: tiled input (column reads), tiled output (column writes), and the untiled chunked path
+    const AString fromTiledName = tempDir.path() + "/from_tiled.dtseries.nii", toTiledName = tempDir.path() + "/to_tiled.dtseries.nii",
+                  plainName = tempDir.path() + "/plain.dtseries.nii";
+    {
+        CiftiFile fromTiled;
+        fromTiled.setWritingFile(fromTiledName);
+        AlgorithmCiftiTranspose(NULL, &tiledIn, &fromTiled);
+        fromTiled.close();
+        CiftiFile toTiled;
+        toTiled.setWritingTiled(TILE_SIZE);
+        toTiled.setWritingFile(toTiledName);
+        AlgorithmCiftiTranspose(NULL, &untiledIn, &toTiled);
+        toTiled.close();
+        CiftiFile plain;
+        plain.setWritingFile(plainName);
+        AlgorithmCiftiTranspose(NULL, &untiledIn, &plain, 0.00001f);//about 10KB, so it takes several passes
+        plain.close();
+    }
+    CiftiFile fromTiled(fromTiledName), toTiled(toTiledName), plain(plainName);
+    checkMatrix(plain, NUM_COLS, NUM_ROWS, true, "untiled transpose");
+    checkMatrix(fromTiled, NUM_COLS, NUM_ROWS, true, "transpose of tiled file");
+    checkMatrix(toTiled, NUM_COLS, NUM_ROWS, true, "transpose to tiled file");
+    if (toTiled.getTileSize() != TILE_SIZE) setFailed("transpose to tiled file didn't write a tiled file");
+    if (!failed()) std::cout << "Tiled cifti reading, writing and transpose were successful." << std::endl;
+}
@@ -23,6 +23,8 @@
 #define CIFTIFILETEST_H
 
 namespace caret {
+class CiftiFile;
+
 class CiftiFileTest : public TestInterface
 {
 public:
@@ -34,6 +36,15 @@ public:
     void testCiftiReadWriteOnDisk();
 };
 
+//doesn't need any data files, so it can run with the other automatic tests
+class CiftiTiledTest : public TestInterface
+{
+    void checkMatrix(const CiftiFile& file, const int64_t& numRows, const int64_t& numCols, const bool& transposed, const AString& descrip);
+public:
+    CiftiTiledTest(const AString &identifier);
+    void execute();
+};
+
 } // namespace caret
 
 #endif // CIFTIFILETEST_H
@@ -113,6 +113,24 @@ void DotTest::checkVal(const float& correct, const float& test, const AString& d
     if (!(abs(test - correct) < TOLER_ABS + TOLER_RATIO * abs(correct))) setFailed(descrip + " got " + AString::number(test) + ", expected " + AString::number(correct));
 }//use "not less than" in order to catch NaNs
 
+void DotTest::checkDot4(const vector<float>& first, const vector<vector<float> >& others, const AString& descrip)
+{//dsdot4 must match 4 separate calls to dsdot of the same implementation
+    CaretAssert(others.size() == 4);
+    const int length = (int)first.size();
+    const float* otherPtrs[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        CaretAssert((int)others[i].size() == length);
+        otherPtrs[i] = others[i].data();
+    }
+    double results[4];
+    dsdot4(first.data(), otherPtrs, length, results);
+    for (int i = 0; i < 4; ++i)
+    {
+        checkVal(dsdot(first.data(), otherPtrs[i], length), results[i], descrip + " " + AString::number(i));
+    }
+}
+
 void DotTest::execute()
 {
     dot_flags impl_in_use = dot_set_impl(DOT_NAIVE);
@@ -134,6 +152,12 @@ void DotTest::execute()
     const float midsnr_naive = correlate(midsnrA, midsnrB);
     const float highsnr_naive = correlate(highsnrA, highsnrB);
     const float cross_snr_naive = correlate(lowsnrA, highsnrB);
+    vector<vector<float> > dot4Others;
+    dot4Others.push_back(rand1);
+    dot4Others.push_back(lowsnrB);
+    dot4Others.push_back(midsnrB);
+    dot4Others.push_back(highsnrB);
+    checkDot4(midsnrA, dot4Others, "naive dsdot4");
     //sse2
     impl_in_use = dot_set_impl(DOT_SSE2);
     if (impl_in_use == DOT_SSE2)
@@ -144,6 +168,7 @@ void DotTest::execute()
         checkVal(midsnr_naive, correlate(midsnrA, midsnrB), "sse2 mid snr correlation");
         checkVal(highsnr_naive, correlate(highsnrA, highsnrB), "sse2 high snr correlation");
         checkVal(cross_snr_naive, correlate(lowsnrA, highsnrB), "sse2 cross snr correlation");
+        checkDot4(midsnrA, dot4Others, "sse2 dsdot4");
     } else {
         cout << "skipping SSE2, not supported" << endl;
     }
@@ -157,6 +182,7 @@ void DotTest::execute()
         checkVal(midsnr_naive, correlate(midsnrA, midsnrB), "avx mid snr correlation");
         checkVal(highsnr_naive, correlate(highsnrA, highsnrB), "avx high snr correlation");
         checkVal(cross_snr_naive, correlate(lowsnrA, highsnrB), "avx cross snr correlation");
+        checkDot4(midsnrA, dot4Others, "avx dsdot4");
     } else {
         cout << "skipping AVX, not supported" << endl;
     }
@@ -170,6 +196,7 @@ void DotTest::execute()
         checkVal(midsnr_naive, correlate(midsnrA, midsnrB), "avxfma mid snr correlation");
         checkVal(highsnr_naive, correlate(highsnrA, highsnrB), "avxfma high snr correlation");
         checkVal(cross_snr_naive, correlate(lowsnrA, highsnrB), "avxfma cross snr correlation");
+        checkDot4(midsnrA, dot4Others, "avxfma dsdot4");
     } else {
         cout << "skipping AVXFMA, not supported" << endl;
     }
@@ -183,6 +210,7 @@ void DotTest::execute()
         checkVal(midsnr_naive, correlate(midsnrA, midsnrB), "avx512 mid snr correlation");
         checkVal(highsnr_naive, correlate(highsnrA, highsnrB), "avx512 high snr correlation");
         checkVal(cross_snr_naive, correlate(lowsnrA, highsnrB), "avx512 cross snr correlation");
+        checkDot4(midsnrA, dot4Others, "avx512 dsdot4");
     } else {
         cout << "skipping AVX512, not supported" << endl;
     }
@@ -196,6 +224,7 @@ void DotTest::execute()
         checkVal(midsnr_naive, correlate(midsnrA, midsnrB), "avx512fma mid snr correlation");
         checkVal(highsnr_naive, correlate(highsnrA, highsnrB), "avx512fma high snr correlation");
         checkVal(cross_snr_naive, correlate(lowsnrA, highsnrB), "avx512fma cross snr correlation");
+        checkDot4(midsnrA, dot4Others, "avx512fma dsdot4");
     } else {
         cout << "skipping AVX512FMA, not supported" << endl;
     }
@@ -0,0 +1,102 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "GeodesicAllPairsTest.h"
+
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "GeodesicAllPairsHelper.h"
+#include "GeodesicHelper.h"
+#include "SurfaceFile.h"
+#include "TopologyHelper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+GeodesicAllPairsTest::GeodesicAllPairsTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void GeodesicAllPairsTest::compareHelpers(const SurfaceFile& mySurf, const AString& descrip)
+{
+    const int32_t numNodes = mySurf.getNumberOfNodes();
+    CaretPointer<GeodesicHelper> refHelp = mySurf.getGeodesicHelper();
+    vector<float> expected(numNodes), result(numNodes);
+    for (int smooth = 0; smooth < 2; ++smooth)
+    {
+        GeodesicAllPairsHelper myHelper(*mySurf.getGeodesicHelperBase(), smooth == 1);
+        const AString smoothDescrip = descrip + (smooth ? ", smooth" : ", naive");
+        for (int sample = 0; sample < 20; ++sample)
+        {
+            const int32_t root = (sample == 0 ? 0 : rand() % numNodes);//vertex 0 has the tiny edge, when there is one
+            refHelp->getGeoFromNode(root, expected, smooth == 1);
+            const float maxExpected = *max_element(expected.begin(), expected.end());
+            for (int limited = 0; limited < 2; ++limited)
+            {
+                const float maxDist = (limited ? maxExpected * 0.4f : -1.0f);
+                myHelper.getGeoFromNode(root, result.data(), maxDist);
+                for (int32_t i = 0; i < numNodes; ++i)
+                {
+                    float expectVal = expected[i];
+                    if (limited && abs(expectVal - maxDist) < 1e-4f * maxExpected) continue;//too close to the limit to know which side rounding puts it on
+                    if (limited && expectVal > maxDist) expectVal = -1.0f;
+                    if (abs(result[i] - expectVal) > 1e-5f * maxExpected)
+                    {
+                        setFailed(smoothDescrip + (limited ? ", limited" : "") + ": root " + AString::number(root) + ", vertex " + AString::number(i) +
+                                  " has distance " + AString::number(result[i]) + ", expected " + AString::number(expectVal));
+                        return;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void GeodesicAllPairsTest::execute()
+{
+    SurfaceFile mySurf;
+    AlgorithmSurfaceCreateSphere(NULL, 2562, &mySurf);
+    const int32_t numNodes = mySurf.getNumberOfNodes();
+    for (int32_t i = 0; i < numNodes; ++i)
+    {//uneven radius, so edges have many different lengths
+        const float* coord = mySurf.getCoordinate(i);
+        const float scale = 1.0f + 0.1f * sin(coord[0] * 0.05f) * cos(coord[2] * 0.03f);
+        mySurf.setCoordinate(i, coord[0] * scale, coord[1] * scale, coord[2] * scale);
+    }
+    compareHelpers(mySurf, "sphere");
+    if (failed()) return;
+    //move vertex 0 almost onto a neighbor, so the shortest edge is much smaller than the bucket width
+    SurfaceFile tinyEdgeSurf = mySurf;
+    const int32_t neighbor = tinyEdgeSurf.getTopologyHelper()->getNodeNeighbors(0)[0];
+    const float* coord = tinyEdgeSurf.getCoordinate(0), *neighCoord = tinyEdgeSurf.getCoordinate(neighbor);
+    float newCoord[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        newCoord[i] = neighCoord[i] + (coord[i] - neighCoord[i]) * 0.0001f;
+    }
+    tinyEdgeSurf.setCoordinate(0, newCoord);
+    compareHelpers(tinyEdgeSurf, "tiny edge");
+    if (!failed()) cout << "geodesic all pairs tests successful" << endl;
+}
@@ -0,0 +1,240 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "GiftiDecodeTest.h"
+
+#include "Base64.h"
+#include "GiftiException.h"
+#include "GiftiStreamDecoder.h"
+
+#include "zlib.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace caret;
+using namespace std;
+
+GiftiDecodeTest::GiftiDecodeTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    
+    vector<unsigned char> randomBytes(const int64_t& size)
+    {
+        vector<unsigned char> ret(size);
+        for (int64_t i = 0; i < size; ++i)
+        {
+            ret[i] = (unsigned char)(rand() % 256);
+        }
+        return ret;
+    }
+    
+    string encode(const vector<unsigned char>& bytes)
+    {
+        vector<unsigned char> buffer(bytes.size() * 4 / 3 + 8);
+        uint64_t length = Base64::encode(bytes.data(), bytes.size(), buffer.data());
+        return string((const char*)buffer.data(), length);
+    }
+    
+    vector<unsigned char> compress(const vector<unsigned char>& bytes, const bool& gzipHeader)
+    {
+        z_stream myStream;
+        memset(&myStream, 0, sizeof(z_stream));
+        deflateInit2(&myStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + (gzipHeader ? 16 : 0), 8, Z_DEFAULT_STRATEGY);
+        vector<unsigned char> ret(deflateBound(&myStream, bytes.size()) + 32);
+        myStream.next_in = (Bytef*)bytes.data();
+        myStream.avail_in = (uInt)bytes.size();
+        myStream.next_out = ret.data();
+        myStream.avail_out = (uInt)ret.size();
+        deflate(&myStream, Z_FINISH);
+        ret.resize(myStream.total_out);
+        deflateEnd(&myStream);
+        return ret;
+    }
+    
+    string addWhitespace(const string& text)
+    {//line breaks like a wrapped encoder, plus random whitespace anywhere
+        const char whitespace[] = { ' ', '\t', '\r', '\n' };
+        string ret = "\n   ";
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            if (i % 64 == 0) ret += "\r\n";
+            if (rand() % 10 == 0) ret += whitespace[rand() % 4];
+            ret += text[i];
+        }
+        return ret + "\n  ";
+    }
+    
+    string stripPadding(string text)
+    {
+        while (!text.empty() && text[text.size() - 1] == '=') text.resize(text.size() - 1);
+        return text;
+    }
+    
+    //maxChunk of 0 means all at once, otherwise random chunk sizes up to maxChunk
+    vector<unsigned char> decodeChunked(const string& text, const int64_t& outputSize, const bool& compressed, const int& maxChunk)
+    {
+        vector<unsigned char> ret(outputSize);
+        GiftiStreamDecoder myDecoder(ret.data(), outputSize, compressed);
+        int64_t pos = 0;
+        while (pos < (int64_t)text.size())
+        {
+            int64_t chunk = (int64_t)text.size() - pos;
+            if (maxChunk > 0) chunk = min(chunk, (int64_t)(rand() % maxChunk + 1));
+            myDecoder.addText(text.data() + pos, chunk);
+            pos += chunk;
+        }
+        myDecoder.finish();
+        return ret;
+    }
+}
+
+void GiftiDecodeTest::checkDecode(const string& text, const vector<unsigned char>& expected, const bool& compressed, const AString& descrip)
+{
+    const int maxChunks[4] = { 0, 1, 7, 1000 };
+    for (int c = 0; c < 4; ++c)
+    {
+        const AString chunkDescrip = descrip + (maxChunks[c] == 0 ? AString(" in one piece") : " in chunks of up to " + AString::number(maxChunks[c]));
+        try
+        {
+            vector<unsigned char> result = decodeChunked(text, (int64_t)expected.size(), compressed, maxChunks[c]);
+            if (result != expected)
+            {
+                setFailed(chunkDescrip + ": decoded data doesn't match");
+                return;
+            }
+        } catch (GiftiException& e) {
+            setFailed(chunkDescrip + ": " + e.whatString());
+            return;
+        }
+    }
+}
+
+void GiftiDecodeTest::checkFails(const string& text, const int64_t& outputSize, const bool& compressed, const AString& descrip)
+{
+    try
+    {
+        decodeChunked(text, outputSize, compressed, 13);
+    } catch (GiftiException&) {
+        return;
+    }
+    setFailed(descrip + ": decoding should have thrown");
+}
+
+void GiftiDecodeTest::testDecoder(const AString& implName)
+{
+    const int64_t sizes[] = { 1, 2, 3, 100, 1000, 1001, 1002, 100000 };//all 3 padding cases, and enough compressed data to refill the decoder's buffer
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); ++s)
+    {
+        const AString descrip = implName + ", " + AString::number(sizes[s]) + " bytes";
+        vector<unsigned char> bytes = randomBytes(sizes[s]);
+        string text = encode(bytes);
+        checkDecode(text, bytes, false, descrip);
+        checkDecode(addWhitespace(text), bytes, false, descrip + " with whitespace");
+        checkDecode(stripPadding(text), bytes, false, descrip + " without padding");
+        checkDecode(text + (sizes[s] % 3 == 0 ? "====" : "="), bytes, false, descrip + " with extra padding");
+        checkDecode(text + "==\n", bytes, false, descrip + " with extra padding and whitespace");
+        for (int gzipHeader = 0; gzipHeader < 2; ++gzipHeader)
+        {
+            const AString compDescrip = descrip + (gzipHeader ? " gzip" : " zlib");
+            string compText = encode(compress(bytes, gzipHeader != 0));
+            checkDecode(compText, bytes, true, compDescrip);
+            checkDecode(addWhitespace(compText), bytes, true, compDescrip + " with whitespace");
+            checkDecode(stripPadding(compText), bytes, true, compDescrip + " without padding");
+            checkFails(compText, sizes[s] + 1, true, compDescrip + " with too little data");
+            checkFails(compText, sizes[s] - 1, true, compDescrip + " with too much data");
+            checkFails(compText.substr(0, compText.size() / 2), sizes[s], true, compDescrip + " truncated");
+        }
+        checkFails(text, sizes[s] + 1, false, descrip + " with too little data");
+        checkFails(text, sizes[s] - 1, false, descrip + " with too much data");
+        string badText = text;
+        badText.insert(badText.size() / 2, "*");
+        checkFails(badText, sizes[s], false, descrip + " with invalid character");
+        if (sizes[s] % 3 == 0)
+        {
+            checkFails(text.substr(0, text.size() - 3), sizes[s], false, descrip + " ending in a partial group");
+            checkFails("=" + text, sizes[s], false, descrip + " starting with padding");
+        }
+        if (failed()) return;
+    }
+}
+
+void GiftiDecodeTest::testDecodeRun()
+{
+    if (Base64::setImpl(DOT_AVX) != DOT_AVX)
+    {
+        cout << "skipping AVX2 base64 decoding, not supported" << endl;
+        return;
+    }
+    const char disruptors[] = { '=', ' ', '\n', '*', '-', (char)0x80, (char)0xFF, '\0' };//things that must stop a run
+    for (int trial = 0; trial < 2000; ++trial)
+    {
+        const int64_t length = rand() % 300;
+        string input(length, 'A');
+        for (int64_t i = 0; i < length; ++i)
+        {
+            input[i] = BASE64_ALPHABET[rand() % 64];
+        }
+        if (length > 0 && trial % 4 != 0)
+        {
+            input[rand() % length] = disruptors[rand() % sizeof(disruptors)];
+        }
+        const int64_t outputSpace = rand() % (length + 8);
+        vector<unsigned char> naiveOut(outputSpace + 1), avxOut(outputSpace + 1);
+        int64_t naiveUsed = -1, avxUsed = -1;
+        Base64::setImpl(DOT_NAIVE);
+        int64_t naiveWritten = Base64::decodeRun(input.data(), length, naiveOut.data(), outputSpace, &naiveUsed);
+        Base64::setImpl(DOT_AVX);
+        int64_t avxWritten = Base64::decodeRun(input.data(), length, avxOut.data(), outputSpace, &avxUsed);
+        const AString descrip = "decodeRun trial " + AString::number(trial) + " (length " + AString::number(length) + ", output space " + AString::number(outputSpace) + ")";
+        if (naiveUsed % 4 != 0 || naiveWritten != naiveUsed / 4 * 3 || naiveWritten > outputSpace)
+        {
+            setFailed(descrip + ": plain version used " + AString::number(naiveUsed) + " characters for " + AString::number(naiveWritten) + " bytes");
+            return;
+        }
+        //the AVX2 version finishes with the plain one when blocks don't fit, so it must stop in exactly the same place
+        if (avxUsed != naiveUsed || avxWritten != naiveWritten || !equal(avxOut.begin(), avxOut.begin() + avxWritten, naiveOut.begin()))
+        {
+            setFailed(descrip + ": AVX2 version used " + AString::number(avxUsed) + " characters for " + AString::number(avxWritten) +
+                      " bytes, plain version used " + AString::number(naiveUsed));
+            return;
+        }
+    }
+}
+
+void GiftiDecodeTest::execute()
+{
+    Base64::setImpl(DOT_NAIVE);
+    testDecoder("plain");
+    if (failed()) return;
+    if (Base64::setImpl(DOT_AVX) == DOT_AVX)
+    {
+        testDecoder("AVX2");
+        if (failed()) return;
+    }
+    testDecodeRun();
+    Base64::setImpl(DOT_AUTO);
+}
@@ -0,0 +1,43 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#ifndef __GIFTI_DECODE_TEST_H__
+#define __GIFTI_DECODE_TEST_H__
+
+#include "TestInterface.h"
+
+#include <string>
+#include <vector>
+
+namespace caret {
+
+    //checks GiftiStreamDecoder on chunked, whitespace-laden, badly padded and gzipped text, and the AVX2 base64 kernel against the plain one
+    class GiftiDecodeTest : public TestInterface
+    {
+        void checkDecode(const std::string& text, const std::vector<unsigned char>& expected, const bool& compressed, const AString& descrip);
+        void checkFails(const std::string& text, const int64_t& outputSize, const bool& compressed, const AString& descrip);
+        void testDecoder(const AString& implName);
+        void testDecodeRun();
+    public:
+        GiftiDecodeTest(const AString& identifier);
+        virtual void execute();
+    };
+
+}
+#endif //__GIFTI_DECODE_TEST_H__
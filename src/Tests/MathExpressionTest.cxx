@@ -55,4 +55,28 @@ void MathExpressionTest::execute()
     {
         setFailed("output value incorrect, expected " + AString::number(correctresult) + ", got " + AString::number(testresult));
     }
+    CaretMathExpression compiledExpr("(a >= b || !(a < 0)) * max(a, b) - mod(a, b + 3) / atan2(a, 2) + (a == b) - round(-a)");//test the compiled form against the tree
+    const int numElems = 1000;//more than one block
+    vector<float> aVals(numElems), bVals(numElems), manyOut(numElems), scalarVars(2);
+    for (int i = 0; i < numElems; ++i)
+    {
+        aVals[i] = (i % 37) * 0.25f - 4.0f;
+        bVals[i] = (i % 11) * 0.5f - 2.0f;
+    }
+    vector<const float*> varPointers(2);
+    bool aFirst = (compiledExpr.getVarNames()[0] == "a");
+    varPointers[0] = aFirst ? aVals.data() : bVals.data();
+    varPointers[1] = aFirst ? bVals.data() : aVals.data();
+    compiledExpr.evaluateMany(varPointers, manyOut.data(), numElems);
+    for (int i = 0; i < numElems; ++i)
+    {
+        scalarVars[0] = varPointers[0][i];
+        scalarVars[1] = varPointers[1][i];
+        float scalarResult = (float)compiledExpr.evaluate(scalarVars);
+        if (!(abs(manyOut[i] - scalarResult) <= abs(scalarResult) * TOLER || (manyOut[i] != manyOut[i] && scalarResult != scalarResult)))//the compiler may contract operations differently
+        {
+            setFailed("evaluateMany differs from evaluate at element " + AString::number(i) + ", expected " + AString::number(scalarResult) + ", got " + AString::number(manyOut[i]));
+            break;
+        }
+    }
 }
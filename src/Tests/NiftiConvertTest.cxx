@@ -0,0 +1,259 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "NiftiConvertTest.h"
+
+#include "NiftiConvert.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+using namespace caret;
+using namespace std;
+
+NiftiConvertTest::NiftiConvertTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int NUM_REPEATS = 5;//repeat the special values enough to use both the vector loops and the scalar tails
+    const int64_t COUNTS[] = { 1, 7, 8, 15, 16, 17, 33, 1000 };//around the 8 and 16 element vector widths
+    const int NUM_COUNTS = sizeof(COUNTS) / sizeof(COUNTS[0]);
+    const int64_t ARRAY_SIZE = 1001;//so the largest count can also start unaligned
+    
+    struct Scaling
+    {
+        bool doScale;
+        double mult, offset;
+    };
+    const Scaling SCALINGS[] = { { false, 1.0, 0.0 }, { true, 0.37, -12.5 }, { true, -2.0, 100.0 } };
+    const int NUM_SCALINGS = sizeof(SCALINGS) / sizeof(SCALINGS[0]);
+    
+    AString scalingName(const Scaling& scaling)
+    {
+        if (!scaling.doScale) return "unscaled";
+        return "scaled by " + AString::number(scaling.mult) + ", " + AString::number(scaling.offset);
+    }
+    
+    float randFloat(const float& low, const float& high)
+    {
+        return low + (high - low) * (rand() / (float)RAND_MAX);
+    }
+    
+    //random values, with NaN, infinities and exact halves mixed in
+    vector<float> floatInput(const float& low, const float& high)
+    {
+        const float specials[] = { numeric_limits<float>::quiet_NaN(), numeric_limits<float>::infinity(), -numeric_limits<float>::infinity(),
+                                   0.5f, -0.5f, 1.5f, -1.5f, 254.5f, 255.5f, 32766.5f, 32767.5f, -32768.5f, -32769.5f, 1e10f, -1e10f };
+        vector<float> ret(ARRAY_SIZE);
+        for (int64_t i = 0; i < ARRAY_SIZE; ++i)
+        {
+            if (rand() % 8 == 0)
+            {
+                ret[i] = specials[rand() % (sizeof(specials) / sizeof(specials[0]))];
+            } else if (rand() % 4 == 0) {
+                ret[i] = floor(randFloat(low, high)) + 0.5f;
+            } else {
+                ret[i] = randFloat(low, high);
+            }
+        }
+        return ret;
+    }
+    
+    template<typename T>
+    vector<T> randomInts()
+    {
+        vector<T> ret(ARRAY_SIZE);
+        for (int64_t i = 0; i < ARRAY_SIZE; ++i)
+        {
+            ret[i] = (T)(rand() % 65536);
+        }
+        return ret;
+    }
+}
+
+void NiftiConvertTest::checkFloats(const vector<float>& expected, const vector<float>& actual, const AString& descrip)
+{
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        if (expected[i] != actual[i] && !(isnan(expected[i]) && isnan(actual[i])))
+        {
+            setFailed(descrip + ": element " + AString::number(i) + " is " + AString::number(actual[i]) + ", expected " + AString::number(expected[i]));
+            return;
+        }
+    }
+}
+
+template<typename T>
+void NiftiConvertTest::checkInts(const vector<T>& expected, const vector<T>& actual, const AString& descrip)
+{
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        if (expected[i] != actual[i])
+        {
+            setFailed(descrip + ": element " + AString::number(i) + " is " + AString::number((int64_t)actual[i]) + ", expected " + AString::number((int64_t)expected[i]));
+            return;
+        }
+    }
+}
+
+void NiftiConvertTest::testPlainValues()
+{//known results, run with whichever implementation is selected
+    const float specialIn[] = { 2.5f, -2.5f, 0.5f, -0.5f, 1.49999f, numeric_limits<float>::quiet_NaN(), numeric_limits<float>::infinity(),
+                                -numeric_limits<float>::infinity(), 1e10f, -1e10f, 32767.5f, -32768.5f, 255.5f, 254.49f };
+    const int16_t int16Expected[] = { 3, -2, 1, 0, 1, -32768, 32767, -32768, 32767, -32768, 32767, -32768, 256, 254 };//round half up, NaN to lowest, clamp
+    const uint8_t uint8Expected[] = { 3, 0, 1, 0, 1, 0, 255, 0, 255, 0, 255, 0, 255, 254 };
+    const int numSpecial = sizeof(specialIn) / sizeof(specialIn[0]);
+    vector<float> in;
+    vector<int16_t> int16Correct;
+    vector<uint8_t> uint8Correct;
+    for (int r = 0; r < NUM_REPEATS; ++r)
+    {
+        in.insert(in.end(), specialIn, specialIn + numSpecial);
+        int16Correct.insert(int16Correct.end(), int16Expected, int16Expected + numSpecial);
+        uint8Correct.insert(uint8Correct.end(), uint8Expected, uint8Expected + numSpecial);
+    }
+    const int64_t count = (int64_t)in.size();
+    vector<int16_t> int16Out(count);
+    NiftiConvert::int16FromFloat(int16Out.data(), in.data(), count, false, 1.0, 0.0);
+    checkInts(int16Correct, int16Out, "int16 from float rounding and clamping");
+    vector<uint8_t> uint8Out(count);
+    NiftiConvert::uint8FromFloat(uint8Out.data(), in.data(), count, false, 1.0, 0.0);
+    checkInts(uint8Correct, uint8Out, "uint8 from float rounding and clamping");
+    vector<float> scaledIn(count, 11.25f), floatOut(count);
+    NiftiConvert::int16FromFloat(int16Out.data(), scaledIn.data(), count, true, 0.5, 10.0);//(11.25 - 10) / 0.5 = 2.5, rounds to 3
+    checkInts(vector<int16_t>(count, 3), int16Out, "scaled int16 from float");
+    vector<int16_t> int16In(count, 4);
+    NiftiConvert::floatFromInt16(floatOut.data(), int16In.data(), count, true, 0.5, 10.0);
+    checkFloats(vector<float>(count, 12.0f), floatOut, "scaled float from int16");
+    vector<int16_t> swap16(count, 0x0102);
+    NiftiConvert::swap16(swap16.data(), count);
+    checkInts(vector<int16_t>(count, 0x0201), swap16, "16 bit byte swap");
+    vector<int32_t> swap32(count, 0x01020304);
+    NiftiConvert::swap32(swap32.data(), count);
+    checkInts(vector<int32_t>(count, 0x04030201), swap32, "32 bit byte swap");
+    vector<int64_t> swap64(count, 0x0102030405060708LL);
+    NiftiConvert::swap64(swap64.data(), count);
+    checkInts(vector<int64_t>(count, 0x0807060504030201LL), swap64, "64 bit byte swap");
+}
+
+void NiftiConvertTest::testAVX2()
+{
+    if (NiftiConvert::setImpl(DOT_AVX) != DOT_AVX)
+    {
+        cout << "skipping AVX2 nifti conversion, not supported" << endl;
+        return;
+    }
+    vector<float> int16Source = floatInput(-40000.0f, 40000.0f), uint8Source = floatInput(-50.0f, 300.0f), floatSource = floatInput(-1000.0f, 1000.0f);
+    vector<int16_t> int16Ints = randomInts<int16_t>();
+    vector<uint8_t> uint8Ints = randomInts<uint8_t>();
+    for (int c = 0; c < NUM_COUNTS; ++c)
+    {
+        for (int start = 0; start < 2; ++start)
+        {
+            const int64_t count = COUNTS[c];
+            const AString countDescrip = " (" + AString::number(count) + " elements from " + AString::number(start) + ")";
+            for (int s = 0; s < NUM_SCALINGS; ++s)
+            {
+                const Scaling& myScaling = SCALINGS[s];
+                const AString descrip = scalingName(myScaling) + countDescrip;
+                vector<float> floatPlain(count), floatAVX(count);
+                vector<int16_t> int16Plain(count), int16AVX(count);
+                vector<uint8_t> uint8Plain(count), uint8AVX(count);
+                //int16 source values get scaled up by 1/mult, so scale the random range down to keep most of them in range
+                vector<float> int16Scaled(int16Source.begin() + start, int16Source.begin() + start + count);
+                if (myScaling.doScale)
+                {
+                    for (int64_t i = 0; i < count; ++i) int16Scaled[i] = int16Scaled[i] * abs(myScaling.mult) + myScaling.offset;
+                }
+                NiftiConvert::setImpl(DOT_NAIVE);
+                NiftiConvert::int16FromFloat(int16Plain.data(), int16Scaled.data(), count, myScaling.doScale, myScaling.mult, myScaling.offset);
+                NiftiConvert::uint8FromFloat(uint8Plain.data(), uint8Source.data() + start, count, myScaling.doScale, myScaling.mult, myScaling.offset);
+                NiftiConvert::setImpl(DOT_AVX);
+                NiftiConvert::int16FromFloat(int16AVX.data(), int16Scaled.data(), count, myScaling.doScale, myScaling.mult, myScaling.offset);
+                NiftiConvert::uint8FromFloat(uint8AVX.data(), uint8Source.data() + start, count, myScaling.doScale, myScaling.mult, myScaling.offset);
+                checkInts(int16Plain, int16AVX, "AVX2 int16 from float, " + descrip);
+                checkInts(uint8Plain, uint8AVX, "AVX2 uint8 from float, " + descrip);
+                NiftiConvert::setImpl(DOT_NAIVE);
+                NiftiConvert::floatFromInt16(floatPlain.data(), int16Ints.data() + start, count, myScaling.doScale, myScaling.mult, myScaling.offset);
+                NiftiConvert::setImpl(DOT_AVX);
+                NiftiConvert::floatFromInt16(floatAVX.data(), int16Ints.data() + start, count, myScaling.doScale, myScaling.mult, myScaling.offset);
+                checkFloats(floatPlain, floatAVX, "AVX2 float from int16, " + descrip);
+                NiftiConvert::setImpl(DOT_NAIVE);
+                NiftiConvert::floatFromUint8(floatPlain.data(), uint8Ints.data() + start, count, myScaling.doScale, myScaling.mult, myScaling.offset);
+                NiftiConvert::setImpl(DOT_AVX);
+                NiftiConvert::floatFromUint8(floatAVX.data(), uint8Ints.data() + start, count, myScaling.doScale, myScaling.mult, myScaling.offset);
+                checkFloats(floatPlain, floatAVX, "AVX2 float from uint8, " + descrip);
+                NiftiConvert::setImpl(DOT_NAIVE);
+                NiftiConvert::floatFromFloat(floatPlain.data(), floatSource.data() + start, count, myScaling.doScale, myScaling.mult, myScaling.offset);
+                NiftiConvert::setImpl(DOT_AVX);
+                NiftiConvert::floatFromFloat(floatAVX.data(), floatSource.data() + start, count, myScaling.doScale, myScaling.mult, myScaling.offset);
+                checkFloats(floatPlain, floatAVX, "AVX2 float from float, " + descrip);
+                if (failed()) return;
+            }
+            vector<uint8_t> bytes(count * 8 + 1);
+            for (size_t i = 0; i < bytes.size(); ++i)
+            {
+                bytes[i] = (uint8_t)(rand() % 256);
+            }
+            for (int size = 2; size <= 8; size *= 2)
+            {
+                vector<uint8_t> plainBytes(bytes), avxBytes(bytes);
+                NiftiConvert::setImpl(DOT_NAIVE);
+                switch (size)
+                {
+                    case 2: NiftiConvert::swap16(plainBytes.data() + start, count); break;
+                    case 4: NiftiConvert::swap32(plainBytes.data() + start, count); break;
+                    case 8: NiftiConvert::swap64(plainBytes.data() + start, count); break;
+                }
+                NiftiConvert::setImpl(DOT_AVX);
+                switch (size)
+                {
+                    case 2: NiftiConvert::swap16(avxBytes.data() + start, count); break;
+                    case 4: NiftiConvert::swap32(avxBytes.data() + start, count); break;
+                    case 8: NiftiConvert::swap64(avxBytes.data() + start, count); break;
+                }
+                if (plainBytes != avxBytes)
+                {
+                    setFailed("AVX2 " + AString::number(size * 8) + " bit byte swap differs from plain" + countDescrip);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+void NiftiConvertTest::execute()
+{
+    NiftiConvert::setImpl(DOT_NAIVE);
+    testPlainValues();
+    if (failed()) return;
+    if (NiftiConvert::setImpl(DOT_AVX) == DOT_AVX)
+    {
+        testPlainValues();
+        if (failed()) return;
+    }
+    testAVX2();
+    NiftiConvert::setImpl(DOT_AUTO);
+}
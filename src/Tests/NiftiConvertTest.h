@@ -0,0 +1,44 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#ifndef __NIFTI_CONVERT_TEST_H__
+#define __NIFTI_CONVERT_TEST_H__
+
+#include "TestInterface.h"
+
+#include "stdint.h"
+#include <vector>
+
+namespace caret {
+
+    //checks the AVX2 nifti conversion, scaling and byte swapping kernels against the plain ones, including NaN, clamping and rounding
+    class NiftiConvertTest : public TestInterface
+    {
+        void checkFloats(const std::vector<float>& expected, const std::vector<float>& actual, const AString& descrip);
+        template<typename T>
+        void checkInts(const std::vector<T>& expected, const std::vector<T>& actual, const AString& descrip);
+        void testPlainValues();
+        void testAVX2();
+    public:
+        NiftiConvertTest(const AString& identifier);
+        virtual void execute();
+    };
+
+}
+#endif //__NIFTI_CONVERT_TEST_H__
@@ -0,0 +1,222 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "PointLocatorTest.h"
+
+#include "CaretPointLocator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+PointLocatorTest::PointLocatorTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int64_t NUM_TARGETS = 5000;//more than the locator's threshold for threading a batch
+    const int NUM_NEAREST = 6;
+    const float LIMITED_DIST = 3.0f, RANGE_DIST = 8.0f;
+    const float TOLERANCE = 1e-4f;
+
+    vector<float> randomPoints(const int64_t& numPoints, const float& extent)
+    {
+        vector<float> ret(numPoints * 3);
+        for (int64_t i = 0; i < numPoints * 3; ++i)
+        {
+            ret[i] = (rand() / (float)RAND_MAX * 2.0f - 1.0f) * extent;
+        }
+        return ret;
+    }
+
+    struct BruteHit
+    {
+        float m_dist;
+        int64_t m_index;
+        int32_t m_set;
+        bool operator<(const BruteHit& rhs) const { return m_dist < rhs.m_dist; }
+    };
+}
+
+void PointLocatorTest::checkQueries(const CaretPointLocator& myLocator, const vector<vector<float> >& pointSets, const vector<float>& targets, const AString& descrip)
+{
+    const int64_t numTargets = (int64_t)targets.size() / 3;
+    vector<int64_t> indices(numTargets), limitedIndices(numTargets), nearIndices(numTargets * NUM_NEAREST);
+    vector<float> distances(numTargets), limitedDistances(numTargets), nearDistances(numTargets * NUM_NEAREST);
+    vector<int32_t> sets(numTargets), limitedSets(numTargets), nearSets(numTargets * NUM_NEAREST);
+    myLocator.closestPoints(targets.data(), numTargets, indices.data(), distances.data(), sets.data());
+    myLocator.closestPointsLimited(targets.data(), numTargets, LIMITED_DIST, limitedIndices.data(), limitedDistances.data(), limitedSets.data());
+    myLocator.nearestPoints(targets.data(), numTargets, NUM_NEAREST, nearIndices.data(), nearDistances.data(), nearSets.data());
+    vector<int64_t> rangeOffsets, rangeIndices;
+    vector<float> rangeDistances;
+    vector<int32_t> rangeSets;
+    myLocator.pointsInRange(targets.data(), numTargets, RANGE_DIST, rangeOffsets, rangeIndices, &rangeDistances, &rangeSets);
+    if ((int64_t)rangeOffsets.size() != numTargets + 1)
+    {
+        setFailed(descrip + ": pointsInRange returned " + AString::number(rangeOffsets.size()) + " offsets for " + AString::number(numTargets) + " targets");
+        return;
+    }
+    int64_t numLimitedFound = 0;
+    for (int64_t t = 0; t < numTargets; ++t)
+    {
+        const float* target = targets.data() + t * 3;
+        const AString targetDescrip = descrip + ": target " + AString::number(t);
+        vector<BruteHit> brute;
+        for (int32_t s = 0; s < (int32_t)pointSets.size(); ++s)
+        {
+            for (int64_t i = 0; i < (int64_t)pointSets[s].size() / 3; ++i)
+            {
+                const float* point = pointSets[s].data() + i * 3;
+                BruteHit myHit;
+                myHit.m_dist = (Vector3D(point) - Vector3D(target)).length();
+                myHit.m_index = i;
+                myHit.m_set = s;
+                brute.push_back(myHit);
+            }
+        }
+        sort(brute.begin(), brute.end());
+        LocatorInfo single(-1, -1, Vector3D());
+        int64_t singleIndex = myLocator.closestPoint(target, &single);
+        //ties are possible in principle, so compare distances, and only require matching indices when the distances differ
+        if (abs(distances[t] - brute[0].m_dist) > TOLERANCE ||
+            ((indices[t] != singleIndex || sets[t] != single.whichSet) && abs((single.coords - Vector3D(target)).length() - distances[t]) > TOLERANCE))
+        {
+            setFailed(targetDescrip + ": closestPoints gave " + AString::number(indices[t]) + " in set " + AString::number(sets[t]) +
+                      ", closestPoint gave " + AString::number(singleIndex) + " in set " + AString::number(single.whichSet));
+            return;
+        }
+        int64_t singleLimited = myLocator.closestPointLimited(target, LIMITED_DIST, &single);
+        if ((singleLimited == -1) != (limitedIndices[t] == -1) ||
+            (singleLimited != -1 && (limitedIndices[t] != singleLimited || limitedSets[t] != single.whichSet) &&
+             abs((single.coords - Vector3D(target)).length() - limitedDistances[t]) > TOLERANCE))
+        {
+            setFailed(targetDescrip + ": closestPointsLimited gave " + AString::number(limitedIndices[t]) + ", closestPointLimited gave " + AString::number(singleLimited));
+            return;
+        }
+        if (limitedIndices[t] != -1) ++numLimitedFound;
+        for (int i = 0; i < NUM_NEAREST; ++i)
+        {
+            const int64_t pos = t * NUM_NEAREST + i;
+            if (abs(nearDistances[pos] - brute[i].m_dist) > TOLERANCE)
+            {
+                setFailed(targetDescrip + ": nearestPoints distance " + AString::number(i) + " is " + AString::number(nearDistances[pos]) +
+                          ", brute force is " + AString::number(brute[i].m_dist));
+                return;
+            }
+            const float* point = pointSets[nearSets[pos]].data() + nearIndices[pos] * 3;
+            if (abs((Vector3D(point) - Vector3D(target)).length() - nearDistances[pos]) > TOLERANCE)
+            {
+                setFailed(targetDescrip + ": nearestPoints distance " + AString::number(i) + " doesn't match its point");
+                return;
+            }
+        }
+        set<LocatorInfo> inRange = myLocator.pointsInRange(target, RANGE_DIST);
+        if ((int64_t)inRange.size() != rangeOffsets[t + 1] - rangeOffsets[t])
+        {
+            setFailed(targetDescrip + ": batch pointsInRange found " + AString::number(rangeOffsets[t + 1] - rangeOffsets[t]) + " points, single found " +
+                      AString::number(inRange.size()));
+            return;
+        }
+        int64_t pos = rangeOffsets[t];
+        for (set<LocatorInfo>::const_iterator iter = inRange.begin(); iter != inRange.end(); ++iter, ++pos)
+        {
+            if (rangeIndices[pos] != iter->index || rangeSets[pos] != iter->whichSet ||
+                abs(rangeDistances[pos] - (iter->coords - Vector3D(target)).length()) > TOLERANCE)
+            {
+                setFailed(targetDescrip + ": batch pointsInRange differs from single at position " + AString::number(pos - rangeOffsets[t]));
+                return;
+            }
+        }
+    }
+    if (numLimitedFound == 0 || numLimitedFound == numTargets)
+    {
+        setFailed(descrip + ": limited distance should find points for some targets and not others, found " + AString::number(numLimitedFound));
+    }
+}
+
+void PointLocatorTest::testPadding()
+{//fewer points than k
+    const int NUM_POINTS = 4, K = 7;
+    vector<float> points = randomPoints(NUM_POINTS, 10.0f), targets = randomPoints(10, 15.0f);
+    CaretPointLocator myLocator(points.data(), NUM_POINTS);
+    vector<int64_t> indices(10 * K);
+    vector<float> distances(10 * K);
+    vector<int32_t> sets(10 * K);
+    myLocator.nearestPoints(targets.data(), 10, K, indices.data(), distances.data(), sets.data());
+    for (int64_t t = 0; t < 10; ++t)
+    {
+        set<int64_t> found;
+        for (int i = 0; i < K; ++i)
+        {
+            const int64_t pos = t * K + i;
+            if (i < NUM_POINTS)
+            {
+                if (indices[pos] < 0 || indices[pos] >= NUM_POINTS || sets[pos] != 0 || (i > 0 && distances[pos] < distances[pos - 1]))
+                {
+                    setFailed("nearestPoints with k > number of points: bad result " + AString::number(i) + " for target " + AString::number(t));
+                    return;
+                }
+                found.insert(indices[pos]);
+            } else {
+                if (indices[pos] != -1 || distances[pos] != -1.0f || sets[pos] != -1)
+                {
+                    setFailed("nearestPoints with k > number of points: result " + AString::number(i) + " for target " + AString::number(t) + " isn't padded");
+                    return;
+                }
+            }
+        }
+        if ((int)found.size() != NUM_POINTS) setFailed("nearestPoints with k > number of points: duplicate points for target " + AString::number(t));
+    }
+}
+
+void PointLocatorTest::execute()
+{
+    vector<vector<float> > pointSets(2);
+    pointSets[0] = randomPoints(3000, 50.0f);
+    pointSets[1] = randomPoints(500, 30.0f);
+    const float minBounds[3] = { -50.0f, -50.0f, -50.0f }, maxBounds[3] = { 50.0f, 50.0f, 50.0f };
+    CaretPointLocator myLocator(minBounds, maxBounds);
+    for (int s = 0; s < 2; ++s)
+    {
+        int32_t whichSet = myLocator.addPointSet(pointSets[s].data(), (int64_t)pointSets[s].size() / 3);
+        if (whichSet != s)
+        {
+            setFailed("addPointSet returned set " + AString::number(whichSet) + ", expected " + AString::number(s));
+            return;
+        }
+    }
+    vector<float> targets = randomPoints(NUM_TARGETS, 60.0f);//some outside the bounding box
+    checkQueries(myLocator, pointSets, targets, "two point sets");
+    if (failed()) return;
+    myLocator.removePointSet(1);//the batch queries must see the change
+    pointSets[1].clear();
+    checkQueries(myLocator, pointSets, targets, "after removing a point set");
+    if (failed()) return;
+    vector<float> fewTargets(targets.begin(), targets.begin() + 300);//serial batch
+    checkQueries(myLocator, pointSets, fewTargets, "small batch");
+    if (failed()) return;
+    testPadding();
+}
@@ -0,0 +1,42 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#ifndef __POINT_LOCATOR_TEST_H__
+#define __POINT_LOCATOR_TEST_H__
+
+#include "TestInterface.h"
+
+#include <vector>
+
+namespace caret {
+
+    class CaretPointLocator;
+
+    //checks the batch queries of CaretPointLocator against the single point queries and brute force
+    class PointLocatorTest : public TestInterface
+    {
+        void checkQueries(const CaretPointLocator& myLocator, const std::vector<std::vector<float> >& pointSets, const std::vector<float>& targets, const AString& descrip);
+        void testPadding();
+    public:
+        PointLocatorTest(const AString& identifier);
+        virtual void execute();
+    };
+
+}
+#endif //__POINT_LOCATOR_TEST_H__
@@ -0,0 +1,192 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "ResampleMatrixTest.h"
+
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "CaretSparseFile.h"
+#include "CiftiBrainModelsMap.h"
+#include "CommandOperationManager.h"
+#include "DataFileException.h"
+#include "MetricFile.h"
+#include "ProgramParameters.h"
+#include "ResamplingMatrix.h"
+#include "SurfaceFile.h"
+
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace caret;
+using namespace std;
+
+ResampleMatrixTest::ResampleMatrixTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int NUM_COLUMNS = 3;
+    
+    vector<AString> makeArgs(const char* first, const AString& a, const AString& b, const AString& c, const AString& d, const AString& e = "")
+    {
+        vector<AString> ret;
+        ret.push_back(first);
+        ret.push_back(a);
+        ret.push_back(b);
+        ret.push_back(c);
+        ret.push_back(d);
+        if (e != "") ret.push_back(e);
+        return ret;
+    }
+}
+
+void ResampleMatrixTest::runCommand(const vector<AString>& arguments)
+{
+    const char* programName = "wb_command";
+    ProgramParameters myParams(1, &programName);
+    for (int i = 0; i < (int)arguments.size(); ++i)
+    {
+        myParams.addParameter(arguments[i]);
+    }
+    CommandOperationManager::getCommandOperationManager()->runCommand(myParams);
+}
+
+void ResampleMatrixTest::testRoundTrip(const AString& method, const bool& areaCorrect)
+{
+    const AString curName = m_tempDir + "/cur.surf.gii", newName = m_tempDir + "/new.surf.gii", inName = m_tempDir + "/in.func.gii";
+    const AString matrixName = m_tempDir + "/" + method + ".resample.wbsparse";
+    const AString appliedName = m_tempDir + "/applied.func.gii", directName = m_tempDir + "/direct.func.gii";
+    vector<AString> areaArgs;
+    if (areaCorrect)
+    {//spheres are fine as area surfaces, the correction is still applied
+        areaArgs.push_back("-area-surfs");
+        areaArgs.push_back(curName);
+        areaArgs.push_back(newName);
+    }
+    vector<AString> args = makeArgs("-surface-resample-matrix", curName, newName, method, matrixName);
+    args.insert(args.end(), areaArgs.begin(), areaArgs.end());
+    runCommand(args);
+    runCommand(makeArgs("-metric-apply-resample-matrix", inName, matrixName, appliedName, ""));
+    args = makeArgs("-metric-resample", inName, curName, newName, method, directName);
+    args.insert(args.end(), areaArgs.begin(), areaArgs.end());
+    runCommand(args);
+    MetricFile applied, direct;
+    applied.readFile(appliedName);
+    direct.readFile(directName);
+    if (applied.getNumberOfNodes() != direct.getNumberOfNodes() || applied.getNumberOfColumns() != direct.getNumberOfColumns())
+    {
+        setFailed(method + ": applied matrix output has different dimensions than -metric-resample");
+        return;
+    }
+    float maxAbs = 0.0f;
+    for (int c = 0; c < direct.getNumberOfColumns(); ++c)
+    {
+        const float* directData = direct.getValuePointerForColumn(c);
+        for (int i = 0; i < direct.getNumberOfNodes(); ++i)
+        {
+            maxAbs = max(maxAbs, abs(directData[i]));
+        }
+    }
+    if (maxAbs == 0.0f)
+    {
+        setFailed(method + ": -metric-resample output is all zeros, test data is bad");
+        return;
+    }
+    for (int c = 0; c < direct.getNumberOfColumns(); ++c)
+    {
+        const float* appliedData = applied.getValuePointerForColumn(c), *directData = direct.getValuePointerForColumn(c);
+        for (int i = 0; i < direct.getNumberOfNodes(); ++i)
+        {//matrix accumulates in double, -metric-resample in float
+            if (abs(appliedData[i] - directData[i]) > 1e-5f * maxAbs)
+            {
+                setFailed(method + ": mismatch at vertex " + AString::number(i) + " column " + AString::number(c) + ", applied matrix gave " +
+                          AString::number(appliedData[i]) + ", -metric-resample gave " + AString::number(directData[i]));
+                return;
+            }
+        }
+    }
+}
+
+void ResampleMatrixTest::testWrongContents()
+{//a trajectory file also has brain models on both dimensions, but must not be accepted as a resampling matrix
+    CiftiBrainModelsMap mySpace;
+    mySpace.addSurfaceModel(10, StructureEnum::CORTEX_LEFT);
+    CiftiXML myXML;
+    myXML.setNumberOfDimensions(2);
+    myXML.setMap(CiftiXML::ALONG_ROW, mySpace);
+    myXML.setMap(CiftiXML::ALONG_COLUMN, mySpace);
+    const AString trajName = m_tempDir + "/other.trajTEMP.wbsparse";
+    CaretSparseFileWriter myWriter(trajName, myXML);
+    myWriter.finish();
+    ResamplingMatrix myMatrix;
+    bool threw = false;
+    try
+    {
+        myMatrix.readFile(trajName);
+    } catch (DataFileException&) {
+        threw = true;
+    }
+    if (!threw) setFailed("sparse file without resampling matrix metadata was read as a resampling matrix");
+}
+
+void ResampleMatrixTest::execute()
+{
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid())
+    {
+        setFailed("failed to create temporary directory");
+        return;
+    }
+    m_tempDir = tempDir.path();
+    SurfaceFile curSphere, newSphere;
+    AlgorithmSurfaceCreateSphere(NULL, 2562, &curSphere);
+    AlgorithmSurfaceCreateSphere(NULL, 642, &newSphere);
+    curSphere.setStructure(StructureEnum::CORTEX_LEFT);
+    newSphere.setStructure(StructureEnum::CORTEX_LEFT);
+    const int numNewNodes = newSphere.getNumberOfNodes();
+    const float angle = 0.3f, cosA = cos(angle), sinA = sin(angle);
+    for (int i = 0; i < numNewNodes; ++i)
+    {//rotate, so that new vertices don't land exactly on old ones
+        const float* coord = newSphere.getCoordinate(i);
+        newSphere.setCoordinate(i, coord[0] * cosA - coord[1] * sinA, coord[0] * sinA + coord[1] * cosA, coord[2]);
+    }
+    curSphere.writeFile(m_tempDir + "/cur.surf.gii");
+    newSphere.writeFile(m_tempDir + "/new.surf.gii");
+    const int numCurNodes = curSphere.getNumberOfNodes();
+    MetricFile inMetric;
+    inMetric.setNumberOfNodesAndColumns(numCurNodes, NUM_COLUMNS);
+    inMetric.setStructure(StructureEnum::CORTEX_LEFT);
+    for (int c = 0; c < NUM_COLUMNS; ++c)
+    {
+        for (int i = 0; i < numCurNodes; ++i)
+        {
+            const float* coord = curSphere.getCoordinate(i);
+            inMetric.setValue(i, c, sin(coord[0] * 0.05f + c) * cos(coord[1] * 0.03f) + 0.01f * coord[2] * c);
+        }
+    }
+    inMetric.writeFile(m_tempDir + "/in.func.gii");
+    testRoundTrip("BARYCENTRIC", false);
+    testRoundTrip("ADAP_BARY_AREA", true);
+    testWrongContents();
+    if (!failed()) cout << "resampling matrix tests successful" << endl;
+}
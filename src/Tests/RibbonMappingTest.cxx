@@ -0,0 +1,258 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "RibbonMappingTest.h"
+
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "CaretException.h"
+#include "CommandOperationManager.h"
+#include "MetricFile.h"
+#include "ProgramParameters.h"
+#include "RibbonMappingHelper.h"
+#include "SurfaceFile.h"
+#include "VolumeFile.h"
+
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+using namespace caret;
+using namespace std;
+
+RibbonMappingTest::RibbonMappingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int64_t VOL_DIMS[3] = { 28, 24, 30 };
+    const float SPACING[3] = { 1.0f, 1.2f, 0.9f };
+    
+    //anisotropic voxels, centered on the origin like the spheres
+    VolumeSpace makeSpace()
+    {
+        vector<vector<float> > sform(3, vector<float>(4, 0.0f));
+        for (int i = 0; i < 3; ++i)
+        {
+            sform[i][i] = SPACING[i];
+            sform[i][3] = -SPACING[i] * (VOL_DIMS[i] - 1) / 2.0f;
+        }
+        return VolumeSpace(VOL_DIMS, sform);
+    }
+    
+    void makeShell(const SurfaceFile& sphere, const float& radius, SurfaceFile& shellOut)
+    {
+        shellOut = sphere;
+        for (int32_t i = 0; i < shellOut.getNumberOfNodes(); ++i)
+        {
+            const float* coord = shellOut.getCoordinate(i);
+            const float scale = radius / sqrt(coord[0] * coord[0] + coord[1] * coord[1] + coord[2] * coord[2]);
+            shellOut.setCoordinate(i, coord[0] * scale, coord[1] * scale, coord[2] * scale);
+        }
+    }
+}
+
+void RibbonMappingTest::runCommand(const vector<AString>& arguments)
+{
+    const char* programName = "wb_command";
+    ProgramParameters myParams(1, &programName);
+    for (int i = 0; i < (int)arguments.size(); ++i)
+    {
+        myParams.addParameter(arguments[i]);
+    }
+    CommandOperationManager::getCommandOperationManager()->runCommand(myParams);
+}
+
+void RibbonMappingTest::testSampling(const SurfaceFile& innerSurf, const SurfaceFile& outerSurf)
+{//skipping the parts of a voxel that no face passes through must count exactly the same samples
+    const VolumeSpace mySpace = makeSpace();
+    for (int thin = 0; thin < 2; ++thin)
+    {
+        for (int divisions = 3; divisions <= 5; divisions += 2)
+        {
+            const AString descrip = AString(thin ? "thin" : "thick") + " columns with " + AString::number(divisions) + " divisions";
+            vector<vector<VoxelWeight> > adaptive, bruteForce;
+            RibbonMappingHelper::computeWeightsRibbon(adaptive, mySpace, &innerSurf, &outerSurf, NULL, divisions, thin == 1, true);
+            RibbonMappingHelper::computeWeightsRibbon(bruteForce, mySpace, &innerSurf, &outerSurf, NULL, divisions, thin == 1, false);
+            bool haveWeights = false;
+            for (int64_t node = 0; node < (int64_t)bruteForce.size(); ++node)
+            {
+                if (adaptive[node].size() != bruteForce[node].size())
+                {
+                    setFailed(descrip + ": vertex " + AString::number(node) + " has " + AString::number(adaptive[node].size()) + " voxels, expected " +
+                              AString::number(bruteForce[node].size()));
+                    return;
+                }
+                for (int i = 0; i < (int)bruteForce[node].size(); ++i)
+                {
+                    const VoxelWeight& mine = adaptive[node][i], &expected = bruteForce[node][i];
+                    if (mine.weight != expected.weight || mine.ijk[0] != expected.ijk[0] || mine.ijk[1] != expected.ijk[1] || mine.ijk[2] != expected.ijk[2])
+                    {
+                        setFailed(descrip + ": vertex " + AString::number(node) + " voxel " + AString::number(i) + " has weight " + AString::number(mine.weight) +
+                                  ", expected " + AString::number(expected.weight));
+                        return;
+                    }
+                    haveWeights = true;
+                }
+            }
+            if (!haveWeights)
+            {
+                setFailed(descrip + ": no voxels have weights, test data is bad");
+                return;
+            }
+        }
+    }
+}
+
+void RibbonMappingTest::testThinColumns(const SurfaceFile& innerSurf, const SurfaceFile& outerSurf)
+{//every sample is inside at most one thin column, while the normal polyhedra overlap each other about 3 times
+    const VolumeSpace mySpace = makeSpace();
+    const int64_t frameSize = VOL_DIMS[0] * VOL_DIMS[1] * VOL_DIMS[2];
+    for (int thin = 0; thin < 2; ++thin)
+    {
+        vector<vector<VoxelWeight> > myWeights;
+        RibbonMappingHelper::computeWeightsRibbon(myWeights, mySpace, &innerSurf, &outerSurf, NULL, 5, thin == 1);
+        vector<double> voxelSums(frameSize, 0.0);
+        for (int64_t node = 0; node < (int64_t)myWeights.size(); ++node)
+        {
+            for (int i = 0; i < (int)myWeights[node].size(); ++i)
+            {
+                voxelSums[mySpace.getIndex(myWeights[node][i].ijk)] += myWeights[node][i].weight;
+            }
+        }
+        const double maxSum = *max_element(voxelSums.begin(), voxelSums.end());
+        if (thin == 1 && maxSum > 1.0001)
+        {
+            setFailed("thin columns overlap, a voxel has total weight " + AString::number(maxSum));
+            return;
+        }
+        if (thin == 0 && maxSum < 2.0)
+        {
+            setFailed("normal ribbon polyhedra don't overlap, largest total voxel weight is " + AString::number(maxSum));
+            return;
+        }
+    }
+}
+
+void RibbonMappingTest::testSavedWeights(const SurfaceFile& innerSurf, const SurfaceFile& outerSurf)
+{
+    const VolumeSpace mySpace = makeSpace();
+    vector<int64_t> dims(VOL_DIMS, VOL_DIMS + 3);
+    dims.push_back(2);
+    VolumeFile myVol(dims, mySpace.getSform());
+    for (int64_t f = 0; f < 2; ++f)
+    {
+        for (int64_t k = 0; k < VOL_DIMS[2]; ++k)
+        {
+            for (int64_t j = 0; j < VOL_DIMS[1]; ++j)
+            {
+                for (int64_t i = 0; i < VOL_DIMS[0]; ++i)
+                {
+                    myVol.setValue(sin(i * 0.3f + f) + cos(j * 0.2f - k * 0.4f) + rand() / (float)RAND_MAX, i, j, k, f);
+                }
+            }
+        }
+    }
+    SurfaceFile midSurf;
+    makeShell(innerSurf, 9.5f, midSurf);
+    const AString volName = m_tempDir + "/data.nii.gz", innerName = m_tempDir + "/inner.surf.gii", outerName = m_tempDir + "/outer.surf.gii";
+    const AString midName = m_tempDir + "/mid.surf.gii", weightsName = m_tempDir + "/ribbon.resample.wbsparse";
+    const AString directName = m_tempDir + "/direct.func.gii", savedName = m_tempDir + "/saved.func.gii";
+    myVol.writeFile(volName);
+    innerSurf.writeFile(innerName);
+    outerSurf.writeFile(outerName);
+    midSurf.writeFile(midName);
+    vector<AString> args;
+    args.push_back("-volume-to-surface-mapping");
+    args.push_back(volName);
+    args.push_back(midName);
+    args.push_back(directName);
+    args.push_back("-ribbon-constrained");
+    args.push_back(innerName);
+    args.push_back(outerName);
+    args.push_back("-thin-columns");
+    args.push_back("-voxel-subdiv");
+    args.push_back("5");
+    args.push_back("-save-weights");
+    args.push_back(weightsName);
+    runCommand(args);
+    args.resize(4);
+    args[3] = savedName;
+    args.push_back("-ribbon-weights");
+    args.push_back(weightsName);
+    runCommand(args);
+    MetricFile direct, saved;
+    direct.readFile(directName);
+    saved.readFile(savedName);
+    if (direct.getNumberOfNodes() != saved.getNumberOfNodes() || direct.getNumberOfColumns() != 2 || saved.getNumberOfColumns() != 2)
+    {
+        setFailed("mapping with saved weights gave different dimensions than ribbon mapping");
+        return;
+    }
+    for (int c = 0; c < 2; ++c)
+    {
+        const float* directData = direct.getValuePointerForColumn(c), *savedData = saved.getValuePointerForColumn(c);
+        for (int i = 0; i < direct.getNumberOfNodes(); ++i)
+        {
+            if (abs(directData[i] - savedData[i]) > 1e-5f * max(1.0f, abs(directData[i])))
+            {
+                setFailed("mapping with saved weights differs at vertex " + AString::number(i) + " column " + AString::number(c) + ", got " +
+                          AString::number(savedData[i]) + ", expected " + AString::number(directData[i]));
+                return;
+            }
+        }
+    }
+    //same vertex count, but the weights were made for the other hemisphere
+    midSurf.setStructure(StructureEnum::CORTEX_RIGHT);
+    midSurf.writeFile(midName);
+    bool threw = false;
+    try
+    {
+        runCommand(args);
+    } catch (CaretException&) {
+        threw = true;
+    }
+    if (!threw) setFailed("saved ribbon weights were used on a surface of a different structure");
+}
+
+void RibbonMappingTest::execute()
+{
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid())
+    {
+        setFailed("failed to create temporary directory");
+        return;
+    }
+    m_tempDir = tempDir.path();
+    SurfaceFile sphere, innerSurf, outerSurf;
+    AlgorithmSurfaceCreateSphere(NULL, 162, &sphere);
+    sphere.setStructure(StructureEnum::CORTEX_LEFT);
+    makeShell(sphere, 8.0f, innerSurf);
+    makeShell(sphere, 11.0f, outerSurf);
+    testSampling(innerSurf, outerSurf);
+    if (failed()) return;
+    testThinColumns(innerSurf, outerSurf);
+    if (failed()) return;
+    testSavedWeights(innerSurf, outerSurf);
+    if (!failed()) cout << "ribbon mapping tests successful" << endl;
+}
@@ -0,0 +1,338 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "SparseFileTest.h"
+
+#include "CaretSparseFile.h"
+#include "CiftiSeriesMap.h"
+#include "DataFileException.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+SparseFileTest::SparseFileTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int64_t ROW_LENGTH = 1000, NUM_ROWS = 50;
+    
+    CiftiXML makeXML()
+    {
+        CiftiXML ret;
+        ret.setNumberOfDimensions(2);
+        ret.setMap(CiftiXML::ALONG_ROW, CiftiSeriesMap(ROW_LENGTH));
+        ret.setMap(CiftiXML::ALONG_COLUMN, CiftiSeriesMap(NUM_ROWS));
+        return ret;
+    }
+    
+    //random sparse rows, some empty, with values that need the full 64 bits
+    void makeRows(vector<vector<int64_t> >& indices, vector<vector<int64_t> >& values)
+    {
+        indices.resize(NUM_ROWS);
+        values.resize(NUM_ROWS);
+        for (int64_t row = 0; row < NUM_ROWS; ++row)
+        {
+            indices[row].clear();
+            values[row].clear();
+            if (row % 7 == 3) continue;
+            for (int64_t i = rand() % 5; i < ROW_LENGTH; i += 1 + rand() % (row + 2))
+            {
+                indices[row].push_back(i);
+                values[row].push_back((int64_t)((((uint64_t)rand()) << 33) ^ (((uint64_t)rand()) << 5) ^ (uint64_t)rand()));
+            }
+        }
+    }
+}
+
+void SparseFileTest::testBatchRoundTrip(const bool& compressed)
+{
+    const AString descrip = (compressed ? "compressed: " : "original: ");
+    const AString filename = m_tempDir + (compressed ? "/roundtrip_z.wbsparse" : "/roundtrip.wbsparse");
+    vector<vector<int64_t> > indices, values;
+    makeRows(indices, values);
+    {
+        CaretSparseFileWriter writer(filename, makeXML(), compressed);
+        //split the rows between the batch and single row functions, to make sure they mix
+        writer.writeRowsSparse(0, vector<vector<int64_t> >(indices.begin(), indices.begin() + 20), vector<vector<int64_t> >(values.begin(), values.begin() + 20));
+        writer.writeRowSparse(20, indices[20], values[20]);
+        writer.writeRowsSparse(21, vector<vector<int64_t> >(indices.begin() + 21, indices.end()), vector<vector<int64_t> >(values.begin() + 21, values.end()));
+    }
+    CaretSparseFile reader(filename);
+    if (reader.isCompressed() != compressed) setFailed(descrip + "file was written in the wrong format version");
+    if (reader.getDimensions()[0] != ROW_LENGTH || reader.getDimensions()[1] != NUM_ROWS)
+    {
+        setFailed(descrip + "dimensions don't match");
+        return;
+    }
+    vector<int64_t> rowIndices;
+    for (int64_t row = NUM_ROWS - 1; row >= 0; --row)
+    {//out of order, and repeated, should work
+        rowIndices.push_back(row);
+        if (row % 10 == 0) rowIndices.push_back(row);
+    }
+    vector<vector<int64_t> > batchIndices, batchValues;
+    reader.getRowsSparse(rowIndices, batchIndices, batchValues);
+    if (batchIndices.size() != rowIndices.size() || batchValues.size() != rowIndices.size())
+    {
+        setFailed(descrip + "batch read returned the wrong number of rows");
+        return;
+    }
+    vector<int64_t> singleIndices, singleValues, fullRow(ROW_LENGTH);
+    for (size_t i = 0; i < rowIndices.size(); ++i)
+    {
+        const int64_t row = rowIndices[i];
+        if (batchIndices[i] != indices[row] || batchValues[i] != values[row]) setFailed(descrip + "batch read of row " + AString::number(row) + " doesn't match what was written");
+        reader.getRowSparse(row, singleIndices, singleValues);
+        if (singleIndices != indices[row] || singleValues != values[row]) setFailed(descrip + "single read of row " + AString::number(row) + " doesn't match what was written");
+        reader.getRow(row, fullRow.data());
+        size_t next = 0;
+        for (int64_t j = 0; j < ROW_LENGTH; ++j)
+        {
+            int64_t expected = 0;
+            if (next < indices[row].size() && indices[row][next] == j)
+            {
+                expected = values[row][next];
+                ++next;
+            }
+            if (fullRow[j] != expected)
+            {
+                setFailed(descrip + "full read of row " + AString::number(row) + " doesn't match what was written");
+                break;
+            }
+        }
+    }
+    //fibers: encoding is lossy, so compare the batch functions to the single row functions
+    const AString fiberName = m_tempDir + (compressed ? "/fibers_z.wbsparse" : "/fibers.wbsparse");
+    vector<vector<FiberFractions> > fibers(NUM_ROWS);
+    for (int64_t row = 0; row < NUM_ROWS; ++row)
+    {
+        fibers[row].resize(indices[row].size());
+        for (size_t i = 0; i < indices[row].size(); ++i)
+        {
+            FiberFractions& myFiber = fibers[row][i];
+            myFiber.totalCount = 1 + rand() % 100000;
+            myFiber.distance = rand() % 1000;
+            myFiber.fiberFractions.resize(3);
+            myFiber.fiberFractions[0] = (rand() % 500) / 1000.0f;
+            myFiber.fiberFractions[1] = (rand() % 500) / 1000.0f;
+            myFiber.fiberFractions[2] = 1.0f - myFiber.fiberFractions[0] - myFiber.fiberFractions[1];
+        }
+    }
+    {
+        CaretSparseFileWriter writer(fiberName, makeXML(), compressed);
+        writer.writeFibersRowsSparse(0, indices, fibers);
+    }
+    CaretSparseFile fiberReader(fiberName);
+    vector<vector<FiberFractions> > batchFibers;
+    fiberReader.getFibersRowsSparse(rowIndices, batchIndices, batchFibers);
+    vector<FiberFractions> singleFibers;
+    for (size_t i = 0; i < rowIndices.size(); ++i)
+    {
+        const int64_t row = rowIndices[i];
+        fiberReader.getFibersRowSparse(row, singleIndices, singleFibers);
+        bool match = (batchIndices[i] == indices[row] && singleIndices == indices[row] && batchFibers[i].size() == singleFibers.size());
+        for (size_t j = 0; match && j < singleFibers.size(); ++j)
+        {
+            match = (batchFibers[i][j].totalCount == fibers[row][j].totalCount && singleFibers[j].totalCount == fibers[row][j].totalCount &&
+                     batchFibers[i][j].distance == singleFibers[j].distance && batchFibers[i][j].fiberFractions == singleFibers[j].fiberFractions);
+        }
+        if (!match) setFailed(descrip + "batch fiber read of row " + AString::number(row) + " doesn't match single row read");
+    }
+}
+
+void SparseFileTest::testBatchErrors(const bool& compressed)
+{
+    const AString descrip = (compressed ? "compressed: " : "original: ");
+    vector<vector<int64_t> > indices, values;
+    makeRows(indices, values);
+    //unsorted indices must be rejected by the batch writer too
+    {
+        vector<vector<int64_t> > badIndices = indices;
+        badIndices[5].push_back(0);
+        values[5].push_back(1);
+        bool threw = false;
+        try
+        {
+            CaretSparseFileWriter writer(m_tempDir + "/unsorted.wbsparse", makeXML(), compressed);
+            writer.writeRowsSparse(0, badIndices, values);
+        } catch (DataFileException&) {
+            threw = true;
+        }
+        if (!threw) setFailed(descrip + "batch write of unsorted indices didn't throw DataFileException");
+        values[5].pop_back();
+    }
+    //values that can't be fiber fractions must come out of the parallel region as DataFileException, not a sliced or terminating exception
+    const AString filename = m_tempDir + (compressed ? "/badfibers_z.wbsparse" : "/badfibers.wbsparse");
+    for (size_t i = 0; i < values[11].size(); ++i)
+    {
+        values[11][i] = (1LL<<32) | (3LL<<30);//the top two bits of the fraction word must be zero
+    }
+    if (values[11].empty())
+    {
+        setFailed(descrip + "test data has no values in row 11");
+        return;
+    }
+    for (int64_t row = 0; row < NUM_ROWS; ++row)
+    {
+        if (row == 11) continue;
+        for (size_t i = 0; i < values[row].size(); ++i)
+        {
+            values[row][i] = (1LL<<32) | (100<<10);
+        }
+    }
+    {
+        CaretSparseFileWriter writer(filename, makeXML(), compressed);
+        writer.writeRowsSparse(0, indices, values);
+    }
+    CaretSparseFile reader(filename);
+    vector<int64_t> rowIndices;
+    for (int64_t row = 0; row < NUM_ROWS; ++row) rowIndices.push_back(row);
+    vector<vector<int64_t> > outIndices;
+    vector<vector<FiberFractions> > outFibers;
+    bool threw = false;
+    try
+    {
+        reader.getFibersRowsSparse(rowIndices, outIndices, outFibers);
+    } catch (DataFileException&) {
+        threw = true;
+    }
+    if (!threw) setFailed(descrip + "batch fiber read of invalid values didn't throw DataFileException");
+}
+
+void SparseFileTest::checkCorrupt(const QByteArray& contents, const AString& name, const int64_t& row, const bool& failsOnOpen)
+{
+    const AString filename = m_tempDir + "/" + name + ".wbsparse";
+    QFile outFile(filename);
+    if (!outFile.open(QIODevice::WriteOnly) || outFile.write(contents) != contents.size())
+    {
+        setFailed("failed to write test file '" + filename + "'");
+        return;
+    }
+    outFile.close();
+    bool opened = false;
+    try
+    {
+        CaretSparseFile reader(filename);
+        opened = true;
+        vector<int64_t> rowIndices(1, row);
+        vector<vector<int64_t> > indices, values;
+        reader.getRowsSparse(rowIndices, indices, values);
+        setFailed(name + ": corrupt file was read without error");
+    } catch (DataFileException&) {
+        if (opened == failsOnOpen) setFailed(name + (failsOnOpen ? ": error wasn't found when opening the file" : ": error was found when opening the file, expected it when reading the row"));
+    }
+}
+
+namespace
+{
+    QByteArray readWhole(const AString& filename)
+    {
+        QFile inFile(filename);
+        if (!inFile.open(QIODevice::ReadOnly)) return QByteArray();
+        return inFile.readAll();
+    }
+    
+    void setInt64LE(QByteArray& contents, const int64_t& position, const int64_t& value)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            contents[(int)(position + i)] = (char)((((uint64_t)value) >> (8 * i)) & 255);
+        }
+    }
+}
+
+void SparseFileTest::testCorruptFiles()
+{
+    //row 0 has one nonzero of value 1, which encodes as 3 bytes: gap 0, high half 0, low half 1
+    //row 1 has 4 nonzeros, which encode as 12 bytes
+    vector<int64_t> indices1, values1(4, 1);
+    for (int i = 0; i < 4; ++i) indices1.push_back(i);
+    const AString compressedName = m_tempDir + "/corrupt_template_z.wbsparse", originalName = m_tempDir + "/corrupt_template.wbsparse";
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        CaretSparseFileWriter writer(pass == 0 ? compressedName : originalName, makeXML(), pass == 0);
+        writer.writeRowSparse(0, vector<int64_t>(1, 0), vector<int64_t>(1, 1));
+        writer.writeRowSparse(1, indices1, values1);
+    }
+    const QByteArray compressed = readWhole(compressedName), original = readWhole(originalName);
+    const int64_t offsetTableStart = 8 + 2 * sizeof(int64_t) + NUM_ROWS * sizeof(int64_t);
+    const int64_t compressedDataStart = offsetTableStart + NUM_ROWS * sizeof(int64_t);
+    const int64_t originalDataStart = offsetTableStart;
+    if (compressed.size() <= compressedDataStart + 15 || original.size() <= originalDataStart + 5 * 16)
+    {
+        setFailed("corrupt file templates are too short");
+        return;
+    }
+    {//sanity check that the unmodified templates read correctly
+        CaretSparseFile compressedReader(compressedName), originalReader(originalName);
+        vector<int64_t> indicesOut, valuesOut;
+        compressedReader.getRowSparse(1, indicesOut, valuesOut);
+        if (indicesOut != indices1 || valuesOut != values1) setFailed("compressed template doesn't read back correctly");
+        originalReader.getRowSparse(1, indicesOut, valuesOut);
+        if (indicesOut != indices1 || valuesOut != values1) setFailed("original template doesn't read back correctly");
+    }
+    QByteArray temp = compressed;
+    setInt64LE(temp, offsetTableStart + (NUM_ROWS - 1) * sizeof(int64_t), 0x7FFFFFFFFFFFFFF0LL);//would overflow the xml offset
+    checkCorrupt(temp, "huge_offset", 0, true);
+    temp = compressed;
+    setInt64LE(temp, offsetTableStart, -3);
+    checkCorrupt(temp, "negative_offset", 0, true);
+    temp = compressed;
+    temp[(int)(compressedDataStart + 2)] = (char)0x81;//continuation bit on the last byte of the row
+    checkCorrupt(temp, "truncated_varint", 0, false);
+    temp = compressed;
+    for (int i = 0; i < 10; ++i)
+    {//more than 64 bits of continuation bytes
+        temp[(int)(compressedDataStart + 3 + i)] = (char)0xFF;
+    }
+    checkCorrupt(temp, "overlong_varint", 1, false);
+    temp = compressed;
+    temp[(int)(compressedDataStart + 3)] = (char)0x80;//merge the first two gaps into one varint of 127 * 128, past the end of the row
+    temp[(int)(compressedDataStart + 4)] = (char)0x7F;
+    checkCorrupt(temp, "index_out_of_range", 1, false);
+    checkCorrupt(compressed.left(compressedDataStart + 8), "truncated_compressed", 0, true);
+    checkCorrupt(original.left(originalDataStart + 40), "truncated_original", 0, true);
+}
+
+void SparseFileTest::execute()
+{
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid())
+    {
+        setFailed("failed to create temporary directory");
+        return;
+    }
+    m_tempDir = tempDir.path();
+    srand(12345);
+    testBatchRoundTrip(false);
+    testBatchRoundTrip(true);
+    testBatchErrors(false);
+    testBatchErrors(true);
+    testCorruptFiles();
+    if (!failed()) cout << "sparse file tests successful" << endl;
+}
@@ -0,0 +1,309 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "TFCETest.h"
+
+#include "AlgorithmCiftiSeparate.h"
+#include "AlgorithmCiftiTFCE.h"
+#include "AlgorithmMetricTFCE.h"
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "AlgorithmVolumeTFCE.h"
+#include "CiftiBrainModelsMap.h"
+#include "CiftiFile.h"
+#include "CiftiScalarsMap.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+#include "TopologyHelper.h"
+#include "VolumeFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+TFCETest::TFCETest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int64_t NUM_MAPS = 5, VOL_DIM = 12;
+    
+    //smooth positive and negative blobs plus a little noise, so there are clusters of several sizes
+    float blobValue(const float& x, const float& y, const float& z, const int64_t& map)
+    {
+        return 3.0f * sin(x * 0.05f + map) * cos(y * 0.07f - 0.5f * map) + cos(z * 0.04f + 0.3f * map) + 0.2f * (rand() / (float)RAND_MAX - 0.5f);
+    }
+    
+    //the definition, without union-find: at each distinct data value, flood fill the elements at or above it, and add the slice of the
+    //integral from the previous value to this one to every element in each cluster
+    vector<double> bruteForceTFCE(const vector<float>& data, const vector<vector<int32_t> >& neighbors, const vector<float>& areas, const double& param_e, const double& param_h)
+    {
+        const int32_t numElements = (int32_t)data.size();
+        vector<double> ret(numElements, 0.0);
+        for (int sign = 1; sign >= -1; sign -= 2)
+        {
+            vector<float> thresholds;
+            for (int32_t i = 0; i < numElements; ++i)
+            {
+                if (sign * data[i] > 0.0f) thresholds.push_back(sign * data[i]);
+            }
+            sort(thresholds.begin(), thresholds.end());
+            thresholds.erase(unique(thresholds.begin(), thresholds.end()), thresholds.end());
+            double previous = 0.0;
+            for (int t = 0; t < (int)thresholds.size(); ++t)
+            {
+                const double thresh = thresholds[t];
+                const double slice = (pow(thresh, param_h + 1.0) - pow(previous, param_h + 1.0)) / (param_h + 1.0);
+                vector<int> visited(numElements, 0);
+                for (int32_t start = 0; start < numElements; ++start)
+                {
+                    if (visited[start] || sign * data[start] < thresh) continue;
+                    vector<int32_t> cluster(1, start), stack(1, start);
+                    visited[start] = 1;
+                    double area = 0.0;
+                    while (!stack.empty())
+                    {
+                        const int32_t elem = stack.back();
+                        stack.pop_back();
+                        area += areas[elem];
+                        for (int n = 0; n < (int)neighbors[elem].size(); ++n)
+                        {
+                            const int32_t neigh = neighbors[elem][n];
+                            if (visited[neigh] || sign * data[neigh] < thresh) continue;
+                            visited[neigh] = 1;
+                            cluster.push_back(neigh);
+                            stack.push_back(neigh);
+                        }
+                    }
+                    for (int i = 0; i < (int)cluster.size(); ++i)
+                    {
+                        ret[cluster[i]] += sign * pow(area, param_e) * slice;
+                    }
+                }
+                previous = thresh;
+            }
+        }
+        return ret;
+    }
+}
+
+void TFCETest::checkClose(const float* data, const float* expected, const int64_t& count, const AString& descrip)
+{
+    float maxAbs = 0.0f;
+    for (int64_t i = 0; i < count; ++i)
+    {
+        maxAbs = max(maxAbs, abs(expected[i]));
+    }
+    if (maxAbs == 0.0f)
+    {
+        setFailed(descrip + ": expected result is all zeros, test data is bad");
+        return;
+    }
+    for (int64_t i = 0; i < count; ++i)
+    {
+        if (abs(data[i] - expected[i]) > 1e-4f * maxAbs)
+        {
+            setFailed(descrip + ": mismatch at element " + AString::number(i) + ", got " + AString::number(data[i]) + ", expected " + AString::number(expected[i]));
+            return;
+        }
+    }
+}
+
+void TFCETest::checkClose(const float* data, const vector<double>& expected, const AString& descrip)
+{
+    vector<float> expectedFloat(expected.begin(), expected.end());
+    checkClose(data, expectedFloat.data(), (int64_t)expected.size(), descrip);
+}
+
+void TFCETest::testBruteForce()
+{
+    //small volume with anisotropic voxels, all voxels used
+    const int64_t volDims[3] = { 6, 5, 4 };
+    vector<int64_t> dims(volDims, volDims + 3);
+    vector<vector<float> > sform(3, vector<float>(4, 0.0f));
+    sform[0][0] = 1.5f;
+    sform[1][1] = 2.0f;
+    sform[2][2] = 1.0f;
+    VolumeFile inVol(dims, sform);
+    const int64_t frameSize = volDims[0] * volDims[1] * volDims[2];
+    vector<float> volData(frameSize);
+    vector<vector<int32_t> > volNeighbors(frameSize);
+    for (int64_t k = 0; k < volDims[2]; ++k)
+    {
+        for (int64_t j = 0; j < volDims[1]; ++j)
+        {
+            for (int64_t i = 0; i < volDims[0]; ++i)
+            {
+                const int64_t index = inVol.getIndex(i, j, k);
+                float value = 0.0f;
+                if (rand() % 6 != 0) value = sin(i * 0.9f) + cos(j * 0.7f + k * 0.5f) + (rand() / (float)RAND_MAX - 0.5f);
+                inVol.setValue(value, i, j, k);
+                volData[index] = value;
+                if (i > 0) volNeighbors[index].push_back(inVol.getIndex(i - 1, j, k));
+                if (i < volDims[0] - 1) volNeighbors[index].push_back(inVol.getIndex(i + 1, j, k));
+                if (j > 0) volNeighbors[index].push_back(inVol.getIndex(i, j - 1, k));
+                if (j < volDims[1] - 1) volNeighbors[index].push_back(inVol.getIndex(i, j + 1, k));
+                if (k > 0) volNeighbors[index].push_back(inVol.getIndex(i, j, k - 1));
+                if (k < volDims[2] - 1) volNeighbors[index].push_back(inVol.getIndex(i, j, k + 1));
+            }
+        }
+    }
+    VolumeFile outVol;
+    AlgorithmVolumeTFCE(NULL, &inVol, &outVol);
+    checkClose(outVol.getFrame(), bruteForceTFCE(volData, volNeighbors, vector<float>(frameSize, 1.5f * 2.0f * 1.0f), 0.5, 2.0), "volume against brute force");
+    if (failed()) return;
+    //small sphere, vertex areas from the surface
+    SurfaceFile mySurf;
+    AlgorithmSurfaceCreateSphere(NULL, 162, &mySurf);
+    const int32_t numNodes = mySurf.getNumberOfNodes();
+    MetricFile inMetric, outMetric;
+    inMetric.setNumberOfNodesAndColumns(numNodes, 1);
+    vector<float> surfData(numNodes), surfAreas;
+    vector<vector<int32_t> > surfNeighbors(numNodes);
+    CaretPointer<TopologyHelper> myTopoHelp = mySurf.getTopologyHelper();
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        const float* coord = mySurf.getCoordinate(i);
+        surfData[i] = blobValue(coord[0] * 3.0f, coord[1] * 3.0f, coord[2] * 3.0f, 0);
+        inMetric.setValue(i, 0, surfData[i]);
+        surfNeighbors[i] = myTopoHelp->getNodeNeighbors(i);
+    }
+    mySurf.computeNodeAreas(surfAreas);
+    AlgorithmMetricTFCE(NULL, &mySurf, &inMetric, &outMetric);
+    checkClose(outMetric.getValuePointerForColumn(0), bruteForceTFCE(surfData, surfNeighbors, surfAreas, 1.0, 2.0), "surface against brute force");
+}
+
+void TFCETest::execute()
+{
+    testBruteForce();//the cifti comparisons below all use the same TFCE code, so first check that against the definition
+    if (failed()) return;
+    SurfaceFile mySurf;
+    AlgorithmSurfaceCreateSphere(NULL, 2562, &mySurf);
+    const int64_t numNodes = mySurf.getNumberOfNodes();
+    const float sform[12] = { 2.0f, 0.0f, 0.0f, -12.0f,
+                              0.0f, 2.0f, 0.0f, -12.0f,
+                              0.0f, 0.0f, 2.0f, -12.0f };
+    const int64_t volDims[3] = { VOL_DIM, VOL_DIM, VOL_DIM };
+    vector<int64_t> ijkList;
+    for (int64_t k = 2; k < VOL_DIM - 2; ++k)//leave a border, so the separated volume has voxels outside the structure
+    {
+        for (int64_t j = 1; j < VOL_DIM - 1; ++j)
+        {
+            for (int64_t i = 2; i < VOL_DIM - 1; ++i)
+            {
+                ijkList.push_back(i);
+                ijkList.push_back(j);
+                ijkList.push_back(k);
+            }
+        }
+    }
+    CiftiBrainModelsMap myDenseMap;
+    myDenseMap.setVolumeSpace(VolumeSpace(volDims, sform));
+    myDenseMap.addSurfaceModel(numNodes, StructureEnum::CORTEX_LEFT);
+    myDenseMap.addVolumeModel(StructureEnum::THALAMUS_LEFT, ijkList);
+    const int64_t mapLength = myDenseMap.getLength();
+    CiftiXML columnXML, rowXML;
+    columnXML.setNumberOfDimensions(2);
+    columnXML.setMap(CiftiXML::ALONG_COLUMN, myDenseMap);
+    columnXML.setMap(CiftiXML::ALONG_ROW, CiftiScalarsMap(NUM_MAPS));
+    rowXML.setNumberOfDimensions(2);
+    rowXML.setMap(CiftiXML::ALONG_ROW, myDenseMap);
+    rowXML.setMap(CiftiXML::ALONG_COLUMN, CiftiScalarsMap(NUM_MAPS));
+    vector<float> maps(NUM_MAPS * mapLength);
+    vector<CiftiBrainModelsMap::SurfaceMap> surfMap = myDenseMap.getSurfaceMap(StructureEnum::CORTEX_LEFT);
+    vector<CiftiBrainModelsMap::VolumeMap> volMap = myDenseMap.getVolumeStructureMap(StructureEnum::THALAMUS_LEFT);
+    for (int64_t map = 0; map < NUM_MAPS; ++map)
+    {
+        for (int64_t i = 0; i < (int64_t)surfMap.size(); ++i)
+        {
+            const float* coord = mySurf.getCoordinate(surfMap[i].m_surfaceNode);
+            maps[map * mapLength + surfMap[i].m_ciftiIndex] = blobValue(coord[0], coord[1], coord[2], map);
+        }
+        for (int64_t i = 0; i < (int64_t)volMap.size(); ++i)
+        {
+            const int64_t* ijk = volMap[i].m_ijk;
+            maps[map * mapLength + volMap[i].m_ciftiIndex] = blobValue(ijk[0] * 25.0f, ijk[1] * 25.0f, ijk[2] * 25.0f, map);
+        }
+    }
+    CiftiFile columnCifti, rowCifti;//both in memory
+    columnCifti.setCiftiXML(columnXML);
+    rowCifti.setCiftiXML(rowXML);
+    vector<float> scratchRow(NUM_MAPS);
+    for (int64_t row = 0; row < mapLength; ++row)
+    {
+        for (int64_t map = 0; map < NUM_MAPS; ++map)
+        {
+            scratchRow[map] = maps[map * mapLength + row];
+        }
+        columnCifti.setRow(scratchRow.data(), row);
+    }
+    for (int64_t map = 0; map < NUM_MAPS; ++map)
+    {
+        rowCifti.setRow(maps.data() + map * mapLength, map);
+    }
+    //expected results, from the separated structures
+    MetricFile sepMetric, tfceMetric;
+    AlgorithmCiftiSeparate(NULL, &columnCifti, CiftiXML::ALONG_COLUMN, StructureEnum::CORTEX_LEFT, &sepMetric);
+    AlgorithmMetricTFCE(NULL, &mySurf, &sepMetric, &tfceMetric);
+    VolumeFile sepVol, tfceVol;
+    int64_t volOffset[3];
+    AlgorithmCiftiSeparate(NULL, &columnCifti, CiftiXML::ALONG_COLUMN, StructureEnum::THALAMUS_LEFT, &sepVol, volOffset, NULL, false);
+    AlgorithmVolumeTFCE(NULL, &sepVol, &tfceVol);
+    vector<float> expected(NUM_MAPS * mapLength);
+    for (int64_t map = 0; map < NUM_MAPS; ++map)
+    {
+        for (int64_t i = 0; i < (int64_t)surfMap.size(); ++i)
+        {
+            expected[map * mapLength + surfMap[i].m_ciftiIndex] = tfceMetric.getValue(surfMap[i].m_surfaceNode, map);
+        }
+        for (int64_t i = 0; i < (int64_t)volMap.size(); ++i)
+        {
+            expected[map * mapLength + volMap[i].m_ciftiIndex] = tfceVol.getValue(volMap[i].m_ijk, map);
+        }
+    }
+    //a tiny memory limit makes the column direction use one map per block
+    const float memLimits[2] = { -1.0f, 0.0f };
+    for (int whichLimit = 0; whichLimit < 2; ++whichLimit)
+    {
+        const AString descrip = AString("column direction") + (memLimits[whichLimit] < 0.0f ? "" : " with memory limit");
+        CiftiFile columnOut;
+        AlgorithmCiftiTFCE(NULL, &columnCifti, CiftiXML::ALONG_COLUMN, &columnOut, 0.0f, 0.0f, &mySurf, NULL, NULL, NULL, NULL, NULL,
+                           NULL, false, 1.0f, 2.0f, 0.5f, 2.0f, memLimits[whichLimit]);
+        vector<float> column(mapLength);
+        for (int64_t map = 0; map < NUM_MAPS; ++map)
+        {
+            columnOut.getColumn(column.data(), map);
+            checkClose(column.data(), expected.data() + map * mapLength, mapLength, descrip + ", map " + AString::number(map));
+            if (failed()) return;
+        }
+    }
+    CiftiFile rowOut;
+    AlgorithmCiftiTFCE(NULL, &rowCifti, CiftiXML::ALONG_ROW, &rowOut, 0.0f, 0.0f, &mySurf);
+    vector<float> row(mapLength);
+    for (int64_t map = 0; map < NUM_MAPS; ++map)
+    {
+        rowOut.getRow(row.data(), map);
+        checkClose(row.data(), expected.data() + map * mapLength, mapLength, "row direction, map " + AString::number(map));
+        if (failed()) return;
+    }
+}
@@ -0,0 +1,43 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#ifndef __TFCE_TEST_H__
+#define __TFCE_TEST_H__
+
+#include "TestInterface.h"
+
+#include <vector>
+
+namespace caret {
+
+    class CiftiFile;
+    
+    //checks -metric-tfce and -volume-tfce against a brute force TFCE on small data, and that -cifti-tfce gives the same answers as they do on the separated structures
+    class TFCETest : public TestInterface
+    {
+        void checkClose(const float* data, const float* expected, const int64_t& count, const AString& descrip);
+        void checkClose(const float* data, const std::vector<double>& expected, const AString& descrip);
+        void testBruteForce();
+    public:
+        TFCETest(const AString& identifier);
+        virtual void execute();
+    };
+
+}
+#endif //__TFCE_TEST_H__
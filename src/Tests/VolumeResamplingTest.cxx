@@ -0,0 +1,214 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "VolumeResamplingTest.h"
+
+#include "FloatMatrix.h"
+#include "Vector3D.h"
+#include "VolumeResamplingHelper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+VolumeResamplingTest::VolumeResamplingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int64_t NUM_FRAMES = 2;
+    const int64_t IN_DIMS[3] = { 14, 12, 10 };
+    const float IN_SFORM[3][4] = { { 2.0f, 0.3f, 0.0f, -14.0f },
+                                   { 0.0f, 2.0f, 0.2f, -12.0f },
+                                   { 0.0f, 0.0f, 2.5f, -10.0f } };
+    //different spacing and a larger extent, so some output voxels fall outside the input
+    const int64_t OUT_DIMS[3] = { 16, 15, 12 };
+    const float OUT_SFORM[3][4] = { { 1.8f, 0.0f, 0.0f, -16.0f },
+                                    { 0.0f, 1.8f, 0.0f, -15.0f },
+                                    { 0.0f, 0.0f, 2.2f, -12.0f } };
+    //the warpfield covers less than the output space, so the edge voxels have no displacement
+    const int64_t WARP_DIMS[3] = { 14, 13, 10 };
+
+    vector<vector<float> > toSform(const float sformIn[3][4])
+    {
+        vector<vector<float> > ret(3, vector<float>(4));
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                ret[i][j] = sformIn[i][j];
+            }
+        }
+        return ret;
+    }
+
+    AString methodName(const VolumeFile::InterpType& method)
+    {
+        switch (method)
+        {
+            case VolumeFile::ENCLOSING_VOXEL:
+                return "ENCLOSING_VOXEL";
+            case VolumeFile::TRILINEAR:
+                return "TRILINEAR";
+            case VolumeFile::CUBIC:
+                return "CUBIC";
+        }
+        return "unknown";
+    }
+
+    FloatMatrix testAffine()
+    {//small rotation around z and x, plus a translation
+        const float angleZ = 0.2f, angleX = -0.1f;
+        FloatMatrix rotZ = FloatMatrix::identity(4), rotX = FloatMatrix::identity(4);
+        rotZ[0][0] = cos(angleZ); rotZ[0][1] = -sin(angleZ);
+        rotZ[1][0] = sin(angleZ); rotZ[1][1] = cos(angleZ);
+        rotX[1][1] = cos(angleX); rotX[1][2] = -sin(angleX);
+        rotX[2][1] = sin(angleX); rotX[2][2] = cos(angleX);
+        FloatMatrix ret = rotZ * rotX;
+        ret[0][3] = 1.5f;
+        ret[1][3] = -0.7f;
+        ret[2][3] = 0.4f;
+        return ret;
+    }
+}
+
+void VolumeResamplingTest::testMethod(const VolumeFile& inVol, const VolumeFile& warpfield, const VolumeSpace& outSpace, const VolumeFile::InterpType& method, const bool& useWarpfield)
+{
+    const AString descrip = methodName(method) + (useWarpfield ? " with warpfield" : " with affine");
+    vector<int64_t> outDims(OUT_DIMS, OUT_DIMS + 3);
+    outDims.push_back(NUM_FRAMES);
+    VolumeFile outVol(outDims, toSform(OUT_SFORM));
+    const FloatMatrix affine = testAffine();
+    if (useWarpfield)
+    {
+        VolumeResamplingHelper(inVol.getVolumeSpace(), &warpfield, outSpace, method).resample(&inVol, &outVol);
+    } else {
+        VolumeResamplingHelper(inVol.getVolumeSpace(), affine, outSpace, method).resample(&inVol, &outVol);
+    }
+    //reference: the same coordinate math as the algorithms used before the helper, one interpolateValue call per voxel
+    Vector3D xvec(affine[0][0], affine[1][0], affine[2][0]), yvec(affine[0][1], affine[1][1], affine[2][1]),
+             zvec(affine[0][2], affine[1][2], affine[2][2]), offset(affine[0][3], affine[1][3], affine[2][3]);
+    int64_t numValid = 0, numInvalid = 0;
+    for (int64_t f = 0; f < NUM_FRAMES; ++f)
+    {
+        double maxDiff = 0.0, maxAbs = 0.0;
+        for (int64_t k = 0; k < OUT_DIMS[2]; ++k)
+        {
+            for (int64_t j = 0; j < OUT_DIMS[1]; ++j)
+            {
+                for (int64_t i = 0; i < OUT_DIMS[0]; ++i)
+                {
+                    Vector3D outCoord, inCoord;
+                    outSpace.indexToSpace(i, j, k, outCoord);
+                    bool valid = true;
+                    if (useWarpfield)
+                    {
+                        Vector3D displacement;
+                        displacement[0] = warpfield.interpolateValue(outCoord, VolumeFile::TRILINEAR, &valid, 0);
+                        displacement[1] = warpfield.interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 1);
+                        displacement[2] = warpfield.interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 2);
+                        inCoord = outCoord + displacement;
+                    } else {
+                        inCoord = xvec * outCoord[0] + yvec * outCoord[1] + zvec * outCoord[2] + offset;
+                    }
+                    float expected = VolumeFile::INVALID_INTERP_VALUE;
+                    if (valid)
+                    {
+                        expected = inVol.interpolateValue(inCoord, method, &valid, f);
+                        if (!valid) expected = VolumeFile::INVALID_INTERP_VALUE;
+                    }
+                    const float actual = outVol.getValue(i, j, k, f);
+                    if (!valid)
+                    {
+                        ++numInvalid;
+                        if (actual != expected)
+                        {
+                            setFailed(descrip + ": voxel " + AString::number(i) + ", " + AString::number(j) + ", " + AString::number(k) +
+                                      " should be invalid, got " + AString::number(actual));
+                            return;
+                        }
+                        continue;
+                    }
+                    ++numValid;
+                    maxDiff = max(maxDiff, (double)abs(actual - expected));
+                    maxAbs = max(maxAbs, (double)abs(expected));
+                }
+            }
+        }
+        //ENCLOSING_VOXEL copies values, the others only differ by the order of the float operations
+        const double tolerance = (method == VolumeFile::ENCLOSING_VOXEL ? 0.0 : 1e-5 * max(1.0, maxAbs));
+        if (maxDiff > tolerance)
+        {
+            setFailed(descrip + ": frame " + AString::number(f) + " differs from interpolateValue by " + AString::number(maxDiff));
+        }
+    }
+    if (numValid == 0 || numInvalid == 0)
+    {
+        setFailed(descrip + ": test geometry should give both valid and invalid voxels, got " + AString::number(numValid) + " valid and " +
+                  AString::number(numInvalid) + " invalid");
+    }
+}
+
+void VolumeResamplingTest::execute()
+{
+    vector<int64_t> inDims(IN_DIMS, IN_DIMS + 3);
+    inDims.push_back(NUM_FRAMES);
+    VolumeFile inVol(inDims, toSform(IN_SFORM));
+    for (int64_t f = 0; f < NUM_FRAMES; ++f)
+    {
+        for (int64_t k = 0; k < IN_DIMS[2]; ++k)
+        {
+            for (int64_t j = 0; j < IN_DIMS[1]; ++j)
+            {
+                for (int64_t i = 0; i < IN_DIMS[0]; ++i)
+                {
+                    inVol.setValue(sin(i * 0.5f + f) + cos(j * 0.4f - k * 0.3f) + rand() / (float)RAND_MAX, i, j, k, f);
+                }
+            }
+        }
+    }
+    vector<int64_t> warpDims(WARP_DIMS, WARP_DIMS + 3);
+    warpDims.push_back(3);
+    VolumeFile warpfield(warpDims, toSform(OUT_SFORM));
+    for (int64_t k = 0; k < WARP_DIMS[2]; ++k)
+    {
+        for (int64_t j = 0; j < WARP_DIMS[1]; ++j)
+        {
+            for (int64_t i = 0; i < WARP_DIMS[0]; ++i)
+            {//smooth displacements of a few mm
+                warpfield.setValue(2.0f * sin(j * 0.3f) + 1.0f, i, j, k, 0);
+                warpfield.setValue(1.5f * cos(k * 0.4f + i * 0.2f), i, j, k, 1);
+                warpfield.setValue(-1.0f + 0.1f * i, i, j, k, 2);
+            }
+        }
+    }
+    VolumeSpace outSpace(OUT_DIMS, toSform(OUT_SFORM));
+    const VolumeFile::InterpType methods[3] = { VolumeFile::ENCLOSING_VOXEL, VolumeFile::TRILINEAR, VolumeFile::CUBIC };
+    for (int m = 0; m < 3; ++m)
+    {
+        testMethod(inVol, warpfield, outSpace, methods[m], false);
+        testMethod(inVol, warpfield, outSpace, methods[m], true);
+    }
+}
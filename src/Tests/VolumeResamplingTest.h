@@ -0,0 +1,39 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#ifndef __VOLUME_RESAMPLING_TEST_H__
+#define __VOLUME_RESAMPLING_TEST_H__
+
+#include "TestInterface.h"
+
+#include "VolumeFile.h"
+
+namespace caret {
+
+    //checks VolumeResamplingHelper against VolumeFile::interpolateValue for each method, with both an affine and a warpfield
+    class VolumeResamplingTest : public TestInterface
+    {
+        void testMethod(const VolumeFile& inVol, const VolumeFile& warpfield, const VolumeSpace& outSpace, const VolumeFile::InterpType& method, const bool& useWarpfield);
+    public:
+        VolumeResamplingTest(const AString& identifier);
+        virtual void execute();
+    };
+
+}
+#endif //__VOLUME_RESAMPLING_TEST_H__
@@ -0,0 +1,161 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#include "VolumeSmoothingTest.h"
+
+#include "AlgorithmVolumeSmoothing.h"
+#include "Vector3D.h"
+#include "VolumeFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+VolumeSmoothingTest::VolumeSmoothingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+namespace
+{
+    const int64_t NUM_FRAMES = 3;
+    const int64_t SHEARED_DIMS[3] = { 20, 18, 16 };
+    const float SHEARED_SFORM[3][4] = { { 1.5f, 0.5f, 0.0f, -10.0f },
+                                        { 0.0f, 1.5f, 0.3f, -10.0f },
+                                        { 0.0f, 0.0f, 1.5f, -10.0f } };
+    //very thin slices make the kernel long along k, which is the only way the separable kernel gets big enough for FFT to win on a small volume
+    const int64_t THIN_DIMS[3] = { 12, 12, 64 };
+    const float THIN_SFORM[3][4] = { { 2.0f, 0.0f, 0.0f, -10.0f },
+                                     { 0.0f, 2.0f, 0.0f, -10.0f },
+                                     { 0.0f, 0.0f, 0.125f, -4.0f } };
+}
+
+void VolumeSmoothingTest::testKernel(const int64_t volDims[3], const float volSform[3][4], const float& kernel, const bool& fixZeros)
+{
+    const AString descrip = "kernel " + AString::number(kernel) + " on " + AString::number(volDims[0]) + "x" + AString::number(volDims[1]) + "x" + AString::number(volDims[2]) +
+                            (fixZeros ? " with -fix-zeros" : "");
+    vector<int64_t> dims(volDims, volDims + 3);
+    dims.push_back(NUM_FRAMES);
+    vector<vector<float> > sform(3, vector<float>(4));
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            sform[i][j] = volSform[i][j];
+        }
+    }
+    VolumeFile inVol(dims, sform);
+    for (int64_t f = 0; f < NUM_FRAMES; ++f)
+    {
+        for (int64_t k = 0; k < volDims[2]; ++k)
+        {
+            for (int64_t j = 0; j < volDims[1]; ++j)
+            {
+                for (int64_t i = 0; i < volDims[0]; ++i)
+                {
+                    float value = 0.0f;
+                    if (rand() % 5 != 0) value = sin(i * 0.4f + f) + cos(j * 0.3f - k * 0.2f) + rand() / (float)RAND_MAX;//some zeros, for -fix-zeros
+                    inVol.setValue(value, i, j, k, f);
+                }
+            }
+        }
+    }
+    VolumeFile outVol;
+    AlgorithmVolumeSmoothing(NULL, &inVol, kernel, &outVol, NULL, fixZeros);
+    //brute force, with the same kernel box and cutoff as the algorithm
+    Vector3D ivec(volSform[0][0], volSform[1][0], volSform[2][0]), jvec(volSform[0][1], volSform[1][1], volSform[2][1]), kvec(volSform[0][2], volSform[1][2], volSform[2][2]);
+    const float kernBox = kernel * 3.0f;
+    const bool orthogonal = (ivec.dot(jvec) == 0.0f && jvec.dot(kvec) == 0.0f && kvec.dot(ivec) == 0.0f);
+    int irange, jrange, krange;
+    if (orthogonal)
+    {//separable kernel, which covers the whole box, rather than cutting it off at kernBox distance
+        irange = max(1, (int)floor(kernBox / ivec.length()));
+        jrange = max(1, (int)floor(kernBox / jvec.length()));
+        krange = max(1, (int)floor(kernBox / kvec.length()));
+    } else {
+        irange = max(1, (int)floor(abs(kernBox / ivec.dot(jvec.cross(kvec).normal()))));
+        jrange = max(1, (int)floor(abs(kernBox / jvec.dot(kvec.cross(ivec).normal()))));
+        krange = max(1, (int)floor(abs(kernBox / kvec.dot(ivec.cross(jvec).normal()))));
+    }
+    for (int64_t f = 0; f < NUM_FRAMES; ++f)
+    {
+        vector<double> expected(volDims[0] * volDims[1] * volDims[2]);
+        double maxAbs = 0.0;
+        for (int64_t k = 0; k < volDims[2]; ++k)
+        {
+            for (int64_t j = 0; j < volDims[1]; ++j)
+            {
+                for (int64_t i = 0; i < volDims[0]; ++i)
+                {
+                    double sum = 0.0, weightSum = 0.0;
+                    for (int64_t kk = max((int64_t)0, k - krange); kk <= min(volDims[2] - 1, k + krange); ++kk)
+                    {
+                        for (int64_t jj = max((int64_t)0, j - jrange); jj <= min(volDims[1] - 1, j + jrange); ++jj)
+                        {
+                            for (int64_t ii = max((int64_t)0, i - irange); ii <= min(volDims[0] - 1, i + irange); ++ii)
+                            {
+                                const float dist = (ivec * (ii - i) + jvec * (jj - j) + kvec * (kk - k)).length();
+                                const float value = inVol.getValue(ii, jj, kk, f);
+                                if ((!orthogonal && dist > kernBox) || (fixZeros && value == 0.0f)) continue;
+                                const double weight = exp(-dist * dist / kernel / kernel / 2.0f);
+                                sum += weight * value;
+                                weightSum += weight;
+                            }
+                        }
+                    }
+                    const double result = (weightSum != 0.0 ? sum / weightSum : 0.0);
+                    expected[inVol.getIndex(i, j, k)] = result;
+                    maxAbs = max(maxAbs, abs(result));
+                }
+            }
+        }
+        const float* outFrame = outVol.getFrame(f);
+        for (int64_t i = 0; i < (int64_t)expected.size(); ++i)
+        {
+            if (abs(outFrame[i] - expected[i]) > 1e-4 * maxAbs)
+            {
+                setFailed(descrip + ": frame " + AString::number(f) + ", voxel " + AString::number(i) + " is " + AString::number(outFrame[i]) +
+                          ", expected " + AString::number(expected[i]));
+                return;
+            }
+        }
+    }
+}
+
+void VolumeSmoothingTest::execute()
+{
+    testKernel(SHEARED_DIMS, SHEARED_SFORM, 0.7f, false);//small kernels use direct smoothing
+    if (failed()) return;
+    testKernel(SHEARED_DIMS, SHEARED_SFORM, 0.7f, true);
+    if (failed()) return;
+    testKernel(SHEARED_DIMS, SHEARED_SFORM, 3.0f, false);//large kernels on a non-orthogonal volume use FFT convolution
+    if (failed()) return;
+    testKernel(SHEARED_DIMS, SHEARED_SFORM, 3.0f, true);
+    if (failed()) return;
+    testKernel(THIN_DIMS, THIN_SFORM, 0.3f, false);//orthogonal volumes use three 1D smoothings
+    if (failed()) return;
+    testKernel(THIN_DIMS, THIN_SFORM, 0.3f, true);
+    if (failed()) return;
+    testKernel(THIN_DIMS, THIN_SFORM, 2.5f, false);//unless the separable kernel is large enough for FFT convolution
+    if (failed()) return;
+    testKernel(THIN_DIMS, THIN_SFORM, 2.5f, true);
+}
@@ -0,0 +1,37 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+#ifndef __VOLUME_SMOOTHING_TEST_H__
+#define __VOLUME_SMOOTHING_TEST_H__
+
+#include "TestInterface.h"
+
+namespace caret {
+
+    //checks -volume-smoothing on non-orthogonal and orthogonal volumes against brute force, with kernels that use both the direct and FFT methods
+    class VolumeSmoothingTest : public TestInterface
+    {
+        void testKernel(const int64_t volDims[3], const float volSform[3][4], const float& kernel, const bool& fixZeros);
+    public:
+        VolumeSmoothingTest(const AString& identifier);
+        virtual void execute();
+    };
+
+}
+#endif //__VOLUME_SMOOTHING_TEST_H__
@@ -33,21 +33,32 @@
 #include "CaretException.h"
 
 //tests
+#include "BatchTest.h"
 #include "CiftiFileTest.h"
 #include "DotTest.h"
+#include "GeodesicAllPairsTest.h"
 #include "GeodesicHelperTest.h"
+#include "GiftiDecodeTest.h"
 #include "HttpTest.h"
 #include "HeapTest.h"
 #include "LookupTest.h"
 #include "MathExpressionTest.h"
+#include "NiftiConvertTest.h"
 #include "NiftiTest.h"
 #include "PointerTest.h"
+#include "PointLocatorTest.h"
 #include "ProgressTest.h"
 #include "QuatTest.h"
+#include "ResampleMatrixTest.h"
+#include "RibbonMappingTest.h"
+#include "SparseFileTest.h"
 #include "StatisticsTest.h"
+#include "TFCETest.h"
 #include "TimerTest.h"
 #include "TopologyHelperTest.h"
 #include "VolumeFileTest.h"
+#include "VolumeResamplingTest.h"
+#include "VolumeSmoothingTest.h"
 #include "XnatTest.h"
 
 using namespace std;
@@ -69,22 +80,34 @@ int main(int argc, char** argv)
         caret_global_commandLine_init(argc, argv);
         SessionManager::createSessionManager(ApplicationTypeEnum::APPLICATION_TYPE_COMMAND_LINE);
         vector<TestInterface*> mytests;
+        mytests.push_back(new BatchTest("batch"));
         mytests.push_back(new CiftiFileTest("ciftifile"));
+        mytests.push_back(new CiftiTiledTest("ciftitiled"));
         mytests.push_back(new DotTest("dotsimd"));
+        mytests.push_back(new GeodesicAllPairsTest("geoallpairs"));
         mytests.push_back(new GeodesicHelperTest("geohelp"));
+        mytests.push_back(new GiftiDecodeTest("giftidecode"));
         mytests.push_back(new HeapTest("heap"));
         mytests.push_back(new HttpTest("http"));
         mytests.push_back(new LookupTest("lookup"));
         mytests.push_back(new MathExpressionTest("mathexpression"));
+        mytests.push_back(new NiftiConvertTest("niftisimd"));
         mytests.push_back(new NiftiFileTest("niftifile"));
         mytests.push_back(new NiftiHeaderTest("niftiheader"));
         mytests.push_back(new PointerTest("pointer"));
+        mytests.push_back(new PointLocatorTest("pointlocator"));
         mytests.push_back(new ProgressTest("progress"));
         mytests.push_back(new QuatTest("quaternion"));
+        mytests.push_back(new ResampleMatrixTest("resamplematrix"));
+        mytests.push_back(new RibbonMappingTest("ribbonmapping"));
+        mytests.push_back(new SparseFileTest("sparsefile"));
         mytests.push_back(new StatisticsTest("statistics"));
+        mytests.push_back(new TFCETest("tfce"));
         mytests.push_back(new TimerTest("timer"));
         mytests.push_back(new TopologyHelperTest("topohelp"));
         mytests.push_back(new VolumeFileTest("volumefile"));
+        mytests.push_back(new VolumeResamplingTest("volumeresampling"));
+        mytests.push_back(new VolumeSmoothingTest("volumesmoothing"));
         mytests.push_back(new XnatTest("xnat"));
         if (argc < 2)
         {
@@ -14,6 +14,8 @@
 extern float  sdot  (const float  *a, const float  *b, int n);
 extern double ddot  (const double *a, const double *b, int n);
 extern double dsdot (const float  *a, const float  *b, int n);
+extern void   dsdot4(const float  *a, const float *const *b, int n,
+                     double *res);
 
 /*----------------------------------------------------------------------------
   Global Variables
@@ -21,6 +23,7 @@ extern double dsdot (const float  *a, const float  *b, int n);
 sdot_func  *sdot_ptr  = &sdot_select;
 ddot_func  *ddot_ptr  = &ddot_select;
 dsdot_func *dsdot_ptr = &dsdot_select;
+dsdot4_func *dsdot4_ptr = &dsdot4_select;
 
 /*----------------------------------------------------------------------------
   Functions
@@ -41,6 +44,16 @@ double dsdot_select (const float *a, const float *b, int n) {
   return (*dsdot_ptr)(a,b,n);
 }
 
+/*--------------------------------------------------------------------------*/
+
+void dsdot4_select (const float *a, const float *const *b, int n,
+                    double *res) {
+  dot_set_impl(DOT_AUTO);
+  (*dsdot4_ptr)(a,b,n,res);
+}
+
+/*--------------------------------------------------------------------------*/
+
 dot_flags dot_set_impl (dot_flags impl) {
 
   #ifndef ARCH_IS_X86_64
@@ -56,6 +69,7 @@ dot_flags dot_set_impl (dot_flags impl) {
         sdot_ptr  = &sdot_avx512fma;
         ddot_ptr  = &ddot_avx512fma;
         dsdot_ptr = &dsdot_avx512fma;
+        dsdot4_ptr = &dsdot4_avx512fma;
         return DOT_AVX512FMA;
       }
      #endif
@@ -64,6 +78,7 @@ dot_flags dot_set_impl (dot_flags impl) {
         sdot_ptr  = &sdot_avx512;
         ddot_ptr  = &ddot_avx512;
         dsdot_ptr = &dsdot_avx512;
+        dsdot4_ptr = &dsdot4_avx512;
         return DOT_AVX512;
       }
     #endif
@@ -75,6 +90,7 @@ dot_flags dot_set_impl (dot_flags impl) {
         sdot_ptr  = &sdot_avxfma;
         ddot_ptr  = &ddot_avxfma;
         dsdot_ptr = &dsdot_avxfma;
+        dsdot4_ptr = &dsdot4_avxfma;
         return DOT_AVXFMA;
       }
     #endif
@@ -83,6 +99,7 @@ dot_flags dot_set_impl (dot_flags impl) {
         sdot_ptr  = &sdot_avx;
         ddot_ptr  = &ddot_avx;
         dsdot_ptr = &dsdot_avx;
+        dsdot4_ptr = &dsdot4_avx;
         return DOT_AVX;
       }
     case DOT_SSE2 :
@@ -90,12 +107,14 @@ dot_flags dot_set_impl (dot_flags impl) {
         sdot_ptr  = &sdot_sse2;
         ddot_ptr  = &ddot_sse2;
         dsdot_ptr = &dsdot_sse2;
+        dsdot4_ptr = &dsdot4_sse2;
         return DOT_SSE2;
       }
     case DOT_NAIVE :
       sdot_ptr  = &sdot_naive;
       ddot_ptr  = &ddot_naive;
       dsdot_ptr = &dsdot_naive;
+      dsdot4_ptr = &dsdot4_naive;
       return DOT_NAIVE;
     default :
       return dot_set_impl(DOT_AUTO);
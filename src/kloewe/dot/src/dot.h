@@ -43,6 +43,8 @@ typedef enum {
 typedef float  (sdot_func)    (const float  *a, const float  *b, int n);
 typedef double (ddot_func)    (const double *a, const double *b, int n);
 typedef double (dsdot_func)   (const float  *a, const float  *b, int n);
+typedef void   (dsdot4_func)  (const float  *a, const float *const *b, int n,
+                               double *res);
 
 /*----------------------------------------------------------------------------
   Global Variables
@@ -50,6 +52,7 @@ typedef double (dsdot_func)   (const float  *a, const float  *b, int n);
 extern sdot_func  *sdot_ptr;
 extern ddot_func  *ddot_ptr;
 extern dsdot_func *dsdot_ptr;
+extern dsdot4_func *dsdot4_ptr;
 
 /*----------------------------------------------------------------------------
   Function Prototypes
@@ -57,6 +60,17 @@ extern dsdot_func *dsdot_ptr;
 inline float  sdot            (const float  *a, const float  *b, int n);
 inline double ddot            (const double *a, const double *b, int n);
 inline double dsdot           (const float  *a, const float  *b, int n);
+inline void   dsdot4          (const float  *a, const float *const *b, int n,
+                               double *res);
+
+/* dsdot4
+ * ------
+ * compute the 4 dot products of a with b[0] .. b[3] (all of length n)
+ * and store them in res[0] .. res[3]
+ *
+ * Each element of a is loaded only once for all 4 products, which makes
+ * this the inner kernel of blocked matrix-matrix products.
+ */
 
 /* dot_set_impl
  * ------------
@@ -85,33 +99,47 @@ extern dot_flags dot_set_impl (dot_flags impl);
 extern float  sdot_select     (const float  *a, const float  *b, int n);
 extern double ddot_select     (const double *a, const double *b, int n);
 extern double dsdot_select    (const float  *a, const float  *b, int n);
+extern void   dsdot4_select   (const float  *a, const float *const *b, int n,
+                               double *res);
 
 extern float  sdot_naive      (const float  *a, const float  *b, int n);
 extern double ddot_naive      (const double *a, const double *b, int n);
 extern double dsdot_naive     (const float  *a, const float  *b, int n);
+extern void   dsdot4_naive    (const float  *a, const float *const *b, int n,
+                               double *res);
 
 #ifdef ARCH_IS_X86_64
 extern float  sdot_sse2       (const float  *a, const float  *b, int n);
 extern double ddot_sse2       (const double *a, const double *b, int n);
 extern double dsdot_sse2      (const float  *a, const float  *b, int n);
+extern void   dsdot4_sse2     (const float  *a, const float *const *b, int n,
+                               double *res);
 
 extern float  sdot_avx        (const float  *a, const float  *b, int n);
 extern double ddot_avx        (const double *a, const double *b, int n);
 extern double dsdot_avx       (const float  *a, const float  *b, int n);
+extern void   dsdot4_avx      (const float  *a, const float *const *b, int n,
+                               double *res);
 
 # ifndef DOT_NOFMA
 extern float  sdot_avxfma     (const float  *a, const float  *b, int n);
 extern double ddot_avxfma     (const double *a, const double *b, int n);
 extern double dsdot_avxfma    (const float  *a, const float  *b, int n);
+extern void   dsdot4_avxfma   (const float  *a, const float *const *b, int n,
+                               double *res);
 # endif
 # ifndef DOT_NOAVX512
 extern float  sdot_avx512     (const float  *a, const float  *b, int n);
 extern double ddot_avx512     (const double *a, const double *b, int n);
 extern double dsdot_avx512    (const float  *a, const float  *b, int n);
+extern void   dsdot4_avx512   (const float  *a, const float *const *b, int n,
+                               double *res);
 #  ifndef DOT_NOFMA
 extern float  sdot_avx512fma  (const float  *a, const float  *b, int n);
 extern double ddot_avx512fma  (const double *a, const double *b, int n);
 extern double dsdot_avx512fma (const float  *a, const float  *b, int n);
+extern void   dsdot4_avx512fma(const float  *a, const float *const *b, int n,
+                               double *res);
 #  endif
 # endif
 #endif
@@ -132,6 +160,11 @@ inline double dsdot (const float *a, const float *b, int n) {
   return (*dsdot_ptr)(a,b,n);
 }
 
+inline void dsdot4 (const float *a, const float *const *b, int n,
+                    double *res) {
+  (*dsdot4_ptr)(a,b,n,res);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,10 +25,14 @@
 inline float  sdot_avxfma  (const float  *a, const float  *b, int n);
 inline double ddot_avxfma  (const double *a, const double *b, int n);
 inline double dsdot_avxfma (const float  *a, const float  *b, int n);
+inline void   dsdot4_avxfma(const float  *a, const float *const *b, int n,
+                            double *res);
 #else
 inline float  sdot_avx     (const float  *a, const float  *b, int n);
 inline double ddot_avx     (const double *a, const double *b, int n);
 inline double dsdot_avx    (const float  *a, const float  *b, int n);
+inline void   dsdot4_avx   (const float  *a, const float *const *b, int n,
+                            double *res);
 #endif
 
 /*----------------------------------------------------------------------------
@@ -198,4 +202,61 @@ inline double dsdot_avx    (const float *a, const float *b, int n)
   return s;
 }  // dsdot_avx()
 
+/*--------------------------------------------------------------------------*/
+
+// --- four dot products sharing the first operand
+//     (input: single; intermediate and output: double)
+#ifdef __FMA__
+inline void dsdot4_avxfma (const float *a, const float *const *b, int n,
+                           double *res)
+#else
+inline void dsdot4_avx    (const float *a, const float *const *b, int n,
+                           double *res)
+#endif
+{
+  const float *b0 = b[0], *b1 = b[1], *b2 = b[2], *b3 = b[3];
+
+  // initialize 4 sums for each of the 4 dot products
+  __m256d s0 = _mm256_setzero_pd();
+  __m256d s1 = _mm256_setzero_pd();
+  __m256d s2 = _mm256_setzero_pd();
+  __m256d s3 = _mm256_setzero_pd();
+
+  // load 4 elements of a once, use them for all 4 products
+  for (int k = 0, nq = 4*(n/4); k < nq; k += 4) {
+    #ifdef __FMA__
+    __m256d ak = _mm256_cvtps_pd(_mm_loadu_ps(a+k));
+    s0 = _mm256_fmadd_pd(ak, _mm256_cvtps_pd(_mm_loadu_ps(b0+k)), s0);
+    s1 = _mm256_fmadd_pd(ak, _mm256_cvtps_pd(_mm_loadu_ps(b1+k)), s1);
+    s2 = _mm256_fmadd_pd(ak, _mm256_cvtps_pd(_mm_loadu_ps(b2+k)), s2);
+    s3 = _mm256_fmadd_pd(ak, _mm256_cvtps_pd(_mm_loadu_ps(b3+k)), s3);
+    #else
+    __m128 ak = _mm_loadu_ps(a+k);
+    s0 = _mm256_add_pd(
+      _mm256_cvtps_pd(_mm_mul_ps(ak, _mm_loadu_ps(b0+k))), s0);
+    s1 = _mm256_add_pd(
+      _mm256_cvtps_pd(_mm_mul_ps(ak, _mm_loadu_ps(b1+k))), s1);
+    s2 = _mm256_add_pd(
+      _mm256_cvtps_pd(_mm_mul_ps(ak, _mm_loadu_ps(b2+k))), s2);
+    s3 = _mm256_add_pd(
+      _mm256_cvtps_pd(_mm_mul_ps(ak, _mm_loadu_ps(b3+k))), s3);
+    #endif
+  }
+
+  // compute the 4 horizontal sums at once
+  __m256d h01 = _mm256_hadd_pd(s0, s1);  // s0 lo, s1 lo, s0 hi, s1 hi
+  __m256d h23 = _mm256_hadd_pd(s2, s3);  // s2 lo, s3 lo, s2 hi, s3 hi
+  _mm256_storeu_pd(res, _mm256_add_pd(
+    _mm256_permute2f128_pd(h01, h23, 0x21),  // s0 hi, s1 hi, s2 lo, s3 lo
+    _mm256_blend_pd(h01, h23, 0xC)));        // s0 lo, s1 lo, s2 hi, s3 hi
+
+  // add the remaining products
+  for (int k = 4*(n/4); k < n; k++) {
+    res[0] += a[k] * b0[k];
+    res[1] += a[k] * b1[k];
+    res[2] += a[k] * b2[k];
+    res[3] += a[k] * b3[k];
+  }
+}  // dsdot4_avx()
+
 #endif // DOT_AVX_H
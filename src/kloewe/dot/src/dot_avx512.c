@@ -12,8 +12,12 @@
 extern float  sdot_avx512fma  (const float  *a, const float  *b, int n);
 extern double ddot_avx512fma  (const double *a, const double *b, int n);
 extern double dsdot_avx512fma (const float  *a, const float  *b, int n);
+extern void   dsdot4_avx512fma(const float  *a, const float *const *b, int n,
+                               double *res);
 #else
 extern float  sdot_avx512     (const float  *a, const float  *b, int n);
 extern double ddot_avx512     (const double *a, const double *b, int n);
 extern double dsdot_avx512    (const float  *a, const float  *b, int n);
+extern void   dsdot4_avx512   (const float  *a, const float *const *b, int n,
+                               double *res);
 #endif
@@ -19,10 +19,14 @@
 inline float  sdot_avx512fma  (const float  *a, const float  *b, int n);
 inline double ddot_avx512fma  (const double *a, const double *b, int n);
 inline double dsdot_avx512fma (const float  *a, const float  *b, int n);
+inline void   dsdot4_avx512fma(const float  *a, const float *const *b, int n,
+                               double *res);
 #else
 inline float  sdot_avx512     (const float  *a, const float  *b, int n);
 inline double ddot_avx512     (const double *a, const double *b, int n);
 inline double dsdot_avx512    (const float  *a, const float  *b, int n);
+inline void   dsdot4_avx512   (const float  *a, const float *const *b, int n,
+                               double *res);
 #endif
 
 /*----------------------------------------------------------------------------
@@ -121,4 +125,60 @@ inline double dsdot_avx512    (const float *a, const float *b, int n)
   return s;
 }  // dsdot_avx512()
 
+/*--------------------------------------------------------------------------*/
+
+// --- four dot products sharing the first operand
+//     (input: single; intermediate and output: double)
+#ifdef __FMA__
+inline void dsdot4_avx512fma (const float *a, const float *const *b, int n,
+                              double *res)
+#else
+inline void dsdot4_avx512    (const float *a, const float *const *b, int n,
+                              double *res)
+#endif
+{
+  const float *b0 = b[0], *b1 = b[1], *b2 = b[2], *b3 = b[3];
+
+  // initialize 8 sums for each of the 4 dot products
+  __m512d s0 = _mm512_setzero_pd();
+  __m512d s1 = _mm512_setzero_pd();
+  __m512d s2 = _mm512_setzero_pd();
+  __m512d s3 = _mm512_setzero_pd();
+
+  // load 8 elements of a once, use them for all 4 products
+  for (int k = 0, nq = 8*(n/8); k < nq; k += 8) {
+    #ifdef __FMA__
+    __m512d ak = _mm512_cvtps_pd(_mm256_loadu_ps(a+k));
+    s0 = _mm512_fmadd_pd(ak, _mm512_cvtps_pd(_mm256_loadu_ps(b0+k)), s0);
+    s1 = _mm512_fmadd_pd(ak, _mm512_cvtps_pd(_mm256_loadu_ps(b1+k)), s1);
+    s2 = _mm512_fmadd_pd(ak, _mm512_cvtps_pd(_mm256_loadu_ps(b2+k)), s2);
+    s3 = _mm512_fmadd_pd(ak, _mm512_cvtps_pd(_mm256_loadu_ps(b3+k)), s3);
+    #else
+    __m256 ak = _mm256_loadu_ps(a+k);
+    s0 = _mm512_add_pd(_mm512_cvtps_pd(
+           _mm256_mul_ps(ak, _mm256_loadu_ps(b0+k))), s0);
+    s1 = _mm512_add_pd(_mm512_cvtps_pd(
+           _mm256_mul_ps(ak, _mm256_loadu_ps(b1+k))), s1);
+    s2 = _mm512_add_pd(_mm512_cvtps_pd(
+           _mm256_mul_ps(ak, _mm256_loadu_ps(b2+k))), s2);
+    s3 = _mm512_add_pd(_mm512_cvtps_pd(
+           _mm256_mul_ps(ak, _mm256_loadu_ps(b3+k))), s3);
+    #endif
+  }
+
+  // compute horizontal sums
+  res[0] = _mm512_reduce_add_pd(s0);
+  res[1] = _mm512_reduce_add_pd(s1);
+  res[2] = _mm512_reduce_add_pd(s2);
+  res[3] = _mm512_reduce_add_pd(s3);
+
+  // add the remaining products
+  for (int k = 8*(n/8); k < n; k++) {
+    res[0] += a[k] * b0[k];
+    res[1] += a[k] * b1[k];
+    res[2] += a[k] * b2[k];
+    res[3] += a[k] * b3[k];
+  }
+}  // dsdot4_avx512()
+
 #endif // DOT_AVX512_H
@@ -12,6 +12,8 @@
 inline float  sdot_naive  (const float  *a, const float  *b, int n);
 inline double ddot_naive  (const double *a, const double *b, int n);
 inline double dsdot_naive (const float  *a, const float  *b, int n);
+inline void   dsdot4_naive(const float  *a, const float *const *b, int n,
+                           double *res);
 
 /*----------------------------------------------------------------------------
   Inline Functions
@@ -60,4 +62,20 @@ inline double dsdot_naive (const float *a, const float *b, int n)
   return sum;
 }  // dsdot_naive()
 
+// --- four dot products sharing the first operand
+//     (input: single; intermediate and output: double)
+inline void dsdot4_naive (const float *a, const float *const *b, int n,
+                          double *res)
+{
+  const float *b0 = b[0], *b1 = b[1], *b2 = b[2], *b3 = b[3];
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  for (int k = 0; k < n; k++) {
+    s0 += a[k] * b0[k];
+    s1 += a[k] * b1[k];
+    s2 += a[k] * b2[k];
+    s3 += a[k] * b3[k];
+  }
+  res[0] = s0; res[1] = s1; res[2] = s2; res[3] = s3;
+}  // dsdot4_naive()
+
 #endif // DOT_NAIVE_H
@@ -11,3 +11,5 @@
 extern float  sdot_sse2  (const float  *a, const float  *b, int n);
 extern double ddot_sse2  (const double *a, const double *b, int n);
 extern double dsdot_sse2 (const float  *a, const float  *b, int n);
+extern void   dsdot4_sse2(const float  *a, const float *const *b, int n,
+                          double *res);
@@ -32,6 +32,8 @@
 inline float  sdot_sse2  (const float  *a, const float  *b, int n);
 inline double ddot_sse2  (const double *a, const double *b, int n);
 inline double dsdot_sse2 (const float  *a, const float  *b, int n);
+inline void   dsdot4_sse2(const float  *a, const float *const *b, int n,
+                          double *res);
 
 /*----------------------------------------------------------------------------
   Inline Functions
@@ -181,4 +183,58 @@ inline double dsdot_sse2 (const float *a, const float *b, int n)
   return s;
 }  // dsdot_sse2()
 
+/*--------------------------------------------------------------------------*/
+
+// --- four dot products sharing the first operand
+//     (input: single; intermediate and output: double)
+inline void dsdot4_sse2 (const float *a, const float *const *b, int n,
+                         double *res)
+{
+  const float *b0 = b[0], *b1 = b[1], *b2 = b[2], *b3 = b[3];
+
+  // initialize 2 sums (low and high half) for each of the 4 dot products
+  __m128d s0l = _mm_setzero_pd(), s0h = _mm_setzero_pd();
+  __m128d s1l = _mm_setzero_pd(), s1h = _mm_setzero_pd();
+  __m128d s2l = _mm_setzero_pd(), s2h = _mm_setzero_pd();
+  __m128d s3l = _mm_setzero_pd(), s3h = _mm_setzero_pd();
+
+  // load 4 elements of a once, use them for all 4 products
+  // note that _mm_cvtps_pd() converts *the lower two* SPFP values
+  for (int k = 0, nq = 4*(n/4); k < nq; k += 4) {
+    __m128 ak = _mm_loadu_ps(a+k);
+    __m128 p0 = _mm_mul_ps(ak, _mm_loadu_ps(b0+k));
+    __m128 p1 = _mm_mul_ps(ak, _mm_loadu_ps(b1+k));
+    __m128 p2 = _mm_mul_ps(ak, _mm_loadu_ps(b2+k));
+    __m128 p3 = _mm_mul_ps(ak, _mm_loadu_ps(b3+k));
+    s0l = _mm_add_pd(s0l, _mm_cvtps_pd(p0));
+    s0h = _mm_add_pd(s0h, _mm_cvtps_pd(_mm_movehl_ps(p0, p0)));
+    s1l = _mm_add_pd(s1l, _mm_cvtps_pd(p1));
+    s1h = _mm_add_pd(s1h, _mm_cvtps_pd(_mm_movehl_ps(p1, p1)));
+    s2l = _mm_add_pd(s2l, _mm_cvtps_pd(p2));
+    s2h = _mm_add_pd(s2h, _mm_cvtps_pd(_mm_movehl_ps(p2, p2)));
+    s3l = _mm_add_pd(s3l, _mm_cvtps_pd(p3));
+    s3h = _mm_add_pd(s3h, _mm_cvtps_pd(_mm_movehl_ps(p3, p3)));
+  }
+  s0l = _mm_add_pd(s0l, s0h);
+  s1l = _mm_add_pd(s1l, s1h);
+  s2l = _mm_add_pd(s2l, s2h);
+  s3l = _mm_add_pd(s3l, s3h);
+
+  // compute horizontal sums, two at a time
+  __m128d h01 = _mm_add_pd(_mm_unpacklo_pd(s0l, s1l),
+                           _mm_unpackhi_pd(s0l, s1l));
+  __m128d h23 = _mm_add_pd(_mm_unpacklo_pd(s2l, s3l),
+                           _mm_unpackhi_pd(s2l, s3l));
+  _mm_storeu_pd(res,   h01);
+  _mm_storeu_pd(res+2, h23);
+
+  // add the remaining products
+  for (int k = 4*(n/4); k < n; k++) {
+    res[0] += a[k] * b0[k];
+    res[1] += a[k] * b1[k];
+    res[2] += a[k] * b2[k];
+    res[3] += a[k] * b3[k];
+  }
+}  // dsdot4_sse2()
+
 #endif // DOT_SSE2_H